@@ -102,6 +102,8 @@ def make_all(project_dir, output_dir):
         strip_binary(output)
         output_file_path = os.path.join(output_dir, output)
         os.rename(output, output_file_path)
+    # The constants of the model, mapped by the libraries and binaries at init
+    shutil.copy("weights.bin", output_dir)
     # Return running directory
     os.chdir(running_dir)
 
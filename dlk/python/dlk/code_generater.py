@@ -20,11 +20,14 @@ import shutil
 import utils
 from template import Template
 
+from core.activation_arena import ActivationArena
 from core.config import Config
+from core.dma_plan import DmaPlan
 from core.graph import Graph
+from core.layer_cost import layer_costs
 from core.operators import Conv
+from core.weight_file import WeightFile
 from typing import cast
-from collections import defaultdict
 
 
 class CodeGenerater(object):
@@ -37,12 +40,16 @@ class CodeGenerater(object):
         self.params = params
         self.config = config
         assert len(self.graph.get_inputs()) == 1, 'Codegenerator does not support multiple inputs.'
+        self.arena = ActivationArena(self.graph)
         self.template = Template({
             'graph': self.graph,
             'params': self.params,
             'config': self.config,
             'graph_input': self.graph.get_inputs()[0],
             'graph_output': self.graph.non_variables[-1],
+            'arena': self.arena,
+            'layers': layer_costs(self.graph),
+            'dma_plan': DmaPlan(self.graph),
         })
         self.src_dir = path.join(self.config.output_pj_path, 'src')
         self.header_dir = path.join(self.config.output_pj_path, 'include')
@@ -89,6 +96,9 @@ class CodeGenerater(object):
                                           new_name=node.name + '.h',
                                           node=node)
 
+    def generate_weights(self) -> None:
+        WeightFile(self.graph).write(path.join(self.config.output_pj_path, 'weights.bin'))
+
     def generate_thresholds(self):
         src_template_path = path.join('manual', 'consts', 'thresholds.tpl.cpp')
         header_template_path = path.join('manual', 'consts', 'thresholds.tpl.h')
@@ -119,44 +129,3 @@ class CodeGenerater(object):
         self.template.generate(header_template_path,
                                self.header_dir,
                                quantized_convs=qconvs_convs)
-
-    def reuse_output_buffers(self):
-
-        operations = self.graph.non_variables
-        candidates = defaultdict(set)
-
-        for idx, op in enumerate(operations):
-            prev_ops = operations[:idx]
-            next_ops = operations[idx:]
-
-            next_inputs = []
-            for x in next_ops:
-                for i in x.input_ops.values():
-                    next_inputs.append(i.name)
-
-            aliased = set()
-            for prev_op in prev_ops:
-                if prev_op.op_type in ['Reshape', 'Split']:
-                    aliased.add(prev_op.name)
-                    for i in prev_op.input_ops.values():
-                        aliased.add(i.name)
-                if prev_op.name not in next_inputs and prev_op.size >= op.size and prev_op.dtype == op.dtype:
-                    candidates[op.name].add(prev_op.name)
-
-            candidates[op.name] = candidates[op.name].difference(aliased)
-
-        being_reused = []
-        reusing = []
-        for op in operations:
-            cs = candidates[op.name]
-            if cs:
-                reusable_buffer = None
-                for option in cs:
-                    if option not in being_reused and option not in reusing:
-                        reusable_buffer = option
-                        break
-
-                if reusable_buffer:
-                    op.available_buffer = reusable_buffer
-                    being_reused.append(reusable_buffer)
-                    reusing.append(op.name)
@@ -0,0 +1,104 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Static placement of the activation buffers of the generated network."""
+from typing import Dict, List
+
+import numpy as np
+
+from core.graph import Graph
+
+
+class ActivationBuffer(object):
+    """An output buffer of an operator and the range of operators it is alive for."""
+
+    def __init__(self, name: str, cpptype: str, elems: int, nbytes: int, first: int, last: int) -> None:
+        self.name = name
+        self.cpptype = cpptype
+        self.elems = elems
+        self.nbytes = nbytes
+        self.first = first
+        self.last = last
+        self.offset = 0
+
+    def overlaps(self, other: 'ActivationBuffer') -> bool:
+        """Return True if both buffers are alive at the same time."""
+        return self.first <= other.last and other.first <= self.last
+
+
+class ActivationArena(object):
+    """Single arena holding every activation buffer at a fixed offset.
+
+    The liveness of each buffer is computed over `graph.non_variables`: a buffer
+    is alive from the operator which writes it to the last operator which reads it.
+    Buffers whose lifetimes do not intersect may share the same bytes.
+    """
+
+    def __init__(self, graph: Graph, alignment: int = 64) -> None:
+        self.alignment = alignment
+        self.buffers = self._compute_liveness(graph)
+        self.size = self._assign_offsets()
+
+    def _align(self, n: int) -> int:
+        return (n + self.alignment - 1) // self.alignment * self.alignment
+
+    def _compute_liveness(self, graph: Graph) -> List[ActivationBuffer]:
+        operations = graph.non_variables
+        last_use: Dict[str, int] = {}
+        for idx, op in enumerate(operations):
+            last_use[op.name] = idx
+            for i in op.input_ops.values():
+                if not i.is_variable:
+                    last_use[i.name] = idx
+
+        # the graph output is copied out after the last operator has run
+        if operations:
+            last_use[operations[-1].name] = len(operations)
+
+        buffers = []
+        for idx, op in enumerate(operations):
+            elems = op.size
+            nbytes = elems * np.dtype(op.dtype.nptype()).itemsize
+            output_keys = list(op.output_ops.keys())
+            if len(output_keys) > 1:
+                names = [op.name + '_' + k for k in output_keys]
+            elif output_keys:
+                names = [op.name]
+            else:
+                names = []
+            for name in names:
+                buffers.append(ActivationBuffer(name, op.dtype.cpptype(), elems, nbytes, idx, last_use[op.name]))
+
+        return buffers
+
+    def _assign_offsets(self) -> int:
+        """Greedy by size: place large buffers first at the lowest offset that is free during their lifetime."""
+        placed: List[ActivationBuffer] = []
+        for buf in sorted(self.buffers, key=lambda b: (-b.nbytes, b.first)):
+            offset = 0
+            for other in sorted([p for p in placed if p.overlaps(buf)], key=lambda b: b.offset):
+                if offset + buf.nbytes <= other.offset:
+                    break
+                offset = max(offset, self._align(other.offset + other.nbytes))
+            buf.offset = offset
+            placed.append(buf)
+
+        total = max([b.offset + b.nbytes for b in self.buffers], default=0)
+        return max(self.alignment, self._align(total))
+
+    @property
+    def naive_size(self) -> int:
+        """Size which would be needed without sharing any buffer."""
+        return sum(self._align(b.nbytes) for b in self.buffers)
@@ -67,12 +67,20 @@ class Int(Special, int):
     def cpptype(cls):
         return 'int'
 
+    @classmethod
+    def nptype(cls):
+        return np.int32
+
 
 class UInt(Special, int):
     @classmethod
     def cpptype(cls):
         return 'unsigned'
 
+    @classmethod
+    def nptype(cls):
+        return np.uint32
+
 
 class Int8(Primitive, int):
     @classmethod
@@ -111,7 +119,7 @@ class Uint16(Primitive, int):
 
     @classmethod
     def nptype(cls):
-        return np.uint8
+        return np.uint16
 
 
 class Int32(Primitive, int):
@@ -183,6 +191,10 @@ class Float(Special, float):
     def cpptype(cls):
         return 'float'
 
+    @classmethod
+    def nptype(cls):
+        return np.float32
+
 
 class Float32(Primitive, float):
     @classmethod
@@ -0,0 +1,105 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Placement of the quantized convolution inputs in the DMA buffers of the FPGA."""
+from typing import Dict, List
+
+from core.graph import Graph
+from core.operators import Operator
+
+# indices of the two DMA buffers of a lane
+INPUT_BUFFER = 0
+OUTPUT_BUFFER = 1
+
+
+class DmaConv(object):
+    """DMA buffers a quantized convolution reads its input from and writes its output to."""
+
+    def __init__(self, name: str, input_buffer: int, output_buffer: int) -> None:
+        self.name = name
+        self.input_buffer = input_buffer
+        self.output_buffer = output_buffer
+
+    @property
+    def swapped(self) -> bool:
+        """Return True if the convolution reads the output DMA buffer and writes the input one."""
+        return self.input_buffer != INPUT_BUFFER
+
+
+class DmaTensor(object):
+    """An activation which lives in a DMA buffer instead of the activation arena."""
+
+    def __init__(self, name: str, buffer: int) -> None:
+        self.name = name
+        self.buffer = buffer
+
+
+class DmaPlan(object):
+    """Packed activations which go to the FPGA without a copy.
+
+    By default a quantized convolution copies its input into the input DMA
+    buffer and the TCA writes the output into the output DMA buffer, from where
+    it is copied into the activation arena. When a packed ChHWBCl activation is
+    only read by the next quantized convolution to run, its producer writes it
+    straight into a DMA buffer, which that convolution then reads in place.
+    A convolution reading the output of another one swaps the two buffers, so
+    chains of thresholded convolutions never copy their activations.
+    """
+
+    def __init__(self, graph: Graph) -> None:
+        self.convs: List[DmaConv] = []
+        self.tensors: List[DmaTensor] = []
+        self._plan(graph)
+
+    @staticmethod
+    def _is_device_conv(op: Operator) -> bool:
+        return op.op_type == 'Conv' and op.is_quantized
+
+    def _plan(self, graph: Graph) -> None:
+        operations = graph.non_variables
+        # the graph input is not generated as a layer and the graph output is
+        # copied to the caller, so both stay out of the DMA buffers
+        position = {op.name: idx for idx, op in enumerate(operations[:-1])}
+        conv_positions = [idx for idx, op in enumerate(operations) if self._is_device_conv(op)]
+        output_buffer: Dict[str, int] = {}
+
+        for idx in conv_positions:
+            conv = operations[idx]
+            x = conv.input_ops['X']
+
+            in_place = (
+                x.name in position
+                and x.dtype.cpptype() == 'QUANTIZED_PACKED'
+                and x.dimension == 'ChHWBCl'
+                and len(x.output_ops) == 1
+                and x.output_op_list == [conv]
+                # another convolution in between would overwrite the buffer
+                and not any(position[x.name] < c < idx for c in conv_positions)
+            )
+
+            if in_place:
+                buffer = output_buffer.get(x.name, INPUT_BUFFER)
+                self.tensors.append(DmaTensor(x.name, buffer))
+                planned = DmaConv(conv.name, buffer, 1 - buffer)
+            else:
+                planned = DmaConv(conv.name, INPUT_BUFFER, OUTPUT_BUFFER)
+
+            output_buffer[conv.name] = planned.output_buffer
+            self.convs.append(planned)
+
+    @property
+    def swaps_buffers(self) -> bool:
+        """Return True if some convolution reads the output DMA buffer, so both need room for either role."""
+        return any(c.swapped for c in self.convs)
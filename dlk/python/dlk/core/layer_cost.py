@@ -0,0 +1,64 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Static cost of every generated layer, attached to the runtime profile."""
+from typing import List
+
+import numpy as np
+
+from core.graph import Graph
+from core.operators import Operator
+
+
+class LayerCost(object):
+    """Name, operator type, arithmetic and memory traffic of one layer."""
+
+    def __init__(self, name: str, op_type: str, flops: int, nbytes: int) -> None:
+        self.name = name
+        self.op_type = op_type
+        self.flops = flops
+        self.nbytes = nbytes
+
+
+def _nbytes(op: Operator) -> int:
+    return op.size * np.dtype(op.dtype.nptype()).itemsize
+
+
+def _flops(op: Operator) -> int:
+    """Multiply and add count as two operations, everything else as one per output element."""
+    try:
+        if op.op_type == 'Conv':
+            kd = op.input_ops['X'].channel
+            return 2 * op.size * op.kernel_height * op.kernel_width * kd
+        if op.op_type in ('MaxPool', 'AveragePool'):
+            return op.size * op.kernel_height * op.kernel_width
+        if op.op_type in ('MatMul', 'Gemm'):
+            a = list(op.input_ops.values())[0]
+            return 2 * op.size * a.shape[-1]
+    except (ValueError, IndexError, KeyError):
+        pass
+    return op.size
+
+
+def layer_costs(graph: Graph) -> List[LayerCost]:
+    """Return the cost of every operator of `graph.non_variables`, in run order.
+
+    The traffic counts every input once, weights included, plus the output.
+    """
+    costs = []
+    for op in graph.non_variables:
+        nbytes = _nbytes(op) + sum(_nbytes(i) for i in op.input_ops.values())
+        costs.append(LayerCost(op.name, op.op_type, _flops(op), nbytes))
+    return costs
@@ -53,7 +53,6 @@ class Operator(object):
         self.__connect_to_outputs()
         self._check_consistency()
         self._rank = len(shape)
-        self._available_buffer = ''
 
     def update_shape(self, shape: List[int], dimension_format: str) -> None:
         self._shape: List[int] = shape
@@ -433,14 +432,6 @@ class Operator(object):
     def rank(self) -> int:
         return self._rank
 
-    @property
-    def available_buffer(self) -> str:
-        return self._available_buffer
-
-    @available_buffer.setter
-    def available_buffer(self, v: str) -> None:
-        self._available_buffer = v
-
     def transpose(self, perm: List[int]) -> None:
         """Transpose the shape and format. This operation is destructive."""
         self._assert(len(set(perm)) == len(self._shape), "Illegal permutation spacified.")
@@ -1046,6 +1037,10 @@ class Conv(Operator):
         self._a_quantizer: List['Quantizer'] = []
         self._quantizer: Optional['Quantizer'] = None
         self._thresholds = thresholds
+        self._epilogue_scale: Optional[List[float]] = None
+        self._epilogue_shift: Optional[List[float]] = None
+        self._epilogue_activation = ''
+        self._epilogue_alpha = 0.0
         self._original_shape = shape
         super().__init__(name, shape, dtype, input_ops, dimension_format=dimension_format)
         # if kernel shape is not assigned, estimate kernel shape from input W's shape
@@ -1090,7 +1085,7 @@ class Conv(Operator):
             # print(self.name, ' stride_H: ', stride_H)
             # print(self.name, ' output height: ', self.height, ' (', self.index_H, ' in ', self.dimension, ')')
             output_H_base = self.input_ops['X'].height + pad_H - \
-                (self.kernel_height + 2 * (dilation_H - 1))
+                ((self.kernel_height - 1) * dilation_H + 1)
             # print(self.name, ' output_H_base ', output_H_base)
             output_H, output_H_rest = divmod(output_H_base, stride_H)
             output_H += 1
@@ -1115,7 +1110,7 @@ class Conv(Operator):
             # print(self.name, ' stride_W: ', stride_W)
             # print(self.name, ' output width: ', self.width, ' (', self.index_W, ' in ', self.dimension, ')')
             output_W_base = self.input_ops['X'].width + pad_W - \
-                (self.kernel_width + 2 * (dilation_W - 1))
+                ((self.kernel_width - 1) * dilation_W + 1)
             output_W, output_W_rest = divmod(output_W_base, stride_W)
             output_W += 1
             message = f'Conv operator {self.name} does not match the width:'
@@ -1229,6 +1224,47 @@ class Conv(Operator):
     def thresholds(self, val: List[float]) -> None:
         self._thresholds = val
 
+    @property
+    def has_epilogue(self) -> bool:
+        """Whether the float output of the quantized convolution gets its scaling factor,
+        a folded batch normalization and an activation in the same pass."""
+        return self.is_quantized and not self.has_thresholds and self._epilogue_scale is not None
+
+    @property
+    def epilogue_scale(self) -> Optional[List[float]]:
+        """Per output channel factor of the integer accumulator, the scaling factor included."""
+        return self._epilogue_scale
+
+    @epilogue_scale.setter
+    def epilogue_scale(self, val: Optional[List[float]]) -> None:
+        self._epilogue_scale = val
+
+    @property
+    def epilogue_shift(self) -> Optional[List[float]]:
+        """Per output channel offset added after the scale."""
+        return self._epilogue_shift
+
+    @epilogue_shift.setter
+    def epilogue_shift(self, val: Optional[List[float]]) -> None:
+        self._epilogue_shift = val
+
+    @property
+    def epilogue_activation(self) -> str:
+        """Op type of the activation applied last ('Relu' or 'LeakyRelu'), or '' for none."""
+        return self._epilogue_activation
+
+    @epilogue_activation.setter
+    def epilogue_activation(self, val: str) -> None:
+        self._epilogue_activation = val
+
+    @property
+    def epilogue_alpha(self) -> float:
+        return self._epilogue_alpha
+
+    @epilogue_alpha.setter
+    def epilogue_alpha(self, val: float) -> None:
+        self._epilogue_alpha = val
+
     @classmethod
     def infer_shape(cls, lists: Dict[str, List[int]], format: str, input_formats: List[str],
                     attrs: Dict[str, Any]) -> List[int]:
@@ -21,7 +21,8 @@ import numpy as np
 from core.graph import Graph
 from core.graph_pattern_matching import get_nodes_in_branch, sort_graph
 from core.operators import Constant, Operator, Conv, Lookup
-from core.data_types import Uint32, Int32, QUANTIZED_NOT_PACKED, QUANTIZED_PACKED, PackedUint32, QUANTIZED_PACKED_KERNEL
+from core.data_types import Float32, Uint32, Int32, QUANTIZED_NOT_PACKED, QUANTIZED_PACKED, PackedUint32, \
+    QUANTIZED_PACKED_KERNEL
 from typing import cast, List, Any
 from collections import defaultdict
 from modules.packer import Packer
@@ -507,6 +508,74 @@ def pass_quantize_convolutions(graph: Graph) -> None:
             qtz.update_shape([height, width, depth_upper, 2, b], "HWChBCl")
 
 
+def pass_fuse_conv_epilogue(graph: Graph) -> None:
+    """Given a quantized convolution node C without thresholds, whose output is float:
+         - if the only consumer of C is a BatchNormalization node B with constant parameters, B is folded into
+           a scale and a shift per output channel,
+         - if then the only consumer is a Relu or LeakyRelu node A, A is folded too,
+       and C applies its scaling factor, B and A to the integer accumulator while it writes its output.
+       This saves the passes of B and A over the whole output tensor.
+
+    Parameters
+    ----------
+    graph : Graph
+        The input graph. It will be modified in-place.
+    """
+    # temporary: (2^n - 1) * (max - min), the same factor as func_QuantizedConv2D
+    post_qtz_factor = 2.0 / 3.0
+
+    exec_list = [n for n in sort_graph(graph) if n.op_type == 'Conv']
+    to_be_removed = []
+    for m in exec_list:
+        conv_node = cast(Conv, m)
+        if not conv_node.is_quantized or conv_node.has_thresholds or conv_node.dtype != Float32():
+            continue
+
+        ch = conv_node.channel
+        scale = np.broadcast_to(np.float64(conv_node.quantizer.scaling_factor) * post_qtz_factor, [ch]).copy()
+        shift = np.zeros([ch], dtype=np.float64)
+        last = conv_node
+
+        consumers = conv_node.output_ops['Y']
+        if len(consumers) == 1 and consumers[0].op_type == 'BatchNormalization':
+            bn = consumers[0]
+            params = [bn.input_ops[name] for name in ['scale', 'B', 'mean', 'var']]
+            if all(isinstance(param, Constant) for param in params):
+                gamma, beta, mean, var = [np.asarray(param.data, dtype=np.float64).flatten() for param in params]
+                factor = gamma / np.sqrt(var + bn.epsilon)
+                scale *= factor
+                shift = beta - mean * factor
+                to_be_removed.append(bn)
+                to_be_removed += [param for param in params if len(param.output_ops['output']) == 1]
+                last = bn
+
+        consumers = last.output_ops['Y']
+        if len(consumers) == 1 and consumers[0].op_type in ['Relu', 'LeakyRelu']:
+            activation = consumers[0]
+            conv_node.epilogue_activation = activation.op_type
+            conv_node.epilogue_alpha = activation.alpha if activation.op_type == 'LeakyRelu' else 0.0
+            to_be_removed.append(activation)
+            last = activation
+
+        conv_node.epilogue_scale = scale.astype(np.float32).tolist()
+        conv_node.epilogue_shift = shift.astype(np.float32).tolist()
+        if last == conv_node:
+            continue
+
+        # the consumers of the last folded node read the convolution instead
+        out_ops = last.output_ops['Y']
+        for output_node in out_ops:
+            for input_name, input_node in output_node.input_ops.items():
+                if input_node == last:
+                    output_node.add_input(input_name, conv_node)
+
+        conv_node.remove_output('Y')
+        conv_node.add_outputs({'Y': out_ops})
+
+    for op in to_be_removed:
+        graph.remove_op(op)
+
+
 def pass_propagate_datatypes(graph) -> None:
     """Further propagate output data types.
 
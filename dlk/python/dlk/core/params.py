@@ -90,12 +90,15 @@ class Params(object):
     def max_size_im2col_inputs_per_layer(self):
         convs = self.graph.convs()
 
+        # the whole input is converted into the buffer too, which is the larger
+        # one when the stride is more than the kernel
         im2col_input_sizes = \
-            [(
+            [max(
                 x.kernel_height *
                 x.kernel_width *
                 x.input_ops['X'].channel *
-                x.height * x.width
+                x.height * x.width,
+                x.input_ops['X'].size
             ) for x in convs]
 
         if len(im2col_input_sizes) != 0:
@@ -103,19 +106,72 @@ class Params(object):
         else:
             return 0
 
+    # a band of the quantized kn2row convolution is not made smaller than
+    # this (int32) unless the whole layer fits, see Workspace::kn2row_buf_elems.
+    kn2row_min_band = 1 << 18
+
     @property
     def max_size_kn2row_buffer_per_layer(self) -> int:
-        convs: List[Conv] = self.graph.convs()
+        """Products of one band of the quantized 3x3 kn2row convolution.
 
-        kn2row_buffer_sizes = \
-            [(
-                x.kernel_height *
-                x.kernel_width *
-                x.height * x.width *
-                x.channel
-            ) for x in convs]
-
-        return max(kn2row_buffer_sizes) if kn2row_buffer_sizes else 0
+        A band of output rows needs the 9 * oc products of every pixel in its
+        rows and the row above and below, so the buffer holds at least three
+        rows of the largest layer.
+        """
+        # only the quantized 3x3 convolutions still go through kn2row
+        convs: List[Conv] = [x for x in self.graph.convs()
+                             if not self._is_float_conv(x) and x.kernel_height == 3 and x.kernel_width == 3]
+
+        sizes = []
+        for x in convs:
+            # the output channels are padded to a multiple of 32, as in core/view.py
+            oc = (x.channel + 31) // 32 * 32
+            row = x.kernel_height * x.kernel_width * oc * x.width
+            layer = row * x.height
+            sizes.append(min(layer, max(3 * row, self.kn2row_min_band)))
+
+        return max(sizes) if sizes else 0
+
+    # these follow the float convolution in templates/src/func/conv2d.cpp:
+    # inputs with at most this many channels are convolved directly,
+    float_conv_direct_max_depth = 4
+    # the packed right hand side of a matrix multiplication has up to this
+    # many columns more than the matrix,
+    float_conv_matmul_pad_cols = 8
+    # and a band is not made smaller than this (floats) unless the whole
+    # layer fits, so that the matrix multiplications stay large enough.
+    float_conv_min_band = 1 << 21
+
+    @staticmethod
+    def _is_float_conv(x: Conv) -> bool:
+        return not (x.is_quantized and x.input_ops['X'].op_type != 'Input')
+
+    @property
+    def max_size_float_conv_buffer_per_layer(self) -> int:
+        """Floats of one band of the float convolution, see Workspace::float_conv_buf_elems.
+
+        A band is some output rows of the im2col matrix, or some rows of
+        winograd tiles with their transformed outputs. It must hold at
+        least one row of the largest layer.
+        """
+        sizes = []
+        for x in filter(self._is_float_conv, self.graph.convs()):
+            ic = x.input_ops['X'].channel
+            if ic <= self.float_conv_direct_max_depth:
+                continue
+            kh, kw = x.kernel_height, x.kernel_width
+            winograd = kh == 3 and kw == 3 and x.strides == [1, 1] and x.dilations == [1, 1]
+            if winograd:
+                tile_cols = (x.width + 1) // 2
+                row = 16 * (ic + x.channel) * tile_cols
+                layer = row * ((x.height + 1) // 2)
+            else:
+                k = kh * kw * ic
+                row = k * (x.width + self.float_conv_matmul_pad_cols)
+                layer = k * (x.height * x.width + self.float_conv_matmul_pad_cols)
+            sizes.append(min(layer, max(row, self.float_conv_min_band)))
+
+        return max(sizes) if sizes else 0
 
     @property
     def max_size_im2col_qinputs_per_layer(self):
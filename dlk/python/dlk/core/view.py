@@ -21,7 +21,6 @@ from textwrap import dedent
 class View(object):
     def __init__(self, op):
         self.op = op
-        self.reuse_buffer_str = ''
 
     @property
     def rank(self):
@@ -35,25 +34,174 @@ class View(object):
     def shape_list(self):
         return ','.join(map(lambda x: str(x), self.op.shape))
 
-    def run(self):
+    def params(self):
+        """Return the parameter structs of this operator.
+
+        They only depend on the graph, so the network declares them once before
+        the frame loop of `run_batch` and every frame reuses them.
+        """
         op = self.op
         input_ops = op.input_ops
-        output_ops = op.output_ops
-        inputs_string = self.inputs_to_string(input_ops)
-        shape_string = self.shape_to_string(op.shape)
 
-        if op.available_buffer != '':
-            if len(op.output_ops.keys()) > 1:
-                op_name = op.name + '_' + str(list(op.output_ops.keys())[0])
+        if op.op_type == 'Conv':
+            x_op = input_ops['X']
+            w_op = input_ops['W']
+
+            ih = x_op.height
+            iw = x_op.width
+            oh = op.height
+            ow = op.width
+            b = 32
+            od = op.channel
+            pad_top = op.pads[op.kernel_index_H]
+            pad_left = op.pads[op.kernel_index_W]
+            stride_h = op.strides[op.kernel_index_H]
+            stride_w = op.strides[op.kernel_index_W]
+            dilation_h, dilation_w = op.dilations
+            kh = op.kernel_height
+            kw = op.kernel_width
+            kd = x_op.channel
+            k_elems = kh * kw * kd
+            nbit_qinput = 8 if x_op.op_type == 'Input' else 2
+
+            if op.is_quantized and nbit_qinput == 2:
+                od = ((od + b - 1) // b) * b
+
+            conv_params = self.format_string(
+                f"""
+                struct convolution_parameters {op.name}_conv_params;
+                {op.name}_conv_params.input_height = {ih};
+                {op.name}_conv_params.input_width = {iw};
+                {op.name}_conv_params.kernel_height = {kh};
+                {op.name}_conv_params.kernel_width = {kw};
+                {op.name}_conv_params.kernel_depth = {kd};
+                {op.name}_conv_params.kernel_elements = {k_elems};
+                {op.name}_conv_params.output_channels = {od};
+                {op.name}_conv_params.output_height = {oh};
+                {op.name}_conv_params.output_width = {ow};
+                {op.name}_conv_params.padding = {pad_top};
+                {op.name}_conv_params.padding_top = {pad_top};
+                {op.name}_conv_params.padding_left = {pad_left};
+                {op.name}_conv_params.stride_along_height = {stride_h};
+                {op.name}_conv_params.stride_along_width = {stride_w};
+                {op.name}_conv_params.dilation_along_height = {dilation_h};
+                {op.name}_conv_params.dilation_along_width = {dilation_w};
+                {op.name}_conv_params.workspace = &workspace;
+                {op.name}_conv_params.thread_pool = &thread_pool;
+                """
+            )
+
+            if not (op.is_quantized and nbit_qinput == 2):
+                return conv_params
+
+            qk_elems = w_op.data.shape[1]
+
+            if op.has_thresholds:
+                threshold = f'{op.name}_thresholds'
+                thresholds_addr = f'THRESHOLD_ADDR + {op.name}_thresholds_offset'
+                nbit_aqtz = op.a_quantizer[0].nbit
+                max_value = op.a_quantizer[0].max_v
             else:
-                op_name = op.name
+                threshold = 'nullptr'
+                thresholds_addr = '0'
+                nbit_aqtz = 2
+                max_value = 2.0
+
+            # temporary: formula which derive number of qinput is not complete
+            bin_conv_params = conv_params + '\n\n' + self.format_string(
+                f"""
+                struct binary_convolution_parameters {op.name}_params;
+                {op.name}_params.normal_conv_params = {op.name}_conv_params;
+                {op.name}_params.bin_input_extra_bits = 0;
+                {op.name}_params.bin_input_bitwidth = {nbit_qinput};
+                {op.name}_params.bin_kernel_ndata = {qk_elems};
+                {op.name}_params.bin_input_nwords = {qk_elems};
+                {op.name}_params.bin_input_ndata = {qk_elems}*{nbit_qinput};
+                {op.name}_params.device_input_buf = lane.device_input_buf;
+                {op.name}_params.device_output_buf = lane.device_output_buf;
+                {op.name}_params.thresholds = {threshold};
+                {op.name}_params.n_bit = {nbit_aqtz};
+                {op.name}_params.max_value = {max_value};
+                {op.name}_params.debug_name = "{op.name}";
+#ifdef RUN_ON_FPGA
+                {op.name}_params.device_input_phys_addr = lane.dma_input_buffer.physical_address();
+                {op.name}_params.device_output_phys_addr = lane.dma_output_buffer.physical_address();
+                {op.name}_params.dma_input_buffer = &lane.dma_input_buffer;
+                {op.name}_params.dma_output_buffer = &lane.dma_output_buffer;
+                {op.name}_params.device_kernel_phys_addr = KERNEL_ADDR + {op.name}_kernel_offset;
+                {op.name}_params.device_thresholds_phys_addr = {thresholds_addr};
+#endif
+                """
+            )
+
+            if not op.has_epilogue:
+                return bin_conv_params
+
+            activation = {'': 'None', 'Relu': 'Relu', 'LeakyRelu': 'LeakyRelu'}[op.epilogue_activation]
+
+            return bin_conv_params + '\n\n' + self.format_string(
+                f"""
+                struct conv_epilogue_parameters {op.name}_epilogue;
+                {op.name}_epilogue.scaling_factor = 1.0f;
+                {op.name}_epilogue.scale = scaling_factors::{op.name}_epilogue_scale;
+                {op.name}_epilogue.shift = scaling_factors::{op.name}_epilogue_shift;
+                {op.name}_epilogue.activation = ActivationType::{activation};
+                {op.name}_epilogue.alpha = {op.epilogue_alpha}f;
+                """
+            )
+
+        elif op.op_type == 'MaxPool':
+            x_op = input_ops['X']
+
+            return self.format_string(
+                f"""
+                struct max_pooling_parameters {op.name}_params;
+                {op.name}_params.input_height = {x_op.height};
+                {op.name}_params.input_width = {x_op.width};
+                {op.name}_params.input_depth = {x_op.channel};
+                {op.name}_params.kernel_height = {op.kernel_height};
+                {op.name}_params.kernel_width = {op.kernel_width};
+                {op.name}_params.kernel_depth = 1;
+                {op.name}_params.output_elements = {op.size};
+                {op.name}_params.output_channels = {op.channel};
+                {op.name}_params.output_height = {op.height};
+                {op.name}_params.output_width = {op.width};
+                {op.name}_params.padding = {op.pads[0]};
+                {op.name}_params.stride = {op.strides[0]};
+                {op.name}_params.thread_pool = &thread_pool;
+                """
+            )
 
-            shape_string = self.shape_to_string(op.shape, channel_active=True)
+        elif op.op_type == 'AveragePool':
+            x_op = input_ops['X']
 
-            self.reuse_buffer_str = f"""TensorView<{op.dtype.cpptype()}, \
-            MemoryLayout::{op.dimension}>::tensor_info_t<std::size_t> {op_name}_shape = {{ {shape_string} }};
-            TensorView<{op.dtype.cpptype()}, \
-            MemoryLayout::{op.dimension}> {op_name}({op.available_buffer}_raw, {op_name}_shape);"""
+            return self.format_string(
+                f"""
+                struct avg_pooling_parameters {op.name}_params;
+                {op.name}_params.input_height = {x_op.height};
+                {op.name}_params.input_width = {x_op.width};
+                {op.name}_params.input_depth = {x_op.channel};
+                {op.name}_params.kernel_depth = 1;
+                {op.name}_params.kernel_height = {op.kernel_height};
+                {op.name}_params.kernel_width = {op.kernel_width};
+                {op.name}_params.output_elements = {op.size};
+                {op.name}_params.output_channels = {op.channel};
+                {op.name}_params.output_height = {op.height};
+                {op.name}_params.output_width = {op.width};
+                {op.name}_params.padding = {op.pads[0]};
+                {op.name}_params.stride = {op.strides[0]};
+                {op.name}_params.thread_pool = &thread_pool;
+                """
+            )
+
+        return ''
+
+    def run(self):
+        op = self.op
+        input_ops = op.input_ops
+        output_ops = op.output_ops
+        inputs_string = self.inputs_to_string(input_ops)
+        shape_string = self.shape_to_string(op.shape)
 
         if self.op.op_type == 'QTZ_binary_mean_scaling':
             if len(input_ops) != 1:
@@ -73,7 +221,7 @@ class View(object):
 
             return self.format_string(
                 f"""
-                func_QTZ_linear_mid_tread_half({inputs_string}, {op.name});
+                func_QTZ_linear_mid_tread_half({inputs_string}, {op.name}, workspace, thread_pool);
                 """
             )
 
@@ -99,27 +247,9 @@ class View(object):
                 self.raise_invalid_args_exception(op, input_ops, output_ops)
 
             x_op = input_ops['X']
-            w_op = input_ops['W']
-
-            ih = x_op.height
-            iw = x_op.width
-            oh = op.height
-            ow = op.width
-            b = 32
-            od = op.channel
-            pad = op.pads[0]
-            stride = op.strides[0]
             nbit_qinput = 8 if x_op.op_type == 'Input' else 2
 
             if op.is_quantized and nbit_qinput == 2:
-                qk_elems = w_op.data.shape[1]
-
-                kh = self.op.kernel_height
-                kw = self.op.kernel_width
-                kd = x_op.channel
-                k_elems = kh * kw * kd
-                od = ((od + b - 1) // b) * b
-
                 if input_ops['X'].op_type == 'Split':
                     for k, v in input_ops['X'].output_ops.items():
                         if v[0] == op:
@@ -129,63 +259,24 @@ class View(object):
                     inputs_string = self.inputs_to_string(input_ops)
 
                 if op.has_thresholds:
-                    threshold = f'{op.name}_thresholds'
-                    thresholds_addr = f'THRESHOLD_ADDR + {op.name}_thresholds_offset'
                     conv_func = 'func_QuantizedConv2DWithThreshold'
-                    nbit_aqtz = self.op.a_quantizer[0].nbit
-                    max_value = self.op.a_quantizer[0].max_v
+                    epilogue = f'scaling_factors::{op.name}'
+                elif op.has_epilogue:
+                    conv_func = 'func_QuantizedConv2DWithEpilogue'
+                    epilogue = f'{op.name}_epilogue'
                 else:
-                    threshold = 'nullptr'
-                    thresholds_addr = '0'
                     conv_func = 'func_QuantizedConv2D'
-                    nbit_aqtz = 2
-                    max_value = 2.0
+                    epilogue = f'scaling_factors::{op.name}'
 
-                # temporary: formula which derive number of qinput is not complete
                 render_string = self.format_string(
                     f"""
-                    Conv2D_struct.input_height = {ih};
-                    Conv2D_struct.input_width = {iw};
-                    Conv2D_struct.kernel_height = {kh};
-                    Conv2D_struct.kernel_width = {kw};
-                    Conv2D_struct.kernel_depth = {kd};
-                    Conv2D_struct.kernel_elements = {k_elems};
-                    Conv2D_struct.output_channels = {od};
-                    Conv2D_struct.output_height = {oh};
-                    Conv2D_struct.output_width = {ow};
-                    Conv2D_struct.padding = {pad};
-                    Conv2D_struct.stride_along_height = {stride};
-                    Conv2D_struct.stride_along_width = {stride};
-
-                    binConv2D_struct.normal_conv_params = Conv2D_struct;
-                    binConv2D_struct.bin_input_extra_bits = 0;
-                    binConv2D_struct.bin_input_bitwidth = {nbit_qinput};
-                    binConv2D_struct.bin_kernel_ndata = {qk_elems};
-                    binConv2D_struct.bin_input_nwords = {qk_elems};
-                    binConv2D_struct.bin_input_ndata = {qk_elems}*{nbit_qinput};
-                    binConv2D_struct.device_input_buf = device_input_buf;
-                    binConv2D_struct.device_output_buf = device_output_buf;
-                    binConv2D_struct.thresholds = {threshold};
-                    binConv2D_struct.n_bit = {nbit_aqtz};
-                    binConv2D_struct.max_value = {max_value};
-                    binConv2D_struct.debug_name = "{op.name}";
-#ifdef RUN_ON_FPGA
-                    binConv2D_struct.device_kernel_phys_addr = KERNEL_ADDR + {op.name}_kernel_offset;
-                    binConv2D_struct.device_thresholds_phys_addr = {thresholds_addr};
-#endif
-
-                    {conv_func}({inputs_string}, {op.name}, scaling_factors::{op.name}, binConv2D_struct);
+                    {conv_func}({inputs_string}, {op.name}, {epilogue}, {op.name}_params);
                     """
                 )
 
             else:
                 # temporary
                 # weight order is followed by tensorflow: "NHWC"
-                kh = self.op.kernel_height
-                kw = self.op.kernel_width
-                kd = x_op.channel
-                k_elems = kh * kw * kd
-
                 if input_ops['X'].op_type == 'Split':
                     for k, v in input_ops['X'].output_ops.items():
                         if v[0] == op:
@@ -196,20 +287,7 @@ class View(object):
 
                 render_string = self.format_string(
                     f"""
-                    Conv2D_struct.input_height = {ih};
-                    Conv2D_struct.input_width = {iw};
-                    Conv2D_struct.kernel_height = {kh};
-                    Conv2D_struct.kernel_width = {kw};
-                    Conv2D_struct.kernel_depth = {kd};
-                    Conv2D_struct.kernel_elements = {k_elems};
-                    Conv2D_struct.output_channels = {od};
-                    Conv2D_struct.output_height = {oh};
-                    Conv2D_struct.output_width = {ow};
-                    Conv2D_struct.padding = {pad};
-                    Conv2D_struct.stride_along_height = {stride};
-                    Conv2D_struct.stride_along_width = {stride};
-
-                    func_Conv2D({inputs_string}, {op.name}, Conv2D_struct);
+                    func_Conv2D({inputs_string}, {op.name}, {op.name}_conv_params);
                     """
                 )
 
@@ -237,40 +315,11 @@ class View(object):
             if len(input_ops) != 1:
                 self.raise_invalid_args_exception(op, input_ops, output_ops)
 
-            x_op = input_ops['X']
-            ih = x_op.height
-            iw = x_op.width
-            id = x_op.channel
-
-            oh = op.height
-            ow = op.width
-            od = op.channel
-
-            kh = op.kernel_height
-            kw = op.kernel_width
-            kd = 1
-
-            elems = op.size
-            pad = op.pads[0]
-            stride = op.strides[0]
             inputs_string = self.inputs_to_string(input_ops)
 
             return self.format_string(
                 f"""
-                MaxPool_struct.input_height = {ih};
-                MaxPool_struct.input_width = {iw};
-                MaxPool_struct.input_depth = {id};
-                MaxPool_struct.kernel_height = {kh};
-                MaxPool_struct.kernel_width = {kw};
-                MaxPool_struct.kernel_depth = {kd};
-                MaxPool_struct.output_elements = {elems};
-                MaxPool_struct.output_channels = {od};
-                MaxPool_struct.output_height = {oh};
-                MaxPool_struct.output_width = {ow};
-                MaxPool_struct.padding = {pad};
-                MaxPool_struct.stride = {stride};
-
-                func_MaxPool({inputs_string}, {op.name}, MaxPool_struct);
+                func_MaxPool({inputs_string}, {op.name}, {op.name}_params);
                 """
             )
 
@@ -485,40 +534,11 @@ class View(object):
             if len(input_ops) != 1:
                 self.raise_invalid_args_exception(op, input_ops, output_ops)
 
-            x_op = input_ops['X']
-            ih = x_op.height
-            iw = x_op.width
-            id = x_op.channel
-
-            oh = op.height
-            ow = op.width
-            od = op.channel
-
-            kh = op.kernel_height
-            kw = op.kernel_width
-            kd = 1
-
-            pad = op.pads[0]
-            stride = op.strides[0]
-
             inputs_string = self.inputs_to_string(input_ops)
 
             return self.format_string(
                 f"""
-                AveragePool_struct.input_height = {ih};
-                AveragePool_struct.input_width = {iw};
-                AveragePool_struct.input_depth = {id};
-                AveragePool_struct.kernel_depth = {kd};
-                AveragePool_struct.kernel_height = {kh};
-                AveragePool_struct.kernel_width = {kw};
-                AveragePool_struct.output_elements = {op.size};
-                AveragePool_struct.output_channels = {od};
-                AveragePool_struct.output_height = {oh};
-                AveragePool_struct.output_width = {ow};
-                AveragePool_struct.padding = {pad};
-                AveragePool_struct.stride = {stride};
-
-                func_AveragePool({inputs_string}, {op.name}, AveragePool_struct);
+                func_AveragePool({inputs_string}, {op.name}, {op.name}_params);
                 """
             )
 
@@ -550,7 +570,7 @@ class View(object):
             args2 = f"{k_w}, {stride_w}"
             return self.format_string(
                 f"""
-                func_ExtractImagePatches({args1}{args2});
+                func_ExtractImagePatches({args1}{args2}, thread_pool);
                 """
             )
 
@@ -593,7 +613,7 @@ class View(object):
 
             return self.format_string(
                 f"""
-                func_BatchNormalization({inputs_string}, {op.epsilon}, {op.name});
+                func_BatchNormalization({inputs_string}, {op.epsilon}, {op.name}, thread_pool);
                 """
             )
 
@@ -614,7 +634,7 @@ class View(object):
 
             return self.format_string(
                 f"""
-                func_ExtractImagePatches({args1}{args2});
+                func_ExtractImagePatches({args1}{args2}, thread_pool);
                 """
             )
         elif self.op.op_type == 'Mul':
@@ -731,7 +751,7 @@ class View(object):
 
             inputs_string = self.inputs_to_string(input_ops)
 
-            return self.format_string(f"""func_Lookup({inputs_string}, {op.name});""")
+            return self.format_string(f"""func_Lookup({inputs_string}, {op.name}, thread_pool);""")
 
     def render_alias(self, op, input_ops, output_ops):
         if len(input_ops) != 1:
@@ -740,9 +760,6 @@ class View(object):
             return f'{op.dtype.cpptype()}* {op.name} = {input_ops["input"].name};'
 
     def format_string(self, string):
-        if self.reuse_buffer_str:
-            string = self.reuse_buffer_str + '\n' + string
-
         return dedent(string).strip()
 
     def inputs_to_string(self, inputs):
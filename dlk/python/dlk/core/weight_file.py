@@ -0,0 +1,107 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Binary file holding the constants of a graph, mapped by the generated code at init."""
+import struct
+from typing import List, Tuple
+
+import numpy as np
+
+from core.graph import Graph
+
+# Layout of the file, version 1. Every integer is little endian.
+#
+#   header   magic, version, number of entries, alignment, reserved, file size
+#   entries  offset and size of the data, offset and size of the name, reserved
+#   names    nul terminated
+#   data     of every entry, at offsets which are multiples of the alignment
+#
+# Must match include/weight_file.h of the generated project.
+MAGIC = b'DLKWGHT\0'
+VERSION = 1
+ALIGNMENT = 64
+HEADER = struct.Struct('<8sIIIIQ')
+ENTRY = struct.Struct('<QQIIQ')
+
+# a constant with a different layout for each target is stored once per layout.
+# the data for NEON and AVX keeps the plain name of the constant.
+TRANSPOSED_SUFFIX = '.transposed'  # TCA of the FPGA
+KN2ROW_SUFFIX = '.kn2row'  # generic x86 and arm
+THRESHOLDS_SUFFIX = '.thresholds'
+
+
+class WeightFile(object):
+    """Every non scalar constant, and the thresholds of the quantized convolutions, of a graph.
+
+    The generated Network maps the file at init and uses the data in place,
+    so the constants are no longer compiled into the library, and swapping
+    the weights of a model only needs a new file.
+    """
+
+    def __init__(self, graph: Graph) -> None:
+        self.entries: List[Tuple[str, bytes]] = []
+
+        for node in graph.consts:
+            if node.is_scalar:
+                continue
+            dtype = node.dtype.nptype()
+            if node.transposed_data:
+                self._add(node.name + TRANSPOSED_SUFFIX, node.transposed_data, dtype)
+                self._add(node.name, node.data, dtype)
+                self._add(node.name + KN2ROW_SUFFIX, node.kn2row_data, dtype)
+            else:
+                self._add(node.name, node.data, dtype)
+
+        for conv in graph.convs(quantized_only=True):
+            if conv.has_thresholds:
+                self._add(conv.name + THRESHOLDS_SUFFIX, conv.thresholds, np.int16)
+
+    def _add(self, name: str, data, dtype) -> None:
+        array = np.asarray(data).flatten().astype(np.dtype(dtype).newbyteorder('<'))
+        self.entries.append((name, array.tobytes()))
+
+    def _layout(self) -> Tuple[List[int], List[int], int]:
+        """Return the offsets of the names and of the data of the entries, and the file size."""
+        offset = HEADER.size + ENTRY.size * len(self.entries)
+        name_offsets = []
+        for name, _ in self.entries:
+            name_offsets.append(offset)
+            offset += len(name.encode()) + 1
+
+        data_offsets = []
+        for _, data in self.entries:
+            offset = (offset + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+            data_offsets.append(offset)
+            offset += len(data)
+
+        return name_offsets, data_offsets, offset
+
+    def to_bytes(self) -> bytes:
+        name_offsets, data_offsets, size = self._layout()
+
+        blob = bytearray(size)
+        HEADER.pack_into(blob, 0, MAGIC, VERSION, len(self.entries), ALIGNMENT, 0, size)
+        for i, (name, data) in enumerate(self.entries):
+            encoded = name.encode()
+            ENTRY.pack_into(blob, HEADER.size + ENTRY.size * i,
+                            data_offsets[i], len(data), name_offsets[i], len(encoded), 0)
+            blob[name_offsets[i]:name_offsets[i] + len(encoded)] = encoded
+            blob[data_offsets[i]:data_offsets[i] + len(data)] = data
+
+        return bytes(blob)
+
+    def write(self, path: str) -> None:
+        with open(path, 'wb') as f:
+            f.write(self.to_bytes())
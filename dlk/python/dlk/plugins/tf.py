@@ -199,7 +199,7 @@ class Node(object):
         attrs_data = []
         if attr_name == 'padding' or attr_name == 'data_format':
             attrs_data.append(self.nd_.attr[attr_name].s)
-        elif attr_name in ['strides', 'ksize']:
+        elif attr_name in ['strides', 'ksize', 'dilations']:
             attrs_data.append(self.nd_.attr[attr_name].list.i)
         elif attr_name in ['epsilon', 'alpha']:
             attrs_data.append(self.nd_.attr[attr_name].f)
@@ -650,6 +650,7 @@ class Importer(object):
 
         if op_type == 'Conv':
             strides = node.attribute('strides')[0][1:3]
+            dilations = node.attribute('dilations')[0][1:3] if 'dilations' in node.attributes else [1, 1]
             padding = node.attribute('padding')[0].decode(encoding='utf-8')
             # calculated pads size for tf
             input_format = input_format_list[0]
@@ -661,17 +662,20 @@ class Importer(object):
             filt_w = input_ops['W'].shape[kernel_format.index('W')]
             stride_h = strides[0]
             stride_w = strides[1]
+            # the extent of the dilated filter decides the padding
+            extent_h = (filt_h - 1) * dilations[0] + 1
+            extent_w = (filt_w - 1) * dilations[1] + 1
 
             pads: List[int] = []
             if padding == 'SAME':
                 if in_h % stride_h == 0:
-                    pad_along_height = max(filt_h - stride_h, 0)
+                    pad_along_height = max(extent_h - stride_h, 0)
                 else:
-                    pad_along_height = max(filt_h - (in_h % stride_h), 0)
+                    pad_along_height = max(extent_h - (in_h % stride_h), 0)
                 if in_w % stride_w == 0:
-                    pad_along_width = max(filt_w - stride_w, 0)
+                    pad_along_width = max(extent_w - stride_w, 0)
                 else:
-                    pad_along_width = max(filt_w - (in_w % stride_w), 0)
+                    pad_along_width = max(extent_w - (in_w % stride_w), 0)
 
                 pad_top = pad_along_height // 2
                 pad_bottom = pad_along_height - pad_top
@@ -687,7 +691,7 @@ class Importer(object):
                 raise ValueError(f'{op_type} {node.name} doesn\'t have the supported padding.')
 
             if not shape:
-                attributes = {'kernel_shape': [filt_h, filt_w],
+                attributes = {'kernel_shape': [extent_h, extent_w],
                               'strides': strides,
                               'pads': pads}
                 shape = infer_shape(attributes)
@@ -699,6 +703,7 @@ class Importer(object):
                 input_ops,
                 dimension_format=current_format,
                 kernel_shape=[filt_h, filt_w],
+                dilations=dilations,
                 strides=strides,
                 pads=pads,
             )
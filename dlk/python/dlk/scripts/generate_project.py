@@ -33,7 +33,7 @@ from core.optimizer import pass_remove_identities, pass_transpose, pass_constant
     pass_propagate_quantization_details_into_conv, pass_compute_thresholds, pass_pack_weights, \
     pass_quantize_convolutions, pass_propagate_datatypes, \
     pass_propagate_format, pass_propagate_output_type_backward, \
-    pass_lookup
+    pass_lookup, pass_fuse_conv_epilogue
 
 SCRITPS_DIR = path.abspath(path.dirname(__file__))
 DLK_ROOT_DIR = path.abspath(path.join(SCRITPS_DIR, '..'))
@@ -71,6 +71,9 @@ def optimize_graph_step(model: Model, config: Config) -> None:
 
     pass_constant_folding(graph)
 
+    if config.activate_hard_quantization:
+        pass_fuse_conv_epilogue(graph)
+
 
 def generate_code_step(model: Model, config: Config) -> None:
     """Generate code for the model.
@@ -91,9 +94,9 @@ def generate_code_step(model: Model, config: Config) -> None:
                             params,
                             config)
 
-    builder.reuse_output_buffers()
     builder.generate_files_from_template()
     builder.generate_inputs()
+    builder.generate_weights()
 
     if config.activate_hard_quantization:
         builder.generate_scaling_factors()
@@ -58,7 +58,51 @@ class NNLib(object):
                 ct.c_float,
                 flags="C_CONTIGUOUS"),
         ]
-        self.lib.network_run.restype = None
+        self.lib.network_run.restype = ct.c_bool
+
+        self.lib.network_run_u8.argtypes = [
+            ct.c_void_p,
+            ndpointer(
+                ct.c_uint8,
+                flags="C_CONTIGUOUS"),
+            ndpointer(
+                ct.c_float,
+                flags="C_CONTIGUOUS"),
+        ]
+        self.lib.network_run_u8.restype = ct.c_bool
+
+        self.lib.network_run_batch.argtypes = [
+            ct.c_void_p,
+            ct.c_int,
+            ndpointer(
+                ct.c_float,
+                flags="C_CONTIGUOUS"),
+            ndpointer(
+                ct.c_float,
+                flags="C_CONTIGUOUS"),
+        ]
+        self.lib.network_run_batch.restype = ct.c_bool
+
+        self.lib.network_set_num_threads.argtypes = [ct.c_void_p, ct.c_int]
+        self.lib.network_set_num_threads.restype = None
+
+        self.lib.network_set_thread_affinity.argtypes = [
+            ct.c_void_p,
+            ndpointer(
+                ct.c_int32,
+                flags="C_CONTIGUOUS"),
+            ct.c_int,
+        ]
+        self.lib.network_set_thread_affinity.restype = None
+
+        self.lib.network_enable_profiling.argtypes = [ct.c_void_p, ct.c_int]
+        self.lib.network_enable_profiling.restype = None
+
+        self.lib.network_clear_profile.argtypes = [ct.c_void_p]
+        self.lib.network_clear_profile.restype = None
+
+        self.lib.network_get_profile.argtypes = [ct.c_void_p, ct.c_int, ct.c_char_p, ct.c_int]
+        self.lib.network_get_profile.restype = ct.c_int
 
         self.nnlib = self.lib.network_create()
         return True
@@ -66,6 +110,27 @@ class NNLib(object):
     def init(self):
         return self.lib.network_init(self.nnlib)
 
+    def set_num_threads(self, n):
+        self.lib.network_set_num_threads(self.nnlib, n)
+
+    def set_thread_affinity(self, cpus):
+        cpus = np.ascontiguousarray(cpus, np.int32)
+        self.lib.network_set_thread_affinity(self.nnlib, cpus, len(cpus))
+
+    def enable_profiling(self, capacity=65536):
+        self.lib.network_enable_profiling(self.nnlib, capacity)
+
+    def clear_profile(self):
+        self.lib.network_clear_profile(self.nnlib)
+
+    def get_profile(self, format='chrome'):
+        """Return the recorded layer timings as chrome trace json ('chrome') or csv ('csv')."""
+        fmt = {'chrome': 0, 'csv': 1}[format]
+        size = self.lib.network_get_profile(self.nnlib, fmt, None, 0)
+        buf = ct.create_string_buffer(size + 1)
+        self.lib.network_get_profile(self.nnlib, fmt, buf, size + 1)
+        return buf.value.decode()
+
     def delete(self):
         if self.nnlib:
             self.lib.network_delete(self.nnlib)
@@ -99,9 +164,37 @@ class NNLib(object):
         input = tensor.flatten().astype(np.float32)
         output = np.zeros((self.get_output_shape()), np.float32)
 
-        self.lib.network_run(
-            self.nnlib,
-            input,
-            output)
+        if not self.lib.network_run(
+                self.nnlib,
+                input,
+                output):
+            raise RuntimeError('network run error')
+
+        return output
+
+    def run_u8(self, image):
+        """Run on the uint8 image, before its division by 255."""
+        input = np.ascontiguousarray(image, np.uint8).reshape(-1)
+        output = np.zeros((self.get_output_shape()), np.float32)
+
+        if not self.lib.network_run_u8(
+                self.nnlib,
+                input,
+                output):
+            raise RuntimeError('network run error')
+
+        return output
+
+    def run_batch(self, tensors):
+        n = len(tensors)
+        input = np.ascontiguousarray(tensors, np.float32).reshape(-1)
+        output = np.zeros((n,) + self.get_output_shape(), np.float32)
+
+        if not self.lib.network_run_batch(
+                self.nnlib,
+                n,
+                input,
+                output):
+            raise RuntimeError('network run error')
 
         return output
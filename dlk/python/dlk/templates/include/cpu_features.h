@@ -0,0 +1,55 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_CPU_FEATURES_H_INCLUDED
+#define DLK_CPU_FEATURES_H_INCLUDED
+
+#if defined __x86_64__ || defined __i386__
+#define DLK_X86
+
+// The x86 SIMD kernels are built into every x86 library, also the ones
+// compiled without -mavx2. Functions defined between a BEGIN and DLK_TARGET_END
+// may use the named extensions and must only be called when cpu_features()
+// reports them.
+#define DLK_TARGET_AVX2_BEGIN \
+  _Pragma("GCC push_options") \
+  _Pragma("GCC target(\"avx2,fma,popcnt\")")
+#define DLK_TARGET_AVX512_BEGIN \
+  _Pragma("GCC push_options") \
+  _Pragma("GCC target(\"avx2,fma,popcnt,avx512f,avx512vl,avx512vpopcntdq\")")
+#define DLK_TARGET_END \
+  _Pragma("GCC pop_options")
+#endif
+
+namespace dlk {
+
+struct CpuFeatures {
+  bool sse42 = false;
+  bool popcnt = false;
+  bool avx2 = false;
+  bool fma = false;
+  bool avx512f = false;
+  bool avx512vl = false;
+  bool avx512vpopcntdq = false;
+  bool neon = false;
+  bool dotprod = false;
+};
+
+// extensions of the cpu running this process, detected on the first call
+const CpuFeatures& cpu_features();
+
+} // namespace dlk
+
+#endif // DLK_CPU_FEATURES_H_INCLUDED
@@ -18,6 +18,8 @@ limitations under the License.
 #include "memdriver.h"
 #include "time_measurement.h"
 #include <cassert>
+#include <mutex>
+#include <thread>
 
 namespace de10_nano {
 
@@ -504,16 +506,30 @@ Parameters calcParameters(uint32_t inputHeight, uint32_t inputWidth, uint32_t in
   return p;
 }
 
-void RunTCA(unsigned long input_addr, unsigned long output_addr, unsigned long kernel_addr,
+// The TCA runs one convolution at a time. StartTCA programs the csr and
+// returns once the accelerator is started, TCADone / WaitTCA complete it.
+// Callers which may run concurrently (the frames in flight of
+// Network::run_batch) hold TCAMutex() from StartTCA until WaitTCA returns.
+// Every lane has its own output buffer, so reading the output after the
+// lock is released is safe.
+std::mutex& TCAMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+volatile uint32_t* TCACsr() {
+  static volatile uint32_t* csr =
+    reinterpret_cast<uint32_t*>(mapPhysicalMemory(HPS_TO_FPGA_LW_BASE, 0xFF));
+  return csr;
+}
+
+void StartTCA(unsigned long input_addr, unsigned long output_addr, unsigned long kernel_addr,
   unsigned long thresholds_addr, unsigned in_w, unsigned in_h, unsigned in_c, unsigned nbits_in_data,
   unsigned out_w, unsigned out_h, unsigned out_c, unsigned k_w, unsigned k_h, unsigned pad, unsigned stride) {
 
   unsigned use_threshold = (thresholds_addr != 0) ? 1 : 0;
 
-  static volatile uint32_t* csr = nullptr;
-  if (csr == nullptr) {
-    csr = reinterpret_cast<uint32_t*>(mapPhysicalMemory(HPS_TO_FPGA_LW_BASE, 0xFF));
-  }
+  volatile uint32_t* csr = TCACsr();
     auto tileWidth = 32u;
     auto tileHeight = 32u;
     auto p = calcParameters(in_h, in_w, in_c, tileWidth, tileHeight, out_c, k_h, k_w, input_addr, kernel_addr, thresholds_addr, output_addr, use_threshold == 1);
@@ -570,14 +586,27 @@ void RunTCA(unsigned long input_addr, unsigned long output_addr, unsigned long k
     csr[Csr::qdmaStartAddress] = p.qdmaStartAddress;
     csr[Csr::bnqEnable] = p.bnqEnable;
 
-    // std::cout << "Status " << csr[Csr::statusRegister] << std::endl;
     csr[Csr::start] = 1;
+}
 
-    // std::cout << "Status " << csr[Csr::statusRegister] << std::endl;
-    while (csr[Csr::statusRegister] != 127) {
-        // std::cout << "Status " << csr[Csr::statusRegister] << std::endl;
-        continue;
-    }
+// true once the convolution started by StartTCA has written its output
+bool TCADone() {
+  return TCACsr()[Csr::statusRegister] == 127;
+}
+
+// waits for the convolution started by StartTCA. the thread gives up its
+// core while polling, so the other frame in flight can run its cpu layers.
+void WaitTCA() {
+  while (!TCADone())
+    std::this_thread::yield();
+}
+
+void RunTCA(unsigned long input_addr, unsigned long output_addr, unsigned long kernel_addr,
+  unsigned long thresholds_addr, unsigned in_w, unsigned in_h, unsigned in_c, unsigned nbits_in_data,
+  unsigned out_w, unsigned out_h, unsigned out_c, unsigned k_w, unsigned k_h, unsigned pad, unsigned stride) {
+  StartTCA(input_addr, output_addr, kernel_addr, thresholds_addr, in_w, in_h, in_c, nbits_in_data,
+    out_w, out_h, out_c, k_w, k_h, pad, stride);
+  WaitTCA();
 }
 
 } // namespace de10_nano
@@ -19,6 +19,8 @@ limitations under the License.
 #include "global.h"
 #include "tensor_view.h"
 
+class ThreadPool;
+
 struct avg_pooling_parameters {
   T_UINT input_height;
   T_UINT input_width;
@@ -32,6 +34,7 @@ struct avg_pooling_parameters {
   T_UINT kernel_width;
   T_UINT stride;
   T_UINT padding;
+  ThreadPool *thread_pool;
 };
 
 void func_AveragePool(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
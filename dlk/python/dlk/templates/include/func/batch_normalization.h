@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "global.h"
 #include "tensor_view.h"
+#include "thread_pool.h"
 
 void func_BatchNormalization(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
     const TensorView<T_FLOAT, MemoryLayout::C>& gamma,
@@ -25,6 +26,7 @@ void func_BatchNormalization(const TensorView<T_FLOAT, MemoryLayout::NHWC>& inpu
     const TensorView<T_FLOAT, MemoryLayout::C>& mean,
     const TensorView<T_FLOAT, MemoryLayout::C>& variance,
     T_FLOAT epsilon,
-    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output);
+    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+    ThreadPool& thread_pool);
 
 #endif // DLK_FUNC_BATCH_NORMALIZATION_H_INCLUDED
@@ -19,6 +19,7 @@ limitations under the License.
 #include <algorithm>
 #include "global.h"
 #include "tensor_view.h"
+#include "thread_pool.h"
 #include "time_measurement.h"
 #include "pack_input_to_qwords.h"
 #include <limits.h>
@@ -31,7 +32,7 @@ template <typename T>
 void func_ExtractImagePatches(
     const TensorView<T, MemoryLayout::NHWC>& input,
     const TensorView<T, MemoryLayout::NHWC>& output,
-    T_UINT kernel_size, T_UINT stride) {
+    T_UINT kernel_size, T_UINT stride, ThreadPool& /* thread_pool */) {
   Measurement::Start("ExtractImagePatches");
 
   const auto in_shape = input.get_shape();
@@ -67,7 +68,7 @@ void func_ExtractImagePatches(
 inline void func_ExtractImagePatches(
     const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& input,
     const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& output,
-    T_UINT kernel_size, T_UINT stride) {
+    T_UINT kernel_size, T_UINT stride, ThreadPool& /* thread_pool */) {
   Measurement::Start("ExtractImagePatches");
 
   const auto in_shape = input.get_shape();
@@ -167,7 +168,7 @@ inline void func_ExtractImagePatches(
 inline void func_ExtractImagePatches(
     const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& input,
     const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output,
-    T_UINT kernel_size, T_UINT stride)
+    T_UINT kernel_size, T_UINT stride, ThreadPool& thread_pool)
 {
   Measurement::Start("ExtractImagePatches");
   const auto in_shape = input.get_shape();
@@ -196,51 +197,52 @@ inline void func_ExtractImagePatches(
     const uint64_t mask64 = mask * 0x1'0000'0001ull;
 #endif
     const T_UINT blocks = kernel_area / out_depth;
-#pragma omp parallel for
-    for(T_UINT wi = 0; wi < out_height; wi++)
-      for(T_UINT wj = 0; wj < out_width; wj++)
+    thread_pool.parallel_for(0, out_height, 1, [&](std::size_t first, std::size_t last) {
+      for(T_UINT wi = first; wi < last; wi++)
+        for(T_UINT wj = 0; wj < out_width; wj++)
 #ifdef USE_NEON
-        for(T_UINT k = 0; k < out_depth; ++k) {
-          auto tmp = vdupq_n_u32(0);
-          auto shift = shift_ref;
-          for(T_UINT i = 0; i < blocks; i += 2) {
-            T_UINT ki = (k * blocks + i) >> lb_kernel_size;
-            T_UINT kj = (k * blocks + i) & kernel_mask;
-            T_INT row = (wi * stride) + ki;
-            T_INT col = (wj * stride) + kj;
-            const auto in_idx = row * input_width * bits_per_input
-              + col * bits_per_input;
-            const auto in = vld1q_u32(reinterpret_cast<uint32_t*>(input.data() + in_idx));
-            const auto masked = vandq_u32(mask_v, in);
-            const auto shifted = vshlq_u32(masked, shift);
-            shift += add;
-            tmp |= shifted;
+          for(T_UINT k = 0; k < out_depth; ++k) {
+            auto tmp = vdupq_n_u32(0);
+            auto shift = shift_ref;
+            for(T_UINT i = 0; i < blocks; i += 2) {
+              T_UINT ki = (k * blocks + i) >> lb_kernel_size;
+              T_UINT kj = (k * blocks + i) & kernel_mask;
+              T_INT row = (wi * stride) + ki;
+              T_INT col = (wj * stride) + kj;
+              const auto in_idx = row * input_width * bits_per_input
+                + col * bits_per_input;
+              const auto in = vld1q_u32(reinterpret_cast<uint32_t*>(input.data() + in_idx));
+              const auto masked = vandq_u32(mask_v, in);
+              const auto shifted = vshlq_u32(masked, shift);
+              shift += add;
+              tmp |= shifted;
+            }
+            const auto out = vorr_u32(vget_low_u32(tmp), vget_high_u32(tmp));
+            const auto out_idx = k * out_height * out_width * bits_per_input
+              + wi * out_width * bits_per_input
+              + wj * bits_per_input;
+            vst1_u32(reinterpret_cast<uint32_t*>(output.data() + out_idx), out);
           }
-          const auto out = vorr_u32(vget_low_u32(tmp), vget_high_u32(tmp));
-          const auto out_idx = k * out_height * out_width * bits_per_input
-            + wi * out_width * bits_per_input
-            + wj * bits_per_input;
-          vst1_u32(reinterpret_cast<uint32_t*>(output.data() + out_idx), out);
-        }
 #else
-        for(T_UINT k = 0; k < out_depth; ++k) {
-          uint64_t out = 0;
-          for(T_UINT i = 0; i < blocks; ++i) {
-            T_UINT ki = (k * blocks + i) >> lb_kernel_size;
-            T_UINT kj = (k * blocks + i) & kernel_mask;
-            T_INT row = (wi * stride) + ki;
-            T_INT col = (wj * stride) + kj;
-            const auto in_idx = row * input_width * bits_per_input
-              + col * bits_per_input;
-            const auto in = *reinterpret_cast<uint64_t*>(input.data() + in_idx);
-            out |= (mask64 & in) << (i * bit_shift);
+          for(T_UINT k = 0; k < out_depth; ++k) {
+            uint64_t out = 0;
+            for(T_UINT i = 0; i < blocks; ++i) {
+              T_UINT ki = (k * blocks + i) >> lb_kernel_size;
+              T_UINT kj = (k * blocks + i) & kernel_mask;
+              T_INT row = (wi * stride) + ki;
+              T_INT col = (wj * stride) + kj;
+              const auto in_idx = row * input_width * bits_per_input
+                + col * bits_per_input;
+              const auto in = *reinterpret_cast<uint64_t*>(input.data() + in_idx);
+              out |= (mask64 & in) << (i * bit_shift);
+            }
+            const auto out_idx = k * out_height * out_width * bits_per_input
+              + wi * out_width * bits_per_input
+              + wj * bits_per_input;
+            *reinterpret_cast<uint64_t*>(output.data() + out_idx) = out;
           }
-          const auto out_idx = k * out_height * out_width * bits_per_input
-            + wi * out_width * bits_per_input
-            + wj * bits_per_input;
-          *reinterpret_cast<uint64_t*>(output.data() + out_idx) = out;
-        }
 #endif
+    });
   } else {
     for(T_UINT ih = 0; ih < input_depth; ++ih)
       for(T_UINT wi = 0; wi < out_height; wi++)
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef DLK_FUNC_IMPL_APPLY_THRESHOLDS_H_INCLUDED
 #define DLK_FUNC_IMPL_APPLY_THRESHOLDS_H_INCLUDED
 
+#include <cstddef>
+
 #include "global.h"
 #include "matrix_view.h"
 #include "operators.h" // FIXME(nikolay): for binary_convolution_parameters definition, rid of it later
@@ -24,15 +26,34 @@ namespace dlk {
 
 namespace impl {
 
-void ApplyThresholds(
-    dlk::MatrixView<BIN_CONV_OUTPUT, dlk::MatrixOrder::ColMajor> &result,
-    const binary_convolution_parameters &p);
+// the reordered thresholds take this many values per block of 32 channels:
+// the first, second and third thresholds and the flags of the 32 channels.
+// the thresholds of a decreasing channel are one larger, so that every
+// channel counts the thresholds its accumulator is not below.
+constexpr std::size_t thresholds_block_elems = NUM_OF_A2W1_THRESHOLD * 32;
+
+// reorders p.thresholds for ApplyThresholdsAndPack into thresholds, which
+// takes output_channels / 32 * thresholds_block_elems values
+void ReorderThresholds(const binary_convolution_parameters &p, BIN_CONV_OUTPUT *thresholds);
 
+// applies the thresholds to the accumulators of the pixels [first, last) of
+// result (one column per pixel) and packs the 2 bit results into output,
+// which is a ChHWBCl tensor of result.cols() pixels.
 void ApplyThresholdsAndPack(
-    dlk::MatrixView<BIN_CONV_OUTPUT, dlk::MatrixOrder::ColMajor> &result,
-    const binary_convolution_parameters &p,
+    const dlk::MatrixView<BIN_CONV_OUTPUT, dlk::MatrixOrder::ColMajor> &result,
+    const BIN_CONV_OUTPUT *thresholds,
+    std::size_t first, std::size_t last,
     QUANTIZED_PACKED output[]);
 
+// one block of 32 channels of pixels pixels, acc_stride values apart in acc:
+// writes the lsb and msb words of pixel i to output[2 * i] and
+// output[2 * i + 1]. kernels() binds the variant for the running cpu.
+void apply_thresholds_pack_block(const BIN_CONV_OUTPUT *acc, std::size_t pixels, std::size_t acc_stride,
+    const BIN_CONV_OUTPUT *thresholds, QUANTIZED_PACKED *output);
+
+void apply_thresholds_pack_block_avx2(const BIN_CONV_OUTPUT *acc, std::size_t pixels, std::size_t acc_stride,
+    const BIN_CONV_OUTPUT *thresholds, QUANTIZED_PACKED *output);
+
 } // namespace impl
 
 } // namespace dlk
@@ -0,0 +1,62 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_FUNC_IMPL_CONV2D_DIRECT_H_INCLUDED
+#define DLK_FUNC_IMPL_CONV2D_DIRECT_H_INCLUDED
+
+#include <algorithm>
+
+#include "global.h"
+#include "operators.h" // FIXME(nikolay): for convolution_parameters definition, rid of it later
+
+namespace dlk {
+
+namespace impl {
+
+// float convolutions with at most this many input channels (the rgb first
+// layer) are computed straight from the taps instead of through a matrix
+// multiplication, which has nothing to reuse with so short a k.
+constexpr T_UINT conv2d_direct_max_depth = 4;
+
+// the output channels of the direct convolution kernel are padded to a
+// multiple of this
+constexpr T_UINT conv2d_direct_channel_block = 8;
+
+// [begin, end) of the taps of a kernel dimension of size k and dilation d
+// which fall inside [0, size) of the input, the first tap being at origin
+inline void conv2d_tap_range(T_INT origin, T_UINT k, T_UINT d, T_UINT size, T_UINT& begin, T_UINT& end) {
+  const T_INT first = origin < 0 ? (-origin + T_INT(d) - 1) / T_INT(d) : 0;
+  const T_INT last = (T_INT(size) - origin + T_INT(d) - 1) / T_INT(d);
+  begin = std::min<T_INT>(first, k);
+  end = std::max<T_INT>(std::min<T_INT>(last, k), begin);
+}
+
+// output row out_row of the convolution p of the NHWC input into the NHWC
+// output. kernel is HWIO with the output channels padded to
+// conv2d_direct_channel_block. kernels() binds the variant for the running cpu.
+void conv2d_direct_row(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *output,
+    const convolution_parameters& p, T_UINT out_row);
+
+void conv2d_direct_row_neon(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *output,
+    const convolution_parameters& p, T_UINT out_row);
+
+void conv2d_direct_row_avx2(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *output,
+    const convolution_parameters& p, T_UINT out_row);
+
+} // namespace impl
+
+} // namespace dlk
+
+#endif // DLK_FUNC_IMPL_CONV2D_DIRECT_H_INCLUDED
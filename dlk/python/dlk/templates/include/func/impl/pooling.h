@@ -0,0 +1,77 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_FUNC_IMPL_POOLING_H_INCLUDED
+#define DLK_FUNC_IMPL_POOLING_H_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "global.h"
+#include "thread_pool.h"
+
+namespace dlk {
+
+namespace impl {
+
+// calls f(out_row, out_col, row_begin, row_end, col_begin, col_end) for every
+// output pixel of the pooling p, with its window clipped to the input, so the
+// taps need no bounds check. The output rows are split over p.thread_pool.
+template <typename P, typename F>
+void for_each_pooling_window(const P& p, F&& f) {
+  p.thread_pool->parallel_for(0, p.output_height, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t wi = first; wi < last; ++wi) {
+      const T_INT top = T_INT(wi * p.stride) - T_INT(p.padding);
+      const T_UINT row_begin = std::max<T_INT>(top, 0);
+      const T_UINT row_end = std::max<T_INT>(std::min<T_INT>(top + p.kernel_height, p.input_height), row_begin);
+      for (T_UINT wj = 0; wj < p.output_width; ++wj) {
+        const T_INT left = T_INT(wj * p.stride) - T_INT(p.padding);
+        const T_UINT col_begin = std::max<T_INT>(left, 0);
+        const T_UINT col_end = std::max<T_INT>(std::min<T_INT>(left + p.kernel_width, p.input_width), col_begin);
+        f(wi, wj, row_begin, row_end, col_begin, col_end);
+      }
+    }
+  });
+}
+
+// max of 32 2 bit values given as their lsb and msb words: the msb is set if
+// either one is, the lsb comes from the values whose msb is the max
+inline void max_2bit(uint32_t& lsb, uint32_t& msb, uint32_t in_lsb, uint32_t in_msb) {
+  lsb = (lsb & (msb | ~in_msb)) | (in_lsb & (in_msb | ~msb));
+  msb |= in_msb;
+}
+
+// acc[i] = max(acc[i], input[i]) for i < n. kernels() binds the variant for
+// the running cpu.
+void max_pool_row(const T_FLOAT *input, T_FLOAT *acc, std::size_t n);
+void max_pool_row_neon(const T_FLOAT *input, T_FLOAT *acc, std::size_t n);
+void max_pool_row_avx2(const T_FLOAT *input, T_FLOAT *acc, std::size_t n);
+
+// acc[i] += input[i] for i < n
+void average_pool_row(const T_FLOAT *input, T_FLOAT *acc, std::size_t n);
+void average_pool_row_neon(const T_FLOAT *input, T_FLOAT *acc, std::size_t n);
+void average_pool_row_avx2(const T_FLOAT *input, T_FLOAT *acc, std::size_t n);
+
+// max_2bit of pairs consecutive lsb and msb word pairs of input into acc
+void max_pool_2bit(const QUANTIZED_PACKED *input, QUANTIZED_PACKED *acc, std::size_t pairs);
+void max_pool_2bit_neon(const QUANTIZED_PACKED *input, QUANTIZED_PACKED *acc, std::size_t pairs);
+void max_pool_2bit_avx2(const QUANTIZED_PACKED *input, QUANTIZED_PACKED *acc, std::size_t pairs);
+
+} // namespace impl
+
+} // namespace dlk
+
+#endif // DLK_FUNC_IMPL_POOLING_H_INCLUDED
@@ -0,0 +1,56 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_FUNC_IMPL_QUANTIZED_CONV2D_EPILOGUE_H_INCLUDED
+#define DLK_FUNC_IMPL_QUANTIZED_CONV2D_EPILOGUE_H_INCLUDED
+
+#include <cstddef>
+
+#include "global.h"
+#include "tensor_view.h"
+#include "operators.h" // FIXME(nikolay): for binary_convolution_parameters definition, rid of it later
+
+namespace dlk {
+
+namespace impl {
+
+// scales the accumulators of QuantizedConv2D, which are in blocks of 32
+// channels (ChHWCl), applies e and writes them to output (NHWC) in one pass
+// over p.device_output_buf.
+void QuantizedConv2DEpilogue(const binary_convolution_parameters& p,
+    const conv_epilogue_parameters& e,
+    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output);
+
+// one block of channels of pixels consecutive pixels: acc holds 32 values per
+// pixel, of which the first channels go to output, out_stride floats apart.
+// scale and shift hold 32 values, aligned to 32 bytes. kernels() binds the
+// variant for the running cpu.
+void conv_epilogue_block(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, ActivationType activation, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride);
+
+void conv_epilogue_block_neon(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, ActivationType activation, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride);
+
+void conv_epilogue_block_avx2(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, ActivationType activation, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride);
+
+} // namespace impl
+
+} // namespace dlk
+
+#endif // DLK_FUNC_IMPL_QUANTIZED_CONV2D_EPILOGUE_H_INCLUDED
@@ -31,6 +31,25 @@ using kn2row_input_t = TensorView<kn2row_input_elem_t, MemoryLayout::HWChBCl>;
 void QuantizedConv2DKn2Row(const kn2row_input_t& input,
                                   const kernel_t& kernel,
                                   const binary_convolution_parameters &p);
+
+// popcount GEMM and shift add of a 1x1 or 3x3 kn2row convolution in one pass,
+// with AVX2 or AVX512 VPOPCNTDQ picked at run time. returns false without
+// touching the output when the cpu or the layer is not supported.
+// unless packed is null, every output row is also packed into it by
+// ApplyThresholdsAndPack with thresholds.
+bool QuantizedConv2DKn2RowX86(const kn2row_input_t& input,
+                              const kernel_t& kernel,
+                              const binary_convolution_parameters &p,
+                              const BIN_CONV_OUTPUT *thresholds,
+                              QUANTIZED_PACKED *packed);
+
+// the xor_pop_count entries of kernels()
+void xor_pop_count_avx2(const uint32_t * const *a, const uint32_t * const *b,
+                        unsigned taps, std::size_t a_stride, std::size_t words,
+                        unsigned rows, int32_t *out);
+void xor_pop_count_vpopcnt(const uint32_t * const *a, const uint32_t * const *b,
+                           unsigned taps, std::size_t a_stride, std::size_t words,
+                           unsigned rows, int32_t *out);
 #else
 using kn2row_input_t = TensorView<kn2row_input_elem_t, MemoryLayout::ChHWBCl>;
 void TCAConv2d(const kn2row_input_t& input,
@@ -19,6 +19,7 @@ limitations under the License.
 #include "global.h"
 #include "operators.h" // FIXME(nikolay): for binary_convolution_parameters definition, rid of it later
 #include "tensor_view.h"
+#include "thread_pool.h"
 
 namespace dlk {
 
@@ -29,7 +30,12 @@ using tiling_input_elem_t = QuantizedPacked<tiling_input_elem_base_t>;
 using tiling_input_t = TensorView<tiling_input_elem_t, MemoryLayout::ChHWBCl>;
 
 void pack_input_for_tiling(const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::NHWC>& input,
-    const tiling_input_t& output);
+    const tiling_input_t& output, ThreadPool& pool);
+
+// largest kernel side and stride QuantizedConv2DTiling supports; the kernel
+// need not be square and the padding may be larger at the bottom and right
+constexpr T_UINT tiling_max_kernel_size = 7;
+constexpr T_UINT tiling_max_stride = 2;
 
 void QuantizedConv2DTiling(const tiling_input_t& input,
                                   const kernel_t& kernel,
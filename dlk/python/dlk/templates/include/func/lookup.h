@@ -18,10 +18,36 @@ limitations under the License.
 
 #include "global.h"
 #include "tensor_view.h"
+#include "thread_pool.h"
 
 void func_Lookup(const TensorView<float, MemoryLayout::NHWC>& input,
     const TensorView<QUANTIZED_PACKED_KERNEL, MemoryLayout::TC>& lsb,
     const TensorView<QUANTIZED_PACKED_KERNEL, MemoryLayout::TC>& msb,
-    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output);
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output,
+    ThreadPool& thread_pool);
+
+// takes the image bytes in [0, 255] directly, instead of floats in [0, 1]
+void func_Lookup(const TensorView<uint8_t, MemoryLayout::NHWC>& input,
+    const TensorView<QUANTIZED_PACKED_KERNEL, MemoryLayout::TC>& lsb,
+    const TensorView<QUANTIZED_PACKED_KERNEL, MemoryLayout::TC>& msb,
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output,
+    ThreadPool& thread_pool);
+
+// the per pixel part of func_Lookup; the avx2 variant is bound by kernels() on x86
+void lookup_pixels(const float *input, std::size_t pixels,
+    const QUANTIZED_PACKED_KERNEL *lsb, const QUANTIZED_PACKED_KERNEL *msb,
+    QUANTIZED_PACKED *output);
+
+void lookup_pixels_avx2(const float *input, std::size_t pixels,
+    const QUANTIZED_PACKED_KERNEL *lsb, const QUANTIZED_PACKED_KERNEL *msb,
+    QUANTIZED_PACKED *output);
+
+void lookup_pixels_u8(const uint8_t *input, std::size_t pixels,
+    const QUANTIZED_PACKED_KERNEL *lsb, const QUANTIZED_PACKED_KERNEL *msb,
+    QUANTIZED_PACKED *output);
+
+void lookup_pixels_u8_avx2(const uint8_t *input, std::size_t pixels,
+    const QUANTIZED_PACKED_KERNEL *lsb, const QUANTIZED_PACKED_KERNEL *msb,
+    QUANTIZED_PACKED *output);
 
 #endif // DLK_FUNC_LOOKUP_H_INCLUDED
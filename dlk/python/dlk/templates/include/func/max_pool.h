@@ -19,6 +19,8 @@ limitations under the License.
 #include "global.h"
 #include "tensor_view.h"
 
+class ThreadPool;
+
 struct max_pooling_parameters {
   T_UINT input_height;
   T_UINT input_width;
@@ -32,6 +34,7 @@ struct max_pooling_parameters {
   T_UINT kernel_width;
   T_UINT stride;
   T_UINT padding;
+  ThreadPool *thread_pool;
 };
 
 struct MaxPoolWithArgmax_parameters {
@@ -56,6 +59,15 @@ void func_MaxPool(const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::NHWC>& in
     const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::NHWC>& output,
     struct max_pooling_parameters mpp);
 
+// max pooling of 2 bit activations on their packed lsb and msb words
+void func_MaxPool(const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& input,
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& output,
+    struct max_pooling_parameters mpp);
+
+void func_MaxPool(const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& input,
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output,
+    struct max_pooling_parameters mpp);
+
 void func_MaxPoolWithArgmax(const TensorView<Quantized_t, MemoryLayout::NHWC>& input,
     const TensorView<Quantized_t, MemoryLayout::NHWC>& output,
     const TensorView<T_UINT, MemoryLayout::NHWC>& indices,
@@ -23,12 +23,11 @@ limitations under the License.
 #include "tensor_view.h"
 #include "tensor_convert.h"
 #include "operators.h"
+#include "thread_pool.h"
 #include "time_measurement.h"
+#include "func/impl/quantized_conv2d_epilogue.h"
 #include "func/impl/quantized_conv2d_tiling.h"
 #include "func/impl/quantized_conv2d_kn2row.h"
-#ifdef _OPENMP
-#include <omp.h>
-#endif
 
 template <typename T, MemoryLayout layout>
 void QuantizedConv2D(const TensorView<T, layout>& input,
@@ -39,17 +38,28 @@ void QuantizedConv2D(const TensorView<T, layout>& input,
   constexpr T_UINT TilingInTypeBitWidth = dlk::impl::tiling_input_elem_t::BitCount;
   T_UINT kh = p.normal_conv_params.kernel_height;
   T_UINT kw = p.normal_conv_params.kernel_width;
-  T_UINT padding = p.normal_conv_params.padding;
   T_UINT ih = p.normal_conv_params.input_height;
   T_UINT iw = p.normal_conv_params.input_width;
   T_UINT ic = p.normal_conv_params.kernel_depth;
   T_UINT oc = p.normal_conv_params.output_channels;
-  auto size = oc * ih * iw;
+  T_UINT stride_h = p.normal_conv_params.stride_along_height;
+  T_UINT stride_w = p.normal_conv_params.stride_along_width;
+  const bool dilated = p.normal_conv_params.dilation_along_height != 1
+      || p.normal_conv_params.dilation_along_width != 1;
+  auto size = oc * p.normal_conv_params.output_height * p.normal_conv_params.output_width;
   if (p.device_output_buf == nullptr)
     p.device_output_buf = new BIN_CONV_OUTPUT[size]();
 
-  if ((kh == 3 && kw == 3 && padding == 1) ||
-      (kh == 1 && kw == 1 && padding == 0)) {
+#if defined USE_NEON && !defined RUN_ON_FPGA || defined USE_AVX
+  const bool supported = kh <= dlk::impl::tiling_max_kernel_size && kw <= dlk::impl::tiling_max_kernel_size
+      && stride_h <= dlk::impl::tiling_max_stride && stride_w <= dlk::impl::tiling_max_stride && !dilated;
+#else
+  T_UINT pad_top = p.normal_conv_params.padding_top;
+  T_UINT pad_left = p.normal_conv_params.padding_left;
+  const bool supported = ((kh == 3 && kw == 3 && pad_top == 1 && pad_left == 1) ||
+      (kh == 1 && kw == 1 && pad_top == 0 && pad_left == 0)) && stride_h <= 1 && stride_w <= 1 && !dilated;
+#endif
+  if (supported) {
 #ifdef RUN_ON_FPGA
     dlk::impl::kn2row_input_t::tensor_info_t<std::size_t> shape = {
       (ic + QUANTIZED_PACKED::BitCount - 1) / QUANTIZED_PACKED::BitCount,
@@ -59,9 +69,14 @@ void QuantizedConv2D(const TensorView<T, layout>& input,
       QUANTIZED_PACKED::BitCount
     };
     dlk::impl::kn2row_input_t tmp(p.device_input_buf, shape);
-    Measurement::Start("Tensor convert");
-    convert_tensor(input, tmp);
-    Measurement::Stop();
+    // the previous layer may have written the input into the DMA buffer already
+    const bool in_place = layout == MemoryLayout::ChHWBCl
+        && static_cast<const volatile void*>(input.data()) == static_cast<const volatile void*>(p.device_input_buf);
+    if (!in_place) {
+      Measurement::Start("Tensor convert");
+      convert_tensor(input, tmp, *p.normal_conv_params.thread_pool);
+      Measurement::Stop();
+    }
     dlk::impl::TCAConv2d(tmp, kernel, p);
 #elif defined USE_NEON || defined USE_AVX
     dlk::impl::tiling_input_t::tensor_info_t<std::size_t> shape = {
@@ -73,7 +88,7 @@ void QuantizedConv2D(const TensorView<T, layout>& input,
     };
     dlk::impl::tiling_input_t tmp(p.device_input_buf, shape);
     Measurement::Start("Tensor convert");
-    convert_tensor(input, tmp);
+    convert_tensor(input, tmp, *p.normal_conv_params.thread_pool);
     Measurement::Stop();
     dlk::impl::QuantizedConv2DTiling(tmp, kernel, p);
 #else
@@ -86,7 +101,7 @@ void QuantizedConv2D(const TensorView<T, layout>& input,
     };
     dlk::impl::kn2row_input_t tmp(p.device_input_buf, shape);
     Measurement::Start("Tensor convert");
-    convert_tensor(input, tmp);
+    convert_tensor(input, tmp, *p.normal_conv_params.thread_pool);
     Measurement::Stop();
     dlk::impl::QuantizedConv2DKn2Row(tmp, kernel, p);
 #endif
@@ -98,37 +113,37 @@ void QuantizedConv2D(const TensorView<T, layout>& input,
 }
 
 template <typename T, MemoryLayout layout>
-void func_QuantizedConv2D(
+void func_QuantizedConv2DWithEpilogue(
     const TensorView<T, layout>& input,
     const kernel_t& kernel,
     const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
-    const T_FLOAT scaling_factor,
+    const conv_epilogue_parameters& e,
     const binary_convolution_parameters& p) {
   QuantizedConv2D(input, kernel, p);
 
-  Measurement::Start("QuantizedConv2D_ApplyScalingFactor");
+  Measurement::Start("QuantizedConv2D_Epilogue");
+  dlk::impl::QuantizedConv2DEpilogue(p, e, output);
+  Measurement::Stop();
+}
 
-  unsigned out_elems = p.normal_conv_params.output_height *
-                       p.normal_conv_params.output_width *
-                       p.normal_conv_params.output_channels;
+template <typename T, MemoryLayout layout>
+void func_QuantizedConv2D(
+    const TensorView<T, layout>& input,
+    const kernel_t& kernel,
+    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+    const T_FLOAT scaling_factor,
+    const binary_convolution_parameters& p) {
+  QuantizedConv2D(input, kernel, p);
 
   // temporary: (2^n - 1) * (max - min)
   const T_FLOAT post_qtz_factor = 2.0f / 3.0f;
 
-  int b = 32;
-  auto &ncp(p.normal_conv_params);
-  auto true_out_channels = output.get_shape()[3];
-  auto channel_blocks = (true_out_channels + b - 1) / b;
-
-  int out_index = 0;
-  for (int h = 0; h < ncp.output_height; ++h)
-    for (int w = 0; w < ncp.output_width; ++w)
-      for (int s = 0; s < channel_blocks; ++s)
-        for (int d = 0; d < std::min(b, (int)true_out_channels - s*b); ++d)
-          output.data()[out_index++] = (scaling_factor * post_qtz_factor) * p.device_output_buf[h * (b * ncp.output_width) + w * b + s * (ncp.output_height * ncp.output_width * b) + d];
-
+  Measurement::Start("QuantizedConv2D_ApplyScalingFactor");
+  const conv_epilogue_parameters e = {
+    scaling_factor * post_qtz_factor, nullptr, nullptr, ActivationType::None, 0.0f
+  };
+  dlk::impl::QuantizedConv2DEpilogue(p, e, output);
   Measurement::Stop();
-
 }
 
 template <typename T, MemoryLayout layout>
@@ -140,27 +155,14 @@ void func_QuantizedConv2D(
     binary_convolution_parameters p) {
   QuantizedConv2D(input, kernel, p);
 
-  unsigned out_elems =
-      p.normal_conv_params.output_height * p.normal_conv_params.output_width;
-  unsigned out_channels = p.normal_conv_params.output_channels;
-
-  int b = 32;
-  auto& ncp(p.normal_conv_params);
-  auto true_out_channels = output.get_shape()[3];
-  auto channel_blocks = (true_out_channels + b - 1) / b;
-
   // temporary: (2^n - 1) * (max - min)
   T_FLOAT post_qtz_factor = 2.0 / 3.0;
 
   Measurement::Start("QuantizedConv2D_ApplyScalingFactor");
-
-  int out_index = 0;
-  for (int h = 0; h < ncp.output_height; ++h)
-    for (int w = 0; w < ncp.output_width; ++w)
-      for (int s = 0; s < channel_blocks; ++s)
-        for (int d = 0; d < std::min(b, (int)true_out_channels - s*b); ++d)
-          output.data()[out_index++] = (scaling_factor[s*b + d] * post_qtz_factor) * p.device_output_buf[h * (b * ncp.output_width) + w * b + s * (ncp.output_height * ncp.output_width * b) + d];
-
+  const conv_epilogue_parameters e = {
+    post_qtz_factor, scaling_factor, nullptr, ActivationType::None, 0.0f
+  };
+  dlk::impl::QuantizedConv2DEpilogue(p, e, output);
   Measurement::Stop();
 }
 
@@ -179,21 +181,20 @@ void func_QuantizedConv2DWithThreshold(
 
   const auto bytes = out_elems / 8 * p.n_bit;
 
+  // the next convolution reads this output in place from the DMA buffer
+  if (static_cast<const volatile void*>(output.data()) == static_cast<const volatile void*>(p.device_output_buf))
+    return;
+
   Measurement::Start("Memcpy");
 
-#ifdef _OPENMP
-  const int num_blocks = bytes / sizeof(QUANTIZED_PACKED);
-  const int num_threads = omp_get_max_threads();
-  const int chunk_size = (num_blocks + num_threads - 1) / num_threads;
-#pragma omp parallel for
-  for (int i = 0; i < num_blocks; i += chunk_size) {
-    memcpy(output.data() + i,
-        (QUANTIZED_PACKED*)(p.device_output_buf) + i,
-        std::min(chunk_size, num_blocks - i) * sizeof(QUANTIZED_PACKED));
-  }
-#else
-  memcpy(output.data(), (void*)p.device_output_buf, bytes);
-#endif
+  const std::size_t num_blocks = bytes / sizeof(QUANTIZED_PACKED);
+  const std::size_t chunk_size = (num_blocks + p.normal_conv_params.thread_pool->num_threads() - 1)
+    / p.normal_conv_params.thread_pool->num_threads();
+  p.normal_conv_params.thread_pool->parallel_for(0, num_blocks, chunk_size, [&](std::size_t first, std::size_t last) {
+    memcpy(output.data() + first,
+        (QUANTIZED_PACKED*)(p.device_output_buf) + first,
+        (last - first) * sizeof(QUANTIZED_PACKED));
+  });
 
   Measurement::Stop();
 }
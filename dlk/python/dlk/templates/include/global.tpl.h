@@ -89,6 +89,13 @@ struct Base<QuantizedPacked<T>> {
   typedef T_INT16 BIN_CONV_OUTPUT;
 #endif
 
+// activation a quantized convolution applies when it writes its float output
+enum class ActivationType {
+  None,
+  Relu,
+  LeakyRelu, // max(x * alpha, x)
+};
+
 #define NBIT_QDYPE {{ params.default_nbit_qword }}
 
 #define DEFAULT_GRAPH_INPUT {{ graph_input.dtype.cpptype() }}
@@ -99,7 +106,10 @@ struct Base<QuantizedPacked<T>> {
 
 #define IP_CSR_ADDR 0xFF200000
 #define TH_IP_CSR_ADDR 0xFF200100
-#define INPUT_ADDR 0x20000000
+// device buffers of the two frames in flight (see Network::run_batch)
+#define INPUT0_ADDR 0x20000000
+#define INPUT1_ADDR 0x24000000
+#define INPUT_ADDR INPUT0_ADDR
 #define OUTPUT0_ADDR 0x28000000
 #define OUTPUT1_ADDR 0x30000000
 #define OUTPUT_ADDR OUTPUT0_ADDR
@@ -129,6 +139,7 @@ struct Base<QuantizedPacked<T>> {
 #define MAX_SIZE_IM2COL_INPUTS_PER_LAYER {{ params.max_size_im2col_inputs_per_layer }}
 #define MAX_SIZE_IM2COL_QINPUTS_PER_LAYER {{ params.max_size_im2col_qinputs_per_layer }}
 #define MAX_SIZE_KN2ROW_BUFFER_PER_LAYER {{ params.max_size_kn2row_buffer_per_layer }}
+#define MAX_SIZE_FLOAT_CONV_BUFFER_PER_LAYER {{ params.max_size_float_conv_buffer_per_layer }}
 
 #define MAX_SIZE_KERNELS_PER_LAYER {{ params.max_size_kernels_per_layer }}
 #define MAX_SIZE_QKERNELS_PER_LAYER {{ params.max_size_qkernels_per_layer }}
@@ -0,0 +1,100 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_KERNEL_TABLE_H_INCLUDED
+#define DLK_KERNEL_TABLE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+#include "global.h"
+#include "matrix_view.h"
+
+class ThreadPool;
+struct convolution_parameters;
+
+namespace dlk {
+
+// Kernels which have several implementations for the same data layout.
+//
+// kernels() binds every entry to the fastest implementation the running cpu
+// supports, the first time it is called (Network::init does). This way one x86
+// library uses AVX2 / AVX512 where available and still runs on older cpus.
+// A null entry means there is no fast path and the caller keeps its portable code.
+//
+// Kernels whose weights or inputs are laid out for one implementation at code
+// generation time (tiling vs kn2row convolution) are still chosen by USE_NEON /
+// USE_AVX.
+struct KernelTable {
+  // linear mid tread quantization of input[begin, end)
+  void (*quantize_linear)(const T_FLOAT *input, T_INT nbit, T_FLOAT max_value,
+                          QUANTIZED_NOT_PACKED *output, T_UINT begin, T_UINT end);
+
+  // packs len 2 bit values into a lsb and a msb word per 32 values, len % 32 == 0
+  void (*pack_input_2bit)(const QUANTIZED_NOT_PACKED *input, std::size_t len,
+                          QUANTIZED_PACKED *output);
+
+  // rgb pixels in [0, 1] to 2 bit packed input through the lookup tables
+  void (*lookup)(const float *input, std::size_t pixels,
+                 const QUANTIZED_PACKED_KERNEL *lsb, const QUANTIZED_PACKED_KERNEL *msb,
+                 QUANTIZED_PACKED *output);
+
+  // same with the rgb bytes of the image, in [0, 255]
+  void (*lookup_u8)(const uint8_t *input, std::size_t pixels,
+                    const QUANTIZED_PACKED_KERNEL *lsb, const QUANTIZED_PACKED_KERNEL *msb,
+                    QUANTIZED_PACKED *output);
+
+  // float GEMM packing B into B_buf (Workspace::matmul_buf_elems floats)
+  void (*matrix_multiplication)(MatrixView<float, MatrixOrder::RowMajor>& A,
+                                MatrixView<float, MatrixOrder::ColMajor>& B,
+                                MatrixView<float, MatrixOrder::ColMajor>& C,
+                                float *B_buf,
+                                ThreadPool& pool);
+
+  // one output row of a float convolution with few input channels, see
+  // func/impl/conv2d_direct.h
+  void (*conv2d_direct_row)(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *output,
+                            const convolution_parameters& p, T_UINT out_row);
+
+  // sum over taps and words of pop_count(a ^ b0) + 2 * pop_count(a ^ b1) for
+  // 4 kernel rows against one pixel of the kn2row convolution
+  void (*xor_pop_count)(const uint32_t * const *a, const uint32_t * const *b,
+                        unsigned taps, std::size_t a_stride, std::size_t words,
+                        unsigned rows, int32_t *out);
+
+  // scale, shift and activation of one block of 32 channels of the
+  // accumulators of a quantized convolution, into its float output
+  void (*conv_epilogue)(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+                        const T_FLOAT *scale, const T_FLOAT *shift, ActivationType activation,
+                        T_FLOAT alpha, T_FLOAT *output, std::size_t out_stride);
+
+  // thresholds and 2 bit packing of one block of 32 channels of the
+  // accumulators of a quantized convolution, see func/impl/apply_thresholds.h
+  void (*apply_thresholds_pack)(const BIN_CONV_OUTPUT *acc, std::size_t pixels, std::size_t acc_stride,
+                                const BIN_CONV_OUTPUT *thresholds, QUANTIZED_PACKED *output);
+
+  // acc = max(acc, input) and acc += input over n floats, a tap of a pooling
+  void (*max_pool_row)(const T_FLOAT *input, T_FLOAT *acc, std::size_t n);
+  void (*average_pool_row)(const T_FLOAT *input, T_FLOAT *acc, std::size_t n);
+
+  // acc = max(acc, input) over pairs lsb and msb word pairs of 2 bit values
+  void (*max_pool_2bit)(const QUANTIZED_PACKED *input, QUANTIZED_PACKED *acc, std::size_t pairs);
+};
+
+const KernelTable& kernels();
+
+} // namespace dlk
+
+#endif // DLK_KERNEL_TABLE_H_INCLUDED
@@ -16,7 +16,9 @@ limitations under the License.
 #ifndef DLK_MATRIX_MULTIPLICATION_H_INCLUDED
 #define DLK_MATRIX_MULTIPLICATION_H_INCLUDED
 
+#include "kernel_table.h"
 #include "matrix_view.h"
+#include "thread_pool.h"
 #include "time_measurement.h"
 
 namespace dlk {
@@ -28,19 +30,33 @@ void matrix_multiplication_col3(
   MatrixView<float, MatrixOrder::ColMajor>& B,
   MatrixView<float, MatrixOrder::ColMajor>& C);
 
+// NEON and AVX2 implementations, bound to kernels().matrix_multiplication
 void matrix_multiplication_impl(
    MatrixView<float, MatrixOrder::RowMajor>& A,
    MatrixView<float, MatrixOrder::ColMajor>& B,
-   MatrixView<float, MatrixOrder::ColMajor>& C);
+   MatrixView<float, MatrixOrder::ColMajor>& C,
+   float *B_buf,
+   ThreadPool& pool);
+
+void matrix_multiplication_avx2(
+   MatrixView<float, MatrixOrder::RowMajor>& A,
+   MatrixView<float, MatrixOrder::ColMajor>& B,
+   MatrixView<float, MatrixOrder::ColMajor>& C,
+   float *B_buf,
+   ThreadPool& pool);
 
 } // namespace details
 
 // FIXME: this implementation is very slow...
+// B_buf is scratch for packing B, Workspace::matmul_buf_elems floats.
+// it and the thread pool are only used by the SIMD implementations.
 template<typename T, typename U, typename V>
 void matrix_multiplication(
    MatrixView<T, MatrixOrder::RowMajor>& A,
    MatrixView<U, MatrixOrder::ColMajor>& B,
-   MatrixView<V, MatrixOrder::ColMajor>& C) {
+   MatrixView<V, MatrixOrder::ColMajor>& C,
+   float *B_buf,
+   ThreadPool& pool) {
 
   assert(A.cols() == B.rows());
   Measurement::Start("matrix_multiplication");
@@ -48,16 +64,15 @@ void matrix_multiplication(
 #ifdef USE_NEON
   if (A.cols() == 3 && A.rows() % 4 == 0) {
     details::matrix_multiplication_col3(A, B, C);
-  } else {
-    details::matrix_multiplication_impl(A, B, C);
+    Measurement::Stop();
+    return;
   }
-  Measurement::Stop();
-  return;
-#elif defined USE_AVX
-  details::matrix_multiplication_impl(A, B, C);
-  Measurement::Stop();
-  return;
 #endif
+  if (const auto impl = kernels().matrix_multiplication) {
+    impl(A, B, C, B_buf, pool);
+    Measurement::Stop();
+    return;
+  }
 
   constexpr unsigned int block_size_i = 16; // configurable, multiple of 4
   constexpr unsigned int block_size_j = 16; // configurable
@@ -18,13 +18,15 @@ limitations under the License.
 
 #include "global.h"
 #include "matrix_view.h"
+#include "thread_pool.h"
 
 namespace dlk {
 
 void quantized_matrix_multiplication(
   const MatrixView<QUANTIZED_PACKED_KERNEL, MatrixOrder::RowMajor>& A,
   const MatrixView<QUANTIZED_PACKED, MatrixOrder::ColMajor>& B,
-  MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>& C);
+  MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>& C,
+  ThreadPool& pool);
 
 } // namespace dlk
 
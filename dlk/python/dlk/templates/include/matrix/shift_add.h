@@ -16,118 +16,23 @@ limitations under the License.
 #ifndef DLK_MATRIX_SHIFT_ADD_H_INCLUDED
 #define DLK_MATRIX_SHIFT_ADD_H_INCLUDED
 
+#include <cstddef>
+
+#include "global.h"
 #include "matrix_view.h"
 #include "operators.h" // FIXME(nikolay): for convolution_parameters definition, rid of it later
-#include "time_measurement.h"
 
 namespace dlk {
 
-inline bool is_first_column(int j, int w) {
-  return (j % w == 0);
-}
-
-inline bool is_last_column(int j, int w) {
-  return (j % w == (w - 1));
-}
-
- // 3x3 matrix
- /* A B C */
- /* D E F */
- /* G H I */
-
-// is the right most column for the kernel matrix?
-inline bool is_cfi(int i, int oc) {
-  return int(i / oc) == 2 or int(i / oc) == 5 or int(i / oc) == 8;
-}
-
-// is the left most column for the kernel matrix?
-inline bool is_adg(int i, int oc) {
-  return int(i / oc) == 0 or int(i / oc) == 3 or int(i / oc) == 6;
-}
-
-// Note: this function is only for 3x3 kernel
-inline int calc_offset(int i, int w) {
-  switch (i) {
-  case 0:
-    return w+1;
-  case 1:
-    return w;
-  case 2:
-    return w-1;
-  case 3:
-    return 1;
-  case 4:
-    return 0;
-  case 5:
-    return -1;
-  case 6:
-    return -w+1;
-  case 7:
-    return -w;
-  case 8:
-    return -w-1;
-  }
-
-  // must not come here
-  assert(false);
-}
-
-template<typename T>
-void matrix_shift_add(MatrixView<T, MatrixOrder::ColMajor>& buf,
-                      MatrixView<T, MatrixOrder::ColMajor>& result,
-                      const struct convolution_parameters& p) {
-  Measurement::Start("matrix_shift_add1");
-
-  const int h = p.input_height;
-  const int w = p.input_width;
-  const int oc = p.output_channels;
-  const int kh = p.kernel_height;
-  const int kw = p.kernel_width;
-
-  // only 3x3 kernel is supported.
-  assert(kh == 3 && kw == 3);
-
-  for (unsigned int j = 0; j < buf.cols(); ++j) {
-    for (unsigned int i = 0; i < buf.rows(); ++i) {
-      if (is_first_column(j, w) && is_cfi(i, p.output_channels)) {
-        buf.set(i, j, 0);
-      } else if (is_last_column(j, w) && is_adg(i, p.output_channels)) {
-        buf.set(i, j, 0);
-      }
-    }
-  }
-
-  Measurement::Stop();
-
-  Measurement::Start("matrix_shift_add2");
-
-  for (int k = 0; k < h * w; ++k) {
-    for (unsigned int i = 0; i < kh * kw; ++i) {
-      int offset = calc_offset(i, w);
-      if ((k + offset < 0) || (k + offset >= h * w)) {
-        continue;
-      }
-
-      T* r = result.data(0, k + offset);
-      T* b = buf.data(i*oc, k);
-
-      for (unsigned int j = 0; j < oc; ++j) {
-        r[j] += b[j];
-      }
-    }
-  }
-
-  Measurement::Stop();
-}
-
-template<>
-void matrix_shift_add(MatrixView<int32_t, MatrixOrder::ColMajor>& buf,
-                      MatrixView<int32_t, MatrixOrder::ColMajor>& result,
-                      const struct convolution_parameters& p);
-template<>
-void matrix_shift_add(MatrixView<float, MatrixOrder::ColMajor>& buf,
-                      MatrixView<float, MatrixOrder::ColMajor>& result,
-                      const struct convolution_parameters& p);
+// Shift add of a 3x3 kn2row convolution, for the output rows
+// [first_row, last_row) of result. Row t * oc + o of buf holds the products of
+// tap t (row major in the 3x3 kernel) and output channel o, for the input
+// pixels of the rows [first_row - 1, last_row + 1) clipped to the input.
+// The output rows are overwritten, not accumulated into.
+void matrix_shift_add(const MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>& buf,
+                      MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>& result,
+                      const struct convolution_parameters& p,
+                      std::size_t first_row, std::size_t last_row);
 
 } // namespace dlk
 
@@ -16,8 +16,15 @@ limitations under the License.
 #ifndef NETWORK_H_INCLUDED
 #define NETWORK_H_INCLUDED
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "global.h"
 #include "dma_buffer.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include "workspace.h"
 
 #define SYM_PUBLIC __attribute__ ((visibility ("default")))
 #define SYM_LOCAL  __attribute__ ((visibility ("hidden")))
@@ -30,6 +37,39 @@ public:
 
     bool init();
 
+    // worker threads used by the kernels, counting the calling thread.
+    // 0 (the default) uses one thread per hardware thread.
+    // must be called before init().
+    void set_num_threads(int n);
+
+    // pin the worker threads to the given cpus, round robin.
+    // must be called before init().
+    void set_thread_affinity(const int *cpus, int n);
+
+    // run the kernels on a thread pool outside the network instead of
+    // starting threads, e.g. to share one pool between the networks of
+    // several models. num_threads counts the thread calling parallel_for.
+    // must be called before init().
+    void set_thread_pool(ThreadPool::external_t parallel_for, void *pool, int num_threads);
+
+    // weight file written by the code generator. by default $DLK_WEIGHTS,
+    // else weights.bin next to the library, else in the working directory.
+    // the weights are shared by every network of the process, so all of them
+    // have to use the same file.
+    // must be called before init().
+    void set_weight_path(const std::string& path);
+
+    // record the time of every layer, and of the kernel sections inside
+    // them, into a ring buffer per lane holding the last capacity events of
+    // the frames run on that lane.
+    // 0 disables profiling, which is the default.
+    // must not be called while run() is running.
+    void enable_profiling(std::size_t capacity);
+    void clear_profile();
+
+    // recorded events of all lanes as chrome trace json or csv
+    std::string get_profile(dlk::ProfileFormat format) const;
+
     int get_input_rank();
     int get_output_rank();
     void get_input_shape(int32_t *shape);
@@ -37,28 +77,95 @@ public:
 
     bool run(float *network_input, float *network_output);
 
+    // same with the rgb bytes of the image, i.e. the input before its
+    // division by 255. a lookup table at the input of the network reads
+    // the bytes directly, other networks get them converted to float.
+    bool run_u8(const uint8_t *network_input, float *network_output);
+
+    // run n frames stored back to back in network_inputs and write the n
+    // results back to back in network_outputs. the tensor views and the
+    // parameter structs of every layer are set up once for the whole batch.
+    // on the FPGA even and odd frames run on two threads, which overlaps the
+    // cpu layers of one frame with the TCA convolutions of the other.
+    bool run_batch(std::size_t n, float *network_inputs, float *network_outputs);
+
 private:
-    // declarations
-    {% for node in graph.non_variables %}
-    {% if node.available_buffer == '' %}
-    {% for out_k in node.output_ops.keys() -%}
-    {% if node.output_ops.keys()|length > 1 %}
-    {{ node.dtype.cpptype() }} *{{ node.name + '_' + out_k }}_raw = 0;
-    {% else %}
-    {{ node.dtype.cpptype() }} *{{ node.name }}_raw = 0;
-    {% endif %}
-    {%- endfor %}
-    {% elif node.available_buffer != '' and node.output_ops.keys()|length > 1 %}
-    {% for out_k in node.output_ops.keys() -%}
-    {% if out_k != node.output_ops.keys()|list|first %}
-    {{ node.dtype.cpptype() }} *{{ node.name + '_' + out_k }}_raw = 0;
-    {% endif %}
-    {%- endfor %}
-    {% endif %}
-    {%- endfor %}
-
-    QUANTIZED_PACKED *device_input_buf = 0;
-    BIN_CONV_OUTPUT *device_output_buf = 0;
+    // everything one frame in flight writes to: activations, kernel scratch
+    // memory, threads and device buffers.
+    struct Lane {
+        // single allocation holding every activation buffer. the offsets are
+        // computed by the liveness analysis of the code generator, so buffers
+        // which are never alive at the same time share memory.
+        uint8_t *activation_arena = 0;
+
+        // scratch memory of the kernels, owned by this instance so that
+        // several networks can run at the same time in one process
+        Workspace workspace;
+
+        // threads shared by the kernels of this lane, started in init()
+        ThreadPool thread_pool;
+
+        dlk::Profiler profiler;
+
+        QUANTIZED_PACKED *device_input_buf = 0;
+        BIN_CONV_OUTPUT *device_output_buf = 0;
+
+        DMA_Buffer dma_input_buffer;
+        DMA_Buffer dma_output_buffer;
+
+        // the lanes after the first run their frames of a batch on a thread
+        // of their own, started in init() and asleep between batches.
+        // batch_size is the number of frames of the batch handed to it, 0
+        // once the worker is done with them.
+        std::thread worker;
+        std::mutex worker_mutex;
+        std::condition_variable worker_wake;
+        std::condition_variable worker_done;
+        std::size_t batch_size = 0;
+        float *batch_inputs = nullptr;
+        float *batch_outputs = nullptr;
+        bool batch_ok = true;
+        bool stopping = false;
+    };
+
+    bool init_lane(std::size_t index);
+
+    // body of the worker thread of lane index
+    void worker_main(std::size_t index);
+
+    // runs frames first, first + step, ... < n on one lane
+    // network_inputs_u8, if not null, replaces network_inputs for the
+    // lookup tables reading the input
+    bool run_lane(Lane& lane, std::size_t first, std::size_t n, std::size_t step,
+                  float *network_inputs, const uint8_t *network_inputs_u8,
+                  float *network_outputs);
+
+    static constexpr std::size_t activation_arena_size = {{ arena.size }};
+    static constexpr std::size_t activation_arena_alignment = {{ arena.alignment }};
+
+    // on the FPGA run_batch keeps two frames in flight, so that the cpu
+    // layers of one frame run while the TCA convolves the other. each lane
+    // has its own device buffers (INPUT0/OUTPUT0 and INPUT1/OUTPUT1).
+#if defined RUN_ON_FPGA && !defined FUNC_TIME_MEASUREMENT
+    static constexpr std::size_t num_lanes = 2;
+#else
+    static constexpr std::size_t num_lanes = 1;
+#endif
+    Lane lanes[num_lanes];
+    // lanes whose buffers could be set up in init()
+    std::size_t active_lanes = 0;
+
+    // profile frame number of frame 0 of the running batch
+    std::uint32_t first_frame = 0;
+
+    // run_u8 input converted to float, for networks without a lookup table
+    std::vector<float> u8_input;
+
+    std::size_t num_threads = 0;
+    std::vector<int> thread_affinity;
+    ThreadPool::external_t external_parallel_for = nullptr;
+    void *external_pool = nullptr;
+    std::string weight_path;
 
     const T_INT input_rank = {{ graph_input.rank }};
     const T_INT input_shape[{{ graph_input.rank }}] = { {{ graph_input.view.shape_list }} };
@@ -66,12 +173,12 @@ private:
     const T_INT output_rank = {{ graph_output.rank }};
     const T_INT output_shape[{{ graph_output.rank }}] = { {{ graph_output.view.shape_list }} };
 
+    static constexpr std::size_t input_elems = {{ graph_input.view.shape }};
+    static constexpr std::size_t output_elems = {{ graph_output.view.shape }};
+
     const int max_device_input_elems = MAX_SIZE_IM2COL_QINPUTS_PER_LAYER;
     const int max_device_output_elems = MAX_SIZE_OUTPUTS_PER_LAYER;
 
-    DMA_Buffer dma_input_buffer;
-    DMA_Buffer dma_output_buffer;
-
 #if defined RUN_ON_FPGA
   {% set offset = namespace(o=0) -%}
   {% for qconv in graph.convs(quantized_only=True) -%}
@@ -18,6 +18,8 @@ limitations under the License.
 
 #include "dma_buffer.h"
 #include "global.h"
+#include "thread_pool.h"
+#include "workspace.h"
 #include <string>
 
 struct convolution_parameters {
@@ -32,7 +34,27 @@ struct convolution_parameters {
   T_UINT kernel_width;
   T_UINT stride_along_height;
   T_UINT stride_along_width;
+  T_UINT dilation_along_height;
+  T_UINT dilation_along_width;
   T_UINT padding;
+  // padding before the first row and column, which differ for 1xN and Nx1
+  // kernels. padding is the top one.
+  T_UINT padding_top;
+  T_UINT padding_left;
+  Workspace *workspace;
+  ThreadPool *thread_pool;
+};
+
+// what a quantized convolution without thresholds does to its integer
+// accumulators while it writes its float output. output channel c gets
+// activation(scaling_factor * scale[c] * x + shift[c]), scale and shift
+// being optional.
+struct conv_epilogue_parameters {
+  T_FLOAT scaling_factor;
+  const T_FLOAT *scale;
+  const T_FLOAT *shift;
+  ActivationType activation;
+  T_FLOAT alpha;
 };
 
 struct binary_convolution_parameters {
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "global.h"
 #include "operators.h" // FIXME(nikolay): for convolution_parameters definition, rid of it later
+#include "thread_pool.h"
 
 void pack_input_to_qwords(QUANTIZED_NOT_PACKED input[],
                           QUANTIZED_PACKED output[],
@@ -31,6 +32,12 @@ void pack_input_to_qwords(
 
 
 int pack_input(QUANTIZED_NOT_PACKED input[], size_t input_height, size_t input_width, size_t input_depth,
-  size_t bits_per_input, QUANTIZED_PACKED output[]);
+  size_t bits_per_input, QUANTIZED_PACKED output[], ThreadPool& thread_pool);
+
+// 2 bit fast paths of pack_input, bound by kernels()
+void pack_input_2bit_neon(const QUANTIZED_NOT_PACKED *input, std::size_t len,
+  QUANTIZED_PACKED *output);
+void pack_input_2bit_avx2(const QUANTIZED_NOT_PACKED *input, std::size_t len,
+  QUANTIZED_PACKED *output);
 
 #endif // DLK_PACK_INPUT_TO_QWORDS_H_INCLUDED
@@ -0,0 +1,146 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_PROFILER_H_INCLUDED
+#define DLK_PROFILER_H_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dlk {
+
+// static description of a generated layer, emitted by the code generator
+struct LayerInfo {
+  const char *name;
+  const char *op_type;
+  std::uint64_t flops;
+  std::uint64_t bytes;
+};
+
+enum class ProfileFormat {
+  ChromeTrace = 0,  // json for chrome://tracing and perfetto
+  Csv = 1,
+};
+
+// Records per layer (and per Measurement section) timings of a network into
+// a ring buffer allocated by enable(). When the buffer is full the oldest
+// events are overwritten. Recording does not allocate and costs two
+// steady_clock reads per event, a disabled profiler costs one branch.
+//
+// One profiler belongs to one lane of a network and is written by the thread
+// running that lane; export it only while the network is not running.
+class Profiler {
+ public:
+  // capacity 0 disables recording and frees the buffer
+  void enable(std::size_t capacity);
+  bool enabled() const { return !events.empty(); }
+  void clear();
+
+  // number of events currently held
+  std::size_t size() const { return count; }
+
+  // index is the number of the frame across all the lanes of the network
+  void begin_frame(std::uint32_t index) { frame = index; }
+  void begin_layer() {
+    if (enabled())
+      layer_start = now();
+  }
+  void end_layer(const LayerInfo& layer) {
+    if (enabled())
+      record(layer.name, layer.op_type, layer.flops, layer.bytes, layer_start, now(), 0);
+  }
+
+  // nested sections reported by Measurement::Start / Stop
+  void push(const char *name);
+  void pop();
+
+  // events of all the profilers, frame by frame. in the chrome trace every
+  // profiler gets its own thread id, so that overlapping frames stay apart.
+  static std::string export_as(const std::vector<const Profiler*>& profilers, ProfileFormat format);
+
+  // profiler of the network running on this thread, or null.
+  // Measurement forwards its sections there.
+  static Profiler *current();
+
+  // makes a profiler current() for the lifetime of the session, if enabled
+  class Session {
+   public:
+    explicit Session(Profiler& profiler);
+    ~Session();
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+   private:
+    Profiler *previous;
+  };
+
+ private:
+  struct Event {
+    const char *name;
+    const char *op_type;
+    std::uint64_t flops;
+    std::uint64_t bytes;
+    std::int64_t start_ns;
+    std::int64_t end_ns;
+    std::uint32_t frame;
+    std::uint32_t depth;
+  };
+
+  struct LaneEvent {
+    Event event;
+    std::uint32_t lane;
+  };
+
+  struct Section {
+    const char *name;
+    std::int64_t start_ns;
+  };
+
+  static constexpr std::size_t max_depth = 16;
+
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void record(const char *name, const char *op_type, std::uint64_t flops, std::uint64_t bytes,
+              std::int64_t start_ns, std::int64_t end_ns, std::uint32_t depth);
+
+  // events in the order they were recorded
+  template <typename F>
+  void for_each(F f) const {
+    const std::size_t first = (head + events.size() - count) % events.size();
+    for (std::size_t i = 0; i < count; ++i)
+      f(events[(first + i) % events.size()]);
+  }
+
+  static std::string chrome_trace(const std::vector<LaneEvent>& events);
+  static std::string csv(const std::vector<LaneEvent>& events);
+
+  std::vector<Event> events;
+  std::size_t head = 0;
+  std::size_t count = 0;
+  std::uint32_t frame = 0;
+  std::int64_t layer_start = 0;
+
+  Section sections[max_depth];
+  std::size_t depth = 0;
+};
+
+} // namespace dlk
+
+#endif // DLK_PROFILER_H_INCLUDED
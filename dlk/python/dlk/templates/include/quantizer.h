@@ -20,6 +20,8 @@ limitations under the License.
 
 #include "global.h"
 #include "tensor_view.h"
+#include "thread_pool.h"
+#include "workspace.h"
 
 void func_QTZ_binary_channel_wise_mean_scaling(
     const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
@@ -46,16 +48,37 @@ void func_QTZ_binary_mean_scaling(
   }
 }
 
+// quantize input[begin, end); the avx2 variant is bound by kernels() on x86
+void func_QTZ_linear_mid_tread_half_body(
+  const T_FLOAT input[],
+  T_INT nbit,
+  T_FLOAT max_value,
+  QUANTIZED_NOT_PACKED output[],
+  T_UINT begin,
+  T_UINT end);
+
+void func_QTZ_linear_mid_tread_half_body_avx2(
+  const T_FLOAT input[],
+  T_INT nbit,
+  T_FLOAT max_value,
+  QUANTIZED_NOT_PACKED output[],
+  T_UINT begin,
+  T_UINT end);
+
 void func_QTZ_linear_mid_tread_half(
     const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
     const TensorView<T_INT, MemoryLayout::Atom>& nbit,
     const TensorView<T_FLOAT, MemoryLayout::Atom>& max_value,
-    const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& output);
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& output,
+    const Workspace& workspace,
+    ThreadPool& thread_pool);
 
 void func_QTZ_linear_mid_tread_half(
   const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
   const TensorView<T_INT, MemoryLayout::Atom>& nbit,
   const TensorView<T_FLOAT, MemoryLayout::Atom>& max_value,
-  const TensorView<T_FLOAT, MemoryLayout::NHWC>& output);
+  const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+  const Workspace& workspace,
+  ThreadPool& thread_pool);
 
 #endif // QUANTIZER_H_INCLUDED
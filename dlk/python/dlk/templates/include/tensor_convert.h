@@ -18,15 +18,13 @@ limitations under the License.
 
 #include "global.h"
 #include "tensor_view.h"
+#include "thread_pool.h"
 #include "func/impl/quantized_conv2d_kn2row.h"
 #include "func/impl/quantized_conv2d_tiling.h"
 #include "func/impl/quantized_conv2d_dim2col.h"
 #ifdef USE_NEON
 #include <arm_neon.h>
 #endif
-#ifdef _OPENMP
-#include <omp.h>
-#endif
 
 inline void convert_tensor(const TensorView<BIN_CONV_OUTPUT, MemoryLayout::HWC>& before,
     const TensorView<BIN_CONV_OUTPUT, MemoryLayout::ChHWCl>& after) {
@@ -104,62 +102,67 @@ inline void convert_tensor(const TensorView<QUANTIZED_PACKED, MemoryLayout::HWCh
 }
 
 inline void convert_tensor(const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& before,
-    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& after) {
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& after,
+    ThreadPool& pool) {
   const auto in_shape = before.get_shape();
   const auto height = in_shape[0];
   const auto width = in_shape[1];
   const auto channel = in_shape[2];
   const auto bits = in_shape[3];
-#pragma omp parallel for
-  for (std::size_t i = 0; i < height; ++i)
-    for (std::size_t j = 0; j < width; ++j)
-      for (std::size_t k = 0; k < channel; ++k) {
-        const auto idx_before = i * width * channel * bits
-            + j * channel * bits
-            + k * bits;
-        const auto idx_after = k * height * width * bits
-            + i * width * bits
-            + j * bits;
+  pool.parallel_for(0, height, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i)
+      for (std::size_t j = 0; j < width; ++j)
+        for (std::size_t k = 0; k < channel; ++k) {
+          const auto idx_before = i * width * channel * bits
+              + j * channel * bits
+              + k * bits;
+          const auto idx_after = k * height * width * bits
+              + i * width * bits
+              + j * bits;
 #ifdef AARCH32
-        const auto tmp = vld1_u32(reinterpret_cast<uint32_t*>(before.data() + idx_before));
-        vst1_u32(reinterpret_cast<uint32_t*>(after.data() + idx_after), tmp);
+          const auto tmp = vld1_u32(reinterpret_cast<uint32_t*>(before.data() + idx_before));
+          vst1_u32(reinterpret_cast<uint32_t*>(after.data() + idx_after), tmp);
 #else
-        *reinterpret_cast<uint64_t*>(after.data() + idx_after) =
-            *reinterpret_cast<uint64_t*>(before.data() + idx_before);
+          *reinterpret_cast<uint64_t*>(after.data() + idx_after) =
+              *reinterpret_cast<uint64_t*>(before.data() + idx_before);
 #endif
-      }
+        }
+  });
 }
 
 inline void convert_tensor(const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& before,
-    const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& after) {
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& after,
+    ThreadPool& pool) {
   const auto in_shape = before.get_shape();
   const auto height = in_shape[1];
   const auto width = in_shape[2];
   const auto channel = in_shape[0];
   const auto bits = in_shape[3];
-#pragma omp parallel for
-  for (std::size_t i = 0; i < height; ++i)
-    for (std::size_t j = 0; j < width; ++j)
-      for (std::size_t k = 0; k < channel; ++k) {
-        const auto idx_before = k * height * width * bits
-            + i * width * bits
-            + j * bits;
-        const auto idx_after = i * width * channel * bits
-            + j * channel * bits
-            + k * bits;
+  pool.parallel_for(0, height, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i)
+      for (std::size_t j = 0; j < width; ++j)
+        for (std::size_t k = 0; k < channel; ++k) {
+          const auto idx_before = k * height * width * bits
+              + i * width * bits
+              + j * bits;
+          const auto idx_after = i * width * channel * bits
+              + j * channel * bits
+              + k * bits;
 #ifdef AARCH32
-        const auto tmp = vld1_u32(reinterpret_cast<uint32_t*>(before.data() + idx_before));
-        vst1_u32(reinterpret_cast<uint32_t*>(after.data() + idx_after), tmp);
+          const auto tmp = vld1_u32(reinterpret_cast<uint32_t*>(before.data() + idx_before));
+          vst1_u32(reinterpret_cast<uint32_t*>(after.data() + idx_after), tmp);
 #else
-        *reinterpret_cast<uint64_t*>(after.data() + idx_after) =
-            *reinterpret_cast<uint64_t*>(before.data() + idx_before);
+          *reinterpret_cast<uint64_t*>(after.data() + idx_after) =
+              *reinterpret_cast<uint64_t*>(before.data() + idx_before);
 #endif
-      }
+        }
+  });
 }
 
 inline void convert_tensor(const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::NHWC>& before,
-    const dlk::impl::tiling_input_t& after) {
-  dlk::impl::pack_input_for_tiling(before, after);
+    const dlk::impl::tiling_input_t& after,
+    ThreadPool& pool) {
+  dlk::impl::pack_input_for_tiling(before, after, pool);
 }
 
 inline void convert_tensor(const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::NHWC>& before,
@@ -170,18 +173,13 @@ inline void convert_tensor(const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::
 
 template <typename T, MemoryLayout layout>
 void convert_tensor(const TensorView<T, layout>& before,
-    const TensorView<T, layout>& after) {
-  const auto num_elems = before.size();
-#ifdef _OPENMP
-  const auto num_threads = omp_get_max_threads();
-  const auto chunk_size = (num_elems + num_threads - 1) / num_threads;
-#pragma omp parallel for
-  for (int i = 0; i < num_elems; i += chunk_size) {
-    std::copy(before.data() + i, before.data() + std::min(i + chunk_size, num_elems), after.data() + i);
-  }
-#else
-  std::copy(before.data(), before.data() + num_elems, after.data());
-#endif
+    const TensorView<T, layout>& after,
+    ThreadPool& pool) {
+  const std::size_t num_elems = before.size();
+  const std::size_t chunk_size = (num_elems + pool.num_threads() - 1) / pool.num_threads();
+  pool.parallel_for(0, num_elems, chunk_size, [&](std::size_t first, std::size_t last) {
+    std::copy(before.data() + first, before.data() + last, after.data() + first);
+  });
 }
 
 #endif
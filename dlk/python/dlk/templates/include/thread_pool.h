@@ -0,0 +1,112 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_THREAD_POOL_H_INCLUDED
+#define DLK_THREAD_POOL_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Worker threads shared by all the kernels of one Network.
+//
+// The threads are started once in init() and sleep between jobs, so a layer
+// only pays for waking them up. parallel_for splits its range evenly over the
+// workers and the calling thread; a thread which runs out of work steals the
+// back half of the largest remaining range.
+class ThreadPool
+{
+public:
+  // calls ctx's job on [first, last)
+  using invoke_t = void (*)(void *ctx, std::size_t first, std::size_t last);
+  // parallel_for of a pool outside the network, e.g. one shared by the
+  // networks of several libraries loaded into the same process. it must
+  // accept calls from several threads at once and run nested calls serially.
+  using external_t = void (*)(void *pool, std::size_t begin, std::size_t end, std::size_t grain,
+                              invoke_t invoke, void *ctx);
+
+  ThreadPool() = default;
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // num_threads counts the calling thread, 0 means hardware_concurrency().
+  // worker i is pinned to cpus[i % cpus.size()] unless cpus is empty.
+  bool init(std::size_t num_threads, const std::vector<int>& cpus);
+
+  // starts no thread and hands every parallel_for to parallel_for(pool, ...),
+  // which runs on num_threads threads counting the calling one
+  bool init_external(external_t parallel_for, void *pool, std::size_t num_threads);
+
+  std::size_t num_threads() const { return external ? external_threads : workers.size() + 1; }
+
+  // calls f(first, last) on disjoint sub ranges covering [begin, end).
+  // each call gets at most grain elements; it returns when all calls are done.
+  template<typename F>
+  void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& f) {
+    using Fn = typename std::remove_reference<F>::type;
+    run(begin, end, grain,
+        [](void *ctx, std::size_t first, std::size_t last) {
+          (*static_cast<Fn*>(ctx))(first, last);
+        },
+        const_cast<void*>(static_cast<const void*>(&f)));
+  }
+
+private:
+  struct alignas(64) Range {
+    std::mutex mutex;
+    std::size_t next = 0;
+    std::size_t end = 0;
+  };
+
+  // plain new[] does not honour the cache line alignment of Range before
+  // C++17, so the ranges live in posix_memalign'ed memory
+  struct RangesDeleter {
+    std::size_t count;
+    void operator()(Range *r) const;
+  };
+
+  void run(std::size_t begin, std::size_t end, std::size_t grain, invoke_t invoke, void *ctx);
+  void work(std::size_t self);
+  bool steal(std::size_t self);
+  void worker_main(std::size_t self);
+
+  std::vector<std::thread> workers;
+  std::unique_ptr<Range[], RangesDeleter> ranges;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::atomic<uint64_t> generation{0};
+  std::atomic<std::size_t> pending{0};
+  bool stopping = false;
+
+  invoke_t job_invoke = nullptr;
+  void *job_ctx = nullptr;
+  std::size_t job_grain = 1;
+
+  external_t external = nullptr;
+  void *external_pool = nullptr;
+  std::size_t external_threads = 1;
+};
+
+#endif // DLK_THREAD_POOL_H_INCLUDED
@@ -33,8 +33,8 @@ private:
 
   struct measure
   {
-    std::chrono::system_clock::time_point start;
-    std::chrono::system_clock::time_point end;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
   };
 
   struct Node {
@@ -57,7 +57,11 @@ private:
   static void DumpTimeTree(const Node&, int level);
 
 public:
-  static void Start(const std::string &measure_name);
+  // Sections are forwarded to the profiler of the running network when
+  // profiling is enabled (see Network::enable_profiling). The text tree of
+  // Report() is only collected when built with FUNC_TIME_MEASUREMENT.
+  // measure_name must outlive the profile, string literals are.
+  static void Start(const char *measure_name);
   static void Stop();
   static void Report();
 };
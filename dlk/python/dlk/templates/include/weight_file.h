@@ -0,0 +1,99 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_WEIGHT_FILE_H_INCLUDED
+#define DLK_WEIGHT_FILE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "tensor_view.h"
+
+namespace dlk {
+
+// Constants of the network, written by the code generator next to the
+// project (core/weight_file.py) and mapped read/write private, so pages are
+// read from disk when a layer first touches them and are shared with every
+// other process using the same file.
+//
+// Layout, version 1, little endian:
+//   header   magic, version, number of entries, alignment, reserved, file size
+//   entries  offset and size of the data, offset and size of the name, reserved
+//   names    nul terminated
+//   data     of every entry, at offsets which are multiples of the alignment
+class WeightFile {
+ public:
+  static constexpr char magic[8] = {'D', 'L', 'K', 'W', 'G', 'H', 'T', '\0'};
+  static constexpr std::uint32_t version = 1;
+
+  struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t num_entries;
+    std::uint32_t alignment;
+    std::uint32_t reserved;
+    std::uint64_t file_size;
+  };
+
+  struct Entry {
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint32_t name_offset;
+    std::uint32_t name_size;
+    std::uint64_t reserved;
+  };
+
+  WeightFile() = default;
+  WeightFile(const WeightFile&) = delete;
+  WeightFile& operator=(const WeightFile&) = delete;
+  ~WeightFile() { close(); }
+
+  // maps the file and checks its header and entry table
+  bool open(const std::string& path);
+  void close();
+  bool is_open() const { return base != nullptr; }
+  const std::string& get_path() const { return path; }
+
+  // data of the entry called name, or null if there is none or it holds
+  // less than size bytes
+  void *find(const char *name, std::size_t size) const;
+
+  // points view, whose shape is already set, to the entry called name
+  template <typename T, MemoryLayout layout>
+  bool bind(const char *name, TensorView<T, layout>& view) const {
+    void *data = find(name, view.size() * sizeof(T));
+    if (data == nullptr)
+      return false;
+    view = TensorView<T, layout>(static_cast<T*>(data), view.get_shape());
+    return true;
+  }
+
+ private:
+  std::string path;
+  std::uint8_t *base = nullptr;
+  std::size_t size = 0;
+  const Entry *entries = nullptr;
+  std::uint32_t num_entries = 0;
+};
+
+// $DLK_WEIGHTS if set, else weights.bin in the directory of the library or
+// executable this code is linked into, else weights.bin in the working
+// directory
+std::string default_weight_path();
+
+} // namespace dlk
+
+#endif // DLK_WEIGHT_FILE_H_INCLUDED
@@ -0,0 +1,105 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef DLK_WORKSPACE_H_INCLUDED
+#define DLK_WORKSPACE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include "global.h"
+#include "kernel_table.h"
+
+// Scratch memory used by the kernels while a network runs.
+// Each Network owns one Workspace and passes it to the kernels through
+// convolution_parameters, so that Network instances in different threads
+// never share a buffer.
+class Workspace
+{
+public:
+  // thresholds of one layer reordered for the tiling convolution
+  static constexpr std::size_t thresholds_elems = NUM_OF_A2W1_THRESHOLD * MAX_IN_C;
+
+  // a band of the float convolution: im2col columns or winograd tiles
+  static constexpr std::size_t float_conv_buf_elems = MAX_SIZE_FLOAT_CONV_BUFFER_PER_LAYER;
+
+  // packed right hand side of the float matrix multiplication (+ alignment
+  // margin). the right hand side is a band of at most float_conv_buf_elems
+  // floats; packing may add up to matmul_pad_cols columns to it.
+  static constexpr std::size_t matmul_pad_cols = 8;
+  static constexpr std::size_t matmul_align_margin = 32 / sizeof(float);
+  static constexpr std::size_t matmul_buf_elems = float_conv_buf_elems + matmul_align_margin;
+
+  // products of a band of output rows of the quantized 3x3 kn2row convolution
+  static constexpr std::size_t kn2row_buf_elems = MAX_SIZE_KN2ROW_BUFFER_PER_LAYER;
+
+  // packed 2 bit output of the quantized kn2row convolution with thresholds
+  static constexpr std::size_t kn2row_packed_buf_elems = MAX_SIZE_QOUTPUTS_PER_LAYER;
+
+  // not yet packed output of the linear activation quantizer
+  static constexpr std::size_t quantizer_buf_elems = MAX_SIZE_INPUTS_PER_LAYER;
+
+  // kernel words of the 1x1 tiling convolution, each stored twice (+ alignment
+  // margin for the 32 byte loads)
+  static constexpr std::size_t tiling_kernel_align_margin = 32 / sizeof(uint32_t);
+  static constexpr std::size_t tiling_kernel_buf_elems = MAX_SIZE_QKERNELS_PER_LAYER * 2;
+
+  bool init()
+  {
+    thresholds_.reset(new (std::nothrow) BIN_CONV_OUTPUT[thresholds_elems]);
+    if (dlk::kernels().matrix_multiplication != nullptr) {
+      matmul_buf_.reset(new (std::nothrow) float[matmul_buf_elems]);
+      if (!matmul_buf_)
+        return false;
+    }
+    float_conv_buf_.reset(new (std::nothrow) float[float_conv_buf_elems]);
+    kn2row_buf_.reset(new (std::nothrow) BIN_CONV_OUTPUT[kn2row_buf_elems]);
+    kn2row_packed_buf_.reset(new (std::nothrow) QUANTIZED_PACKED[kn2row_packed_buf_elems]);
+    quantizer_buf_.reset(new (std::nothrow) QUANTIZED_NOT_PACKED[quantizer_buf_elems]);
+#ifdef USE_AVX
+    tiling_kernel_buf_.reset(new (std::nothrow) uint32_t[tiling_kernel_buf_elems + tiling_kernel_align_margin]);
+    if (!tiling_kernel_buf_)
+      return false;
+    void *aligned = tiling_kernel_buf_.get();
+    std::size_t space = (tiling_kernel_buf_elems + tiling_kernel_align_margin) * sizeof(uint32_t);
+    tiling_kernel_buf_aligned_ = static_cast<uint32_t*>(
+        std::align(32, tiling_kernel_buf_elems * sizeof(uint32_t), aligned, space));
+#endif
+
+    return thresholds_ && float_conv_buf_ && kn2row_buf_ && kn2row_packed_buf_ && quantizer_buf_;
+  }
+
+  BIN_CONV_OUTPUT *thresholds() const { return thresholds_.get(); }
+  float *matmul_buf() const { return matmul_buf_.get(); }
+  float *float_conv_buf() const { return float_conv_buf_.get(); }
+  BIN_CONV_OUTPUT *kn2row_qbuf() const { return kn2row_buf_.get(); }
+  QUANTIZED_PACKED *kn2row_packed_buf() const { return kn2row_packed_buf_.get(); }
+  QUANTIZED_NOT_PACKED *quantizer_buf() const { return quantizer_buf_.get(); }
+  uint32_t *tiling_kernel_buf() const { return tiling_kernel_buf_aligned_; }
+
+private:
+  std::unique_ptr<BIN_CONV_OUTPUT[]> thresholds_;
+  std::unique_ptr<float[]> matmul_buf_;
+  std::unique_ptr<float[]> float_conv_buf_;
+  std::unique_ptr<BIN_CONV_OUTPUT[]> kn2row_buf_;
+  std::unique_ptr<QUANTIZED_PACKED[]> kn2row_packed_buf_;
+  std::unique_ptr<QUANTIZED_NOT_PACKED[]> quantizer_buf_;
+  std::unique_ptr<uint32_t[]> tiling_kernel_buf_;
+  uint32_t *tiling_kernel_buf_aligned_ = nullptr;
+};
+
+#endif // DLK_WORKSPACE_H_INCLUDED
@@ -26,68 +26,55 @@ const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::Atom>
 
 {% else -%}
 
+// the data is in the weight file, Network::init() points the view to it
+
 {% if node.transposed_data %}
 
 #ifdef RUN_ON_FPGA
-static Base<{{ node.dtype.cpptype() }}>::type {{ node.name }}_raw[] = {
-  {% for d in node.transposed_data -%}
-  {{- d -}},
-  {%- endfor %}
-};
 static constexpr decltype({{ node.name }})::tensor_info_t<std::size_t> {{ node.name }}_shape = {
   {% for l in node.transposed_shape -%}
   {{- l -}},
   {%- endfor %}
 };
-const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.transposed_dimension_format }}> {{ node.name }}(
-    reinterpret_cast<{{ node.dtype.cpptype() }}*>({{ node.name }}_raw),
-    {{ node.name }}_shape);
+static const char {{ node.name }}_entry[] = "{{ node.name }}.transposed";
+TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.transposed_dimension_format }}> {{ node.name }}(
+    nullptr, {{ node.name }}_shape);
 #elif defined USE_NEON || defined USE_AVX
-static Base<{{ node.dtype.cpptype() }}>::type {{ node.name }}_raw[] = {
-  {% for d in node.data.flatten() -%}
-  {{- d -}},
-  {%- endfor %}
-};
 static constexpr decltype({{ node.name }})::tensor_info_t<std::size_t> {{ node.name }}_shape = {
   {% for l in node.shape -%}
   {{- l -}},
   {%- endfor %}
 };
-const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension }}> {{ node.name }}(
-    reinterpret_cast<{{ node.dtype.cpptype() }}*>({{ node.name }}_raw),
-    {{ node.name }}_shape);
+static const char {{ node.name }}_entry[] = "{{ node.name }}";
+TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension }}> {{ node.name }}(
+    nullptr, {{ node.name }}_shape);
 #else
-static Base<{{ node.dtype.cpptype() }}>::type {{ node.name }}_raw[] = {
-  {% for d in node.kn2row_data -%}
-  {{- d -}},
-  {%- endfor %}
-};
 static constexpr decltype({{ node.name }})::tensor_info_t<std::size_t> {{ node.name }}_shape = {
   {% for l in node.kn2row_shape -%}
   {{- l -}},
   {%- endfor %}
 };
-const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.kn2row_dimension_format }}> {{ node.name }}(
-    reinterpret_cast<{{ node.dtype.cpptype() }}*>({{ node.name }}_raw),
-    {{ node.name }}_shape);
+static const char {{ node.name }}_entry[] = "{{ node.name }}.kn2row";
+TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.kn2row_dimension_format }}> {{ node.name }}(
+    nullptr, {{ node.name }}_shape);
 #endif
 
 {% else -%}
 
-static Base<{{ node.dtype.cpptype() }}>::type {{ node.name }}_raw[] = {
-  {% for d in node.data.flatten() -%}
-  {{- d -}},
-  {%- endfor %}
-};
 static constexpr decltype({{ node.name }})::tensor_info_t<std::size_t> {{ node.name }}_shape = {
   {% for l in node.shape -%}
   {{- l -}},
   {%- endfor %}
 };
-const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension }}> {{ node.name }}(
-    reinterpret_cast<{{ node.dtype.cpptype() }}*>({{ node.name }}_raw),
-    {{ node.name }}_shape);
+static const char {{ node.name }}_entry[] = "{{ node.name }}";
+TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension }}> {{ node.name }}(
+    nullptr, {{ node.name }}_shape);
 
 {% endif %}
 
+bool bind_{{ node.name }}(const dlk::WeightFile& weights)
+{
+  return weights.bind({{ node.name }}_entry, {{ node.name }});
+}
+
 {%- endif %}
@@ -17,24 +17,32 @@ limitations under the License.
 #define INPUT_{{ node.name }}_H_INCLUDED
 
 #include "global.h"
+#include "weight_file.h"
 
 {% if node.is_scalar -%}
 
 extern const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::Atom> {{ node.name }};
 
-{% elif node.transposed_data -%}
+{% else -%}
+
+{% if node.transposed_data -%}
 
 #ifdef RUN_ON_FPGA
-extern const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.transposed_dimension_format }}> {{ node.name }};
+extern TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.transposed_dimension_format }}> {{ node.name }};
 #elif defined USE_NEON || defined USE_AVX
-extern const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension}}> {{ node.name }};
+extern TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension}}> {{ node.name }};
 #else
-extern const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.kn2row_dimension_format }}> {{ node.name }};
+extern TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.kn2row_dimension_format }}> {{ node.name }};
 #endif
 
 {% else -%}
 
-extern const TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension}}> {{ node.name }};
+extern TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension}}> {{ node.name }};
+
+{% endif -%}
+
+// points {{ node.name }} to its data in the weight file
+bool bind_{{ node.name }}(const dlk::WeightFile& weights);
 
 {%- endif %}
 
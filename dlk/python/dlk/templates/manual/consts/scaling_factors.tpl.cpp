@@ -38,6 +38,22 @@ OtherQuantizerScalingFactorNotImplemented
 
 {%- endif %}
 
+{% if conv.has_epilogue -%}
+
+T_FLOAT {{ conv.name }}_epilogue_scale[{{ conv.channel }}] = {
+  {% for f in conv.epilogue_scale -%}
+  {{- f -}},
+  {%- endfor %}
+};
+
+T_FLOAT {{ conv.name }}_epilogue_shift[{{ conv.channel }}] = {
+  {% for f in conv.epilogue_shift -%}
+  {{- f -}},
+  {%- endfor %}
+};
+
+{%- endif %}
+
 {%- endfor %}
 
 } // namespace scaling_factors
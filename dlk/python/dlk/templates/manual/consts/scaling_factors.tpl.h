@@ -36,6 +36,13 @@ OtherQuantizerScalingFactorNotImplemented
 
 {%- endif %}
 
+{% if conv.has_epilogue -%}
+
+extern T_FLOAT {{ conv.name }}_epilogue_scale[{{ conv.channel }}];
+extern T_FLOAT {{ conv.name }}_epilogue_shift[{{ conv.channel }}];
+
+{%- endif %}
+
 {%- endfor %}
 
 } // namespace scaling_factors
@@ -17,11 +17,17 @@ limitations under the License.
 #include "thresholds.h"
 
 {% for conv in quantized_convs %}
+BIN_CONV_OUTPUT *{{ conv.name }}_thresholds = nullptr;
+{%- endfor %}
 
-BIN_CONV_OUTPUT {{ conv.name }}_thresholds[{{ conv.channel }} * NUM_OF_A2W1_THRESHOLD] = {
-  {% for d in conv.thresholds -%}
-  {{- d -}},
-  {%- endfor %}
-};
-
-{% endfor %}
+bool bind_thresholds(const dlk::WeightFile& weights)
+{
+  void *data;
+  {% for conv in quantized_convs -%}
+  data = weights.find("{{ conv.name }}.thresholds", {{ conv.channel }} * NUM_OF_A2W1_THRESHOLD * sizeof(BIN_CONV_OUTPUT));
+  if (data == nullptr)
+    return false;
+  {{ conv.name }}_thresholds = static_cast<BIN_CONV_OUTPUT*>(data);
+  {% endfor %}
+  return true;
+}
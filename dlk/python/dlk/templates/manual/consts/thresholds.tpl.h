@@ -17,13 +17,18 @@ limitations under the License.
 #define INPUT_THRESHOLDS_H_INCLUDED
 
 #include "global.h"
+#include "weight_file.h"
 
 {% for conv in quantized_convs %}
 
-extern BIN_CONV_OUTPUT {{ conv.name }}_thresholds[{{ conv.channel }} * NUM_OF_A2W1_THRESHOLD];
+// {{ conv.channel }} * NUM_OF_A2W1_THRESHOLD values in the weight file
+extern BIN_CONV_OUTPUT *{{ conv.name }}_thresholds;
 
 {%- endfor %}
 
+// points the thresholds of every convolution to their data in the weight file
+bool bind_thresholds(const dlk::WeightFile& weights);
+
 
 #endif //{{ name }}_TS_H_INCLUDED
 
@@ -0,0 +1,56 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "cpu_features.h"
+
+#if defined __aarch64__ && defined __linux__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace dlk {
+
+namespace {
+
+CpuFeatures detect() {
+  CpuFeatures f;
+#if defined DLK_X86
+  __builtin_cpu_init();
+  f.sse42 = __builtin_cpu_supports("sse4.2");
+  f.popcnt = __builtin_cpu_supports("popcnt");
+  f.avx2 = __builtin_cpu_supports("avx2");
+  f.fma = __builtin_cpu_supports("fma");
+  f.avx512f = __builtin_cpu_supports("avx512f");
+  f.avx512vl = __builtin_cpu_supports("avx512vl");
+  f.avx512vpopcntdq = __builtin_cpu_supports("avx512vpopcntdq");
+#elif defined __aarch64__
+  f.neon = true; // mandatory in armv8-a
+#if defined __linux__ && defined HWCAP_ASIMDDP
+  f.dotprod = (getauxval(AT_HWCAP) & HWCAP_ASIMDDP) != 0;
+#endif
+#elif defined __ARM_NEON
+  f.neon = true;
+#endif
+  return f;
+}
+
+} // namespace
+
+const CpuFeatures& cpu_features() {
+  static const CpuFeatures features = detect();
+  return features;
+}
+
+} // namespace dlk
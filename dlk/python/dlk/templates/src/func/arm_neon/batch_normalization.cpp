@@ -27,7 +27,8 @@ void func_BatchNormalization(const TensorView<T_FLOAT, MemoryLayout::NHWC>& inpu
     const TensorView<T_FLOAT, MemoryLayout::C>& mean,
     const TensorView<T_FLOAT, MemoryLayout::C>& variance,
     T_FLOAT epsilon,
-    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output) {
+    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+    ThreadPool& thread_pool) {
   Measurement::Start("BatchNorm");
 
   const auto out_shape = output.get_shape();
@@ -66,38 +67,39 @@ void func_BatchNormalization(const TensorView<T_FLOAT, MemoryLayout::NHWC>& inpu
     shift[i] = beta(i) - (scale[i] * mean(i));
   }
 
-// TODO(nlpng): remove use of OpenMP library
-#pragma omp parallel for
-  for (T_UINT f = 0; f < size; f++) {
+  const std::size_t chunk_size = (size + thread_pool.num_threads() - 1) / thread_pool.num_threads();
+  thread_pool.parallel_for(0, size, chunk_size, [&](std::size_t first, std::size_t last) {
+    for (T_UINT f = first; f < last; f++) {
 
-    T_FLOAT *in_temp = input.data() + f * out_depth;
-    T_FLOAT *out_temp = output.data() + f * out_depth;
+      T_FLOAT *in_temp = input.data() + f * out_depth;
+      T_FLOAT *out_temp = output.data() + f * out_depth;
 
-    T_UINT d = 0;
-    for (; d + 3 < out_depth; d += 4) {
+      T_UINT d = 0;
+      for (; d + 3 < out_depth; d += 4) {
 #ifdef AARCH32
-      asm volatile("vldmia %0, {d16,d17}    \t\n" // q8(d16,d17) scale
-                   "vldmia %1, {d18,d19}    \t\n" // q9(d18,d19) shift
-                   "vldmia %2, {d20,d21}    \t\n" // q10(d20,d21) input
-                   "vmla.f32 q9, q10, q8    \t\n"
-                   "vstmia %3, {d18,d19}    \t\n"
-                   :
-                   : "r"(&scale[d]), "r"(&shift[d]), "r"(in_temp), "r"(out_temp)
-                   : "memory", "q8", "q9", "q10");
+        asm volatile("vldmia %0, {d16,d17}    \t\n" // q8(d16,d17) scale
+                     "vldmia %1, {d18,d19}    \t\n" // q9(d18,d19) shift
+                     "vldmia %2, {d20,d21}    \t\n" // q10(d20,d21) input
+                     "vmla.f32 q9, q10, q8    \t\n"
+                     "vstmia %3, {d18,d19}    \t\n"
+                     :
+                     : "r"(&scale[d]), "r"(&shift[d]), "r"(in_temp), "r"(out_temp)
+                     : "memory", "q8", "q9", "q10");
 #else
-      const auto scale_v = vld1q_f32(scale + d);
-      const auto shift_v = vld1q_f32(shift + d);
-      const auto in_v = vld1q_f32(in_temp);
-      vst1q_f32(out_temp, vmlaq_f32(shift_v, in_v, scale_v));
+        const auto scale_v = vld1q_f32(scale + d);
+        const auto shift_v = vld1q_f32(shift + d);
+        const auto in_v = vld1q_f32(in_temp);
+        vst1q_f32(out_temp, vmlaq_f32(shift_v, in_v, scale_v));
 #endif
-      in_temp += 4;
-      out_temp += 4;
-    }
+        in_temp += 4;
+        out_temp += 4;
+      }
 
-    for (; d < out_depth; d++) {
-      *out_temp++ = *in_temp++ * scale[d] + shift[d];
+      for (; d < out_depth; d++) {
+        *out_temp++ = *in_temp++ * scale[d] + shift[d];
+      }
     }
-  }
+  });
 
   delete[] scale;
   delete[] shift;
@@ -13,11 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <cassert>
-#include <cstring>
 
 #include "global.h"
 #include "func/average_pool.h"
+#include "func/impl/pooling.h"
+#include "kernel_table.h"
 #include "time_measurement.h"
 
 void func_AveragePool(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
@@ -29,34 +31,25 @@ void func_AveragePool(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
   assert (app.input_depth == app.kernel_depth * app.output_channels && \
           "input_depth must equal kernel_depth * output_channels.");
 
-  int idx_out = 0;
-  const T_FLOAT num_k_elems = app.kernel_height * app.kernel_width * app.kernel_depth;
-
-  std::memset(output.data(), 0.0f, app.output_channels * app.output_height * app.output_width * sizeof(T_FLOAT));
-
-  for(T_UINT oc = 0; oc < app.output_channels; oc++) {
-    for(T_UINT wi = 0; wi < app.output_height; wi++) {
-      for(T_UINT wj = 0; wj < app.output_width; wj++) {
-        T_FLOAT out = 0;
-        for(T_UINT ki = 0; ki < app.kernel_height; ki++) {
-          for(T_UINT kj = 0; kj < app.kernel_width; kj++) {
-            T_INT row = (wi * app.stride) - app.padding + ki;
-            T_INT col = (wj * app.stride) - app.padding + kj;
-
-            T_INT inside = (row >= 0 && col >= 0 && row < (T_INT) app.input_height && col < (T_INT)app.input_width);
-            if (!inside) continue;
-            for(T_UINT kz = 0; kz < app.kernel_depth; kz++) {
-              int idx_in = oc * app.kernel_depth
-                + row * (app.input_width * app.input_depth)
-                + col * (app.input_depth) + kz;
-              out += input(0, row, col, oc * app.kernel_depth + kz);
-            }
-          }
-        }
-        output(0, wi, wj, oc) += T_FLOAT(out) / num_k_elems;
+  const T_UINT channels = app.output_channels;
+  // the padding counts as zeros, so the sum is divided by the whole window
+  const T_FLOAT scale = 1.0f / (app.kernel_height * app.kernel_width * app.kernel_depth);
+  const auto add_row = dlk::kernels().average_pool_row;
+
+  // channels are innermost, so every tap is a contiguous row of them
+  dlk::impl::for_each_pooling_window(app, [&](T_UINT wi, T_UINT wj,
+      T_UINT row_begin, T_UINT row_end, T_UINT col_begin, T_UINT col_end) {
+    T_FLOAT *out = output.data() + (wi * app.output_width + wj) * channels;
+    std::fill(out, out + channels, 0.0f);
+    for (T_UINT row = row_begin; row < row_end; ++row) {
+      for (T_UINT col = col_begin; col < col_end; ++col) {
+        add_row(input.data() + (row * app.input_width + col) * channels, out, channels);
       }
     }
-  }
+    for (T_UINT d = 0; d < channels; ++d) {
+      out[d] *= scale;
+    }
+  });
 
   Measurement::Stop();
 }
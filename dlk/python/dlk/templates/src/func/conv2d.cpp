@@ -13,190 +13,311 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
 #include <memory>
+#include <vector>
 
 #include "global.h"
+#include "kernel_table.h"
 #include "func/conv2d.h"
+#include "func/impl/conv2d_direct.h"
 #include "matrix_view.h"
-#include "matrix/shift_add.h"
 #include "matrix/multiplication.h"
 #include "operators.h" // FIXME(nikolay): for convolution_parameters definition, rid of it later
 #include "time_measurement.h"
+#include "workspace.h"
 
 namespace {
 
-template<typename T, typename U>
-void conv3x3_kn2row(const TensorView<T, MemoryLayout::NHWC>& input,
-    const TensorView<T, MemoryLayout::HWNC>& kernels,
-    const TensorView<U, MemoryLayout::NHWC>& output,
-    struct convolution_parameters& p) {
-  const int ic = p.kernel_depth;
-  const int oc = p.output_channels;
-  const int kh = p.kernel_height;
-  const int kw = p.kernel_width;
-  const int ih = p.input_height;
-  const int iw = p.input_width;
-  const int oh = p.output_height;
-  const int ow = p.output_width;
-
-  // assertions
-  assert(ih * iw == oh * ow);
-  assert(kh == 3 && kw == 3);
-  assert(MAX_SIZE_KN2ROW_BUFFER_PER_LAYER >= oc * kh * kw * ih * iw);
-
-  // need to initialize output
-  std::memset(output.data(), 0, oc * ih * iw * sizeof(U));
-
-  Measurement::Start("kn2row");
-  Measurement::Start("kn2row-buf");
-
-  assert(p.input_height > 0);
-  assert(p.input_width > 0);
-
-  static U buf[MAX_SIZE_KN2ROW_BUFFER_PER_LAYER];
-
-  Measurement::Stop();
-
-  auto kernels_ = dlk::MatrixView<T, dlk::MatrixOrder::RowMajor>(kernels.data(), oc * kh * kw, ic);
-  auto input_ = dlk::MatrixView<T, dlk::MatrixOrder::ColMajor>(input.data(), ic, p.input_height * p.input_width);
-  auto buf_ = dlk::MatrixView<U, dlk::MatrixOrder::ColMajor>(buf, oc * kh * kw, p.input_height * p.input_width);
-  auto output_ = dlk::MatrixView<U, dlk::MatrixOrder::ColMajor>(output.data(), oc, p.input_height * p.input_width);
-
-  dlk::matrix_multiplication(kernels_, input_, buf_);
-  dlk::matrix_shift_add(buf_, output_, p);
-
-  Measurement::Stop();
+using ColMatrix = dlk::MatrixView<T_FLOAT, dlk::MatrixOrder::ColMajor>;
+using RowMatrix = dlk::MatrixView<T_FLOAT, dlk::MatrixOrder::RowMajor>;
+
+// output rows in a band of a convolution whose matrix multiplication has a
+// right hand side of k rows and cols_per_row columns per output row. the band
+// and its packed copy fit in the workspace, params.py makes room for one row.
+T_UINT rows_per_band(std::size_t k, std::size_t cols_per_row, T_UINT rows) {
+  const std::size_t cols = Workspace::float_conv_buf_elems / k;
+  const std::size_t band = cols > Workspace::matmul_pad_cols
+      ? (cols - Workspace::matmul_pad_cols) / cols_per_row : 0;
+  assert(band > 0);
+  return std::max<std::size_t>(1, std::min<std::size_t>(band, rows));
 }
 
-// kernel format converter
-// ohwi : oc kh kw ic, hwoi: kh kw oc ic
-template<typename T>
-void ohwi_to_hwoi(const TensorView<T, MemoryLayout::NHWC>& ohwi,
-    const TensorView<T, MemoryLayout::HWNC>& hwoi,
-    const struct convolution_parameters& p) {
-  int ic = p.kernel_depth;
-  int oc = p.output_channels;
-  int kh = p.kernel_height;
-  int kw = p.kernel_width;
-
-  for (unsigned int r = 0; r < kh; ++r) {
-    for (unsigned int c = 0; c < kw; ++c) {
-      for (unsigned int j = 0; j < oc; ++j) {
-        for (unsigned int k = 0; k < ic; ++k) {
-          hwoi(r, c, j, k) = ohwi(j, r, c, k);
+// convolution of an input with few channels straight from the taps, any
+// kernel size, stride and padding. the output rows are split over the threads.
+void conv_direct(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
+                 const TensorView<T_FLOAT, MemoryLayout::NHWC>& kernels,
+                 const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+                 struct convolution_parameters& p) {
+  const T_UINT ic = p.kernel_depth;
+  const T_UINT oc = p.output_channels;
+  const T_UINT kh = p.kernel_height;
+  const T_UINT kw = p.kernel_width;
+  constexpr T_UINT block = dlk::impl::conv2d_direct_channel_block;
+  const T_UINT oc_padded = (oc + block - 1) / block * block;
+
+  Measurement::Start("conv-direct");
+
+  // ohwi to hwio, the output channels innermost and zero padded
+  const auto kernels_hwio = std::make_unique<T_FLOAT[]>(kh * kw * ic * oc_padded);
+  for (T_UINT r = 0; r < kh; ++r) {
+    for (T_UINT c = 0; c < kw; ++c) {
+      for (T_UINT k = 0; k < ic; ++k) {
+        for (T_UINT j = 0; j < oc; ++j) {
+          kernels_hwio[((r * kw + c) * ic + k) * oc_padded + j] = kernels(j, r, c, k);
         }
       }
     }
   }
- }
-
-template<typename T, typename U>
-void conv1x1_kn2row(const TensorView<T, MemoryLayout::NHWC>& input,
-                    const TensorView<T, MemoryLayout::NHWC>& kernels,
-                    const TensorView<U, MemoryLayout::NHWC>& output,
-                    struct convolution_parameters& p) {
-  int ic = p.kernel_depth;
-  int oc = p.output_channels;
-  int kh = p.kernel_height;
-  int kw = p.kernel_width;
 
-  Measurement::Start("kn2row-1x1");
+  const auto row = dlk::kernels().conv2d_direct_row;
+  p.thread_pool->parallel_for(0, p.output_height, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t wi = first; wi < last; ++wi)
+      row(input.data(), kernels_hwio.get(), output.data(), p, wi);
+  });
 
-
-   assert(p.input_height > 0);
-   assert(p.input_width > 0);
-
-   auto kernels_ = dlk::MatrixView<T, dlk::MatrixOrder::RowMajor>(kernels.data(), oc * kh * kw, ic);
-   auto input_ = dlk::MatrixView<T, dlk::MatrixOrder::ColMajor>(input.data(), ic, p.input_height * p.input_width);
-   auto output_ = dlk::MatrixView<U, dlk::MatrixOrder::ColMajor>(output.data(), oc, p.input_height * p.input_width);
-
-   dlk::matrix_multiplication(kernels_, input_, output_);
-
-   Measurement::Stop();
+  Measurement::Stop();
 }
 
-template<typename T>
-void conv_general(
-  const TensorView<T, MemoryLayout::NHWC>& input,
-  const TensorView<T, MemoryLayout::NHWC>& kernels,
-  const TensorView<T, MemoryLayout::NHWC>& output,
-  struct convolution_parameters p)
-{
-  for(T_UINT wi = 0; wi < p.output_height; wi++)
-  for(T_UINT wj = 0; wj < p.output_width; wj++)
-  {
-    for(T_UINT kernel_id = 0; kernel_id < p.output_channels; kernel_id++)
-    {
-      T_UINT kernel_offset = kernel_id * p.kernel_elements;
-
-      T out = 0;
-      T_UINT current_kernel_index = 0;
+// 3x3 stride 1 convolution by winograd F(2x2, 3x3): each 2x2 output tile
+// takes 16 instead of 36 multiplications per channel pair. for each of the 16
+// positions xi of a 4x4 tile, the transformed kernel U[xi] (oc x ic) times the
+// transformed input tiles V[xi] (ic x tiles) gives M[xi] (oc x tiles), which
+// are transformed back into the output tiles. the tiles go in bands of tile
+// rows, so that V and M fit in the workspace.
+void conv3x3_winograd(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
+                      const TensorView<T_FLOAT, MemoryLayout::NHWC>& kernels,
+                      const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+                      struct convolution_parameters& p) {
+  const T_UINT ic = p.kernel_depth;
+  const T_UINT oc = p.output_channels;
+  const T_UINT ih = p.input_height;
+  const T_UINT iw = p.input_width;
+  const T_UINT oh = p.output_height;
+  const T_UINT ow = p.output_width;
+  const T_INT pad = p.padding;
+  const T_UINT tiles_h = (oh + 1) / 2;
+  const T_UINT tiles_w = (ow + 1) / 2;
+
+  Measurement::Start("conv-winograd");
+
+  // U = G g G^T
+  Measurement::Start("winograd-kernel");
+  const auto U = std::make_unique<T_FLOAT[]>(16 * oc * ic);
+  p.thread_pool->parallel_for(0, oc, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t o = first; o < last; ++o) {
+      for (T_UINT c = 0; c < ic; ++c) {
+        T_FLOAT gg[4][3];
+        for (T_UINT j = 0; j < 3; ++j) {
+          const T_FLOAT g0 = kernels(o, 0, j, c);
+          const T_FLOAT g1 = kernels(o, 1, j, c);
+          const T_FLOAT g2 = kernels(o, 2, j, c);
+          gg[0][j] = g0;
+          gg[1][j] = (g0 + g1 + g2) * 0.5f;
+          gg[2][j] = (g0 - g1 + g2) * 0.5f;
+          gg[3][j] = g2;
+        }
+        for (T_UINT i = 0; i < 4; ++i) {
+          T_FLOAT *u = U.get() + (i * 4) * oc * ic + o * ic + c;
+          u[0 * oc * ic] = gg[i][0];
+          u[1 * oc * ic] = (gg[i][0] + gg[i][1] + gg[i][2]) * 0.5f;
+          u[2 * oc * ic] = (gg[i][0] - gg[i][1] + gg[i][2]) * 0.5f;
+          u[3 * oc * ic] = gg[i][2];
+        }
+      }
+    }
+  });
+  Measurement::Stop();
 
-      bool inside_row, inside_col;
+  const T_UINT band = std::max<std::size_t>(1, std::min<std::size_t>(tiles_h,
+      Workspace::float_conv_buf_elems / (16 * std::size_t(ic + oc) * tiles_w)));
+  const auto zeros = std::make_unique<T_FLOAT[]>(ic);
+  for (T_UINT ty0 = 0; ty0 < tiles_h; ty0 += band) {
+    const std::size_t tiles = std::min(band, tiles_h - ty0) * tiles_w;
+    T_FLOAT *V = p.workspace->float_conv_buf();
+    T_FLOAT *M = V + 16 * ic * tiles;
+
+    // V = B^T d B
+    Measurement::Start("winograd-input");
+    p.thread_pool->parallel_for(0, tiles, tiles_w, [&](std::size_t first, std::size_t last) {
+      for (std::size_t t = first; t < last; ++t) {
+        const T_INT y0 = T_INT(2 * (ty0 + t / tiles_w)) - pad;
+        const T_INT x0 = T_INT(2 * (t % tiles_w)) - pad;
+        const T_FLOAT *d[4][4];
+        for (T_INT i = 0; i < 4; ++i) {
+          for (T_INT j = 0; j < 4; ++j) {
+            const bool inside = y0 + i >= 0 && y0 + i < T_INT(ih) && x0 + j >= 0 && x0 + j < T_INT(iw);
+            d[i][j] = inside ? input.data() + ((y0 + i) * iw + x0 + j) * ic : zeros.get();
+          }
+        }
+        T_FLOAT *v = V + t * ic;
+        const std::size_t xi_stride = ic * tiles;
+        for (T_UINT c = 0; c < ic; ++c) {
+          T_FLOAT bd[4][4];
+          for (T_UINT j = 0; j < 4; ++j) {
+            bd[0][j] = d[0][j][c] - d[2][j][c];
+            bd[1][j] = d[1][j][c] + d[2][j][c];
+            bd[2][j] = d[2][j][c] - d[1][j][c];
+            bd[3][j] = d[1][j][c] - d[3][j][c];
+          }
+          for (T_UINT i = 0; i < 4; ++i) {
+            v[(i * 4 + 0) * xi_stride + c] = bd[i][0] - bd[i][2];
+            v[(i * 4 + 1) * xi_stride + c] = bd[i][1] + bd[i][2];
+            v[(i * 4 + 2) * xi_stride + c] = bd[i][2] - bd[i][1];
+            v[(i * 4 + 3) * xi_stride + c] = bd[i][1] - bd[i][3];
+          }
+        }
+      }
+    });
+    Measurement::Stop();
+
+    for (T_UINT xi = 0; xi < 16; ++xi) {
+      auto U_ = RowMatrix(U.get() + xi * oc * ic, oc, ic);
+      auto V_ = ColMatrix(V + xi * ic * tiles, ic, tiles);
+      auto M_ = ColMatrix(M + xi * oc * tiles, oc, tiles);
+      dlk::matrix_multiplication(U_, V_, M_, p.workspace->matmul_buf(), *p.thread_pool);
+    }
 
-      for(T_UINT ki = 0; ki < p.kernel_height; ki++)
-      {
-        T_INT row = (wi * p.stride_along_height) - p.padding + ki;
-        inside_row = (row >= 0 && row < (T_INT) p.input_height);
+    // Y = A^T M A
+    Measurement::Start("winograd-output");
+    p.thread_pool->parallel_for(0, tiles, tiles_w, [&](std::size_t first, std::size_t last) {
+      // the outputs of a tile beyond the output go here
+      std::vector<T_FLOAT> discard(oc);
+      for (std::size_t t = first; t < last; ++t) {
+        const T_UINT oy = 2 * (ty0 + t / tiles_w);
+        const T_UINT ox = 2 * (t % tiles_w);
+        T_FLOAT *y[2][2];
+        for (T_UINT i = 0; i < 2; ++i) {
+          for (T_UINT j = 0; j < 2; ++j) {
+            y[i][j] = oy + i < oh && ox + j < ow
+                ? output.data() + ((oy + i) * ow + ox + j) * oc : discard.data();
+          }
+        }
+        const T_FLOAT *m = M + t * oc;
+        const std::size_t xi_stride = oc * tiles;
+        for (T_UINT o = 0; o < oc; ++o) {
+          T_FLOAT am[2][4];
+          for (T_UINT j = 0; j < 4; ++j) {
+            const T_FLOAT m0 = m[(0 * 4 + j) * xi_stride + o];
+            const T_FLOAT m1 = m[(1 * 4 + j) * xi_stride + o];
+            const T_FLOAT m2 = m[(2 * 4 + j) * xi_stride + o];
+            const T_FLOAT m3 = m[(3 * 4 + j) * xi_stride + o];
+            am[0][j] = m0 + m1 + m2;
+            am[1][j] = m1 - m2 - m3;
+          }
+          for (T_UINT i = 0; i < 2; ++i) {
+            y[i][0][o] = am[i][0] + am[i][1] + am[i][2];
+            y[i][1][o] = am[i][1] - am[i][2] - am[i][3];
+          }
+        }
+      }
+    });
+    Measurement::Stop();
+  }
 
-        for(T_UINT kj = 0; kj < p.kernel_width; kj++)
-        {
-          T_INT col = (wj * p.stride_along_width)  - p.padding + kj;
-          inside_col = (col >= 0 && col < (T_INT) p.input_width);
+  Measurement::Stop();
+}
 
-          for(T_UINT kz = 0; kz < p.kernel_depth; kz++)
-          {
-            if (inside_row && inside_col) {
-              unsigned k_idx = current_kernel_index + kernel_offset;
+// 1x1 convolution without stride and padding: a band of input rows already
+// is the right hand side of the matrix multiplication
+void conv1x1(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
+             const TensorView<T_FLOAT, MemoryLayout::NHWC>& kernels,
+             const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+             struct convolution_parameters& p) {
+  const T_UINT ic = p.kernel_depth;
+  const T_UINT oc = p.output_channels;
+  const T_UINT oh = p.output_height;
+  const T_UINT ow = p.output_width;
+
+  Measurement::Start("conv-1x1");
+
+  auto kernels_ = RowMatrix(kernels.data(), oc, ic);
+  const T_UINT band = rows_per_band(ic, ow, oh);
+  for (T_UINT r = 0; r < oh; r += band) {
+    const std::size_t cols = std::min(band, oh - r) * ow;
+    auto input_ = ColMatrix(input.data() + r * ow * ic, ic, cols);
+    auto output_ = ColMatrix(output.data() + r * ow * oc, oc, cols);
+    dlk::matrix_multiplication(kernels_, input_, output_, p.workspace->matmul_buf(), *p.thread_pool);
+  }
 
-              T in_data = input(0, row, col, kz);;
-              T k_data = kernels(kernel_id, ki, kj, kz);
+  Measurement::Stop();
+}
 
-              out += in_data * k_data;
+// any kernel size, stride, dilation and padding: the patches of a band of
+// output rows (im2col, kh kw ic per output pixel) times the ohwi kernel, which
+// is the oc x (kh kw ic) left hand side as it is
+void conv_im2col(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
+                 const TensorView<T_FLOAT, MemoryLayout::NHWC>& kernels,
+                 const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+                 struct convolution_parameters& p) {
+  const T_UINT ic = p.kernel_depth;
+  const T_UINT oc = p.output_channels;
+  const T_UINT kh = p.kernel_height;
+  const T_UINT kw = p.kernel_width;
+  const T_UINT oh = p.output_height;
+  const T_UINT ow = p.output_width;
+  const std::size_t k = kh * kw * ic;
+
+  Measurement::Start("conv-im2col");
+
+  T_FLOAT *col = p.workspace->float_conv_buf();
+  auto kernels_ = RowMatrix(kernels.data(), oc, k);
+  const T_UINT band = rows_per_band(k, ow, oh);
+  for (T_UINT r = 0; r < oh; r += band) {
+    const std::size_t cols = std::min(band, oh - r) * ow;
+
+    Measurement::Start("im2col");
+    p.thread_pool->parallel_for(0, cols, ow, [&](std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; ++i) {
+        const T_INT top = T_INT((r + i / ow) * p.stride_along_height) - T_INT(p.padding);
+        const T_INT left = T_INT(i % ow * p.stride_along_width) - T_INT(p.padding);
+        T_FLOAT *dst = col + i * k;
+        for (T_UINT ki = 0; ki < kh; ++ki) {
+          const T_INT row = top + T_INT(ki * p.dilation_along_height);
+          for (T_UINT kj = 0; kj < kw; ++kj) {
+            const T_INT c = left + T_INT(kj * p.dilation_along_width);
+            if (row >= 0 && row < T_INT(p.input_height) && c >= 0 && c < T_INT(p.input_width)) {
+              std::memcpy(dst, input.data() + (row * p.input_width + c) * ic, ic * sizeof(T_FLOAT));
+            } else {
+              std::fill(dst, dst + ic, T_FLOAT(0));
             }
-            current_kernel_index++;
+            dst += ic;
           }
         }
       }
+    });
+    Measurement::Stop();
 
-      output(0, wi, wj, kernel_id) = out;
-    }
+    auto col_ = ColMatrix(col, k, cols);
+    auto output_ = ColMatrix(output.data() + r * ow * oc, oc, cols);
+    dlk::matrix_multiplication(kernels_, col_, output_, p.workspace->matmul_buf(), *p.thread_pool);
   }
+
+  Measurement::Stop();
 }
 
-template<typename T>
 void convolution(
-  const TensorView<T, MemoryLayout::NHWC>& input,
-  const TensorView<T, MemoryLayout::NHWC>& kernels,
-  const TensorView<T, MemoryLayout::NHWC>& output,
+  const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
+  const TensorView<T_FLOAT, MemoryLayout::NHWC>& kernels,
+  const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
   struct convolution_parameters p)
 {
-  // use special implementation for 1x1 conv
-  if (p.kernel_height == 1 && p.kernel_width == 1 && p.padding == 0) {
-    int kernels_size = p.kernel_height * p.kernel_width * p.kernel_depth * p.output_channels;
-    conv1x1_kn2row(input, kernels, output, p);
-    return;
-  } else if (p.kernel_height == 3 && p.kernel_width == 3 && p.padding == 1) {
-    int kernels_size = p.kernel_height * p.kernel_width * p.kernel_depth * p.output_channels;
-    const auto kernels_hwoi_buf = std::make_unique<T[]>(kernels_size);
-    using hwoi_t = TensorView<T, MemoryLayout::HWNC>;
-    typename hwoi_t::template tensor_info_t<std::size_t> hwoi_shape = {
-      p.kernel_height,
-      p.kernel_width,
-      p.output_channels,
-      p.kernel_depth
-    };
-    hwoi_t kernels_hwoi(kernels_hwoi_buf.get(), hwoi_shape);
-    ohwi_to_hwoi(kernels, kernels_hwoi, p);
-    conv3x3_kn2row(input, kernels_hwoi, output, p);
-    return;
+  const bool unit_stride = p.stride_along_height == 1 && p.stride_along_width == 1;
+  const bool unit_dilation = p.dilation_along_height == 1 && p.dilation_along_width == 1;
+
+  // the first layer has too few input channels for a matrix multiplication
+  if (p.kernel_depth <= dlk::impl::conv2d_direct_max_depth) {
+    conv_direct(input, kernels, output, p);
+  } else if (p.kernel_height == 3 && p.kernel_width == 3 && unit_stride && unit_dilation) {
+    conv3x3_winograd(input, kernels, output, p);
+  } else if (p.kernel_height == 1 && p.kernel_width == 1 && unit_stride && p.padding == 0) {
+    conv1x1(input, kernels, output, p);
+  } else {
+    conv_im2col(input, kernels, output, p);
   }
-
-  // otherwise, use hand-written implementation
-  conv_general(input, kernels, output, p);
 }
 
 } // namespace
@@ -25,7 +25,8 @@ void func_BatchNormalization(const TensorView<T_FLOAT, MemoryLayout::NHWC>& inpu
     const TensorView<T_FLOAT, MemoryLayout::C>& mean,
     const TensorView<T_FLOAT, MemoryLayout::C>& variance,
     T_FLOAT epsilon,
-    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output) {
+    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+    ThreadPool& thread_pool) {
   Measurement::Start("BatchNorm");
 
   const unsigned out_height = output.get_shape()[1];
@@ -42,13 +43,15 @@ void func_BatchNormalization(const TensorView<T_FLOAT, MemoryLayout::NHWC>& inpu
   for (T_UINT i = 0; i < out_depth; i++)
     shift[i] = beta(i) - (scale[i] * mean(i));
 
-  for (T_UINT r = 0; r < out_height; r++) {
-    for (T_UINT c = 0; c < out_width; c++) {
-      for (T_UINT d = 0; d < out_depth; d++) {
-        output(0, r, c, d) = input(0, r, c, d) * scale[d] + shift[d];
+  thread_pool.parallel_for(0, out_height, 1, [&](std::size_t first, std::size_t last) {
+    for (T_UINT r = first; r < last; r++) {
+      for (T_UINT c = 0; c < out_width; c++) {
+        for (T_UINT d = 0; d < out_depth; d++) {
+          output(0, r, c, d) = input(0, r, c, d) * scale[d] + shift[d];
+        }
       }
     }
-  }
+  });
 
   delete[] scale;
   delete[] shift;
@@ -0,0 +1,126 @@
+/* Copyright 2018 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cstdint>
+
+#include "global.h"
+#include "cpu_features.h"
+#include "func/impl/apply_thresholds.h"
+#include "kernel_table.h"
+#include "matrix_view.h"
+#include "operators.h" // FIXME(nikolay): for binary_convolution_parameters definition, rid of it later
+#ifdef DLK_X86
+#include <x86intrin.h>
+#endif
+
+namespace dlk {
+
+namespace impl {
+
+void ReorderThresholds(const binary_convolution_parameters &p, BIN_CONV_OUTPUT *thresholds) {
+  for (std::size_t i = 0; i < p.normal_conv_params.output_channels; ++i) {
+    const BIN_CONV_OUTPUT *ts = p.thresholds + NUM_OF_A2W1_THRESHOLD * i;
+    BIN_CONV_OUTPUT *block = thresholds + i / 32 * thresholds_block_elems + i % 32;
+    const T_INT flag = ts[3];
+    const T_INT bias = flag < 0 ? 1 : 0;
+    block[0] = ts[0] + bias;
+    block[32] = ts[1] + bias;
+    block[64] = ts[2] + bias;
+    block[96] = flag;
+  }
+}
+
+void ApplyThresholdsAndPack(
+    const dlk::MatrixView<BIN_CONV_OUTPUT, dlk::MatrixOrder::ColMajor> &result,
+    const BIN_CONV_OUTPUT *thresholds,
+    std::size_t first, std::size_t last,
+    QUANTIZED_PACKED output[]) {
+  static_assert(QUANTIZED_PACKED::BitCount == 32, "the blocks of 32 channels are packed into 32 bit words");
+  const auto pack = kernels().apply_thresholds_pack;
+  const std::size_t pixels = result.cols();
+  for (std::size_t b = 0; b < std::size_t(result.rows()) / 32; ++b)
+    pack(result.data(b * 32, first), last - first, result.stride(),
+        thresholds + b * thresholds_block_elems, output + (b * pixels + first) * 2);
+}
+
+// flag 1 (increasing): the number of thresholds d is not below, 0 to 3.
+// flag -1 (decreasing): -1 minus the number of thresholds d is above, whose
+// lower 2 bits are 3 to 0. flag 0 (ignore): 0. flag >= 2: constant flag - 2.
+void apply_thresholds_pack_block(const BIN_CONV_OUTPUT *acc, std::size_t pixels, std::size_t acc_stride,
+    const BIN_CONV_OUTPUT *thresholds, QUANTIZED_PACKED *output) {
+  const BIN_CONV_OUTPUT *th0 = thresholds;
+  const BIN_CONV_OUTPUT *th1 = thresholds + 32;
+  const BIN_CONV_OUTPUT *th2 = thresholds + 64;
+  const BIN_CONV_OUTPUT *flg = thresholds + 96;
+  for (std::size_t i = 0; i < pixels; ++i) {
+    const BIN_CONV_OUTPUT *in = acc + i * acc_stride;
+    uint32_t lsb = 0, msb = 0;
+    for (unsigned c = 0; c < 32; ++c) {
+      const T_INT d = in[c];
+      const T_INT flag = flg[c];
+      const T_INT v = flag >= 2 ? flag - 2
+          : flag * ((d >= th0[c]) + (d >= th1[c]) + (d >= th2[c])) - (flag < 0);
+      lsb |= uint32_t(v & 1) << c;
+      msb |= uint32_t((v >> 1) & 1) << c;
+    }
+    output[2 * i] = QUANTIZED_PACKED(lsb);
+    output[2 * i + 1] = QUANTIZED_PACKED(msb);
+  }
+}
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+void apply_thresholds_pack_block_avx2(const BIN_CONV_OUTPUT *acc, std::size_t pixels, std::size_t acc_stride,
+    const BIN_CONV_OUTPUT *thresholds, QUANTIZED_PACKED *output) {
+  const T_INT16 *th = const_cast<const T_INT16*>(thresholds);
+  __m256i th0[2], th1[2], th2[2], flg[2], is_neg[2], m2[2], is_not_const[2];
+  for (unsigned h = 0; h < 2; ++h) {
+    th0[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(th + 0 + 16 * h));
+    th1[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(th + 32 + 16 * h));
+    th2[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(th + 64 + 16 * h));
+    flg[h] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(th + 96 + 16 * h));
+    is_neg[h] = _mm256_cmpgt_epi16(_mm256_setzero_si256(), flg[h]);
+    m2[h] = _mm256_sub_epi16(flg[h], _mm256_set1_epi16(2));
+    is_not_const[h] = _mm256_cmpgt_epi16(_mm256_setzero_si256(), m2[h]);
+  }
+
+  for (std::size_t i = 0; i < pixels; ++i) {
+    const T_INT16 *in = const_cast<const T_INT16*>(acc + i * acc_stride);
+    __m256i res[2];
+    for (unsigned h = 0; h < 2; ++h) {
+      const auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 16 * h));
+      const auto f0 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th0[h], d), flg[h]);
+      const auto f1 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th1[h], d), flg[h]);
+      const auto f2 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th2[h], d), flg[h]);
+      const auto tmp = _mm256_add_epi16(_mm256_add_epi16(f0, f1), _mm256_add_epi16(f2, is_neg[h]));
+      res[h] = _mm256_blendv_epi8(m2[h], tmp, is_not_const[h]);
+    }
+    // one byte per channel in channel order; bit 0 and 1 of every byte to
+    // the top of the byte for the movemask
+    const auto bytes = _mm256_permute4x64_epi64(_mm256_packs_epi16(res[0], res[1]), 0xD8);
+    const uint32_t lsb = _mm256_movemask_epi8(_mm256_slli_epi16(bytes, 7));
+    const uint32_t msb = _mm256_movemask_epi8(_mm256_slli_epi16(bytes, 6));
+    output[2 * i] = QUANTIZED_PACKED(lsb);
+    output[2 * i + 1] = QUANTIZED_PACKED(msb);
+  }
+}
+
+DLK_TARGET_END
+#endif
+
+} // namespace impl
+
+} // namespace dlk
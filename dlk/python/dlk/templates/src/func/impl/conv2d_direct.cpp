@@ -0,0 +1,199 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+
+#include "global.h"
+#include "cpu_features.h"
+#include "func/impl/conv2d_direct.h"
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+#ifdef DLK_X86
+#include <x86intrin.h>
+#endif
+
+namespace dlk {
+
+namespace impl {
+
+void conv2d_direct_row(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *output,
+    const convolution_parameters& p, T_UINT out_row) {
+  const T_UINT ic = p.kernel_depth;
+  const T_UINT oc = p.output_channels;
+  const T_UINT oc_padded = (oc + conv2d_direct_channel_block - 1)
+      / conv2d_direct_channel_block * conv2d_direct_channel_block;
+  const T_UINT dh = p.dilation_along_height;
+  const T_UINT dw = p.dilation_along_width;
+  const T_INT top = T_INT(out_row * p.stride_along_height) - T_INT(p.padding);
+  T_UINT ki_begin, ki_end;
+  conv2d_tap_range(top, p.kernel_height, dh, p.input_height, ki_begin, ki_end);
+  for (T_UINT wj = 0; wj < p.output_width; ++wj) {
+    T_FLOAT *out = output + (out_row * p.output_width + wj) * oc;
+    std::fill(out, out + oc, T_FLOAT(0));
+    const T_INT left = T_INT(wj * p.stride_along_width) - T_INT(p.padding);
+    T_UINT kj_begin, kj_end;
+    conv2d_tap_range(left, p.kernel_width, dw, p.input_width, kj_begin, kj_end);
+    for (T_UINT ki = ki_begin; ki < ki_end; ++ki) {
+      const T_UINT row = top + T_INT(ki * dh);
+      for (T_UINT kj = kj_begin; kj < kj_end; ++kj) {
+        const T_UINT col = left + T_INT(kj * dw);
+        const T_FLOAT *in = input + (row * p.input_width + col) * ic;
+        const T_FLOAT *k = kernel + (ki * p.kernel_width + kj) * ic * oc_padded;
+        for (T_UINT c = 0; c < ic; ++c) {
+          for (T_UINT o = 0; o < oc; ++o)
+            out[o] += in[c] * k[c * oc_padded + o];
+        }
+      }
+    }
+  }
+}
+
+#ifdef USE_NEON
+namespace {
+
+// N blocks of 4 output channels from oc_begin of one output pixel, of the
+// taps [ki_begin, ki_end) x [kj_begin, kj_end) from the input pixel (top, left)
+template <int N>
+void conv2d_direct_pixel_neon(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *out,
+    const convolution_parameters& p, T_UINT oc_padded, T_UINT oc_begin,
+    T_INT top, T_INT left, T_UINT ki_begin, T_UINT ki_end, T_UINT kj_begin, T_UINT kj_end) {
+  const T_UINT ic = p.kernel_depth;
+  float32x4_t acc[N];
+  for (int n = 0; n < N; ++n)
+    acc[n] = vdupq_n_f32(0.0f);
+  for (T_UINT ki = ki_begin; ki < ki_end; ++ki) {
+    const T_UINT row = top + T_INT(ki * p.dilation_along_height);
+    for (T_UINT kj = kj_begin; kj < kj_end; ++kj) {
+      const T_UINT col = left + T_INT(kj * p.dilation_along_width);
+      const T_FLOAT *in = input + (row * p.input_width + col) * ic;
+      const T_FLOAT *k = kernel + (ki * p.kernel_width + kj) * ic * oc_padded + oc_begin;
+      for (T_UINT c = 0; c < ic; ++c) {
+        const auto x = vdupq_n_f32(in[c]);
+        for (int n = 0; n < N; ++n)
+          acc[n] = vmlaq_f32(acc[n], x, vld1q_f32(k + c * oc_padded + 4 * n));
+      }
+    }
+  }
+
+  for (int n = 0; n < N; ++n) {
+    const T_UINT o = oc_begin + 4 * n;
+    if (o + 4 <= p.output_channels) {
+      vst1q_f32(out + o, acc[n]);
+    } else {
+      float res[4];
+      vst1q_f32(res, acc[n]);
+      for (T_UINT i = 0; o + i < p.output_channels; ++i)
+        out[o + i] = res[i];
+    }
+  }
+}
+
+} // namespace
+
+void conv2d_direct_row_neon(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *output,
+    const convolution_parameters& p, T_UINT out_row) {
+  const T_UINT oc = p.output_channels;
+  const T_UINT oc_padded = (oc + conv2d_direct_channel_block - 1)
+      / conv2d_direct_channel_block * conv2d_direct_channel_block;
+  const T_INT top = T_INT(out_row * p.stride_along_height) - T_INT(p.padding);
+  T_UINT ki_begin, ki_end;
+  conv2d_tap_range(top, p.kernel_height, p.dilation_along_height, p.input_height, ki_begin, ki_end);
+  for (T_UINT wj = 0; wj < p.output_width; ++wj) {
+    T_FLOAT *out = output + (out_row * p.output_width + wj) * oc;
+    const T_INT left = T_INT(wj * p.stride_along_width) - T_INT(p.padding);
+    T_UINT kj_begin, kj_end;
+    conv2d_tap_range(left, p.kernel_width, p.dilation_along_width, p.input_width, kj_begin, kj_end);
+    // 16 channels at a time, then the remaining blocks of 4
+    T_UINT o = 0;
+    for (; o + 16 <= oc_padded; o += 16)
+      conv2d_direct_pixel_neon<4>(input, kernel, out, p, oc_padded, o, top, left,
+          ki_begin, ki_end, kj_begin, kj_end);
+    for (; o < oc; o += 4)
+      conv2d_direct_pixel_neon<1>(input, kernel, out, p, oc_padded, o, top, left,
+          ki_begin, ki_end, kj_begin, kj_end);
+  }
+}
+#endif
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+namespace {
+
+// N blocks of 8 output channels from oc_begin of one output pixel, of the
+// taps [ki_begin, ki_end) x [kj_begin, kj_end) from the input pixel (top, left)
+template <int N>
+void conv2d_direct_pixel_avx2(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *out,
+    const convolution_parameters& p, T_UINT oc_padded, T_UINT oc_begin,
+    T_INT top, T_INT left, T_UINT ki_begin, T_UINT ki_end, T_UINT kj_begin, T_UINT kj_end) {
+  const T_UINT ic = p.kernel_depth;
+  __m256 acc[N];
+  for (int n = 0; n < N; ++n)
+    acc[n] = _mm256_setzero_ps();
+  for (T_UINT ki = ki_begin; ki < ki_end; ++ki) {
+    const T_UINT row = top + T_INT(ki * p.dilation_along_height);
+    for (T_UINT kj = kj_begin; kj < kj_end; ++kj) {
+      const T_UINT col = left + T_INT(kj * p.dilation_along_width);
+      const T_FLOAT *in = input + (row * p.input_width + col) * ic;
+      const T_FLOAT *k = kernel + (ki * p.kernel_width + kj) * ic * oc_padded + oc_begin;
+      for (T_UINT c = 0; c < ic; ++c) {
+        const auto x = _mm256_broadcast_ss(in + c);
+        for (int n = 0; n < N; ++n)
+          acc[n] = _mm256_fmadd_ps(x, _mm256_loadu_ps(k + c * oc_padded + 8 * n), acc[n]);
+      }
+    }
+  }
+
+  const auto lane_ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const auto vn = _mm256_set1_epi32(p.output_channels - oc_begin);
+  for (int n = 0; n < N; ++n) {
+    const auto mask = _mm256_cmpgt_epi32(vn, _mm256_add_epi32(lane_ids, _mm256_set1_epi32(8 * n)));
+    _mm256_maskstore_ps(out + oc_begin + 8 * n, mask, acc[n]);
+  }
+}
+
+} // namespace
+
+void conv2d_direct_row_avx2(const T_FLOAT *input, const T_FLOAT *kernel, T_FLOAT *output,
+    const convolution_parameters& p, T_UINT out_row) {
+  const T_UINT oc = p.output_channels;
+  const T_UINT oc_padded = (oc + conv2d_direct_channel_block - 1)
+      / conv2d_direct_channel_block * conv2d_direct_channel_block;
+  const T_INT top = T_INT(out_row * p.stride_along_height) - T_INT(p.padding);
+  T_UINT ki_begin, ki_end;
+  conv2d_tap_range(top, p.kernel_height, p.dilation_along_height, p.input_height, ki_begin, ki_end);
+  for (T_UINT wj = 0; wj < p.output_width; ++wj) {
+    T_FLOAT *out = output + (out_row * p.output_width + wj) * oc;
+    const T_INT left = T_INT(wj * p.stride_along_width) - T_INT(p.padding);
+    T_UINT kj_begin, kj_end;
+    conv2d_tap_range(left, p.kernel_width, p.dilation_along_width, p.input_width, kj_begin, kj_end);
+    // 32 channels at a time, then the remaining blocks of 8
+    T_UINT o = 0;
+    for (; o + 32 <= oc_padded; o += 32)
+      conv2d_direct_pixel_avx2<4>(input, kernel, out, p, oc_padded, o, top, left,
+          ki_begin, ki_end, kj_begin, kj_end);
+    for (; o < oc_padded; o += 8)
+      conv2d_direct_pixel_avx2<1>(input, kernel, out, p, oc_padded, o, top, left,
+          ki_begin, ki_end, kj_begin, kj_end);
+  }
+}
+
+DLK_TARGET_END
+#endif
+
+} // namespace impl
+
+} // namespace dlk
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include <cassert>
 #include <cstdio>
+#include <mutex>
 
 #include "de10_nano.h"
 #include "func/impl/quantized_conv2d_kn2row.h"
@@ -93,7 +94,8 @@ void QuantizedConv2DKn2Row(const kn2row_input_t& input,
   assert(!ts_activated);
 #endif
 
-  std::copy(input.data(), input.data() + input.size(), p.device_input_buf);
+  if (input.data() != p.device_input_buf)
+    std::copy(input.data(), input.data() + input.size(), p.device_input_buf);
 
   if (out_c_less_than_num_pe)
   {
@@ -209,10 +211,15 @@ void TCAConv2d(const kn2row_input_t& input,
     p.dma_input_buffer->sync_for_device();
     Measurement::Stop();
 
-    Measurement::Start("Conv2D TCA");
-    de10_nano::RunTCA(p.device_input_phys_addr, p.device_output_phys_addr, p.device_kernel_phys_addr, p.device_thresholds_phys_addr, in_w, in_h,
-      k_c, MAX_NBIT_QINPUT, out_w, out_h, out_c, k_w, k_h, cp.padding, cp.stride_along_height);
-    Measurement::Stop();
+    {
+      // the other frame in flight runs its cpu layers while this one waits
+      std::lock_guard<std::mutex> lock(de10_nano::TCAMutex());
+      Measurement::Start("Conv2D TCA");
+      de10_nano::StartTCA(p.device_input_phys_addr, p.device_output_phys_addr, p.device_kernel_phys_addr, p.device_thresholds_phys_addr, in_w, in_h,
+        k_c, MAX_NBIT_QINPUT, out_w, out_h, out_c, k_w, k_h, cp.padding, cp.stride_along_height);
+      de10_nano::WaitTCA();
+      Measurement::Stop();
+    }
 
     Measurement::Start("Sync UDMABuf Output");
     p.dma_output_buffer->sync_size(output_byte_size);
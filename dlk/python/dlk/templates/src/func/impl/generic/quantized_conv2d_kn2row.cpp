@@ -25,7 +25,7 @@ limitations under the License.
 #include "matrix/shift_add.h"
 #include "time_measurement.h"
 #include "tensor_convert.h"
-#include "func/impl/pack_16bit.h"
+#include "workspace.h"
 
 namespace dlk {
 
@@ -56,43 +56,78 @@ void QuantizedConv2DKn2Row(const kn2row_input_t& input,
       input.data(), ic / 16, ih * iw);
   auto output_ = MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>(
       p.device_output_buf, oc, ih * iw);
+  auto& pool = *p.normal_conv_params.thread_pool;
 
-  if (kh == kw && kw == 3) {
-    unsigned bufsize = oc * kh * kw * ih * iw;
-    BIN_CONV_OUTPUT *kn2row_buf = new BIN_CONV_OUTPUT[bufsize]();
-    auto buf_ = MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>(
-        kn2row_buf, oc * kh * kw, ih * iw);
-
-    quantized_matrix_multiplication(kernel_, input_, buf_);
-    std::fill(p.device_output_buf, p.device_output_buf + oc * oh * ow, 0);
-    matrix_shift_add(buf_, output_, p.normal_conv_params);
-    delete[] kn2row_buf;
+  // with thresholds, the accumulators of every band of output rows are
+  // turned into packed 2 bit activations as soon as the band is done. they
+  // go to a separate buffer, as the ChHWBCl output would overwrite
+  // accumulators of later pixels.
+  const auto out_size = oc * oh * ow;
+  QUANTIZED_PACKED *packed = nullptr;
+  BIN_CONV_OUTPUT *thresholds = nullptr;
+  if (p.thresholds != nullptr) {
+    assert(oc <= MAX_IN_C);
+    thresholds = p.normal_conv_params.workspace->thresholds();
+    ReorderThresholds(p, thresholds);
+    assert(out_size / 32 * p.n_bit <= Workspace::kn2row_packed_buf_elems);
+    packed = p.normal_conv_params.workspace->kn2row_packed_buf();
+  }
+  const auto apply_thresholds = [&](std::size_t first_row, std::size_t last_row) {
+    pool.parallel_for(first_row * ow, last_row * ow, ow, [&](std::size_t first, std::size_t last) {
+      ApplyThresholdsAndPack(output_, thresholds, first, last, packed);
+    });
+  };
+
+  if (QuantizedConv2DKn2RowX86(input, kernel, p, thresholds, packed)) {
+    // GEMM, shift add and thresholds already done in one pass
+  } else if (kh == kw && kw == 3) {
+    // the GEMM and the shift add go through bands of output rows, so that
+    // the 9 * oc products per pixel only exist for a few rows at a time.
+    // a band of n output rows needs the products of n + 2 input rows; the
+    // last two of them are moved to the front for the next band instead of
+    // being multiplied again.
+    const std::size_t words = ic / 16;
+    const std::size_t rows = oc * kh * kw;
+    const std::size_t buf_rows = Workspace::kn2row_buf_elems / (rows * iw);
+    assert(buf_rows >= std::min<std::size_t>(ih, 3));
+    const std::size_t band = buf_rows >= ih ? oh : buf_rows - 2;
+    BIN_CONV_OUTPUT *buf = p.normal_conv_params.workspace->kn2row_qbuf();
+
+    // input rows [in_first, in_done) have their products in buf
+    std::size_t in_first = 0;
+    std::size_t in_done = 0;
+    for (std::size_t first_row = 0; first_row < oh; first_row += band) {
+      const std::size_t last_row = std::min<std::size_t>(first_row + band, oh);
+      const std::size_t in_begin = first_row == 0 ? 0 : first_row - 1;
+      const std::size_t in_last = std::min<std::size_t>(last_row + 1, ih);
+
+      std::copy(buf + (in_begin - in_first) * iw * rows, buf + (in_done - in_first) * iw * rows, buf);
+      in_first = in_begin;
+
+      auto band_input_ = MatrixView<QUANTIZED_PACKED, MatrixOrder::ColMajor>(
+          input.data() + in_done * iw * words, words, (in_last - in_done) * iw);
+      auto band_buf_ = MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>(
+          buf + (in_done - in_first) * iw * rows, rows, (in_last - in_done) * iw);
+      quantized_matrix_multiplication(kernel_, band_input_, band_buf_, pool);
+      in_done = in_last;
+
+      const auto buf_ = MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>(
+          buf, rows, (in_done - in_first) * iw);
+      matrix_shift_add(buf_, output_, p.normal_conv_params, first_row, last_row);
+      if (packed)
+        apply_thresholds(first_row, last_row);
+    }
   } else if (kh == kw && kw == 1) {
-    quantized_matrix_multiplication(kernel_, input_, output_);
+    quantized_matrix_multiplication(kernel_, input_, output_, pool);
+    if (packed)
+      apply_thresholds(0, oh);
   } else {
     std::cerr << "Only 1x1 or 3x3 convolutions are supported." << std::endl;
     assert(false);
   }
 
-  const auto out_size = oc * oh * ow;
-  if (p.thresholds != nullptr) {
-    ApplyThresholds(output_, p);
-    const auto buf = std::make_unique<QUANTIZED_PACKED[]>(out_size * p.n_bit / CHAR_BIT);
-    pack_16bit(p.device_output_buf, buf.get(), out_size);
-    const std::size_t b = 32;
-    TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>::tensor_info_t<std::size_t> buf_shape = {
-      oh, ow, (oc + b - 1) / b, p.n_bit, b
-    };
-    TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl> buf_tensor(buf.get(), buf_shape);
-    TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>::tensor_info_t<std::size_t> out_shape = {
-      (oc + b - 1) / b,
-      oh,
-      ow,
-      p.n_bit,
-      b
-    };
-    TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl> out((QUANTIZED_PACKED*)p.device_output_buf, out_shape);
-    convert_tensor(buf_tensor, out);
+  if (packed) {
+    std::copy(packed, packed + out_size / 32 * p.n_bit, (QUANTIZED_PACKED*)p.device_output_buf);
   } else {
     const std::size_t b = 32;
     const auto buf = std::make_unique<BIN_CONV_OUTPUT[]>(out_size);
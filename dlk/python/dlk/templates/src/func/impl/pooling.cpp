@@ -0,0 +1,129 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+
+#include "global.h"
+#include "cpu_features.h"
+#include "func/impl/pooling.h"
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+#ifdef DLK_X86
+#include <x86intrin.h>
+#endif
+
+namespace dlk {
+
+namespace impl {
+
+void max_pool_row(const T_FLOAT *input, T_FLOAT *acc, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    acc[i] = std::max(acc[i], input[i]);
+}
+
+void average_pool_row(const T_FLOAT *input, T_FLOAT *acc, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    acc[i] += input[i];
+}
+
+void max_pool_2bit(const QUANTIZED_PACKED *input, QUANTIZED_PACKED *acc, std::size_t pairs) {
+  const uint32_t *in = reinterpret_cast<const uint32_t*>(input);
+  uint32_t *out = reinterpret_cast<uint32_t*>(acc);
+  for (std::size_t i = 0; i < pairs; ++i)
+    max_2bit(out[2 * i], out[2 * i + 1], in[2 * i], in[2 * i + 1]);
+}
+
+#ifdef USE_NEON
+void max_pool_row_neon(const T_FLOAT *input, T_FLOAT *acc, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(acc + i, vmaxq_f32(vld1q_f32(acc + i), vld1q_f32(input + i)));
+  for (; i < n; ++i)
+    acc[i] = std::max(acc[i], input[i]);
+}
+
+void average_pool_row_neon(const T_FLOAT *input, T_FLOAT *acc, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(acc + i, vaddq_f32(vld1q_f32(acc + i), vld1q_f32(input + i)));
+  for (; i < n; ++i)
+    acc[i] += input[i];
+}
+
+void max_pool_2bit_neon(const QUANTIZED_PACKED *input, QUANTIZED_PACKED *acc, std::size_t pairs) {
+  const uint32_t *in = reinterpret_cast<const uint32_t*>(input);
+  uint32_t *out = reinterpret_cast<uint32_t*>(acc);
+  std::size_t i = 0;
+  for (; i + 4 <= pairs; i += 4) {
+    // val[0] holds the lsb words and val[1] the msb words
+    const auto a = vld2q_u32(out + 2 * i);
+    const auto b = vld2q_u32(in + 2 * i);
+    uint32x4x2_t res;
+    res.val[0] = vorrq_u32(vandq_u32(a.val[0], vornq_u32(a.val[1], b.val[1])),
+        vandq_u32(b.val[0], vornq_u32(b.val[1], a.val[1])));
+    res.val[1] = vorrq_u32(a.val[1], b.val[1]);
+    vst2q_u32(out + 2 * i, res);
+  }
+  for (; i < pairs; ++i)
+    max_2bit(out[2 * i], out[2 * i + 1], in[2 * i], in[2 * i + 1]);
+}
+#endif
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+void max_pool_row_avx2(const T_FLOAT *input, T_FLOAT *acc, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(acc + i, _mm256_max_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(input + i)));
+  for (; i < n; ++i)
+    acc[i] = std::max(acc[i], input[i]);
+}
+
+void average_pool_row_avx2(const T_FLOAT *input, T_FLOAT *acc, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_loadu_ps(input + i)));
+  for (; i < n; ++i)
+    acc[i] += input[i];
+}
+
+void max_pool_2bit_avx2(const QUANTIZED_PACKED *input, QUANTIZED_PACKED *acc, std::size_t pairs) {
+  const uint32_t *in = reinterpret_cast<const uint32_t*>(input);
+  uint32_t *out = reinterpret_cast<uint32_t*>(acc);
+  std::size_t i = 0;
+  for (; i + 4 <= pairs; i += 4) {
+    // every 64 bit lane holds a lsb word and the msb word above it; the
+    // shifted copies bring the msb words down to the lsb words
+    const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + 2 * i));
+    const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+    const auto am = _mm256_srli_epi64(a, 32);
+    const auto bm = _mm256_srli_epi64(b, 32);
+    const auto lsb = _mm256_or_si256(_mm256_andnot_si256(_mm256_andnot_si256(am, bm), a),
+        _mm256_andnot_si256(_mm256_andnot_si256(bm, am), b));
+    const auto msb = _mm256_or_si256(a, b);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i), _mm256_blend_epi32(lsb, msb, 0xAA));
+  }
+  for (; i < pairs; ++i)
+    max_2bit(out[2 * i], out[2 * i + 1], in[2 * i], in[2 * i + 1]);
+}
+
+DLK_TARGET_END
+#endif
+
+} // namespace impl
+
+} // namespace dlk
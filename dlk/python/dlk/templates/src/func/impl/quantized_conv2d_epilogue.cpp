@@ -0,0 +1,230 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+
+#include "global.h"
+#include "cpu_features.h"
+#include "func/impl/quantized_conv2d_epilogue.h"
+#include "kernel_table.h"
+#include "thread_pool.h"
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+#ifdef DLK_X86
+#include <x86intrin.h>
+#endif
+
+namespace dlk {
+
+namespace impl {
+
+namespace {
+
+constexpr unsigned block_size = 32;
+
+template <ActivationType activation>
+inline T_FLOAT activate(T_FLOAT x, T_FLOAT alpha) {
+  switch (activation) {
+    case ActivationType::Relu:
+      return std::max(x, 0.0f);
+    case ActivationType::LeakyRelu:
+      return std::max(x * alpha, x);
+    default:
+      return x;
+  }
+}
+
+template <ActivationType activation>
+void epilogue(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride) {
+  for (std::size_t i = 0; i < pixels; ++i) {
+    const BIN_CONV_OUTPUT *in = acc + i * block_size;
+    T_FLOAT *out = output + i * out_stride;
+    for (unsigned d = 0; d < channels; ++d)
+      out[d] = activate<activation>(in[d] * scale[d] + shift[d], alpha);
+  }
+}
+
+#ifdef USE_NEON
+template <ActivationType activation>
+inline float32x4_t activate_neon(float32x4_t x, T_FLOAT alpha) {
+  switch (activation) {
+    case ActivationType::Relu:
+      return vmaxq_f32(x, vdupq_n_f32(0.0f));
+    case ActivationType::LeakyRelu:
+      return vmaxq_f32(vmulq_n_f32(x, alpha), x);
+    default:
+      return x;
+  }
+}
+
+template <ActivationType activation>
+void epilogue_neon(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride) {
+  const unsigned vectors = channels / 4;
+  float32x4_t scale_v[block_size / 4], shift_v[block_size / 4];
+  for (unsigned v = 0; v < vectors; ++v) {
+    scale_v[v] = vld1q_f32(scale + v * 4);
+    shift_v[v] = vld1q_f32(shift + v * 4);
+  }
+
+  for (std::size_t i = 0; i < pixels; ++i) {
+    // the convolution is done with the buffer, which is volatile on the FPGA
+    const T_INT16 *in = const_cast<const T_INT16*>(acc + i * block_size);
+    T_FLOAT *out = output + i * out_stride;
+    for (unsigned v = 0; v < vectors; ++v) {
+      const auto x = vcvtq_f32_s32(vmovl_s16(vld1_s16(in + v * 4)));
+      vst1q_f32(out + v * 4, activate_neon<activation>(vmlaq_f32(shift_v[v], x, scale_v[v]), alpha));
+    }
+    for (unsigned d = vectors * 4; d < channels; ++d)
+      out[d] = activate<activation>(in[d] * scale[d] + shift[d], alpha);
+  }
+}
+#endif
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+template <ActivationType activation>
+inline __m256 activate_avx2(__m256 x, T_FLOAT alpha) {
+  switch (activation) {
+    case ActivationType::Relu:
+      return _mm256_max_ps(x, _mm256_setzero_ps());
+    case ActivationType::LeakyRelu:
+      return _mm256_max_ps(_mm256_mul_ps(x, _mm256_set1_ps(alpha)), x);
+    default:
+      return x;
+  }
+}
+
+template <ActivationType activation>
+void epilogue_avx2(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride) {
+  const unsigned vectors = channels / 8;
+  __m256 scale_v[block_size / 8], shift_v[block_size / 8];
+  for (unsigned v = 0; v < vectors; ++v) {
+    scale_v[v] = _mm256_load_ps(scale + v * 8);
+    shift_v[v] = _mm256_load_ps(shift + v * 8);
+  }
+
+  for (std::size_t i = 0; i < pixels; ++i) {
+    const T_INT16 *in = const_cast<const T_INT16*>(acc + i * block_size);
+    T_FLOAT *out = output + i * out_stride;
+    for (unsigned v = 0; v < vectors; ++v) {
+      const auto x16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + v * 8));
+      const auto x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x16));
+      _mm256_storeu_ps(out + v * 8, activate_avx2<activation>(_mm256_fmadd_ps(x, scale_v[v], shift_v[v]), alpha));
+    }
+    for (unsigned d = vectors * 8; d < channels; ++d)
+      out[d] = activate<activation>(in[d] * scale[d] + shift[d], alpha);
+  }
+}
+
+DLK_TARGET_END
+#endif
+
+} // namespace
+
+void conv_epilogue_block(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, ActivationType activation, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride) {
+  switch (activation) {
+    case ActivationType::Relu:
+      epilogue<ActivationType::Relu>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+    case ActivationType::LeakyRelu:
+      epilogue<ActivationType::LeakyRelu>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+    default:
+      epilogue<ActivationType::None>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+  }
+}
+
+#ifdef USE_NEON
+void conv_epilogue_block_neon(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, ActivationType activation, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride) {
+  switch (activation) {
+    case ActivationType::Relu:
+      epilogue_neon<ActivationType::Relu>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+    case ActivationType::LeakyRelu:
+      epilogue_neon<ActivationType::LeakyRelu>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+    default:
+      epilogue_neon<ActivationType::None>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+  }
+}
+#endif
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+void conv_epilogue_block_avx2(const BIN_CONV_OUTPUT *acc, std::size_t pixels, unsigned channels,
+    const T_FLOAT *scale, const T_FLOAT *shift, ActivationType activation, T_FLOAT alpha,
+    T_FLOAT *output, std::size_t out_stride) {
+  switch (activation) {
+    case ActivationType::Relu:
+      epilogue_avx2<ActivationType::Relu>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+    case ActivationType::LeakyRelu:
+      epilogue_avx2<ActivationType::LeakyRelu>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+    default:
+      epilogue_avx2<ActivationType::None>(acc, pixels, channels, scale, shift, alpha, output, out_stride);
+      break;
+  }
+}
+
+DLK_TARGET_END
+#endif
+
+void QuantizedConv2DEpilogue(const binary_convolution_parameters& p,
+    const conv_epilogue_parameters& e,
+    const TensorView<T_FLOAT, MemoryLayout::NHWC>& output) {
+  const auto& ncp = p.normal_conv_params;
+  const std::size_t pixels = ncp.output_height * ncp.output_width;
+  const unsigned channels = output.get_shape()[3];
+  const unsigned blocks = (channels + block_size - 1) / block_size;
+
+  const auto epilogue_block = dlk::kernels().conv_epilogue;
+  ThreadPool& thread_pool = *ncp.thread_pool;
+  const std::size_t chunk_size = (pixels + thread_pool.num_threads() - 1) / thread_pool.num_threads();
+  thread_pool.parallel_for(0, pixels, chunk_size, [&](std::size_t first, std::size_t last) {
+    for (unsigned s = 0; s < blocks; ++s) {
+      const unsigned n = std::min(block_size, channels - s * block_size);
+      alignas(32) T_FLOAT scale[block_size];
+      alignas(32) T_FLOAT shift[block_size];
+      for (unsigned d = 0; d < block_size; ++d) {
+        const unsigned c = s * block_size + d;
+        scale[d] = d >= n ? 0.0f : e.scale != nullptr ? e.scaling_factor * e.scale[c] : e.scaling_factor;
+        shift[d] = d >= n || e.shift == nullptr ? 0.0f : e.shift[c];
+      }
+      epilogue_block(p.device_output_buf + (s * pixels + first) * block_size, last - first, n,
+          scale, shift, e.activation, e.alpha,
+          output.data() + first * channels + s * block_size, channels);
+    }
+  });
+}
+
+} // namespace impl
+
+} // namespace dlk
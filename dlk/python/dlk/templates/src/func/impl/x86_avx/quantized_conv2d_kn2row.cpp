@@ -0,0 +1,328 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cstdint>
+
+#include "global.h"
+#include "cpu_features.h"
+#include "func/impl/apply_thresholds.h"
+#include "func/impl/quantized_conv2d_kn2row.h"
+#include "kernel_table.h"
+#include "matrix_view.h"
+#include "thread_pool.h"
+#include "time_measurement.h"
+
+// This file is built into the generic x86 library (lm_x86 / lib_x86), which
+// is compiled without -mavx2. kernels() binds xor_pop_count to the AVX2 or
+// AVX512 VPOPCNTDQ version below when the cpu has them.
+
+#ifdef DLK_X86
+
+#include <x86intrin.h>
+
+DLK_TARGET_AVX2_BEGIN
+
+namespace {
+
+inline __m256i pop_count_epi8(__m256i x) {
+  const auto lut = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const auto mask = _mm256_set1_epi8(0x0f);
+  const auto lo = _mm256_and_si256(x, mask);
+  const auto hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), mask);
+  return _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+}
+
+// splits 8 interleaved (b0, b1) pairs into 8 b0 words and 8 b1 words
+inline void deinterleave(const uint32_t *b, __m256i& b0, __m256i& b1) {
+  const auto idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  const auto lo = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)), idx);
+  const auto hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 8)), idx);
+  b0 = _mm256_permute2x128_si256(lo, hi, 0x20);
+  b1 = _mm256_permute2x128_si256(lo, hi, 0x31);
+}
+
+inline __m256i xor_pop_count_8(const uint32_t *a, __m256i b0, __m256i b1) {
+  const auto av = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+  const auto p0 = pop_count_epi8(_mm256_xor_si256(av, b0));
+  const auto p1 = pop_count_epi8(_mm256_xor_si256(av, b1));
+  // at most 8 + 2 * 8 per byte, summed up to 64 bit lanes right away
+  const auto s = _mm256_add_epi8(p0, _mm256_add_epi8(p1, p1));
+  return _mm256_sad_epu8(s, _mm256_setzero_si256());
+}
+
+inline int32_t hsum_epi64(__m256i v) {
+  const auto s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  return static_cast<int32_t>(_mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1));
+}
+
+int32_t pop_count_sum(const uint32_t *a, std::size_t words) {
+  int32_t sum = 0;
+  for (std::size_t j = 0; j < words; ++j)
+    sum += _mm_popcnt_u32(a[j]);
+  return sum;
+}
+
+} // namespace
+
+namespace dlk {
+
+namespace impl {
+
+// for 4 kernel rows (a[t], a[t] + a_stride, ...) against one input pixel
+// (b[t] holds the interleaved b0 / b1 words of the pixel under tap t).
+// rows < 4 repeats the last row and only writes rows results.
+void xor_pop_count_avx2(const uint32_t * const *a, const uint32_t * const *b,
+                        unsigned taps, std::size_t a_stride, std::size_t words,
+                        unsigned rows, int32_t *out) {
+  const std::size_t r1 = std::min(1u, rows - 1) * a_stride;
+  const std::size_t r2 = std::min(2u, rows - 1) * a_stride;
+  const std::size_t r3 = std::min(3u, rows - 1) * a_stride;
+
+  auto acc0 = _mm256_setzero_si256();
+  auto acc1 = _mm256_setzero_si256();
+  auto acc2 = _mm256_setzero_si256();
+  auto acc3 = _mm256_setzero_si256();
+  int32_t tail0 = 0, tail1 = 0, tail2 = 0, tail3 = 0;
+
+  for (unsigned t = 0; t < taps; ++t) {
+    const uint32_t *at = a[t];
+    const uint32_t *bt = b[t];
+    std::size_t j = 0;
+    for (; j + 8 <= words; j += 8) {
+      __m256i b0, b1;
+      deinterleave(bt + 2 * j, b0, b1);
+      acc0 = _mm256_add_epi64(acc0, xor_pop_count_8(at + j, b0, b1));
+      acc1 = _mm256_add_epi64(acc1, xor_pop_count_8(at + r1 + j, b0, b1));
+      acc2 = _mm256_add_epi64(acc2, xor_pop_count_8(at + r2 + j, b0, b1));
+      acc3 = _mm256_add_epi64(acc3, xor_pop_count_8(at + r3 + j, b0, b1));
+    }
+    for (; j < words; ++j) {
+      const uint32_t b0 = bt[2 * j];
+      const uint32_t b1 = bt[2 * j + 1];
+      tail0 += _mm_popcnt_u32(at[j] ^ b0) + 2 * _mm_popcnt_u32(at[j] ^ b1);
+      tail1 += _mm_popcnt_u32(at[r1 + j] ^ b0) + 2 * _mm_popcnt_u32(at[r1 + j] ^ b1);
+      tail2 += _mm_popcnt_u32(at[r2 + j] ^ b0) + 2 * _mm_popcnt_u32(at[r2 + j] ^ b1);
+      tail3 += _mm_popcnt_u32(at[r3 + j] ^ b0) + 2 * _mm_popcnt_u32(at[r3 + j] ^ b1);
+    }
+  }
+
+  const int32_t res[4] = {
+    hsum_epi64(acc0) + tail0,
+    hsum_epi64(acc1) + tail1,
+    hsum_epi64(acc2) + tail2,
+    hsum_epi64(acc3) + tail3,
+  };
+  std::copy(res, res + rows, out);
+}
+
+} // namespace impl
+
+} // namespace dlk
+
+DLK_TARGET_END
+
+DLK_TARGET_AVX512_BEGIN
+
+namespace {
+
+inline __m256i xor_pop_count_8_vpopcnt(const uint32_t *a, __m256i b0, __m256i b1) {
+  const auto av = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+  const auto p0 = _mm256_popcnt_epi32(_mm256_xor_si256(av, b0));
+  const auto p1 = _mm256_popcnt_epi32(_mm256_xor_si256(av, b1));
+  return _mm256_add_epi32(p0, _mm256_add_epi32(p1, p1));
+}
+
+inline int32_t hsum_epi32(__m256i v) {
+  auto s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+  return _mm_cvtsi128_si32(s);
+}
+
+} // namespace
+
+namespace dlk {
+
+namespace impl {
+
+void xor_pop_count_vpopcnt(const uint32_t * const *a, const uint32_t * const *b,
+                           unsigned taps, std::size_t a_stride, std::size_t words,
+                           unsigned rows, int32_t *out) {
+  const std::size_t r1 = std::min(1u, rows - 1) * a_stride;
+  const std::size_t r2 = std::min(2u, rows - 1) * a_stride;
+  const std::size_t r3 = std::min(3u, rows - 1) * a_stride;
+
+  auto acc0 = _mm256_setzero_si256();
+  auto acc1 = _mm256_setzero_si256();
+  auto acc2 = _mm256_setzero_si256();
+  auto acc3 = _mm256_setzero_si256();
+  int32_t tail0 = 0, tail1 = 0, tail2 = 0, tail3 = 0;
+
+  for (unsigned t = 0; t < taps; ++t) {
+    const uint32_t *at = a[t];
+    const uint32_t *bt = b[t];
+    std::size_t j = 0;
+    for (; j + 8 <= words; j += 8) {
+      __m256i b0, b1;
+      deinterleave(bt + 2 * j, b0, b1);
+      acc0 = _mm256_add_epi32(acc0, xor_pop_count_8_vpopcnt(at + j, b0, b1));
+      acc1 = _mm256_add_epi32(acc1, xor_pop_count_8_vpopcnt(at + r1 + j, b0, b1));
+      acc2 = _mm256_add_epi32(acc2, xor_pop_count_8_vpopcnt(at + r2 + j, b0, b1));
+      acc3 = _mm256_add_epi32(acc3, xor_pop_count_8_vpopcnt(at + r3 + j, b0, b1));
+    }
+    for (; j < words; ++j) {
+      const uint32_t b0 = bt[2 * j];
+      const uint32_t b1 = bt[2 * j + 1];
+      tail0 += _mm_popcnt_u32(at[j] ^ b0) + 2 * _mm_popcnt_u32(at[j] ^ b1);
+      tail1 += _mm_popcnt_u32(at[r1 + j] ^ b0) + 2 * _mm_popcnt_u32(at[r1 + j] ^ b1);
+      tail2 += _mm_popcnt_u32(at[r2 + j] ^ b0) + 2 * _mm_popcnt_u32(at[r2 + j] ^ b1);
+      tail3 += _mm_popcnt_u32(at[r3 + j] ^ b0) + 2 * _mm_popcnt_u32(at[r3 + j] ^ b1);
+    }
+  }
+
+  const int32_t res[4] = {
+    hsum_epi32(acc0) + tail0,
+    hsum_epi32(acc1) + tail1,
+    hsum_epi32(acc2) + tail2,
+    hsum_epi32(acc3) + tail3,
+  };
+  std::copy(res, res + rows, out);
+}
+
+} // namespace impl
+
+} // namespace dlk
+
+DLK_TARGET_END
+
+namespace dlk {
+
+namespace impl {
+
+bool QuantizedConv2DKn2RowX86(const kn2row_input_t& input,
+                              const kernel_t& kernel,
+                              const binary_convolution_parameters& p,
+                              const BIN_CONV_OUTPUT *thresholds,
+                              QUANTIZED_PACKED *packed) {
+  const auto xor_pop_count = kernels().xor_pop_count;
+
+  const auto& cp = p.normal_conv_params;
+  const std::size_t kh = cp.kernel_height;
+  const std::size_t kw = cp.kernel_width;
+  if (xor_pop_count == nullptr
+      || sizeof(QUANTIZED_PACKED_KERNEL) != sizeof(uint32_t)
+      || !(kh == kw && (kh == 1 || kh == 3)))
+    return false;
+
+  Measurement::Start("quantized-kn2row-x86");
+
+  const std::size_t ic = cp.kernel_depth;
+  const std::size_t h = cp.input_height;
+  const std::size_t w = cp.input_width;
+  const std::size_t oc = cp.output_channels;
+  const std::size_t words = ic / 32;
+  const std::size_t pad = kh / 2;
+
+  // kernel rows are (tap, output channel), input pixels hold (b0, b1) word pairs
+  const void *kernel_data = kernel.data();
+  const void *input_data = input.data();
+  const auto *kernel_words = static_cast<const uint32_t*>(kernel_data);
+  const auto *input_words = static_cast<const uint32_t*>(input_data);
+  BIN_CONV_OUTPUT *output = p.device_output_buf;
+  const auto output_ = MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>(output, oc, h * w);
+
+  // one output row per task; a task walks the row once per 4 output channels,
+  // so that the 4 * kh * kw kernel rows in use stay in L1.
+  cp.thread_pool->parallel_for(0, h, 1, [&](std::size_t first, std::size_t last) {
+    const uint32_t *a[9];
+    const uint32_t *b[9];
+    int32_t kernel_pop_count[9][4];
+    int32_t dot[4];
+
+    for (std::size_t y = first; y < last; ++y) {
+      for (std::size_t o = 0; o < oc; o += 4) {
+        const unsigned rows = std::min<std::size_t>(4, oc - o);
+        for (std::size_t t = 0; t < kh * kw; ++t)
+          for (unsigned k = 0; k < rows; ++k)
+            kernel_pop_count[t][k] = pop_count_sum(kernel_words + (t * oc + o + k) * words, words);
+
+        for (std::size_t x = 0; x < w; ++x) {
+          // taps falling on the zero padding are skipped
+          int32_t ones[4] = {0, 0, 0, 0};
+          unsigned taps = 0;
+          for (std::size_t ty = 0; ty < kh; ++ty) {
+            const std::size_t sy = y + ty - pad;
+            if (sy >= h)
+              continue;
+            for (std::size_t tx = 0; tx < kw; ++tx) {
+              const std::size_t sx = x + tx - pad;
+              if (sx >= w)
+                continue;
+              const std::size_t t = ty * kw + tx;
+              a[taps] = kernel_words + (t * oc + o) * words;
+              b[taps] = input_words + (sy * w + sx) * 2 * words;
+              for (unsigned k = 0; k < rows; ++k)
+                ones[k] += kernel_pop_count[t][k];
+              ++taps;
+            }
+          }
+
+          xor_pop_count(a, b, taps, words, words, rows, dot);
+
+          // pop_count(~(a ^ b0)) + 2 * pop_count(~(a ^ b1)) - 3 * pop_count(~a)
+          //   = 3 * pop_count(a) - pop_count(a ^ b0) - 2 * pop_count(a ^ b1)
+          BIN_CONV_OUTPUT *out = output + (y * w + x) * oc + o;
+          for (unsigned k = 0; k < rows; ++k)
+            out[k] = 3 * ones[k] - dot[k];
+        }
+      }
+
+      // the row is done, pack it while it is in cache
+      if (packed != nullptr)
+        ApplyThresholdsAndPack(output_, thresholds, y * w, (y + 1) * w, packed);
+    }
+  });
+
+  Measurement::Stop();
+
+  return true;
+}
+
+} // namespace impl
+
+} // namespace dlk
+
+#else
+
+namespace dlk {
+
+namespace impl {
+
+bool QuantizedConv2DKn2RowX86(const kn2row_input_t& input,
+                              const kernel_t& kernel,
+                              const binary_convolution_parameters& p,
+                              const BIN_CONV_OUTPUT *thresholds,
+                              QUANTIZED_PACKED *packed) {
+  return false;
+}
+
+} // namespace impl
+
+} // namespace dlk
+
+#endif
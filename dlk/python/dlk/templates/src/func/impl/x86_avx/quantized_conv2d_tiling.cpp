@@ -18,25 +18,17 @@ limitations under the License.
 
 #include "global.h"
 #include "func/impl/quantized_conv2d_tiling.h"
+#include "thread_pool.h"
 #include "time_measurement.h"
 
 #include <x86intrin.h>
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
-
 namespace dlk {
 
 namespace impl {
 
-static const auto buf_th0 = std::make_unique<BIN_CONV_OUTPUT[]>(MAX_IN_C);
-static const auto buf_th1 = std::make_unique<BIN_CONV_OUTPUT[]>(MAX_IN_C);
-static const auto buf_th2 = std::make_unique<BIN_CONV_OUTPUT[]>(MAX_IN_C);
-static const auto buf_flg = std::make_unique<BIN_CONV_OUTPUT[]>(MAX_IN_C);
-
 void pack_input_for_tiling(const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::NHWC>& input,
-    const tiling_input_t& output) {
+    const tiling_input_t& output, ThreadPool& pool) {
   Measurement::Start("Pack_input_for_tiling");
   const std::size_t in_channels = input.get_shape()[3];
   const std::size_t in_height = input.get_shape()[1];
@@ -45,32 +37,34 @@ void pack_input_for_tiling(const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::
   
   constexpr std::size_t InTypeBitWidth = CHAR_BIT * sizeof(uint32_t);
   const std::size_t in_stride = (in_channels + InTypeBitWidth - 1) / InTypeBitWidth;
-#pragma omp parallel for schedule(dynamic)
-  for (std::size_t in_ch_high = 0; in_ch_high < in_stride; ++in_ch_high) {
-    for (std::size_t row = 0; row < in_height; ++row) {
-      for (std::size_t col = 0; col < in_width; ++col) {
-        for (std::size_t in_bit_ch = 0; in_bit_ch < in_bitwidth; ++in_bit_ch) {
-          output(in_ch_high, row, col, in_bit_ch, 0) = tiling_input_elem_t(0);
+  pool.parallel_for(0, in_stride, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t in_ch_high = first; in_ch_high < last; ++in_ch_high) {
+      for (std::size_t row = 0; row < in_height; ++row) {
+        for (std::size_t col = 0; col < in_width; ++col) {
+          for (std::size_t in_bit_ch = 0; in_bit_ch < in_bitwidth; ++in_bit_ch) {
+            output(in_ch_high, row, col, in_bit_ch, 0) = tiling_input_elem_t(0);
+          }
         }
       }
     }
-  }
-#pragma omp parallel for schedule(dynamic)
-  for (std::size_t row = 0; row < in_height; ++row) {
-    for (std::size_t col = 0; col < in_width; ++col) {
-      for (std::size_t in_ch_high = 0; in_ch_high < in_channels; in_ch_high += InTypeBitWidth) {
-        for (std::size_t in_ch_low = 0; in_ch_low < InTypeBitWidth; ++in_ch_low) {
-          std::size_t in_ch = in_ch_high + in_ch_low;
-          if (in_ch >= in_channels) break;
-          QUANTIZED_NOT_PACKED val = input(0, row, col, in_ch);
-          for (std::size_t in_bit_ch = 0; in_bit_ch < in_bitwidth; ++in_bit_ch) {
-            tiling_input_elem_base_t bit = (val >> in_bit_ch) & 1;
-            output(in_ch_high / InTypeBitWidth, row, col, in_bit_ch, 0) |= tiling_input_elem_t(bit << in_ch_low);
+  });
+  pool.parallel_for(0, in_height, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t row = first; row < last; ++row) {
+      for (std::size_t col = 0; col < in_width; ++col) {
+        for (std::size_t in_ch_high = 0; in_ch_high < in_channels; in_ch_high += InTypeBitWidth) {
+          for (std::size_t in_ch_low = 0; in_ch_low < InTypeBitWidth; ++in_ch_low) {
+            std::size_t in_ch = in_ch_high + in_ch_low;
+            if (in_ch >= in_channels) break;
+            QUANTIZED_NOT_PACKED val = input(0, row, col, in_ch);
+            for (std::size_t in_bit_ch = 0; in_bit_ch < in_bitwidth; ++in_bit_ch) {
+              tiling_input_elem_base_t bit = (val >> in_bit_ch) & 1;
+              output(in_ch_high / InTypeBitWidth, row, col, in_bit_ch, 0) |= tiling_input_elem_t(bit << in_ch_low);
+            }
           }
         }
       }
     }
-  }
+  });
 
   Measurement::Stop();
 }
@@ -88,16 +82,23 @@ void QuantizedConv2DTiling(const tiling_input_t& input,
   const std::size_t in_height = cp.input_height;
   const std::size_t in_width = cp.input_width;
   const std::size_t in_stride = (in_channels + InTypeBitWidth - 1) / InTypeBitWidth;
-  const std::size_t padding = cp.padding;
+  const std::size_t pad_top = cp.padding_top;
+  const std::size_t pad_left = cp.padding_left;
+  const std::size_t stride_h = std::max<std::size_t>(cp.stride_along_height, 1);
+  const std::size_t stride_w = std::max<std::size_t>(cp.stride_along_width, 1);
   const std::size_t out_height = cp.output_height;
   const std::size_t out_width = cp.output_width;
   const std::size_t out_size = out_height * out_width * out_channels;
 
-  //assert(kh * kw < 32);
-  assert(in_height * in_width == out_height * out_width);
+  assert(kh <= tiling_max_kernel_size && kw <= tiling_max_kernel_size);
+  assert(stride_h <= tiling_max_stride && stride_w <= tiling_max_stride);
   assert((in_channels % InTypeBitWidth) == 0);
 
   Measurement::Start("Quantized Conv2D Tiling");
+  BIN_CONV_OUTPUT *buf_th0 = cp.workspace->thresholds() + 0 * MAX_IN_C;
+  BIN_CONV_OUTPUT *buf_th1 = cp.workspace->thresholds() + 1 * MAX_IN_C;
+  BIN_CONV_OUTPUT *buf_th2 = cp.workspace->thresholds() + 2 * MAX_IN_C;
+  BIN_CONV_OUTPUT *buf_flg = cp.workspace->thresholds() + 3 * MAX_IN_C;
   if (p.thresholds != nullptr) {
     const auto table = _mm256_setr_epi8(
         0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
@@ -131,14 +132,14 @@ void QuantizedConv2DTiling(const tiling_input_t& input,
       const auto res0 = _mm256_sub_epi16(th0, is_neg);
       const auto res1 = _mm256_sub_epi16(th1, is_neg);
       const auto res2 = _mm256_sub_epi16(th2, is_neg);
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf_th0.get() + i), res0);
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf_th1.get() + i), res1);
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf_th2.get() + i), res2);
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf_flg.get() + i), flg);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf_th0 + i), res0);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf_th1 + i), res1);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf_th2 + i), res2);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf_flg + i), flg);
     }
   }
 
-  if (kh == 1 && kw == 1) {
+  if (kh == 1 && kw == 1 && stride_h == 1 && stride_w == 1 && pad_top == 0 && pad_left == 0) {
     constexpr std::size_t InChUnroll = InTypeBitWidth; // hardcoded, not configurable
     constexpr std::size_t OutChUnroll = 16; // hardcoded, not configurable
     constexpr std::size_t OutChUnroll2 = 32; // hardcoded, not configurable
@@ -149,7 +150,7 @@ void QuantizedConv2DTiling(const tiling_input_t& input,
     const auto col_tile_count = (in_width + ColUnroll - 1) / ColUnroll;
     const auto total_tile_count = row_tile_count * col_tile_count;
     alignas(32) int16_t nksum_ary[MAX_IN_C];
-    alignas(32) uint32_t nk[MAX_SIZE_QKERNELS_PER_LAYER];
+    uint32_t *nk = cp.workspace->tiling_kernel_buf();
     for (std::size_t i = 0; i < out_channels; ++i) {
       nksum_ary[i] = 0;
     }
@@ -174,134 +175,135 @@ void QuantizedConv2DTiling(const tiling_input_t& input,
       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
     );
-#pragma omp parallel for schedule(guided)
-    for (std::size_t tile_index = 0; tile_index < total_tile_count; ++tile_index) {
-      const auto col = tile_index % col_tile_count * ColUnroll;
-      const auto row = tile_index / col_tile_count;
-      alignas(32) uint32_t in_buf[MAX_IN_C/InTypeBitWidth][ColUnroll][2];
-      for (std::size_t in_ch_high = 0; in_ch_high < in_channels/InTypeBitWidth; ++in_ch_high) {
-        const auto in_index = in_ch_high * in_height * in_width * in_bitwidth
-          + row * in_width * in_bitwidth
-          + col * in_bitwidth;
-        for (std::size_t j = 0; j < ColUnroll; ++j) {
-          if (col + j >= in_width) {
-            in_buf[in_ch_high][j][0] = 0;
-            in_buf[in_ch_high][j][1] = 0;
-          } else {
-            in_buf[in_ch_high][j][0] = input.data()[in_index + j * 2 + 0].Raw();
-            in_buf[in_ch_high][j][1] = input.data()[in_index + j * 2 + 1].Raw();
+    cp.thread_pool->parallel_for(0, total_tile_count, 1, [&](std::size_t first, std::size_t last) {
+      for (std::size_t tile_index = first; tile_index < last; ++tile_index) {
+        const auto col = tile_index % col_tile_count * ColUnroll;
+        const auto row = tile_index / col_tile_count;
+        alignas(32) uint32_t in_buf[MAX_IN_C/InTypeBitWidth][ColUnroll][2];
+        for (std::size_t in_ch_high = 0; in_ch_high < in_channels/InTypeBitWidth; ++in_ch_high) {
+          const auto in_index = in_ch_high * in_height * in_width * in_bitwidth
+            + row * in_width * in_bitwidth
+            + col * in_bitwidth;
+          for (std::size_t j = 0; j < ColUnroll; ++j) {
+            if (col + j >= in_width) {
+              in_buf[in_ch_high][j][0] = 0;
+              in_buf[in_ch_high][j][1] = 0;
+            } else {
+              in_buf[in_ch_high][j][0] = input.data()[in_index + j * 2 + 0].Raw();
+              in_buf[in_ch_high][j][1] = input.data()[in_index + j * 2 + 1].Raw();
+            }
           }
         }
-      }
-      for (std::size_t Oh = 0; Oh < out_channels; Oh += OutChUnroll) {
-        auto xnorsum0 = _mm256_setzero_si256();
-        auto xnorsum1 = _mm256_setzero_si256();
-        auto xnorsum2 = _mm256_setzero_si256();
-        auto xnorsum3 = _mm256_setzero_si256();
-        for (std::size_t in_ch_high = 0; in_ch_high < in_channels/InTypeBitWidth; ++in_ch_high) {
-          const auto nk_index = Oh * (in_channels / InTypeBitWidth) * 2
-            + in_ch_high * OutChUnroll * 2;
-          const auto nk0 = _mm256_load_si256(reinterpret_cast<__m256i*>(&nk[nk_index +  0 * 2]));
-          const auto nk1 = _mm256_load_si256(reinterpret_cast<__m256i*>(&nk[nk_index +  4 * 2]));
-          const auto nk2 = _mm256_load_si256(reinterpret_cast<__m256i*>(&nk[nk_index +  8 * 2]));
-          const auto nk3 = _mm256_load_si256(reinterpret_cast<__m256i*>(&nk[nk_index + 12 * 2]));
+        for (std::size_t Oh = 0; Oh < out_channels; Oh += OutChUnroll) {
+          auto xnorsum0 = _mm256_setzero_si256();
+          auto xnorsum1 = _mm256_setzero_si256();
+          auto xnorsum2 = _mm256_setzero_si256();
+          auto xnorsum3 = _mm256_setzero_si256();
+          for (std::size_t in_ch_high = 0; in_ch_high < in_channels/InTypeBitWidth; ++in_ch_high) {
+            const auto nk_index = Oh * (in_channels / InTypeBitWidth) * 2
+              + in_ch_high * OutChUnroll * 2;
+            const auto nk0 = _mm256_load_si256(reinterpret_cast<__m256i*>(&nk[nk_index +  0 * 2]));
+            const auto nk1 = _mm256_load_si256(reinterpret_cast<__m256i*>(&nk[nk_index +  4 * 2]));
+            const auto nk2 = _mm256_load_si256(reinterpret_cast<__m256i*>(&nk[nk_index +  8 * 2]));
+            const auto nk3 = _mm256_load_si256(reinterpret_cast<__m256i*>(&nk[nk_index + 12 * 2]));
 #define BINDP(i, j) \
-  const auto xnor##j = in ^ nk##j; \
-  const auto l4##j = mask4 & xnor##j; \
-  const auto popc_l4##j = _mm256_shuffle_epi8(popc_table, l4##j); \
-  const auto h4##j = mask4 & _mm256_srli_epi32(xnor##j, 4); \
-  const auto popc_h4##j = _mm256_shuffle_epi8(popc_table, h4##j); \
-  const auto cnt##j = _mm256_add_epi8(popc_l4##j, popc_h4##j); \
-  const auto cnt16_##j = _mm256_maddubs_epi16(cnt##j, vone);
+    const auto xnor##j = in ^ nk##j; \
+    const auto l4##j = mask4 & xnor##j; \
+    const auto popc_l4##j = _mm256_shuffle_epi8(popc_table, l4##j); \
+    const auto h4##j = mask4 & _mm256_srli_epi32(xnor##j, 4); \
+    const auto popc_h4##j = _mm256_shuffle_epi8(popc_table, h4##j); \
+    const auto cnt##j = _mm256_add_epi8(popc_l4##j, popc_h4##j); \
+    const auto cnt16_##j = _mm256_maddubs_epi16(cnt##j, vone);
 
 #define BINCONV(i) \
-  do { \
-    const auto in = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_buf[in_ch_high][i][0])); \
-    BINDP(i, 0); \
-    BINDP(i, 1); \
-    const auto pack01 = _mm256_packs_epi16(cnt16_0, cnt16_1); \
-    const auto cnt32_01 = _mm256_maddubs_epi16(pack01, vone); \
-    BINDP(i, 2); \
-    BINDP(i, 3); \
-    const auto pack23 = _mm256_packs_epi16(cnt16_2, cnt16_3); \
-    const auto cnt32_23 = _mm256_maddubs_epi16(pack23, vone); \
-    const auto pack03 = _mm256_packs_epi16(cnt32_01, cnt32_23); \
-    const auto cnt64 = _mm256_maddubs_epi16(pack03, _mm256_set1_epi16(0x0201)); \
-    xnorsum##i = _mm256_add_epi16(xnorsum##i, cnt64); \
-  } while(0)
-          BINCONV(0);
-          BINCONV(1);
-          BINCONV(2);
-          BINCONV(3);
+    do { \
+      const auto in = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_buf[in_ch_high][i][0])); \
+      BINDP(i, 0); \
+      BINDP(i, 1); \
+      const auto pack01 = _mm256_packs_epi16(cnt16_0, cnt16_1); \
+      const auto cnt32_01 = _mm256_maddubs_epi16(pack01, vone); \
+      BINDP(i, 2); \
+      BINDP(i, 3); \
+      const auto pack23 = _mm256_packs_epi16(cnt16_2, cnt16_3); \
+      const auto cnt32_23 = _mm256_maddubs_epi16(pack23, vone); \
+      const auto pack03 = _mm256_packs_epi16(cnt32_01, cnt32_23); \
+      const auto cnt64 = _mm256_maddubs_epi16(pack03, _mm256_set1_epi16(0x0201)); \
+      xnorsum##i = _mm256_add_epi16(xnorsum##i, cnt64); \
+    } while(0)
+            BINCONV(0);
+            BINCONV(1);
+            BINCONV(2);
+            BINCONV(3);
 #undef BINDP
 #undef BINCONV
-        }
-        const auto nksum = _mm256_load_si256(reinterpret_cast<__m256i*>(nksum_ary + Oh));
-        const auto table = _mm256_setr_epi32(
-            0, 4, 1, 5, 2, 6, 3, 7
-        );
-        const auto permed0 = _mm256_permutevar8x32_epi32(xnorsum0, table);
-        const auto permed1 = _mm256_permutevar8x32_epi32(xnorsum1, table);
-        const auto permed2 = _mm256_permutevar8x32_epi32(xnorsum2, table);
-        const auto permed3 = _mm256_permutevar8x32_epi32(xnorsum3, table);
-        const auto ans0 = _mm256_sub_epi16(permed0, nksum);
-        const auto ans1 = _mm256_sub_epi16(permed1, nksum);
-        const auto ans2 = _mm256_sub_epi16(permed2, nksum);
-        const auto ans3 = _mm256_sub_epi16(permed3, nksum);
-        const auto Ohh = Oh / OutChUnroll2;
-        const auto Om = Oh / OutChUnroll % OutChBlocks;
-        if (p.thresholds != nullptr) {
-          const auto th0 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(buf_th0.get() + Oh));
-          const auto th1 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(buf_th1.get() + Oh));
-          const auto th2 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(buf_th2.get() + Oh));
-          const auto flg = _mm256_loadu_si256(reinterpret_cast<__m256i*>(buf_flg.get() + Oh));
-          const auto is_neg = _mm256_cmpgt_epi16(_mm256_setzero_si256(), flg);
-          const auto m2 = _mm256_sub_epi16(flg, _mm256_set1_epi16(2));
-          const auto is_not_const = _mm256_cmpgt_epi16(_mm256_setzero_si256(), m2);
+          }
+          const auto nksum = _mm256_load_si256(reinterpret_cast<__m256i*>(nksum_ary + Oh));
+          const auto table = _mm256_setr_epi32(
+              0, 4, 1, 5, 2, 6, 3, 7
+          );
+          const auto permed0 = _mm256_permutevar8x32_epi32(xnorsum0, table);
+          const auto permed1 = _mm256_permutevar8x32_epi32(xnorsum1, table);
+          const auto permed2 = _mm256_permutevar8x32_epi32(xnorsum2, table);
+          const auto permed3 = _mm256_permutevar8x32_epi32(xnorsum3, table);
+          const auto ans0 = _mm256_sub_epi16(permed0, nksum);
+          const auto ans1 = _mm256_sub_epi16(permed1, nksum);
+          const auto ans2 = _mm256_sub_epi16(permed2, nksum);
+          const auto ans3 = _mm256_sub_epi16(permed3, nksum);
+          const auto Ohh = Oh / OutChUnroll2;
+          const auto Om = Oh / OutChUnroll % OutChBlocks;
+          if (p.thresholds != nullptr) {
+            const auto th0 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(buf_th0 + Oh));
+            const auto th1 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(buf_th1 + Oh));
+            const auto th2 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(buf_th2 + Oh));
+            const auto flg = _mm256_loadu_si256(reinterpret_cast<__m256i*>(buf_flg + Oh));
+            const auto is_neg = _mm256_cmpgt_epi16(_mm256_setzero_si256(), flg);
+            const auto m2 = _mm256_sub_epi16(flg, _mm256_set1_epi16(2));
+            const auto is_not_const = _mm256_cmpgt_epi16(_mm256_setzero_si256(), m2);
 #define APPLY_PACK(i) \
-  if (col + i >= out_width) continue; \
-  do { \
-    const auto f0 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th0, ans##i), flg); \
-    const auto f1 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th1, ans##i), flg); \
-    const auto f2 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th2, ans##i), flg); \
-    const auto tmp = _mm256_add_epi16(_mm256_add_epi16(f0, f1), _mm256_add_epi16(f2, is_neg)); \
-    const auto res = _mm256_blendv_epi8(m2, tmp, is_not_const); \
-    const auto packed = _mm256_packs_epi16(res, _mm256_setzero_si256()); \
-    const auto permed = _mm256_permute4x64_epi64(packed, 0xD8); \
-    const auto shorted = _mm256_castsi256_si128(permed); \
-    const auto vlsb = _mm_slli_epi16(shorted, 7); \
-    const auto vmsb = _mm_slli_epi16(shorted, 6); \
-    const auto lsb = _mm_movemask_epi8(vlsb); \
-    const auto msb = _mm_movemask_epi8(vmsb); \
-    reinterpret_cast<uint16_t*>(p.device_output_buf)[out_index + i * 2 * OutChBlocks + 0 * OutChBlocks] = lsb; \
-    reinterpret_cast<uint16_t*>(p.device_output_buf)[out_index + i * 2 * OutChBlocks + 1 * OutChBlocks] = msb; \
-  } while(0)
-          const auto out_index = Ohh * out_height * out_width * 2 * OutChBlocks
-              + row * out_width * 2 * OutChBlocks
-              + col * 2 * OutChBlocks
-              + Om;
-          APPLY_PACK(0);
-          APPLY_PACK(1);
-          APPLY_PACK(2);
-          APPLY_PACK(3);
-        } else {
+    if (col + i >= out_width) continue; \
+    do { \
+      const auto f0 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th0, ans##i), flg); \
+      const auto f1 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th1, ans##i), flg); \
+      const auto f2 = _mm256_andnot_si256(_mm256_cmpgt_epi16(th2, ans##i), flg); \
+      const auto tmp = _mm256_add_epi16(_mm256_add_epi16(f0, f1), _mm256_add_epi16(f2, is_neg)); \
+      const auto res = _mm256_blendv_epi8(m2, tmp, is_not_const); \
+      const auto packed = _mm256_packs_epi16(res, _mm256_setzero_si256()); \
+      const auto permed = _mm256_permute4x64_epi64(packed, 0xD8); \
+      const auto shorted = _mm256_castsi256_si128(permed); \
+      const auto vlsb = _mm_slli_epi16(shorted, 7); \
+      const auto vmsb = _mm_slli_epi16(shorted, 6); \
+      const auto lsb = _mm_movemask_epi8(vlsb); \
+      const auto msb = _mm_movemask_epi8(vmsb); \
+      reinterpret_cast<uint16_t*>(p.device_output_buf)[out_index + i * 2 * OutChBlocks + 0 * OutChBlocks] = lsb; \
+      reinterpret_cast<uint16_t*>(p.device_output_buf)[out_index + i * 2 * OutChBlocks + 1 * OutChBlocks] = msb; \
+    } while(0)
+            const auto out_index = Ohh * out_height * out_width * 2 * OutChBlocks
+                + row * out_width * 2 * OutChBlocks
+                + col * 2 * OutChBlocks
+                + Om;
+            APPLY_PACK(0);
+            APPLY_PACK(1);
+            APPLY_PACK(2);
+            APPLY_PACK(3);
+          } else {
 #define OUT(i) \
-  if (col + i >= out_width) continue; \
-  do { \
-    const auto out_index = Ohh * out_height * out_width * OutChUnroll2 \
-        + row * out_width * OutChUnroll2 \
-        + (col + i) * OutChUnroll2 \
-        + Om * OutChUnroll; \
-    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p.device_output_buf + out_index), ans##i); \
-  } while(0)
-          OUT(0);
-          OUT(1);
-          OUT(2);
-          OUT(3);
+    if (col + i >= out_width) continue; \
+    do { \
+      const auto out_index = Ohh * out_height * out_width * OutChUnroll2 \
+          + row * out_width * OutChUnroll2 \
+          + (col + i) * OutChUnroll2 \
+          + Om * OutChUnroll; \
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(p.device_output_buf + out_index), ans##i); \
+    } while(0)
+            OUT(0);
+            OUT(1);
+            OUT(2);
+            OUT(3);
 #undef OUT
+          }
         }
       }
-    }
+    });
   } else {
     constexpr std::size_t InChUnroll = InTypeBitWidth; // hardcoded, not configurable
     constexpr std::size_t OutChUnroll = 8; // hardcoded, not configurable
@@ -311,209 +313,230 @@ void QuantizedConv2DTiling(const tiling_input_t& input,
     constexpr std::size_t ColUnroll = 3; // hardcoded, not configurable
     const std::size_t TileHeightMax = 20; // configurable
     const std::size_t TileWidthMax = 21; // configurable
-    const std::size_t TileHeight = std::min(in_height, TileHeightMax);
-    const std::size_t TileWidth = std::min(in_width + (ColUnroll - in_width % ColUnroll) % ColUnroll, TileWidthMax);
-    const std::size_t khMax = 5;
-    const std::size_t kwMax = 5;
-    
-    const std::size_t row_tile_count = (in_height + TileHeight - 1) / TileHeight;
-    const std::size_t col_tile_count = (in_width + TileWidth - 1) / TileWidth;
+    const std::size_t TileHeight = std::min(out_height, TileHeightMax);
+    const std::size_t TileWidth = std::min(out_width + (ColUnroll - out_width % ColUnroll) % ColUnroll, TileWidthMax);
+    constexpr std::size_t khMax = tiling_max_kernel_size;
+    constexpr std::size_t kwMax = tiling_max_kernel_size;
+    constexpr std::size_t StrideMax = tiling_max_stride;
+    // the input a tile of the output reads
+    const std::size_t InTileHeight = (TileHeight - 1) * stride_h + kh;
+    const std::size_t InTileWidth = (TileWidth - 1) * stride_w + kw;
+    // the 8 bit counters grow by up to 8 a tap, so they are summed up at
+    // least every 31 taps
+    const std::size_t rows_per_sum = std::max<std::size_t>(31 / kw, 1);
+
+    const std::size_t row_tile_count = (out_height + TileHeight - 1) / TileHeight;
+    const std::size_t col_tile_count = (out_width + TileWidth - 1) / TileWidth;
     const std::size_t out_tile_count = (out_channels + OutChUnroll - 1) / OutChUnroll;
     const std::size_t total_tile_count = row_tile_count * col_tile_count * out_tile_count;
     const auto vone = _mm256_set1_epi8(0x01);
-#pragma omp parallel for schedule(guided)
-    for (std::size_t tile_index = 0; tile_index < total_tile_count; ++tile_index) {
-      const auto out_ch_high = tile_index % out_tile_count;
-      const auto col_high = (tile_index / out_tile_count) % col_tile_count * TileWidth;
-      const auto row_high = tile_index / (out_tile_count * col_tile_count) * TileHeight;
-      alignas(32) BIN_CONV_OUTPUT out_tile[TileHeightMax][TileWidthMax][OutChUnroll];
-      for (std::size_t row = 0; row < TileHeight; ++row) {
-        for (std::size_t col = 0; col < TileWidth; ++col) {
-          for (std::size_t out_ch = 0; out_ch < OutChUnroll; ++out_ch) {
-            out_tile[row][col][out_ch] = 0;
+    cp.thread_pool->parallel_for(0, total_tile_count, 1, [&](std::size_t first, std::size_t last) {
+      for (std::size_t tile_index = first; tile_index < last; ++tile_index) {
+        const auto out_ch_high = tile_index % out_tile_count;
+        const auto col_high = (tile_index / out_tile_count) % col_tile_count * TileWidth;
+        const auto row_high = tile_index / (out_tile_count * col_tile_count) * TileHeight;
+        alignas(32) BIN_CONV_OUTPUT out_tile[TileHeightMax][TileWidthMax][OutChUnroll];
+        for (std::size_t row = 0; row < TileHeight; ++row) {
+          for (std::size_t col = 0; col < TileWidth; ++col) {
+            for (std::size_t out_ch = 0; out_ch < OutChUnroll; ++out_ch) {
+              out_tile[row][col][out_ch] = 0;
+            }
           }
         }
-      }
-      const auto mask4 = _mm256_set1_epi8(0x0F);
-      const auto vone = _mm256_set1_epi8(1);
-      const auto popc_table = _mm256_setr_epi8(
-        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
-        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
-      );
-      for (std::size_t in_ch_high = 0; in_ch_high < in_channels; in_ch_high += InTypeBitWidth) {
-        alignas(32) QUANTIZED_PACKED_KERNEL notk[khMax][kwMax][OutChUnroll][2];
-        alignas(32) BIN_CONV_OUTPUT notsum[OutChUnroll] = {};
-        for (std::size_t out_ch = 0; out_ch < OutChUnroll; ++out_ch) {
-          notsum[out_ch] = 0;
-          for (std::size_t kr = 0; kr < kh; ++kr) {
-            for (std::size_t kc = 0; kc < kw; ++kc) {
-              const auto index = (out_ch_high * OutChUnroll + out_ch) * kh * kw * (in_channels / InTypeBitWidth)
-                + kr * kw * (in_channels / InTypeBitWidth)
-                + kc * (in_channels / InTypeBitWidth)
-                + (in_ch_high / InTypeBitWidth);
-              notk[kr][kc][out_ch][0] = kernel.data()[index];
-              notk[kr][kc][out_ch][1] = kernel.data()[index];
-              notsum[out_ch] += pop_count(notk[kr][kc][out_ch][0]) * 3;
+        const auto mask4 = _mm256_set1_epi8(0x0F);
+        const auto vone = _mm256_set1_epi8(1);
+        const auto popc_table = _mm256_setr_epi8(
+          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+        );
+        for (std::size_t in_ch_high = 0; in_ch_high < in_channels; in_ch_high += InTypeBitWidth) {
+          alignas(32) QUANTIZED_PACKED_KERNEL notk[khMax][kwMax][OutChUnroll][2];
+          alignas(32) BIN_CONV_OUTPUT notsum[OutChUnroll] = {};
+          for (std::size_t out_ch = 0; out_ch < OutChUnroll; ++out_ch) {
+            notsum[out_ch] = 0;
+            for (std::size_t kr = 0; kr < kh; ++kr) {
+              for (std::size_t kc = 0; kc < kw; ++kc) {
+                const auto index = (out_ch_high * OutChUnroll + out_ch) * kh * kw * (in_channels / InTypeBitWidth)
+                  + kr * kw * (in_channels / InTypeBitWidth)
+                  + kc * (in_channels / InTypeBitWidth)
+                  + (in_ch_high / InTypeBitWidth);
+                notk[kr][kc][out_ch][0] = kernel.data()[index];
+                notk[kr][kc][out_ch][1] = kernel.data()[index];
+                notsum[out_ch] += pop_count(notk[kr][kc][out_ch][0]) * 3;
+              }
             }
           }
-        }
-        for (std::size_t in_bit_ch_high = 0; in_bit_ch_high < in_bitwidth; in_bit_ch_high += InBitChUnroll) {
-          alignas(32) tiling_input_elem_t in_tile[TileHeightMax + khMax - 1][TileWidthMax + kwMax - 1][InBitChUnroll];
-          for (std::size_t row = 0; row < TileHeight + kh - 1; ++row) {
-            if (row_high + row >= in_height + 2*padding) break;
-            for (std::size_t col = 0; col < TileWidth + kw - 1; ++col) {
-              if (col_high + col >= in_width + 2*padding) break;
-              for (std::size_t in_bit_ch = 0; in_bit_ch < InBitChUnroll; ++in_bit_ch) {
-                if (row_high + row < padding || row_high + row >= in_height + padding
-                    || col_high + col < padding || col_high + col >= in_width + padding) {
-                  in_tile[row][col][in_bit_ch] = tiling_input_elem_t(0);
-                } else {
-                  const auto index = (in_ch_high / InTypeBitWidth) * in_height * in_width * in_bitwidth
-                    + (row_high + row - padding) * in_width * in_bitwidth
-                    + (col_high + col - padding) * in_bitwidth
-                    + (in_bit_ch_high + in_bit_ch);
-                  in_tile[row][col][in_bit_ch] = input.data()[index];
+          for (std::size_t in_bit_ch_high = 0; in_bit_ch_high < in_bitwidth; in_bit_ch_high += InBitChUnroll) {
+            alignas(32) tiling_input_elem_t in_tile[(TileHeightMax - 1) * StrideMax + khMax]
+                [(TileWidthMax - 1) * StrideMax + kwMax][InBitChUnroll];
+            for (std::size_t row = 0; row < InTileHeight; ++row) {
+              // in the padded input, which may be padded more at the bottom
+              const auto in_row = row_high * stride_h + row;
+              for (std::size_t col = 0; col < InTileWidth; ++col) {
+                const auto in_col = col_high * stride_w + col;
+                for (std::size_t in_bit_ch = 0; in_bit_ch < InBitChUnroll; ++in_bit_ch) {
+                  if (in_row < pad_top || in_row >= in_height + pad_top
+                      || in_col < pad_left || in_col >= in_width + pad_left) {
+                    in_tile[row][col][in_bit_ch] = tiling_input_elem_t(0);
+                  } else {
+                    const auto index = (in_ch_high / InTypeBitWidth) * in_height * in_width * in_bitwidth
+                      + (in_row - pad_top) * in_width * in_bitwidth
+                      + (in_col - pad_left) * in_bitwidth
+                      + (in_bit_ch_high + in_bit_ch);
+                    in_tile[row][col][in_bit_ch] = input.data()[index];
+                  }
                 }
               }
             }
-          }
-          for (std::size_t row = 0; row < TileHeight; ++row) {
-            for (std::size_t col = 0; col < TileWidth; col += ColUnroll) {
-              auto xnorsum00 = _mm256_setzero_si256();
-              auto xnorsum01 = _mm256_setzero_si256();
-              auto xnorsum10 = _mm256_setzero_si256();
-              auto xnorsum11 = _mm256_setzero_si256();
-              auto xnorsum20 = _mm256_setzero_si256();
-              auto xnorsum21 = _mm256_setzero_si256();
-              for (std::size_t kr = 0; kr < kh; ++kr) {
-                auto in0 = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_tile[row + kr][col + 0][0]));
-                auto in1 = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_tile[row + kr][col + 1][0]));
-                for (std::size_t kc = 0; kc < kw; ++kc) {
-                  const auto nk0 = _mm256_load_si256(reinterpret_cast<__m256i*>(&notk[kr][kc][ 0][0]));
-                  const auto nk1 = _mm256_load_si256(reinterpret_cast<__m256i*>(&notk[kr][kc][ 4][0]));
+            for (std::size_t row = 0; row < TileHeight; ++row) {
+              for (std::size_t col = 0; col < TileWidth; col += ColUnroll) {
+                // notsum is subtracted once, with the first rows
+                for (std::size_t kr_begin = 0; kr_begin < kh; kr_begin += rows_per_sum) {
+                  const std::size_t kr_end = std::min(kr_begin + rows_per_sum, kh);
+                  auto xnorsum00 = _mm256_setzero_si256();
+                  auto xnorsum01 = _mm256_setzero_si256();
+                  auto xnorsum10 = _mm256_setzero_si256();
+                  auto xnorsum11 = _mm256_setzero_si256();
+                  auto xnorsum20 = _mm256_setzero_si256();
+                  auto xnorsum21 = _mm256_setzero_si256();
+                  for (std::size_t kr = kr_begin; kr < kr_end; ++kr) {
+                    const auto in_row = in_tile[row * stride_h + kr];
+                    auto in0 = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_row[(col + 0) * stride_w][0]));
+                    auto in1 = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_row[(col + 1) * stride_w][0]));
+                    for (std::size_t kc = 0; kc < kw; ++kc) {
+                      // with stride 1 the columns of the next tap are the ones after
+                      if (stride_w != 1) {
+                        in0 = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_row[(col + 0) * stride_w + kc][0]));
+                        in1 = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_row[(col + 1) * stride_w + kc][0]));
+                      }
+                      const auto nk0 = _mm256_load_si256(reinterpret_cast<__m256i*>(&notk[kr][kc][ 0][0]));
+                      const auto nk1 = _mm256_load_si256(reinterpret_cast<__m256i*>(&notk[kr][kc][ 4][0]));
 #define BINDP(i, j) \
-  do { \
-    const auto xnor = in##i ^ nk##j; \
-    const auto l4 = mask4 & xnor; \
-    const auto popc_l4 = _mm256_shuffle_epi8(popc_table, l4); \
-    const auto h4 = mask4 & _mm256_srli_epi32(xnor, 4); \
-    const auto popc_h4 = _mm256_shuffle_epi8(popc_table, h4); \
-    const auto cnt = _mm256_add_epi8(popc_l4, popc_h4); \
-    xnorsum##i##j = _mm256_add_epi8(xnorsum##i##j, cnt); \
-  } while(0)
+    do { \
+      const auto xnor = in##i ^ nk##j; \
+      const auto l4 = mask4 & xnor; \
+      const auto popc_l4 = _mm256_shuffle_epi8(popc_table, l4); \
+      const auto h4 = mask4 & _mm256_srli_epi32(xnor, 4); \
+      const auto popc_h4 = _mm256_shuffle_epi8(popc_table, h4); \
+      const auto cnt = _mm256_add_epi8(popc_l4, popc_h4); \
+      xnorsum##i##j = _mm256_add_epi8(xnorsum##i##j, cnt); \
+    } while(0)
 
 #define BINCONV(i) \
-  do { \
-    BINDP(i, 0); \
-    BINDP(i, 1); \
-  } while(0)
-                  BINCONV(0);
-                  BINCONV(1);
-                  const auto in2 = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_tile[row + kr][col + kc + 2][0]));
-                  BINCONV(2);
-                  in0 = in1;
-                  in1 = in2;
+    do { \
+      BINDP(i, 0); \
+      BINDP(i, 1); \
+    } while(0)
+                      BINCONV(0);
+                      BINCONV(1);
+                      const auto in2 = _mm256_set1_epi64x(*reinterpret_cast<uint64_t*>(&in_row[(col + 2) * stride_w + kc][0]));
+                      BINCONV(2);
+                      in0 = in1;
+                      in1 = in2;
+                    }
+                  }
+                  const auto cnt16_00 = _mm256_maddubs_epi16(xnorsum00, vone);
+                  const auto cnt16_01 = _mm256_maddubs_epi16(xnorsum01, vone);
+                  const auto cnt16_10 = _mm256_maddubs_epi16(xnorsum10, vone);
+                  const auto cnt16_11 = _mm256_maddubs_epi16(xnorsum11, vone);
+                  const auto cnt16_20 = _mm256_maddubs_epi16(xnorsum20, vone);
+                  const auto cnt16_21 = _mm256_maddubs_epi16(xnorsum21, vone);
+                  const auto v11 = _mm256_set1_epi16(0x0001);
+                  const auto cnt32_00 = _mm256_madd_epi16(cnt16_00, v11);
+                  const auto cnt32_01 = _mm256_madd_epi16(cnt16_01, v11);
+                  const auto cnt32_10 = _mm256_madd_epi16(cnt16_10, v11);
+                  const auto cnt32_11 = _mm256_madd_epi16(cnt16_11, v11);
+                  const auto cnt32_20 = _mm256_madd_epi16(cnt16_20, v11);
+                  const auto cnt32_21 = _mm256_madd_epi16(cnt16_21, v11);
+                  const auto packed00 = _mm256_packs_epi32(cnt32_00, cnt32_01);
+                  const auto packed01 = _mm256_packs_epi32(cnt32_10, cnt32_11);
+                  const auto packed02 = _mm256_packs_epi32(cnt32_20, cnt32_21);
+                  const auto permed00 = _mm256_permute4x64_epi64(packed00, 0xD8);
+                  const auto permed01 = _mm256_permute4x64_epi64(packed01, 0xD8);
+                  const auto permed02 = _mm256_permute4x64_epi64(packed02, 0xD8);
+                  const auto v12 = _mm256_set1_epi32(0x00020001);
+                  const auto hlpacked0 = _mm256_madd_epi16(permed00, v12);
+                  const auto hlpacked1 = _mm256_madd_epi16(permed01, v12);
+                  const auto hlpacked2 = _mm256_madd_epi16(permed02, v12);
+                  const auto packed10 = _mm256_packs_epi32(hlpacked0, _mm256_setzero_si256());
+                  const auto packed11 = _mm256_packs_epi32(hlpacked1, _mm256_setzero_si256());
+                  const auto packed12 = _mm256_packs_epi32(hlpacked2, _mm256_setzero_si256());
+                  const auto permed10 = _mm256_permute4x64_epi64(packed10, 0xD8);
+                  const auto permed11 = _mm256_permute4x64_epi64(packed11, 0xD8);
+                  const auto permed12 = _mm256_permute4x64_epi64(packed12, 0xD8);
+                  const auto short0 = _mm256_castsi256_si128(permed10);
+                  const auto short1 = _mm256_castsi256_si128(permed11);
+                  const auto short2 = _mm256_castsi256_si128(permed12);
+                  const auto tmp0 = _mm_load_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 0][0]));
+                  const auto tmp1 = _mm_load_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 1][0]));
+                  const auto tmp2 = _mm_load_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 2][0]));
+                  const auto nsum = kr_begin == 0
+                      ? _mm_load_si128(reinterpret_cast<__m128i*>(&notsum[0])) : _mm_setzero_si128();
+                  const auto diff0 = _mm_sub_epi16(short0, nsum);
+                  const auto diff1 = _mm_sub_epi16(short1, nsum);
+                  const auto diff2 = _mm_sub_epi16(short2, nsum);
+                  const auto res0 = _mm_add_epi16(tmp0, diff0);
+                  const auto res1 = _mm_add_epi16(tmp1, diff1);
+                  const auto res2 = _mm_add_epi16(tmp2, diff2);
+                  _mm_store_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 0][0]), res0);
+                  _mm_store_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 1][0]), res1);
+                  _mm_store_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 2][0]), res2);
                 }
               }
-              const auto cnt16_00 = _mm256_maddubs_epi16(xnorsum00, vone);
-              const auto cnt16_01 = _mm256_maddubs_epi16(xnorsum01, vone);
-              const auto cnt16_10 = _mm256_maddubs_epi16(xnorsum10, vone);
-              const auto cnt16_11 = _mm256_maddubs_epi16(xnorsum11, vone);
-              const auto cnt16_20 = _mm256_maddubs_epi16(xnorsum20, vone);
-              const auto cnt16_21 = _mm256_maddubs_epi16(xnorsum21, vone);
-              const auto v11 = _mm256_set1_epi16(0x0001);
-              const auto cnt32_00 = _mm256_madd_epi16(cnt16_00, v11);
-              const auto cnt32_01 = _mm256_madd_epi16(cnt16_01, v11);
-              const auto cnt32_10 = _mm256_madd_epi16(cnt16_10, v11);
-              const auto cnt32_11 = _mm256_madd_epi16(cnt16_11, v11);
-              const auto cnt32_20 = _mm256_madd_epi16(cnt16_20, v11);
-              const auto cnt32_21 = _mm256_madd_epi16(cnt16_21, v11);
-              const auto packed00 = _mm256_packs_epi32(cnt32_00, cnt32_01);
-              const auto packed01 = _mm256_packs_epi32(cnt32_10, cnt32_11);
-              const auto packed02 = _mm256_packs_epi32(cnt32_20, cnt32_21);
-              const auto permed00 = _mm256_permute4x64_epi64(packed00, 0xD8);
-              const auto permed01 = _mm256_permute4x64_epi64(packed01, 0xD8);
-              const auto permed02 = _mm256_permute4x64_epi64(packed02, 0xD8);
-              const auto v12 = _mm256_set1_epi32(0x00020001);
-              const auto hlpacked0 = _mm256_madd_epi16(permed00, v12);
-              const auto hlpacked1 = _mm256_madd_epi16(permed01, v12);
-              const auto hlpacked2 = _mm256_madd_epi16(permed02, v12);
-              const auto packed10 = _mm256_packs_epi32(hlpacked0, _mm256_setzero_si256());
-              const auto packed11 = _mm256_packs_epi32(hlpacked1, _mm256_setzero_si256());
-              const auto packed12 = _mm256_packs_epi32(hlpacked2, _mm256_setzero_si256());
-              const auto permed10 = _mm256_permute4x64_epi64(packed10, 0xD8);
-              const auto permed11 = _mm256_permute4x64_epi64(packed11, 0xD8);
-              const auto permed12 = _mm256_permute4x64_epi64(packed12, 0xD8);
-              const auto short0 = _mm256_castsi256_si128(permed10);
-              const auto short1 = _mm256_castsi256_si128(permed11);
-              const auto short2 = _mm256_castsi256_si128(permed12);
-              const auto tmp0 = _mm_load_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 0][0]));
-              const auto tmp1 = _mm_load_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 1][0]));
-              const auto tmp2 = _mm_load_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 2][0]));
-              const auto nsum = _mm_load_si128(reinterpret_cast<__m128i*>(&notsum[0]));
-              const auto diff0 = _mm_sub_epi16(short0, nsum);
-              const auto diff1 = _mm_sub_epi16(short1, nsum);
-              const auto diff2 = _mm_sub_epi16(short2, nsum);
-              const auto res0 = _mm_add_epi16(tmp0, diff0);
-              const auto res1 = _mm_add_epi16(tmp1, diff1);
-              const auto res2 = _mm_add_epi16(tmp2, diff2);
-              _mm_store_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 0][0]), res0);
-              _mm_store_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 1][0]), res1);
-              _mm_store_si128(reinterpret_cast<__m128i*>(&out_tile[row][col + 2][0]), res2);
             }
           }
         }
-      }
-      if (p.thresholds != nullptr) {
-        const auto th0 = _mm_loadu_si128(reinterpret_cast<__m128i*>(buf_th0.get() + out_ch_high * OutChUnroll));
-        const auto th1 = _mm_loadu_si128(reinterpret_cast<__m128i*>(buf_th1.get() + out_ch_high * OutChUnroll));
-        const auto th2 = _mm_loadu_si128(reinterpret_cast<__m128i*>(buf_th2.get() + out_ch_high * OutChUnroll));
-        const auto flg = _mm_loadu_si128(reinterpret_cast<__m128i*>(buf_flg.get() + out_ch_high * OutChUnroll));
-        const auto is_neg = _mm_cmpgt_epi16(_mm_setzero_si128(), flg);
-        const auto m2 = _mm_sub_epi16(flg, _mm_set1_epi16(2));
-        const auto is_not_const = _mm_cmpgt_epi16(_mm_setzero_si128(), m2);
-        for (std::size_t row = 0; row < TileHeight; ++row) {
-          if (row_high + row >= out_height) break;
-          for (std::size_t col = 0; col < TileWidth; ++col) {
-            if (col_high + col >= out_width) break;
-            const auto vec = _mm_loadu_si128(reinterpret_cast<__m128i*>(&out_tile[row][col][0]));
-            const auto f0 = _mm_andnot_si128(_mm_cmpgt_epi16(th0, vec), flg);
-            const auto f1 = _mm_andnot_si128(_mm_cmpgt_epi16(th1, vec), flg);
-            const auto f2 = _mm_andnot_si128(_mm_cmpgt_epi16(th2, vec), flg);
-            const auto tmp = _mm_add_epi16(_mm_add_epi16(f0, f1), _mm_add_epi16(f2, is_neg));
-            const auto res = _mm_blendv_epi8(m2, tmp, is_not_const);
-            const auto pres = _mm_packs_epi16(res, _mm_setzero_si128());
-            const auto vlsb = _mm_slli_epi32(pres, 7);
-            const auto vmsb = _mm_slli_epi32(pres, 6);
-            const auto lsb = _mm_movemask_epi8(vlsb);
-            const auto msb = _mm_movemask_epi8(vmsb);
-            const auto Ohh = out_ch_high / OutChBlocks;
-            const auto Om = out_ch_high % OutChBlocks;
-            const auto index = Ohh * out_height * out_width * 2 * OutChBlocks
-                + (row_high + row) * out_width * 2 * OutChBlocks
-                + (col_high + col) * 2 * OutChBlocks
-                + Om;
-            reinterpret_cast<uint8_t*>(p.device_output_buf)[index + 0] = lsb;
-            reinterpret_cast<uint8_t*>(p.device_output_buf)[index + OutChBlocks] = msb;
+        if (p.thresholds != nullptr) {
+          const auto th0 = _mm_loadu_si128(reinterpret_cast<__m128i*>(buf_th0 + out_ch_high * OutChUnroll));
+          const auto th1 = _mm_loadu_si128(reinterpret_cast<__m128i*>(buf_th1 + out_ch_high * OutChUnroll));
+          const auto th2 = _mm_loadu_si128(reinterpret_cast<__m128i*>(buf_th2 + out_ch_high * OutChUnroll));
+          const auto flg = _mm_loadu_si128(reinterpret_cast<__m128i*>(buf_flg + out_ch_high * OutChUnroll));
+          const auto is_neg = _mm_cmpgt_epi16(_mm_setzero_si128(), flg);
+          const auto m2 = _mm_sub_epi16(flg, _mm_set1_epi16(2));
+          const auto is_not_const = _mm_cmpgt_epi16(_mm_setzero_si128(), m2);
+          for (std::size_t row = 0; row < TileHeight; ++row) {
+            if (row_high + row >= out_height) break;
+            for (std::size_t col = 0; col < TileWidth; ++col) {
+              if (col_high + col >= out_width) break;
+              const auto vec = _mm_loadu_si128(reinterpret_cast<__m128i*>(&out_tile[row][col][0]));
+              const auto f0 = _mm_andnot_si128(_mm_cmpgt_epi16(th0, vec), flg);
+              const auto f1 = _mm_andnot_si128(_mm_cmpgt_epi16(th1, vec), flg);
+              const auto f2 = _mm_andnot_si128(_mm_cmpgt_epi16(th2, vec), flg);
+              const auto tmp = _mm_add_epi16(_mm_add_epi16(f0, f1), _mm_add_epi16(f2, is_neg));
+              const auto res = _mm_blendv_epi8(m2, tmp, is_not_const);
+              const auto pres = _mm_packs_epi16(res, _mm_setzero_si128());
+              const auto vlsb = _mm_slli_epi32(pres, 7);
+              const auto vmsb = _mm_slli_epi32(pres, 6);
+              const auto lsb = _mm_movemask_epi8(vlsb);
+              const auto msb = _mm_movemask_epi8(vmsb);
+              const auto Ohh = out_ch_high / OutChBlocks;
+              const auto Om = out_ch_high % OutChBlocks;
+              const auto index = Ohh * out_height * out_width * 2 * OutChBlocks
+                  + (row_high + row) * out_width * 2 * OutChBlocks
+                  + (col_high + col) * 2 * OutChBlocks
+                  + Om;
+              reinterpret_cast<uint8_t*>(p.device_output_buf)[index + 0] = lsb;
+              reinterpret_cast<uint8_t*>(p.device_output_buf)[index + OutChBlocks] = msb;
+            }
           }
-        }
-      } else {
-        for (std::size_t row = 0; row < TileHeight; ++row) {
-          if (row_high + row >= out_height) break;
-          for (std::size_t col = 0; col < TileWidth; ++col) {
-            if (col_high + col >= out_width) break;
-            const auto vec = _mm_load_si128(reinterpret_cast<__m128i*>(&out_tile[row][col][0]));
-            const auto Ohh = out_ch_high / OutChBlocks;
-            const auto Om = out_ch_high % OutChBlocks;
-            const auto index = Ohh * out_height * out_width * OutChUnroll2
-                + (row_high + row) * out_width * OutChUnroll2
-                + (col_high + col) * OutChUnroll2
-                + Om * OutChUnroll;
-            _mm_storeu_si128(reinterpret_cast<__m128i*>(p.device_output_buf + index), vec);
+        } else {
+          for (std::size_t row = 0; row < TileHeight; ++row) {
+            if (row_high + row >= out_height) break;
+            for (std::size_t col = 0; col < TileWidth; ++col) {
+              if (col_high + col >= out_width) break;
+              const auto vec = _mm_load_si128(reinterpret_cast<__m128i*>(&out_tile[row][col][0]));
+              const auto Ohh = out_ch_high / OutChBlocks;
+              const auto Om = out_ch_high % OutChBlocks;
+              const auto index = Ohh * out_height * out_width * OutChUnroll2
+                  + (row_high + row) * out_width * OutChUnroll2
+                  + (col_high + col) * OutChUnroll2
+                  + Om * OutChUnroll;
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(p.device_output_buf + index), vec);
+            }
           }
         }
       }
-    }
+    });
   }
   Measurement::Stop();
 }
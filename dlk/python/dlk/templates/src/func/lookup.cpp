@@ -14,33 +14,149 @@ limitations under the License.
 ==============================================================================*/
 
 #include "global.h"
+#include "cpu_features.h"
 #include "func/lookup.h"
+#include "kernel_table.h"
+#include "thread_pool.h"
 #include "time_measurement.h"
-#ifdef USE_AVX
+#ifdef DLK_X86
 #include <x86intrin.h>
 #endif
 
+namespace {
+
+inline void lookup_pixel(int r, int g, int b,
+    const QUANTIZED_PACKED_KERNEL *lsb_ptr, const QUANTIZED_PACKED_KERNEL *msb_ptr,
+    QUANTIZED_PACKED *out_ptr) {
+  auto r_lsb = lsb_ptr[r];
+  auto g_lsb = lsb_ptr[g];
+  auto b_lsb = lsb_ptr[b];
+  auto r_msb = msb_ptr[r];
+  auto g_msb = msb_ptr[g];
+  auto b_msb = msb_ptr[b];
+
+  out_ptr[0] = QUANTIZED_PACKED((b_lsb.Raw() << 20) | (g_lsb.Raw() << 10) | r_lsb.Raw());
+  out_ptr[1] = QUANTIZED_PACKED((b_msb.Raw() << 20) | (g_msb.Raw() << 10) | r_msb.Raw());
+}
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+constexpr std::size_t lookup_table_size = 256;
+
+// copies a packed lookup table into plain words the gather instructions can index
+inline void load_lookup_table(const QUANTIZED_PACKED_KERNEL *table_ptr, int32_t *words) {
+  for (std::size_t i = 0; i < lookup_table_size; ++i) {
+    words[i] = static_cast<int32_t>(table_ptr[i].Raw());
+  }
+}
+
+// looks up 8 pixels whose channel values are in r, g and b
+inline void lookup_8_pixels_avx2(__m256i r, __m256i g, __m256i b,
+    const int32_t *lsb_words, const int32_t *msb_words,
+    QUANTIZED_PACKED *out_ptr) {
+  const auto lr = _mm256_i32gather_epi32(lsb_words, r, 4);
+  const auto lg = _mm256_i32gather_epi32(lsb_words, g, 4);
+  const auto lb = _mm256_i32gather_epi32(lsb_words, b, 4);
+  const auto mr = _mm256_i32gather_epi32(msb_words, r, 4);
+  const auto mg = _mm256_i32gather_epi32(msb_words, g, 4);
+  const auto mb = _mm256_i32gather_epi32(msb_words, b, 4);
+  const auto shifted_lg = _mm256_slli_epi32(lg, 10);
+  const auto shifted_lb = _mm256_slli_epi32(lb, 20);
+  const auto l = lr | shifted_lg | shifted_lb;
+  const auto shifted_mg = _mm256_slli_epi32(mg, 10);
+  const auto shifted_mb = _mm256_slli_epi32(mb, 20);
+  const auto m = mr | shifted_mg | shifted_mb;
+  const auto lo0 = _mm256_unpacklo_epi32(l, m);
+  const auto hi0 = _mm256_unpackhi_epi32(l, m);
+  const auto lo1 = _mm256_permute2x128_si256(lo0, hi0, 0x20);
+  const auto hi1 = _mm256_permute2x128_si256(lo0, hi0, 0x31);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_ptr + 0), lo1);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_ptr + 8), hi1);
+}
+
+DLK_TARGET_END
+#endif
+
+} // namespace
+
 void func_Lookup(const TensorView<float, MemoryLayout::NHWC>& input,
     const TensorView<QUANTIZED_PACKED_KERNEL, MemoryLayout::TC>& lsb,
     const TensorView<QUANTIZED_PACKED_KERNEL, MemoryLayout::TC>& msb,
-    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output) {
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output,
+    ThreadPool& thread_pool) {
   const auto in_shape = input.get_shape();
   const auto h = in_shape[1];
   const auto w = in_shape[2];
-  const auto c = in_shape[3];
 
-  int b = 32;
-  int packed_depth = 2;
   Measurement::Start("Lookup");
 
-  const float * in_ptr = input.data();
-  const QUANTIZED_PACKED_KERNEL * lsb_ptr = lsb.data();
-  const QUANTIZED_PACKED_KERNEL * msb_ptr = msb.data();
-  QUANTIZED_PACKED * out_ptr = output.data();
-#ifdef USE_AVX
-  const auto count = h * w;
+  const auto lookup = dlk::kernels().lookup;
+  const std::size_t pixels = h * w;
+  const std::size_t chunk_size = (pixels + thread_pool.num_threads() - 1) / thread_pool.num_threads();
+  thread_pool.parallel_for(0, pixels, chunk_size, [&](std::size_t first, std::size_t last) {
+    lookup(input.data() + first * 3, last - first, lsb.data(), msb.data(), output.data() + first * 2);
+  });
+
+  Measurement::Stop();
+}
+
+void func_Lookup(const TensorView<uint8_t, MemoryLayout::NHWC>& input,
+    const TensorView<QUANTIZED_PACKED_KERNEL, MemoryLayout::TC>& lsb,
+    const TensorView<QUANTIZED_PACKED_KERNEL, MemoryLayout::TC>& msb,
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output,
+    ThreadPool& thread_pool) {
+  const auto in_shape = input.get_shape();
+  const auto h = in_shape[1];
+  const auto w = in_shape[2];
+
+  Measurement::Start("Lookup");
+
+  const auto lookup_u8 = dlk::kernels().lookup_u8;
+  const std::size_t pixels = h * w;
+  const std::size_t chunk_size = (pixels + thread_pool.num_threads() - 1) / thread_pool.num_threads();
+  thread_pool.parallel_for(0, pixels, chunk_size, [&](std::size_t first, std::size_t last) {
+    lookup_u8(input.data() + first * 3, last - first, lsb.data(), msb.data(), output.data() + first * 2);
+  });
+
+  Measurement::Stop();
+}
+
+void lookup_pixels(const float *in_ptr, std::size_t pixels,
+    const QUANTIZED_PACKED_KERNEL *lsb_ptr, const QUANTIZED_PACKED_KERNEL *msb_ptr,
+    QUANTIZED_PACKED *out_ptr) {
+  int len = pixels;
+  for(int i = 0; i < len; i++) {
+    int r = int(in_ptr[i * 3 + 0] * 255.0f);
+    int g = int(in_ptr[i * 3 + 1] * 255.0f);
+    int b = int(in_ptr[i * 3 + 2] * 255.0f);
+
+    lookup_pixel(r, g, b, lsb_ptr, msb_ptr, out_ptr + i * 2);
+  }
+}
+
+void lookup_pixels_u8(const uint8_t *in_ptr, std::size_t pixels,
+    const QUANTIZED_PACKED_KERNEL *lsb_ptr, const QUANTIZED_PACKED_KERNEL *msb_ptr,
+    QUANTIZED_PACKED *out_ptr) {
+  int len = pixels;
+  for(int i = 0; i < len; i++) {
+    lookup_pixel(in_ptr[i * 3 + 0], in_ptr[i * 3 + 1], in_ptr[i * 3 + 2], lsb_ptr, msb_ptr, out_ptr + i * 2);
+  }
+}
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+void lookup_pixels_avx2(const float *in_ptr, std::size_t pixels,
+    const QUANTIZED_PACKED_KERNEL *lsb_ptr, const QUANTIZED_PACKED_KERNEL *msb_ptr,
+    QUANTIZED_PACKED *out_ptr) {
+  const auto count = pixels;
   const auto count_floor = count - (count % 8);
   const auto coeff = _mm256_set1_ps(255.0f);
+  int32_t lsb_words[lookup_table_size];
+  int32_t msb_words[lookup_table_size];
+  load_lookup_table(lsb_ptr, lsb_words);
+  load_lookup_table(msb_ptr, msb_words);
   for (std::size_t i = 0; i < count_floor; i += 8) {
     const auto vl0 = _mm256_castps128_ps256(_mm_loadu_ps(in_ptr + 3 * i +  0));
     const auto vl1 = _mm256_castps128_ps256(_mm_loadu_ps(in_ptr + 3 * i +  4));
@@ -56,65 +172,52 @@ void func_Lookup(const TensorView<float, MemoryLayout::NHWC>& input,
     const auto r = _mm256_shuffle_ps(v0, tmp0, _MM_SHUFFLE(2, 0, 3, 0));
     const auto g = _mm256_shuffle_ps(tmp1, tmp0, _MM_SHUFFLE(3, 1, 2, 0));
     const auto b = _mm256_shuffle_ps(tmp1, v2, _MM_SHUFFLE(3, 0, 3, 1));
-    const auto ri = _mm256_cvtps_epi32(_mm256_mul_ps(r, coeff));
-    const auto gi = _mm256_cvtps_epi32(_mm256_mul_ps(g, coeff));
-    const auto bi = _mm256_cvtps_epi32(_mm256_mul_ps(b, coeff));
-    const auto lr = _mm256_i32gather_epi32(reinterpret_cast<const int32_t*>(lsb_ptr), ri, 4);
-    const auto lg = _mm256_i32gather_epi32(reinterpret_cast<const int32_t*>(lsb_ptr), gi, 4);
-    const auto lb = _mm256_i32gather_epi32(reinterpret_cast<const int32_t*>(lsb_ptr), bi, 4);
-    const auto mr = _mm256_i32gather_epi32(reinterpret_cast<const int32_t*>(msb_ptr), ri, 4);
-    const auto mg = _mm256_i32gather_epi32(reinterpret_cast<const int32_t*>(msb_ptr), gi, 4);
-    const auto mb = _mm256_i32gather_epi32(reinterpret_cast<const int32_t*>(msb_ptr), bi, 4);
-    const auto shifted_lg = _mm256_slli_epi32(lg, 10);
-    const auto shifted_lb = _mm256_slli_epi32(lb, 20);
-    const auto l = lr | shifted_lg | shifted_lb;
-    const auto shifted_mg = _mm256_slli_epi32(mg, 10);
-    const auto shifted_mb = _mm256_slli_epi32(mb, 20);
-    const auto m = mr | shifted_mg | shifted_mb;
-    const auto lo0 = _mm256_unpacklo_epi32(l, m);
-    const auto hi0 = _mm256_unpackhi_epi32(l, m);
-    const auto lo1 = _mm256_permute2x128_si256(lo0, hi0, 0x20);
-    const auto hi1 = _mm256_permute2x128_si256(lo0, hi0, 0x31);
-    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_ptr + 2 * i + 0), lo1);
-    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_ptr + 2 * i + 8), hi1);
+    const auto ri = _mm256_cvttps_epi32(_mm256_mul_ps(r, coeff));
+    const auto gi = _mm256_cvttps_epi32(_mm256_mul_ps(g, coeff));
+    const auto bi = _mm256_cvttps_epi32(_mm256_mul_ps(b, coeff));
+    lookup_8_pixels_avx2(ri, gi, bi, lsb_words, msb_words, out_ptr + 2 * i);
   }
   in_ptr += count_floor * 3;
   out_ptr += count_floor * 2;
   for (std::size_t i = count_floor; i < count; ++i) {
-    int r = int(*in_ptr++ * 255.0);
-    int g = int(*in_ptr++ * 255.0);
-    int b = int(*in_ptr++ * 255.0);
-
-    auto r_lsb = lsb_ptr[r];
-    auto g_lsb = lsb_ptr[g];
-    auto b_lsb = lsb_ptr[b];
-    auto r_msb = msb_ptr[r];
-    auto g_msb = msb_ptr[g];
-    auto b_msb = msb_ptr[b];
-
-    *out_ptr++ = QUANTIZED_PACKED((b_lsb.Raw() << 20) | (g_lsb.Raw() << 10) | r_lsb.Raw());
-    *out_ptr++ = QUANTIZED_PACKED((b_msb.Raw() << 20) | (g_msb.Raw() << 10) | r_msb.Raw());
-  }
-#else
-  int len = h * w;
-#pragma omp parallel for
-  for(int i = 0; i < len; i++) {
-    int r = int(in_ptr[i * 3 + 0] * 255.0f);
-    int g = int(in_ptr[i * 3 + 1] * 255.0f);
-    int b = int(in_ptr[i * 3 + 2] * 255.0f);
+    int r = int(*in_ptr++ * 255.0f);
+    int g = int(*in_ptr++ * 255.0f);
+    int b = int(*in_ptr++ * 255.0f);
 
-    auto r_lsb = lsb_ptr[r];
-    auto g_lsb = lsb_ptr[g];
-    auto b_lsb = lsb_ptr[b];
-    auto r_msb = msb_ptr[r];
-    auto g_msb = msb_ptr[g];
-    auto b_msb = msb_ptr[b];
-
-    out_ptr[i * 2 + 0] = QUANTIZED_PACKED((b_lsb.Raw() << 20) | (g_lsb.Raw() << 10) | r_lsb.Raw());
-    out_ptr[i * 2 + 1] = QUANTIZED_PACKED((b_msb.Raw() << 20) | (g_msb.Raw() << 10) | r_msb.Raw());
+    lookup_pixel(r, g, b, lsb_ptr, msb_ptr, out_ptr);
+    out_ptr += 2;
   }
-#endif
+}
 
-  Measurement::Stop();
+void lookup_pixels_u8_avx2(const uint8_t *in_ptr, std::size_t pixels,
+    const QUANTIZED_PACKED_KERNEL *lsb_ptr, const QUANTIZED_PACKED_KERNEL *msb_ptr,
+    QUANTIZED_PACKED *out_ptr) {
+  const auto count = pixels;
+  const auto count_floor = count - (count % 8);
+  int32_t lsb_words[lookup_table_size];
+  int32_t msb_words[lookup_table_size];
+  load_lookup_table(lsb_ptr, lsb_words);
+  load_lookup_table(msb_ptr, msb_words);
+  // gather the r, g and b bytes of 8 pixels from 16 + 8 input bytes
+  const auto r_lo = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const auto r_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1);
+  const auto g_lo = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const auto g_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+  const auto b_lo = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const auto b_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+  for (std::size_t i = 0; i < count_floor; i += 8) {
+    const auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_ptr + 3 * i));
+    const auto hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in_ptr + 3 * i + 16));
+    const auto r = _mm_shuffle_epi8(lo, r_lo) | _mm_shuffle_epi8(hi, r_hi);
+    const auto g = _mm_shuffle_epi8(lo, g_lo) | _mm_shuffle_epi8(hi, g_hi);
+    const auto b = _mm_shuffle_epi8(lo, b_lo) | _mm_shuffle_epi8(hi, b_hi);
+    lookup_8_pixels_avx2(_mm256_cvtepu8_epi32(r), _mm256_cvtepu8_epi32(g), _mm256_cvtepu8_epi32(b),
+        lsb_words, msb_words, out_ptr + 2 * i);
+  }
+  for (std::size_t i = count_floor; i < count; ++i) {
+    lookup_pixel(in_ptr[i * 3 + 0], in_ptr[i * 3 + 1], in_ptr[i * 3 + 2], lsb_ptr, msb_ptr, out_ptr + i * 2);
+  }
 }
 
+DLK_TARGET_END
+#endif
@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+
 #include "global.h"
 #include "func/matmul.h"
 #include "time_measurement.h"
@@ -26,6 +28,9 @@ void func_Matmul(const TensorView<T_FLOAT, MemoryLayout::NC>& input,
   T_UINT in_size = input.size();
   T_UINT out_depth = output.size();
 
+  // the output buffer may hold data of another layer, so clear it before accumulating
+  std::fill(output.data(), output.data() + out_depth, 0.0f);
+
   T_UINT index = 0;
   for (T_UINT d = 0; d < in_size; d++){
     for (T_UINT kz = 0; kz < out_depth; kz++){
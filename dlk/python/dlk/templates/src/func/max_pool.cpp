@@ -12,53 +12,97 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include "global.h"
 #include "func/max_pool.h"
+#include "func/impl/pooling.h"
+#include "kernel_table.h"
 #include "time_measurement.h"
 
 namespace {
 
-template<typename TYPE>
+// max_row(input, acc, n) takes the max of one more tap into acc
+template<typename TYPE, typename MaxRow>
 void max_pooling(
     const TensorView<TYPE, MemoryLayout::NHWC>& input,
     const TensorView<TYPE, MemoryLayout::NHWC>& output,
-    struct max_pooling_parameters p)
+    struct max_pooling_parameters p,
+    MaxRow max_row)
 {
 
   assert (p.kernel_depth == 1 && "kernel depth 1 is not supported.");
   assert (p.input_depth == p.kernel_depth * p.output_channels && \
           "input_depth must equal kernel_depth * output_channels.");
 
-  int idx_out = 0;
-  const T_FLOAT num_k_elems = p.kernel_height * p.kernel_width * p.kernel_depth;
-
-  std::memset(output.data(), 0, output.size() * sizeof(TYPE));
-
-  for(T_UINT oc = 0; oc < p.output_channels; oc++) {
-    for(T_UINT wi = 0; wi < p.output_height; wi++) {
-      for(T_UINT wj = 0; wj < p.output_width; wj++){
-        TYPE out = 0;
-        for(T_UINT ki = 0; ki < p.kernel_height; ki++) {
-          for(T_UINT kj = 0; kj < p.kernel_width; kj++) {
-	          T_INT row = (wi * p.stride) - p.padding + ki;
-	          T_INT col = (wj * p.stride) - p.padding + kj;
-	          T_INT inside = (row >= 0 && col >= 0 && row < (T_INT) p.input_height && col < (T_INT)p.input_width);
-	          if (!inside) continue;
-              for(T_UINT kz = 0; kz < p.kernel_depth; kz++) {
-                if(ki == 0 && kj == 0){
-                  out = input(0, row, col, oc * p.kernel_depth + kz);
-                }else if (input(0, row, col, oc * p.kernel_depth + kz) > out){
-                  out = input(0, row, col, oc * p.kernel_depth + kz);
-                }
-              }
-          }
+  const T_UINT channels = p.output_channels;
+
+  // channels are innermost, so every tap is a contiguous row of them
+  dlk::impl::for_each_pooling_window(p, [&](T_UINT wi, T_UINT wj,
+      T_UINT row_begin, T_UINT row_end, T_UINT col_begin, T_UINT col_end) {
+    TYPE *out = output.data() + (wi * p.output_width + wj) * channels;
+    if (row_begin == row_end || col_begin == col_end) {
+      std::fill(out, out + channels, TYPE(0));
+      return;
+    }
+    const TYPE *first = input.data() + (row_begin * p.input_width + col_begin) * channels;
+    std::copy(first, first + channels, out);
+    for (T_UINT row = row_begin; row < row_end; ++row) {
+      for (T_UINT col = row == row_begin ? col_begin + 1 : col_begin; col < col_end; ++col) {
+        max_row(input.data() + (row * p.input_width + col) * channels, out, channels);
+      }
+    }
+  });
+}
+
+// max pooling of 2 bit activations on their packed lsb and msb words. Every
+// block of 32 channels of a pixel is a word pair; the pairs of a pixel are
+// consecutive in HWChBCl and a plane of pixels apart in ChHWBCl.
+template<MemoryLayout layout>
+void packed_max_pooling(
+    const TensorView<QUANTIZED_PACKED, layout>& input,
+    const TensorView<QUANTIZED_PACKED, layout>& output,
+    struct max_pooling_parameters p)
+{
+  constexpr bool blocks_inner = layout == MemoryLayout::HWChBCl;
+  constexpr std::size_t bits = 2;
+  assert (input.get_shape()[3] == bits && "only 2 bit activations are supported.");
+
+  const std::size_t blocks = input.get_shape()[blocks_inner ? 2 : 0];
+  const std::size_t in_plane = p.input_height * p.input_width * bits;
+  const std::size_t out_plane = p.output_height * p.output_width * bits;
+  const auto max_pool_2bit = dlk::kernels().max_pool_2bit;
+
+  // the activations are not negative, so the windows start from zero
+  dlk::impl::for_each_pooling_window(p, [&](T_UINT wi, T_UINT wj,
+      T_UINT row_begin, T_UINT row_end, T_UINT col_begin, T_UINT col_end) {
+    const std::size_t out_pixel = wi * p.output_width + wj;
+    if (blocks_inner) {
+      QUANTIZED_PACKED *out = output.data() + out_pixel * blocks * bits;
+      std::fill(out, out + blocks * bits, QUANTIZED_PACKED(0));
+      for (T_UINT row = row_begin; row < row_end; ++row) {
+        for (T_UINT col = col_begin; col < col_end; ++col) {
+          max_pool_2bit(input.data() + (row * p.input_width + col) * blocks * bits, out, blocks);
+        }
+      }
+      return;
+    }
+    for (std::size_t block = 0; block < blocks; ++block) {
+      const QUANTIZED_PACKED *in = input.data() + block * in_plane;
+      uint32_t lsb = 0;
+      uint32_t msb = 0;
+      for (T_UINT row = row_begin; row < row_end; ++row) {
+        for (T_UINT col = col_begin; col < col_end; ++col) {
+          const std::size_t in_index = (row * p.input_width + col) * bits;
+          dlk::impl::max_2bit(lsb, msb, in[in_index].Raw(), in[in_index + 1].Raw());
         }
-        output(0, wi, wj, oc) += TYPE(out);
       }
+      QUANTIZED_PACKED *out = output.data() + block * out_plane + out_pixel * bits;
+      out[0] = QUANTIZED_PACKED(lsb);
+      out[1] = QUANTIZED_PACKED(msb);
     }
-  }
+  });
 }
 
 template<typename TYPE>
@@ -105,7 +149,7 @@ void func_MaxPool(const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
     struct max_pooling_parameters mpp) {
   Measurement::Start("MaxPooling");
 
-  max_pooling(input, output, mpp);
+  max_pooling(input, output, mpp, dlk::kernels().max_pool_row);
 
   Measurement::Stop();
 }
@@ -115,7 +159,31 @@ void func_MaxPool(const TensorView<QUANTIZED_NOT_PACKED, MemoryLayout::NHWC>& in
     struct max_pooling_parameters mpp) {
   Measurement::Start("MaxPooling");
 
-  max_pooling(input, output, mpp);
+  max_pooling(input, output, mpp,
+      [](const QUANTIZED_NOT_PACKED *in, QUANTIZED_NOT_PACKED *acc, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+      acc[i] = std::max(acc[i], in[i]);
+  });
+
+  Measurement::Stop();
+}
+
+void func_MaxPool(const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& input,
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& output,
+    struct max_pooling_parameters mpp) {
+  Measurement::Start("MaxPooling");
+
+  packed_max_pooling(input, output, mpp);
+
+  Measurement::Stop();
+}
+
+void func_MaxPool(const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& input,
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::ChHWBCl>& output,
+    struct max_pooling_parameters mpp) {
+  Measurement::Start("MaxPooling");
+
+  packed_max_pooling(input, output, mpp);
 
   Measurement::Stop();
 }
@@ -0,0 +1,89 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "kernel_table.h"
+#include "cpu_features.h"
+#include "func/impl/apply_thresholds.h"
+#include "func/impl/conv2d_direct.h"
+#include "func/impl/pooling.h"
+#include "func/impl/quantized_conv2d_epilogue.h"
+#include "func/impl/quantized_conv2d_kn2row.h"
+#include "func/lookup.h"
+#include "matrix/multiplication.h"
+#include "pack_input_to_qwords.h"
+#include "quantizer.h"
+
+namespace dlk {
+
+namespace {
+
+KernelTable bind(const CpuFeatures& cpu) {
+  KernelTable t;
+  t.quantize_linear = func_QTZ_linear_mid_tread_half_body;
+  t.pack_input_2bit = nullptr;
+  t.lookup = lookup_pixels;
+  t.lookup_u8 = lookup_pixels_u8;
+  t.matrix_multiplication = nullptr;
+  t.conv2d_direct_row = impl::conv2d_direct_row;
+  t.xor_pop_count = nullptr;
+  t.conv_epilogue = impl::conv_epilogue_block;
+  t.apply_thresholds_pack = impl::apply_thresholds_pack_block;
+  t.max_pool_row = impl::max_pool_row;
+  t.average_pool_row = impl::average_pool_row;
+  t.max_pool_2bit = impl::max_pool_2bit;
+  (void)cpu;
+
+#ifdef USE_NEON
+  t.pack_input_2bit = pack_input_2bit_neon;
+  t.matrix_multiplication = details::matrix_multiplication_impl;
+  t.conv2d_direct_row = impl::conv2d_direct_row_neon;
+  t.conv_epilogue = impl::conv_epilogue_block_neon;
+  t.max_pool_row = impl::max_pool_row_neon;
+  t.average_pool_row = impl::average_pool_row_neon;
+  t.max_pool_2bit = impl::max_pool_2bit_neon;
+#endif
+
+#ifdef DLK_X86
+  if (cpu.avx2 && cpu.fma && cpu.popcnt) {
+    t.quantize_linear = func_QTZ_linear_mid_tread_half_body_avx2;
+    t.pack_input_2bit = pack_input_2bit_avx2;
+    t.lookup = lookup_pixels_avx2;
+    t.lookup_u8 = lookup_pixels_u8_avx2;
+    t.matrix_multiplication = details::matrix_multiplication_avx2;
+    t.conv2d_direct_row = impl::conv2d_direct_row_avx2;
+    t.conv_epilogue = impl::conv_epilogue_block_avx2;
+    t.apply_thresholds_pack = impl::apply_thresholds_pack_block_avx2;
+    t.max_pool_row = impl::max_pool_row_avx2;
+    t.average_pool_row = impl::average_pool_row_avx2;
+    t.max_pool_2bit = impl::max_pool_2bit_avx2;
+#ifndef RUN_ON_FPGA
+    t.xor_pop_count = impl::xor_pop_count_avx2;
+    if (cpu.avx512vl && cpu.avx512vpopcntdq)
+      t.xor_pop_count = impl::xor_pop_count_vpopcnt;
+#endif
+  }
+#endif
+
+  return t;
+}
+
+} // namespace
+
+const KernelTable& kernels() {
+  static const KernelTable table = bind(cpu_features());
+  return table;
+}
+
+} // namespace dlk
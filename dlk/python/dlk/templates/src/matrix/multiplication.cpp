@@ -14,14 +14,17 @@ limitations under the License.
 ==============================================================================*/
 
 #include "matrix/multiplication.h"
+#include <algorithm>
+#include <cassert>
 #include <memory>
 #include "global.h"
-#include "matrix/row_major_to_col_major.h"
-#include "matrix/col_major_to_row_major.h"
+#include "cpu_features.h"
+#include "thread_pool.h"
+#include "workspace.h"
 
 #ifdef USE_NEON
   #include <arm_neon.h>
-#elif defined USE_AVX
+#elif defined DLK_X86
   #include <x86intrin.h>
 #endif
 
@@ -29,58 +32,46 @@ namespace dlk {
 
 namespace details {
 
-constexpr std::size_t ceil_mod(const std::size_t n, const std::size_t mod) {
-  return n + (mod - n%mod) % mod;
-}
-
-static constexpr std::size_t align_margin = 32 / sizeof(float);
-static constexpr std::size_t KMAX = 3;
-static constexpr std::size_t B_buf_size = MAX_IN_C * ceil_mod(MAX_IN_C * KMAX * KMAX, 8) + align_margin;
-static const auto B_buf = std::make_unique<float[]>(B_buf_size);
-
 void matrix_multiplication_col3(
   MatrixView<float, MatrixOrder::RowMajor>& A,
   MatrixView<float, MatrixOrder::ColMajor>& B,
   MatrixView<float, MatrixOrder::ColMajor>& C) {
 #ifdef USE_NEON
-  auto A_colm = row_major_to_col_major(A);
+  assert(A.rows() % 4 == 0);
   for (std::size_t i = 0; i < B.cols(); ++i) {
     float32x4_t rhs0 = vdupq_n_f32((float)(*B.data(0, i)));
     float32x4_t rhs1 = vdupq_n_f32((float)(*B.data(1, i)));
     float32x4_t rhs2 = vdupq_n_f32((float)(*B.data(2, i)));
 
-    assert(A.rows() % 4 == 0);
     for (std::size_t j = 0; j + 3 < A.rows(); j += 4) {
-      float32x4_t lhs0 = vld1q_f32(A_colm.data(j, 0));
-      float32x4_t lhs1 = vld1q_f32(A_colm.data(j, 1));
-      float32x4_t lhs2 = vld1q_f32(A_colm.data(j, 2));
+      // 4 rows of 3 columns are contiguous, vld3q_f32 splits them into columns
+      const float32x4x3_t lhs = vld3q_f32(A.data(j, 0));
 
       float32x4_t r;
-      r = vmulq_f32(lhs0, rhs0);
-      r = vmlaq_f32(r, lhs1, rhs1);
-      r = vmlaq_f32(r, lhs2, rhs2);
+      r = vmulq_f32(lhs.val[0], rhs0);
+      r = vmlaq_f32(r, lhs.val[1], rhs1);
+      r = vmlaq_f32(r, lhs.val[2], rhs2);
       vst1q_f32(C.data(j, i), r);
     }
   }
-  // FIXME: hacky way to prevent memory leak
-  delete [] A_colm.data();
-
 #endif
 }
 
+#ifdef USE_NEON
 void matrix_multiplication_impl(
    MatrixView<float, MatrixOrder::RowMajor>& A,
    MatrixView<float, MatrixOrder::ColMajor>& B,
-   MatrixView<float, MatrixOrder::ColMajor>& C) {
-#ifdef USE_NEON
+   MatrixView<float, MatrixOrder::ColMajor>& C,
+   float *B_buf,
+   ThreadPool& pool) {
   constexpr std::size_t regblock_n = 8;
   constexpr std::size_t regblock_m = 4;
-  const auto B_col_blocks = (B.cols() + regblock_m - 1) / regblock_m;
-  float *B_buf_ptr = B_buf.get();
   for (std::size_t j = 0; j < B.cols(); j += regblock_m) {
     if (B.cols() - j >= regblock_m) {
+      // each block of 4 columns takes 4 * B.rows() floats, whatever the rows
+      float *B_buf_ptr = B_buf + j * B.rows();
       std::size_t k = 0;
-      for (; k < B.rows(); k += regblock_m) {
+      for (; k + regblock_m <= B.rows(); k += regblock_m) {
         const auto im0 = vld1q_f32(B.data(k, j + 0));
         const auto im1 = vld1q_f32(B.data(k, j + 1));
         const auto im2 = vld1q_f32(B.data(k, j + 2));
@@ -121,255 +112,293 @@ void matrix_multiplication_impl(
       }
     }
   }
-#pragma omp parallel for
-  for (std::size_t i = 0; i < A.rows(); i += regblock_n) {
-    float A_buf[regblock_n * A.cols()];
-    for (std::size_t k = 0; k < A.cols(); ++k) {
-      for (std::size_t i2 = 0; i2 < regblock_n; ++i2) {
-        if (i + i2 >= A.rows()) {
-          A_buf[k * regblock_n + i2] = 0;
-        } else {
-          A_buf[k * regblock_n + i2] = A(i + i2, k);
+  pool.parallel_for(0, (A.rows() + regblock_n - 1) / regblock_n, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first * regblock_n; i < std::min<std::size_t>(last * regblock_n, A.rows()); i += regblock_n) {
+      float A_buf[regblock_n * A.cols()];
+      for (std::size_t k = 0; k < A.cols(); ++k) {
+        for (std::size_t i2 = 0; i2 < regblock_n; ++i2) {
+          if (i + i2 >= A.rows()) {
+            A_buf[k * regblock_n + i2] = 0;
+          } else {
+            A_buf[k * regblock_n + i2] = A(i + i2, k);
+          }
         }
       }
-    }
-    float *B_buf_ptr = B_buf.get();
-    for (std::size_t j = 0; j < B.cols(); j += regblock_m) {
-      if (A.rows() - i >= regblock_n && B.cols() - j >= regblock_m) {
-        float *A_buf_ptr = A_buf;
-        auto accum00 = vdupq_n_f32(0);
-        auto accum01 = vdupq_n_f32(0);
-        auto accum10 = vdupq_n_f32(0);
-        auto accum11 = vdupq_n_f32(0);
-        auto accum20 = vdupq_n_f32(0);
-        auto accum21 = vdupq_n_f32(0);
-        auto accum30 = vdupq_n_f32(0);
-        auto accum31 = vdupq_n_f32(0);
-        for (std::size_t k = 0; k < A.cols(); ++k) {
-          const auto a0 = vld1q_f32(A_buf_ptr);
-          A_buf_ptr += 4;
-          const auto a1 = vld1q_f32(A_buf_ptr);
-          A_buf_ptr += 4;
-          const auto b = vld1q_f32(B_buf_ptr);
-          B_buf_ptr += 4;
-          const auto bl = vget_low_f32(b);
-          const auto bh = vget_high_f32(b);
-          accum00 = vmlaq_lane_f32(accum00, a0, bl, 0);
-          accum01 = vmlaq_lane_f32(accum01, a1, bl, 0);
-          accum10 = vmlaq_lane_f32(accum10, a0, bl, 1);
-          accum11 = vmlaq_lane_f32(accum11, a1, bl, 1);
-          accum20 = vmlaq_lane_f32(accum20, a0, bh, 0);
-          accum21 = vmlaq_lane_f32(accum21, a1, bh, 0);
-          accum30 = vmlaq_lane_f32(accum30, a0, bh, 1);
-          accum31 = vmlaq_lane_f32(accum31, a1, bh, 1);
-        }
-        vst1q_f32(C.data(i + 0, j + 0), accum00);
-        vst1q_f32(C.data(i + 4, j + 0), accum01);
-        vst1q_f32(C.data(i + 0, j + 1), accum10);
-        vst1q_f32(C.data(i + 4, j + 1), accum11);
-        vst1q_f32(C.data(i + 0, j + 2), accum20);
-        vst1q_f32(C.data(i + 4, j + 2), accum21);
-        vst1q_f32(C.data(i + 0, j + 3), accum30);
-        vst1q_f32(C.data(i + 4, j + 3), accum31);
-      } else if (A.rows() - i >= regblock_n) {
-        const auto j2max = std::min(regblock_m, B.cols() - j);
-        for (std::size_t j2 = 0; j2 < j2max; ++j2) {
+      float *B_buf_ptr = B_buf;
+      for (std::size_t j = 0; j < B.cols(); j += regblock_m) {
+        if (A.rows() - i >= regblock_n && B.cols() - j >= regblock_m) {
           float *A_buf_ptr = A_buf;
-          auto accum0 = vdupq_n_f32(0.0f);
-          auto accum1 = vdupq_n_f32(0.0f);
+          auto accum00 = vdupq_n_f32(0);
+          auto accum01 = vdupq_n_f32(0);
+          auto accum10 = vdupq_n_f32(0);
+          auto accum11 = vdupq_n_f32(0);
+          auto accum20 = vdupq_n_f32(0);
+          auto accum21 = vdupq_n_f32(0);
+          auto accum30 = vdupq_n_f32(0);
+          auto accum31 = vdupq_n_f32(0);
           for (std::size_t k = 0; k < A.cols(); ++k) {
             const auto a0 = vld1q_f32(A_buf_ptr);
             A_buf_ptr += 4;
             const auto a1 = vld1q_f32(A_buf_ptr);
             A_buf_ptr += 4;
-            const auto b = vdupq_n_f32(B(k, j + j2));
-            accum0 = vmlaq_f32(accum0, a0, b);
-            accum1 = vmlaq_f32(accum1, a1, b);
-          }
-          vst1q_f32(C.data(i + 0, j + j2), accum0);
-          vst1q_f32(C.data(i + 4, j + j2), accum1);
-        }
-      } else if (B.cols() - j >= regblock_m) {
-        const auto i2max = std::min(regblock_n, A.rows() - i);
-        for (std::size_t i2 = 0; i2 < i2max; ++i2) {
-          B_buf_ptr = B_buf.get() + j * A.cols();
-          auto accum0 = vdupq_n_f32(0.0f);
-          auto accum1 = vdupq_n_f32(0.0f);
-          auto accum2 = vdupq_n_f32(0.0f);
-          auto accum3 = vdupq_n_f32(0.0f);
-          std::size_t k;
-          for (k = 0; k+3 < A.cols(); k += 4) {
-            const auto a = vld1q_f32(A.data(i + i2, k));
-            const auto b = vld4q_f32(B_buf_ptr);
-            B_buf_ptr += 16;
-            accum0 = vmlaq_f32(accum0, a, b.val[0]);
-            accum1 = vmlaq_f32(accum1, a, b.val[1]);
-            accum2 = vmlaq_f32(accum2, a, b.val[2]);
-            accum3 = vmlaq_f32(accum3, a, b.val[3]);
-          }
-          const auto res0 = vpadd_f32(vget_low_f32(accum0), vget_high_f32(accum0));
-          const auto res1 = vpadd_f32(vget_low_f32(accum1), vget_high_f32(accum1));
-          const auto res2 = vpadd_f32(vget_low_f32(accum2), vget_high_f32(accum2));
-          const auto res3 = vpadd_f32(vget_low_f32(accum3), vget_high_f32(accum3));
-          const auto res01 = vpadd_f32(res0, res1);
-          const auto res23 = vpadd_f32(res2, res3);
-          auto res = vcombine_f32(res01, res23);
-          for (; k < A.cols(); ++k) {
-            const auto a = vdupq_n_f32(A(i + i2, k));
             const auto b = vld1q_f32(B_buf_ptr);
             B_buf_ptr += 4;
-            res = vmlaq_f32(res, a, b);
+            const auto bl = vget_low_f32(b);
+            const auto bh = vget_high_f32(b);
+            accum00 = vmlaq_lane_f32(accum00, a0, bl, 0);
+            accum01 = vmlaq_lane_f32(accum01, a1, bl, 0);
+            accum10 = vmlaq_lane_f32(accum10, a0, bl, 1);
+            accum11 = vmlaq_lane_f32(accum11, a1, bl, 1);
+            accum20 = vmlaq_lane_f32(accum20, a0, bh, 0);
+            accum21 = vmlaq_lane_f32(accum21, a1, bh, 0);
+            accum30 = vmlaq_lane_f32(accum30, a0, bh, 1);
+            accum31 = vmlaq_lane_f32(accum31, a1, bh, 1);
           }
-          float res_ary[4];
-          vst1q_f32(res_ary, res);
-          C(i + i2, j + 0) = res_ary[0];
-          C(i + i2, j + 1) = res_ary[1];
-          C(i + i2, j + 2) = res_ary[2];
-          C(i + i2, j + 3) = res_ary[3];
-        }
-      } else {
-        const auto i2max = std::min(regblock_n, A.rows() - i);
-        const auto j2max = std::min(regblock_m, B.cols() - j);
-        for (std::size_t i2 = 0; i2 < i2max; ++i2) {
+          vst1q_f32(C.data(i + 0, j + 0), accum00);
+          vst1q_f32(C.data(i + 4, j + 0), accum01);
+          vst1q_f32(C.data(i + 0, j + 1), accum10);
+          vst1q_f32(C.data(i + 4, j + 1), accum11);
+          vst1q_f32(C.data(i + 0, j + 2), accum20);
+          vst1q_f32(C.data(i + 4, j + 2), accum21);
+          vst1q_f32(C.data(i + 0, j + 3), accum30);
+          vst1q_f32(C.data(i + 4, j + 3), accum31);
+        } else if (A.rows() - i >= regblock_n) {
+          const auto j2max = std::min(regblock_m, B.cols() - j);
           for (std::size_t j2 = 0; j2 < j2max; ++j2) {
-            auto accum = vdupq_n_f32(0.0f);
+            float *A_buf_ptr = A_buf;
+            auto accum0 = vdupq_n_f32(0.0f);
+            auto accum1 = vdupq_n_f32(0.0f);
+            for (std::size_t k = 0; k < A.cols(); ++k) {
+              const auto a0 = vld1q_f32(A_buf_ptr);
+              A_buf_ptr += 4;
+              const auto a1 = vld1q_f32(A_buf_ptr);
+              A_buf_ptr += 4;
+              const auto b = vdupq_n_f32(B(k, j + j2));
+              accum0 = vmlaq_f32(accum0, a0, b);
+              accum1 = vmlaq_f32(accum1, a1, b);
+            }
+            vst1q_f32(C.data(i + 0, j + j2), accum0);
+            vst1q_f32(C.data(i + 4, j + j2), accum1);
+          }
+        } else if (B.cols() - j >= regblock_m) {
+          const auto i2max = std::min(regblock_n, A.rows() - i);
+          for (std::size_t i2 = 0; i2 < i2max; ++i2) {
+            B_buf_ptr = B_buf + j * A.cols();
+            auto accum0 = vdupq_n_f32(0.0f);
+            auto accum1 = vdupq_n_f32(0.0f);
+            auto accum2 = vdupq_n_f32(0.0f);
+            auto accum3 = vdupq_n_f32(0.0f);
             std::size_t k;
             for (k = 0; k+3 < A.cols(); k += 4) {
-              accum = vmlaq_f32(accum, vld1q_f32(A.data(i + i2, k)), vld1q_f32(B.data(k, j + j2)));
+              const auto a = vld1q_f32(A.data(i + i2, k));
+              const auto b = vld4q_f32(B_buf_ptr);
+              B_buf_ptr += 16;
+              accum0 = vmlaq_f32(accum0, a, b.val[0]);
+              accum1 = vmlaq_f32(accum1, a, b.val[1]);
+              accum2 = vmlaq_f32(accum2, a, b.val[2]);
+              accum3 = vmlaq_f32(accum3, a, b.val[3]);
             }
-            float accum_ary[4];
-            vst1q_f32(accum_ary, accum);
-            float res = accum_ary[0] + accum_ary[1] + accum_ary[2] + accum_ary[3];
+            const auto res0 = vpadd_f32(vget_low_f32(accum0), vget_high_f32(accum0));
+            const auto res1 = vpadd_f32(vget_low_f32(accum1), vget_high_f32(accum1));
+            const auto res2 = vpadd_f32(vget_low_f32(accum2), vget_high_f32(accum2));
+            const auto res3 = vpadd_f32(vget_low_f32(accum3), vget_high_f32(accum3));
+            const auto res01 = vpadd_f32(res0, res1);
+            const auto res23 = vpadd_f32(res2, res3);
+            auto res = vcombine_f32(res01, res23);
             for (; k < A.cols(); ++k) {
-              res += A(i + i2, k) * B(k, j + j2);
+              const auto a = vdupq_n_f32(A(i + i2, k));
+              const auto b = vld1q_f32(B_buf_ptr);
+              B_buf_ptr += 4;
+              res = vmlaq_f32(res, a, b);
             }
-            C(i + i2, j + j2) = res;
+            float res_ary[4];
+            vst1q_f32(res_ary, res);
+            C(i + i2, j + 0) = res_ary[0];
+            C(i + i2, j + 1) = res_ary[1];
+            C(i + i2, j + 2) = res_ary[2];
+            C(i + i2, j + 3) = res_ary[3];
           }
-        }
-      }
-    }
-  }
-#elif defined USE_AVX
-  constexpr std::size_t regblock_n = 16;
-  constexpr std::size_t regblock_m = 4;
-  const auto kmax = ceil_mod(A.cols(), regblock_m);
-  const auto jmax = ceil_mod(B.cols(), regblock_m);
-  auto B_buf_aligned = reinterpret_cast<void*>(B_buf.get());
-  auto space = B_buf_size;
-  std::align(32, kmax * jmax, B_buf_aligned, space);
-  float *B_buf_ptr = reinterpret_cast<float*>(B_buf_aligned);
-  for (std::size_t j = 0; j < jmax; j += regblock_m) {
-    if (B.cols() - j >= regblock_m) {
-      std::size_t k = 0;
-      for (; k + regblock_m <= B.rows(); k += regblock_m) {
-        const auto im0 = _mm_loadu_ps(B.data(k, j + 0));
-        const auto im1 = _mm_loadu_ps(B.data(k, j + 1));
-        const auto im2 = _mm_loadu_ps(B.data(k, j + 2));
-        const auto im3 = _mm_loadu_ps(B.data(k, j + 3));
-        const auto pm0 = _mm_shuffle_ps(im0, im1, 0x44);
-        const auto pm1 = _mm_shuffle_ps(im2, im3, 0x44);
-        const auto pm2 = _mm_shuffle_ps(im0, im1, 0xEE);
-        const auto pm3 = _mm_shuffle_ps(im2, im3, 0xEE);
-        const auto qm0 = _mm_shuffle_ps(pm0, pm1, 0x88);
-        const auto qm1 = _mm_shuffle_ps(pm0, pm1, 0xDD);
-        const auto qm2 = _mm_shuffle_ps(pm2, pm3, 0x88);
-        const auto qm3 = _mm_shuffle_ps(pm2, pm3, 0xDD);
-        _mm_store_ps(B_buf_ptr, qm0);
-        B_buf_ptr += 4;
-        _mm_store_ps(B_buf_ptr, qm1);
-        B_buf_ptr += 4;
-        _mm_store_ps(B_buf_ptr, qm2);
-        B_buf_ptr += 4;
-        _mm_store_ps(B_buf_ptr, qm3);
-        B_buf_ptr += 4;
-      }
-      for (; k < kmax; ++k) {
-        for (std::size_t j2 = 0; j2 < regblock_m; ++j2) {
-          if (j + j2 >= B.cols() || k >= B.rows()) {
-            *B_buf_ptr++ = 0;
-          } else {
-            *B_buf_ptr++ = B(k, j + j2);
+        } else {
+          const auto i2max = std::min(regblock_n, A.rows() - i);
+          const auto j2max = std::min(regblock_m, B.cols() - j);
+          for (std::size_t i2 = 0; i2 < i2max; ++i2) {
+            for (std::size_t j2 = 0; j2 < j2max; ++j2) {
+              auto accum = vdupq_n_f32(0.0f);
+              std::size_t k;
+              for (k = 0; k+3 < A.cols(); k += 4) {
+                accum = vmlaq_f32(accum, vld1q_f32(A.data(i + i2, k)), vld1q_f32(B.data(k, j + j2)));
+              }
+              float accum_ary[4];
+              vst1q_f32(accum_ary, accum);
+              float res = accum_ary[0] + accum_ary[1] + accum_ary[2] + accum_ary[3];
+              for (; k < A.cols(); ++k) {
+                res += A(i + i2, k) * B(k, j + j2);
+              }
+              C(i + i2, j + j2) = res;
+            }
           }
         }
       }
-    } else {
-      for (std::size_t k = 0; k < kmax; ++k) {
-        for (std::size_t j2 = 0; j2 < regblock_m; ++j2) {
-          if (j + j2 >= B.cols() || k >= B.rows()) {
-            *B_buf_ptr++ = 0;
-          } else {
-            *B_buf_ptr++ = B(k, j + j2);
-          }
-        }
+    }
+  });
+}
+#endif
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+namespace {
+
+// register block of the AVX2 GEMM: 16 rows (two ymm registers) by 6 columns
+// of C, 12 accumulators
+constexpr std::size_t avx2_mr = 16;
+constexpr std::size_t avx2_nr = 6;
+// cache blocks: a kc x mc block of packed A stays in L2 while the kc x nr
+// slivers of packed B stream through L1
+constexpr std::size_t avx2_kc = 256;
+constexpr std::size_t avx2_mc = 64;
+constexpr std::size_t avx2_nc = 32 * avx2_nr;
+
+// rows of A[i, k, k + kc) into mr row micro panels, [panel][k][mr],
+// zero padded beyond A.rows()
+void pack_a_avx2(MatrixView<float, MatrixOrder::RowMajor>& A, std::size_t i, std::size_t rows,
+    std::size_t k, std::size_t kc, float *A_pack) {
+  for (std::size_t i2 = 0; i2 < rows; i2 += avx2_mr) {
+    for (std::size_t r = 0; r < avx2_mr; ++r) {
+      if (i2 + r < rows) {
+        const float *src = A.data(i + i2 + r, k);
+        for (std::size_t k2 = 0; k2 < kc; ++k2)
+          A_pack[k2 * avx2_mr + r] = src[k2];
+      } else {
+        for (std::size_t k2 = 0; k2 < kc; ++k2)
+          A_pack[k2 * avx2_mr + r] = 0;
       }
     }
+    A_pack += kc * avx2_mr;
+  }
+}
+
+// C[0, rows) x [0, cols) = (C +) A_pack * B_pack over kc, C column major
+void gemm_micro_kernel_avx2(const float *A_pack, const float *B_pack, std::size_t kc,
+    float *C, std::size_t ldc, std::size_t rows, std::size_t cols, bool accumulate) {
+  auto c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+  auto c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  auto c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+  auto c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+  auto c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+  auto c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+  for (std::size_t k = 0; k < kc; ++k) {
+    const auto a0 = _mm256_load_ps(A_pack);
+    const auto a1 = _mm256_load_ps(A_pack + 8);
+    A_pack += avx2_mr;
+    auto b = _mm256_broadcast_ss(B_pack + 0);
+    c00 = _mm256_fmadd_ps(a0, b, c00);
+    c01 = _mm256_fmadd_ps(a1, b, c01);
+    b = _mm256_broadcast_ss(B_pack + 1);
+    c10 = _mm256_fmadd_ps(a0, b, c10);
+    c11 = _mm256_fmadd_ps(a1, b, c11);
+    b = _mm256_broadcast_ss(B_pack + 2);
+    c20 = _mm256_fmadd_ps(a0, b, c20);
+    c21 = _mm256_fmadd_ps(a1, b, c21);
+    b = _mm256_broadcast_ss(B_pack + 3);
+    c30 = _mm256_fmadd_ps(a0, b, c30);
+    c31 = _mm256_fmadd_ps(a1, b, c31);
+    b = _mm256_broadcast_ss(B_pack + 4);
+    c40 = _mm256_fmadd_ps(a0, b, c40);
+    c41 = _mm256_fmadd_ps(a1, b, c41);
+    b = _mm256_broadcast_ss(B_pack + 5);
+    c50 = _mm256_fmadd_ps(a0, b, c50);
+    c51 = _mm256_fmadd_ps(a1, b, c51);
+    B_pack += avx2_nr;
+  }
+
+  const __m256 acc[avx2_nr][2] = {
+    {c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51}
+  };
+  const auto lane_ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const auto vn = _mm256_set1_epi32(rows);
+  const auto mask0 = _mm256_cmpgt_epi32(vn, lane_ids);
+  const auto mask1 = _mm256_cmpgt_epi32(vn, _mm256_add_epi32(lane_ids, _mm256_set1_epi32(8)));
+  for (std::size_t j = 0; j < cols; ++j) {
+    float *c = C + j * ldc;
+    auto r0 = acc[j][0];
+    auto r1 = acc[j][1];
+    if (accumulate) {
+      r0 = _mm256_add_ps(r0, _mm256_maskload_ps(c + 0, mask0));
+      r1 = _mm256_add_ps(r1, _mm256_maskload_ps(c + 8, mask1));
+    }
+    _mm256_maskstore_ps(c + 0, mask0, r0);
+    _mm256_maskstore_ps(c + 8, mask1, r1);
   }
-#pragma omp parallel for
-  for (std::size_t i = 0; i < A.rows(); i += regblock_n) {
-    alignas(32) float A_buf[regblock_n * kmax];
-    for (std::size_t k = 0; k < kmax; ++k) {
-      for (std::size_t i2 = 0; i2 < regblock_n; ++i2) {
-        if (i + i2 >= A.rows() || k >= A.cols()) {
-          A_buf[k * regblock_n + i2] = 0;
+}
+
+} // namespace
+
+void matrix_multiplication_avx2(
+   MatrixView<float, MatrixOrder::RowMajor>& A,
+   MatrixView<float, MatrixOrder::ColMajor>& B,
+   MatrixView<float, MatrixOrder::ColMajor>& C,
+   float *B_buf,
+   ThreadPool& pool) {
+  const std::size_t m = A.rows();
+  const std::size_t n = B.cols();
+  const std::size_t kmax = A.cols();
+  const std::size_t panels = (n + avx2_nr - 1) / avx2_nr;
+
+  // B goes once into nr column panels, [panel][k][nr], zero padded beyond
+  // B.cols(). a kc block of a panel is then contiguous.
+  auto B_buf_aligned = reinterpret_cast<void*>(B_buf);
+  std::size_t space = Workspace::matmul_buf_elems * sizeof(float);
+  const std::size_t B_pack_size = panels * kmax * avx2_nr;
+  std::align(32, B_pack_size * sizeof(float), B_buf_aligned, space);
+  assert(B_buf_aligned != nullptr);
+  float *B_pack = reinterpret_cast<float*>(B_buf_aligned);
+  pool.parallel_for(0, panels, 16, [&](std::size_t first, std::size_t last) {
+    for (std::size_t panel = first; panel < last; ++panel) {
+      float *dst = B_pack + panel * kmax * avx2_nr;
+      const std::size_t j = panel * avx2_nr;
+      for (std::size_t j2 = 0; j2 < avx2_nr; ++j2) {
+        if (j + j2 < n) {
+          const float *src = B.data(0, j + j2);
+          for (std::size_t k = 0; k < kmax; ++k)
+            dst[k * avx2_nr + j2] = src[k];
         } else {
-          A_buf[k * regblock_n + i2] = A(i + i2, k);
+          for (std::size_t k = 0; k < kmax; ++k)
+            dst[k * avx2_nr + j2] = 0;
         }
       }
     }
-    float *B_buf_ptr = reinterpret_cast<float*>(B_buf_aligned);
-    std::size_t j = 0;
-    for (; j < jmax; j += regblock_m) {
-      float *A_buf_ptr = A_buf;
-      auto accum00 = _mm256_setzero_ps();
-      auto accum01 = _mm256_setzero_ps();
-      auto accum10 = _mm256_setzero_ps();
-      auto accum11 = _mm256_setzero_ps();
-      auto accum20 = _mm256_setzero_ps();
-      auto accum21 = _mm256_setzero_ps();
-      auto accum30 = _mm256_setzero_ps();
-      auto accum31 = _mm256_setzero_ps();
-      for (std::size_t k = 0; k < kmax; ++k) {
-        const auto a0 = _mm256_load_ps(A_buf_ptr);
-        A_buf_ptr += 8;
-        const auto a1 = _mm256_load_ps(A_buf_ptr);
-        A_buf_ptr += 8;
-        const auto b0 = _mm256_set1_ps(*B_buf_ptr++);
-        accum00 = _mm256_fmadd_ps(a0, b0, accum00);
-        accum01 = _mm256_fmadd_ps(a1, b0, accum01);
-        const auto b1 = _mm256_set1_ps(*B_buf_ptr++);
-        accum10 = _mm256_fmadd_ps(a0, b1, accum10);
-        accum11 = _mm256_fmadd_ps(a1, b1, accum11);
-        const auto b2 = _mm256_set1_ps(*B_buf_ptr++);
-        accum20 = _mm256_fmadd_ps(a0, b2, accum20);
-        accum21 = _mm256_fmadd_ps(a1, b2, accum21);
-        const auto b3 = _mm256_set1_ps(*B_buf_ptr++);
-        accum30 = _mm256_fmadd_ps(a0, b3, accum30);
-        accum31 = _mm256_fmadd_ps(a1, b3, accum31);
+  });
+
+  // every task computes a mc x nc block of C over all of k
+  const std::size_t row_blocks = (m + avx2_mc - 1) / avx2_mc;
+  const std::size_t col_blocks = (n + avx2_nc - 1) / avx2_nc;
+  pool.parallel_for(0, row_blocks * col_blocks, 1, [&](std::size_t first, std::size_t last) {
+    alignas(32) float A_pack[avx2_mc * avx2_kc];
+    for (std::size_t t = first; t < last; ++t) {
+      const std::size_t i = (t / col_blocks) * avx2_mc;
+      const std::size_t j = (t % col_blocks) * avx2_nc;
+      const std::size_t rows = std::min(avx2_mc, m - i);
+      const std::size_t cols = std::min(avx2_nc, n - j);
+      for (std::size_t k = 0; k < kmax; k += avx2_kc) {
+        const std::size_t kc = std::min(avx2_kc, kmax - k);
+        pack_a_avx2(A, i, rows, k, kc, A_pack);
+        for (std::size_t j2 = 0; j2 < cols; j2 += avx2_nr) {
+          const float *B_sliver = B_pack + (j + j2) / avx2_nr * kmax * avx2_nr + k * avx2_nr;
+          for (std::size_t i2 = 0; i2 < rows; i2 += avx2_mr) {
+            gemm_micro_kernel_avx2(A_pack + i2 * kc, B_sliver, kc,
+                C.data(i + i2, j + j2), m,
+                std::min(avx2_mr, rows - i2), std::min(avx2_nr, cols - j2), k != 0);
+          }
+        }
       }
-      const auto lane_ids = _mm256_setr_epi32(
-          0, 1, 2, 3, 4, 5, 6, 7
-      );
-      const auto idx0 = lane_ids + _mm256_set1_epi32(i+0);
-      const auto idx1 = lane_ids + _mm256_set1_epi32(i+8);
-      const auto vn = _mm256_set1_epi32(A.rows());
-      const auto mask0 = _mm256_cmpgt_epi32(vn, idx0);
-      const auto mask1 = _mm256_cmpgt_epi32(vn, idx1);
-      _mm256_maskstore_ps(C.data(i + 0, j + 0), mask0, accum00);
-      _mm256_maskstore_ps(C.data(i + 8, j + 0), mask1, accum01);
-      if (j + 1 >= B.cols()) continue;
-      _mm256_maskstore_ps(C.data(i + 0, j + 1), mask0, accum10);
-      _mm256_maskstore_ps(C.data(i + 8, j + 1), mask1, accum11);
-      if (j + 2 >= B.cols()) continue;
-      _mm256_maskstore_ps(C.data(i + 0, j + 2), mask0, accum20);
-      _mm256_maskstore_ps(C.data(i + 8, j + 2), mask1, accum21);
-      if (j + 3 >= B.cols()) continue;
-      _mm256_maskstore_ps(C.data(i + 0, j + 3), mask0, accum30);
-      _mm256_maskstore_ps(C.data(i + 8, j + 3), mask1, accum31);
     }
-  }
-#endif
+  });
 }
 
+DLK_TARGET_END
+#endif
+
 } // namespace details
 
 } // namespace dlk
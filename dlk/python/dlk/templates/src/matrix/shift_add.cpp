@@ -13,169 +13,71 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-#include <thread>
-#include <vector>
+#include <algorithm>
+#include <cassert>
 
 #include "global.h"
 #include "matrix_view.h"
 #include "matrix/shift_add.h"
 #include "operators.h" // FIXME(nikolay): for convolution_parameters definition, rid of it later
+#include "thread_pool.h"
 #include "time_measurement.h"
 
-#ifdef USE_NEON
+#if defined USE_NEON && !defined RUN_ON_FPGA
   #include <arm_neon.h>
 #endif
 
 namespace dlk {
 
-template<>
-void matrix_shift_add(MatrixView<float, MatrixOrder::ColMajor>& buf,
-                      MatrixView<float, MatrixOrder::ColMajor>& result,
-                      const struct convolution_parameters& p) {
-  Measurement::Start("matrix_shift_add_f1");
+void matrix_shift_add(const MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>& buf,
+                      MatrixView<BIN_CONV_OUTPUT, MatrixOrder::ColMajor>& result,
+                      const struct convolution_parameters& p,
+                      std::size_t first_row, std::size_t last_row) {
+  Measurement::Start("matrix_shift_add");
 
-  const int h = p.input_height;
-  const int w = p.input_width;
-  const int oc = p.output_channels;
-  const int kh = p.kernel_height;
-  const int kw = p.kernel_width;
+  const std::size_t h = p.input_height;
+  const std::size_t w = p.input_width;
+  const std::size_t oc = p.output_channels;
 
   // only 3x3 kernel is supported.
-  assert(kh == 3 && kw == 3);
-
-  for (unsigned int j = 0; j < buf.cols(); ++j) {
-    for (unsigned int i = 0; i < buf.rows(); ++i) {
-      if (is_first_column(j, w) && is_cfi(i, p.output_channels)) {
-        buf.set(i, j, 0);
-      } else if (is_last_column(j, w) && is_adg(i, p.output_channels)) {
-        buf.set(i, j, 0);
-      }
-    }
-  }
-
-  Measurement::Stop();
-
-  Measurement::Start("matrix_shift_add_f2");
-
-  unsigned int chunk_size = (h * w) / static_cast<unsigned int>(std::thread::hardware_concurrency());
-  if (chunk_size == 0) {
-    chunk_size += 1;
-  }
-
-  std::vector<std::thread> threads;
-  for (unsigned int begin = 0; begin < (h * w); begin += chunk_size) {
-    threads.emplace_back(std::thread([buf, begin, chunk_size, h, w, p, &result] {
-          const int kh = p.kernel_height;
-          const int kw = p.kernel_width;
-          const int oc = p.output_channels;
-          for (int k = begin; k < std::min(begin + chunk_size, static_cast<unsigned int>(h * w)); ++k) {
-            for (unsigned int i = 0; i < (kh * kw); ++i) {
-              int offset = calc_offset(i, w);
-              if ((k - offset < 0) || (k - offset >= (h * w))) {
-                continue;
-              }
-
-              float* r = result.data(0, k);
-              float* b = buf.data(i*oc, k - offset);
-
-
-              unsigned int j = 0;
-#ifdef USE_NEON
-              for (; j + 3 < oc; j += 4) {
-                float32x4_t b_ = vld1q_f32(b+j);
-                float32x4_t r_ = vld1q_f32(r+j);
-                float32x4_t r__ = vaddq_f32(b_, r_);
-                vst1q_f32(r+j, r__);
-              }
+  assert(p.kernel_height == 3 && p.kernel_width == 3);
+
+  // the first input row held in buf
+  const std::size_t buf_row = first_row == 0 ? 0 : first_row - 1;
+
+  // one output row per task
+  p.thread_pool->parallel_for(first_row, last_row, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t y = first; y < last; ++y) {
+      for (std::size_t x = 0; x < w; ++x) {
+        BIN_CONV_OUTPUT *r = result.data(0, y * w + x);
+
+        // the center tap never falls on the padding, so it initializes r
+        const BIN_CONV_OUTPUT *c = buf.data(4 * oc, (y - buf_row) * w + x);
+        std::copy(c, c + oc, r);
+
+        for (std::size_t ty = 0; ty < 3; ++ty) {
+          // taps falling on the zero padding are skipped
+          const std::size_t sy = y + ty - 1;
+          if (sy >= h)
+            continue;
+          for (std::size_t tx = 0; tx < 3; ++tx) {
+            const std::size_t sx = x + tx - 1;
+            if (sx >= w || (ty == 1 && tx == 1))
+              continue;
+            const BIN_CONV_OUTPUT *b = buf.data((ty * 3 + tx) * oc, (sy - buf_row) * w + sx);
+
+            std::size_t j = 0;
+#if defined USE_NEON && !defined RUN_ON_FPGA
+            for (; j + 8 <= oc; j += 8)
+              vst1q_s16(r + j, vaddq_s16(vld1q_s16(b + j), vld1q_s16(r + j)));
 #endif
-              for (; j < oc; ++j) {
-                r[j] += b[j];
-              }
-            }
+            for (; j < oc; ++j)
+              r[j] += b[j];
           }
-        }));
-  }
-
-  for (auto& th: threads) {
-    if (th.joinable())
-      th.join();
-  }
-
-  Measurement::Stop();
-}
-
-template<>
-void matrix_shift_add(MatrixView<int32_t, MatrixOrder::ColMajor>& buf,
-                      MatrixView<int32_t, MatrixOrder::ColMajor>& result,
-                      const struct convolution_parameters& p) {
-  Measurement::Start("matrix_shift_add_i1");
-
-  const int h = p.input_height;
-  const int w = p.input_width;
-  const int oc = p.output_channels;
-  const int kh = p.kernel_height;
-  const int kw = p.kernel_width;
-
-  // only 3x3 kernel is supported.
-  assert(kh == 3 && kw == 3);
-
-  for (unsigned int j = 0; j < buf.cols(); ++j) {
-    for (unsigned int i = 0; i < buf.rows(); ++i) {
-      if (is_first_column(j, w) && is_cfi(i, p.output_channels)) {
-        buf.set(i, j, 0);
-      } else if (is_last_column(j, w) && is_adg(i, p.output_channels)) {
-        buf.set(i, j, 0);
+        }
       }
     }
-  }
-
-  Measurement::Stop();
-
-  Measurement::Start("matrix_shift_add_i2");
-
-  unsigned int chunk_size = (h * w) / static_cast<unsigned int>(std::thread::hardware_concurrency());
-  if (chunk_size == 0) {
-    chunk_size += 1;
-  }
-
-  std::vector<std::thread> threads;
-  for (unsigned int begin = 0; begin < h * w; begin += chunk_size) {
-    threads.emplace_back(std::thread([buf, begin, chunk_size, h, w, p, &result] {
-          const int kh = p.kernel_height;
-          const int kw = p.kernel_width;
-          const int oc = p.output_channels;
-          for (int k = begin; k < std::min(begin + chunk_size, static_cast<unsigned int>(h * w)); ++k) {
-            for (unsigned int i = 0; i < kh * kw; ++i) {
-              int offset = calc_offset(i, w);
-              if ((k - offset < 0) || (k - offset >= h * w)) {
-                continue;
-              }
-
-              int32_t* r = result.data(0, k);
-              int32_t* b = buf.data(i*oc, k - offset);
-
-
-              unsigned int j = 0;
-#ifdef USE_NEON
-              for (; j + 3 < oc; j += 4) {
-                int32x4_t b_ = vld1q_s32(b+j);
-                int32x4_t r_ = vld1q_s32(r+j);
-                int32x4_t r__ = vaddq_s32(b_, r_);
-                vst1q_s32(r+j, r__);
-              }
-#endif
-              for (; j < oc; ++j) {
-                r[j] += b[j];
-              }
-            }
-          }
-    }));
-  }
-
-  for (auto& th: threads) {
-    if (th.joinable())
-      th.join();
-  }
+  });
 
   Measurement::Stop();
 }
@@ -13,11 +13,16 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+{% set input_is_looked_up = graph_input.output_op_list|rejectattr('op_type', 'equalto', 'Lookup')|list|length == 0 -%}
+#include <algorithm>
 #include <iostream>
 #include <vector>
+#include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <ctime>
+#include <mutex>
+#include <thread>
 #include "global.h"
 #include "func/add.h"
 #include "func/average_pool.h"
@@ -47,9 +52,12 @@ limitations under the License.
 #include "func/sub.h"
 #include "func/unpooling.h"
 #include "func/lookup.h"
+#include "kernel_table.h"
 #include "operators.h"
+#include "profiler.h"
 #include "quantizer.h"
 #include "network.h"
+#include "weight_file.h"
 
 #ifdef HARD_QUANTIZATION_ACTIVE
 #include "scaling_factors.h"
@@ -82,6 +90,13 @@ uint8_t* mapPhysicalMemory(size_t base, size_t size) {
     return mapped_base;
 }
 
+// one entry per layer of run_batch, in run order
+const dlk::LayerInfo layer_info[] = {
+  {% for layer in layers -%}
+  { "{{ layer.name }}", "{{ layer.op_type }}", {{ layer.flops }}u, {{ layer.nbytes }}u },
+  {% endfor %}
+};
+
 } // namespace
 
 {% if config.debug -%}
@@ -155,55 +170,104 @@ void save_uint32_data(const std::string &name, uint32_t size, uint32_t postfix,
 {{ '\n' -}}
 /////////////////////////////////////////
 
+namespace {
+
+// the constants above are globals, so every network of the process uses the
+// weight file mapped by the first init(). it is never unmapped, as networks
+// of other threads may still run while the process exits.
+std::mutex network_weights_mutex;
+dlk::WeightFile& network_weights = *new dlk::WeightFile();
+
+bool load_weights(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(network_weights_mutex);
+  if (network_weights.is_open()) {
+    if (network_weights.get_path() == path)
+      return true;
+    std::cout << "Error: weights already loaded from " << network_weights.get_path() << std::endl;
+    return false;
+  }
+
+  if (!network_weights.open(path))
+    return false;
+
+  bool ok = true;
+  {% for input in graph.consts if not input.is_scalar -%}
+  ok = ok && bind_{{ input.name }}(network_weights);
+  {% endfor -%}
+#ifdef THRESHOLD_SKIPPING_ACTIVE
+  ok = ok && bind_thresholds(network_weights);
+#endif
+
+  if (!ok)
+    network_weights.close();
+  return ok;
+}
+
+} // namespace
+
 Network::Network()
 {}
 
 Network::~Network()
 {
-  {% for node in graph.non_variables -%}
-  {% if node.available_buffer == '' -%}
-  {% for out_k in node.output_ops.keys() -%}
-  {% if node.output_ops.keys()|length > 1 %}
-  delete []{{ node.name + '_' + out_k }}_raw;
-  {% else %}
-  delete []{{ node.name }}_raw;
-  {% endif %}
-  {%- endfor %}
-  {% elif node.available_buffer != '' and node.output_ops.keys()|length > 1 %}
-  {% for out_k in node.output_ops.keys() -%}
-  {% if out_k != node.output_ops.keys()|list|first %}
-  delete []{{ node.name + '_' + out_k }}_raw;
-  {% endif %}
-  {%- endfor %}
-  {% endif %}
-  {%- endfor %}
-  {{ '\n' -}}
+  for (auto& lane : lanes) {
+    if (!lane.worker.joinable())
+      continue;
+    {
+      std::lock_guard<std::mutex> lock(lane.worker_mutex);
+      lane.stopping = true;
+    }
+    lane.worker_wake.notify_one();
+    lane.worker.join();
+  }
+
+  for (auto& lane : lanes) {
+    free(lane.activation_arena);
 
 #if defined RUN_ON_FPGA
 #else
-  delete [] device_input_buf;
-  delete [] device_output_buf;
+    delete [] lane.device_input_buf;
+    delete [] lane.device_output_buf;
 #endif
+  }
 }
 
-bool Network::init()
+bool Network::init_lane(std::size_t index)
 {
+  Lane& lane = lanes[index];
 
 #if defined RUN_ON_FPGA
-
+  {% if config.cache -%}
+  const char *const input_devices[] = { "udmabuf0", "udmabuf2" };
+  const char *const output_devices[] = { "udmabuf1", "udmabuf3" };
+  {% else -%}
+  const char *const input_devices[] = { "mem", "mem" };
+  const char *const output_devices[] = { "mem", "mem" };
+  {% endif -%}
+  const unsigned long input_addrs[] = { INPUT0_ADDR, INPUT1_ADDR };
+  const unsigned long output_addrs[] = { OUTPUT0_ADDR, OUTPUT1_ADDR };
+
+  {% if dma_plan.swaps_buffers -%}
+  // some convolutions read the output buffer and write the input buffer,
+  // so both have to hold the larger of the two
+  const std::size_t dma_bytes = std::max(max_device_input_elems * sizeof(QUANTIZED_PACKED),
+                                         max_device_output_elems * sizeof(BIN_CONV_OUTPUT));
+  const uint32_t dma_input_elems = (dma_bytes + sizeof(QUANTIZED_PACKED) - 1) / sizeof(QUANTIZED_PACKED);
+  const uint32_t dma_output_elems = (dma_bytes + sizeof(BIN_CONV_OUTPUT) - 1) / sizeof(BIN_CONV_OUTPUT);
+  {% else -%}
+  const uint32_t dma_input_elems = max_device_input_elems;
+  const uint32_t dma_output_elems = max_device_output_elems;
+  {% endif %}
   if(
-    !dma_input_buffer.init(
-        {% if config.cache %}
-          "udmabuf0",
-        {% else %}
-          "mem",
-        {% endif %}
-        max_device_input_elems,
+    !lane.dma_input_buffer.init(
+        input_devices[index],
+        dma_input_elems,
         sizeof(QUANTIZED_PACKED),
         {% if config.cache %}
           true, 0
         {% else %}
-          false, INPUT_ADDR
+          false, input_addrs[index]
         {% endif %}
     )
   )
@@ -212,18 +276,14 @@ bool Network::init()
   }
 
   if(
-    !dma_output_buffer.init(
-        {% if config.cache %}
-          "udmabuf1",
-        {% else %}
-          "mem",
-        {% endif %}
-        max_device_output_elems,
+    !lane.dma_output_buffer.init(
+        output_devices[index],
+        dma_output_elems,
         sizeof(BIN_CONV_OUTPUT),
         {% if config.cache %}
           true, 0
         {% else %}
-          false, OUTPUT_ADDR
+          false, output_addrs[index]
         {% endif %}
     )
   )
@@ -231,33 +291,61 @@ bool Network::init()
     return false;
   }
 
-  device_input_buf = (QUANTIZED_PACKED*) dma_input_buffer.buffer();
-  device_output_buf = (BIN_CONV_OUTPUT*) dma_output_buffer.buffer();
+  lane.device_input_buf = (QUANTIZED_PACKED*) lane.dma_input_buffer.buffer();
+  lane.device_output_buf = (BIN_CONV_OUTPUT*) lane.dma_output_buffer.buffer();
 
 #else
-  device_input_buf = new QUANTIZED_PACKED[max_device_input_elems]();
-  device_output_buf = new BIN_CONV_OUTPUT[max_device_output_elems]();
+  lane.device_input_buf = new QUANTIZED_PACKED[max_device_input_elems]();
+  lane.device_output_buf = new BIN_CONV_OUTPUT[max_device_output_elems]();
 #endif
 
-  {% for node in graph.non_variables -%}
-  {% if node.available_buffer == '' %}
-  {% for out_k in node.output_ops.keys() -%}
-  {% if node.output_ops.keys()|length > 1 %}
-  {{ node.name + '_' + out_k }}_raw = new {{ node.dtype.cpptype() }}[{{ node.view.shape }}]();
-  {% else %}
-  {{ node.name }}_raw = new {{ node.dtype.cpptype() }}[{{ node.view.shape }}]();
-  {% endif %}
-  {%- endfor %}
-  {% elif node.available_buffer != '' and node.output_ops.keys()|length > 1 %}
-  {% for out_k in node.output_ops.keys() -%}
-  {% if out_k != node.output_ops.keys()|list|first %}
-  {{ node.name + '_' + out_k }}_raw = new {{ node.dtype.cpptype() }}[{{ node.view.shape }}]();
-  {% endif %}
-  {%- endfor %}
-  {% endif %}
-  {%- endfor %}
+  if (!lane.workspace.init())
+    return false;
+
+  // the first lane uses all the threads, the others only run concurrently
+  // with it in run_batch and keep to their own thread. a pool outside the
+  // network takes the jobs of every lane.
+  const bool pool_ok = external_parallel_for != nullptr
+    ? lane.thread_pool.init_external(external_parallel_for, external_pool, num_threads)
+    : lane.thread_pool.init(index == 0 ? num_threads : 1, thread_affinity);
+  if (!pool_ok)
+    return false;
+
+  if (posix_memalign(reinterpret_cast<void**>(&lane.activation_arena),
+        activation_arena_alignment, activation_arena_size) != 0)
+  {
+    lane.activation_arena = 0;
+    return false;
+  }
+  std::memset(lane.activation_arena, 0, activation_arena_size);
+
+  return true;
+}
+
+bool Network::init()
+{
+  // pick the kernel implementations for this cpu before anything runs
+  dlk::kernels();
+
+  if (!load_weights(weight_path.empty() ? dlk::default_weight_path() : weight_path))
+    return false;
+
+  {% for buf in arena.buffers -%}
+  static_assert(sizeof({{ buf.cpptype }}) * {{ buf.elems }} <= {{ buf.nbytes }}, "{{ buf.name }} does not fit in its arena slot");
+  {% endfor %}
   {{ '\n' -}}
 
+  if (!init_lane(0))
+    return false;
+  active_lanes = 1;
+
+  // without the device buffers of a second lane, run_batch runs one frame
+  // at a time like run
+  for (std::size_t i = 1; i < num_lanes && init_lane(i); ++i)
+    active_lanes = i + 1;
+  for (std::size_t i = 1; i < active_lanes; ++i)
+    lanes[i].worker = std::thread(&Network::worker_main, this, i);
+
 #if defined RUN_ON_FPGA
   auto* kernel_buffer = mapPhysicalMemory(KERNEL_ADDR, total_kernel_size);
   {% for qconv in graph.convs(quantized_only=True) -%}
@@ -269,17 +357,57 @@ bool Network::init()
   {% for qconv in graph.convs(quantized_only=True) -%}
       {% if qconv.has_thresholds -%}
           {% set thresholds = qconv.thresholds -%}
-  std::memcpy(thresholds_buffer + {{qconv.name}}_thresholds_offset, const_cast<T_INT16*>({{qconv.name}}_thresholds), {{qconv.name}}_thresholds_size);
+  std::memcpy(thresholds_buffer + {{qconv.name}}_thresholds_offset, const_cast<T_INT16*>({{qconv.name}}_thresholds),
+              std::min<std::size_t>({{qconv.name}}_thresholds_size, {{ thresholds|length }} * sizeof(BIN_CONV_OUTPUT)));
       {% endif -%}
   {% endfor -%}
 #endif // RUN_ON_FPGA
 
-#pragma omp parallel
-  std::cout << std::flush;
-
   return true;
 }
 
+void Network::set_num_threads(int n)
+{
+  num_threads = n > 0 ? n : 0;
+}
+
+void Network::set_thread_affinity(const int *cpus, int n)
+{
+  thread_affinity.assign(cpus, cpus + std::max(n, 0));
+}
+
+void Network::set_thread_pool(ThreadPool::external_t parallel_for, void *pool, int n)
+{
+  external_parallel_for = parallel_for;
+  external_pool = pool;
+  num_threads = n > 0 ? n : 1;
+}
+
+void Network::set_weight_path(const std::string& path)
+{
+  weight_path = path;
+}
+
+void Network::enable_profiling(std::size_t capacity)
+{
+  for (auto& lane : lanes)
+    lane.profiler.enable(capacity);
+}
+
+void Network::clear_profile()
+{
+  for (auto& lane : lanes)
+    lane.profiler.clear();
+}
+
+std::string Network::get_profile(dlk::ProfileFormat format) const
+{
+  std::vector<const dlk::Profiler*> profilers;
+  for (const auto& lane : lanes)
+    profilers.push_back(&lane.profiler);
+  return dlk::Profiler::export_as(profilers, format);
+}
+
 int Network::get_input_rank()
 {
   return input_rank;
@@ -302,30 +430,115 @@ void Network::get_output_shape(int32_t *shape)
 
 bool Network::run(float *network_input, float *network_output)
 {
-  struct convolution_parameters Conv2D_struct;
-  struct binary_convolution_parameters binConv2D_struct;
-  struct max_pooling_parameters MaxPool_struct;
-  struct avg_pooling_parameters AveragePool_struct;
-  struct MaxPoolWithArgmax_parameters MaxPoolWithArgmax_struct;
+  return run_batch(1, network_input, network_output);
+}
 
-  #if defined RUN_ON_FPGA
-  binConv2D_struct.device_input_phys_addr = dma_input_buffer.physical_address();
-  binConv2D_struct.device_output_phys_addr = dma_output_buffer.physical_address();
+void Network::worker_main(std::size_t index)
+{
+  Lane& lane = lanes[index];
+  std::unique_lock<std::mutex> lock(lane.worker_mutex);
+  for (;;) {
+    lane.worker_wake.wait(lock, [&lane] { return lane.stopping || lane.batch_size != 0; });
+    if (lane.stopping)
+      return;
+
+    const std::size_t n = lane.batch_size;
+    float *const inputs = lane.batch_inputs;
+    float *const outputs = lane.batch_outputs;
+    lock.unlock();
+    const bool ok = run_lane(lane, index, n, 2, inputs, nullptr, outputs);
+    lock.lock();
+
+    lane.batch_ok = ok;
+    lane.batch_size = 0;
+    lane.worker_done.notify_one();
+  }
+}
+
+bool Network::run_batch(std::size_t n, float *network_inputs, float *network_outputs)
+{
+  bool ok;
+  if (active_lanes < 2 || n < 2) {
+    ok = run_lane(lanes[0], 0, n, 1, network_inputs, nullptr, network_outputs);
+  } else {
+    // odd frames on the worker of the second lane, even frames on this
+    // thread. they only meet at the TCA, which serializes its users
+    // (de10_nano::TCAMutex)
+    Lane& odd = lanes[1];
+    {
+      std::lock_guard<std::mutex> lock(odd.worker_mutex);
+      odd.batch_size = n;
+      odd.batch_inputs = network_inputs;
+      odd.batch_outputs = network_outputs;
+    }
+    odd.worker_wake.notify_one();
+
+    const bool even_ok = run_lane(lanes[0], 0, n, 2, network_inputs, nullptr, network_outputs);
+
+    bool odd_ok;
+    {
+      std::unique_lock<std::mutex> lock(odd.worker_mutex);
+      odd.worker_done.wait(lock, [&odd] { return odd.batch_size == 0; });
+      odd_ok = odd.batch_ok;
+    }
+    ok = even_ok && odd_ok;
+  }
 
-  binConv2D_struct.dma_input_buffer = &dma_input_buffer;
-  binConv2D_struct.dma_output_buffer = &dma_output_buffer;
-  #endif
+  first_frame += n;
+  return ok;
+}
+
+bool Network::run_u8(const uint8_t *network_input, float *network_output)
+{
+  {% if input_is_looked_up -%}
+  const bool ok = run_lane(lanes[0], 0, 1, 1, nullptr, network_input, network_output);
+  ++first_frame;
+  return ok;
+  {%- else -%}
+  u8_input.resize(input_elems);
+  std::transform(network_input, network_input + input_elems, u8_input.begin(),
+                 [](uint8_t x) { return x / 255.0f; });
+  return run(u8_input.data(), network_output);
+  {%- endif %}
+}
+
+bool Network::run_lane(Lane& lane, std::size_t first, std::size_t n, std::size_t step,
+                       float *network_inputs, const uint8_t *network_inputs_u8,
+                       float *network_outputs)
+{
+  // the layers below refer to the state of this lane by these names
+  Workspace& workspace = lane.workspace;
+  ThreadPool& thread_pool = lane.thread_pool;
+  dlk::Profiler& profiler = lane.profiler;
+  dlk::Profiler::Session profiler_session(profiler);
+
+  {% for buf in arena.buffers -%}
+  {{ buf.cpptype }} *{{ buf.name }}_raw = reinterpret_cast<{{ buf.cpptype }}*>(lane.activation_arena + {{ buf.offset }});
+  {% endfor %}
+  {{ '\n' -}}
+
+#if defined RUN_ON_FPGA
+  {% if dma_plan.tensors -%}
+  // packed activations read only by the next convolution are written
+  // straight into the DMA buffer it reads from
+  DMA_Buffer *const dma_buffers[] = { &lane.dma_input_buffer, &lane.dma_output_buffer };
+  {% for tensor in dma_plan.tensors -%}
+  {{ tensor.name }}_raw = (QUANTIZED_PACKED*) dma_buffers[{{ tensor.buffer }}]->buffer();
+  {% endfor -%}
+  {% endif -%}
+#endif
+  {{ '\n' -}}
+
+  struct MaxPoolWithArgmax_parameters MaxPoolWithArgmax_struct;
 
   TensorView<{{ graph_input.dtype.cpptype() }}, MemoryLayout::{{ graph_input.dimension }}>::tensor_info_t<std::size_t> {{ graph_input.name }}_shape = {
     {% for len in graph_input.shape -%}
     {{- len -}},
     {%- endfor %}
   };
-  TensorView<{{ graph_input.dtype.cpptype() }}, MemoryLayout::{{ graph_input.dimension }}> {{ graph_input.name }}(network_input, {{ graph_input.name }}_shape);
   {{ '\n' -}}
 
   {% for node in graph.non_variables -%}
-  {% if node.available_buffer == '' %}
   {% for out_k in node.output_ops.keys() -%}
   {% if node.output_ops.keys()|length > 1 %}
   TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension }}>::tensor_info_t<std::size_t> {{ node.name + '_' + out_k }}_shape = {
@@ -345,32 +558,58 @@ bool Network::run(float *network_input, float *network_output)
     {{ node.name }}({{ node.name }}_raw, {{ node.name }}_shape);
   {% endif %}
   {%- endfor %}
-  {% elif node.available_buffer != '' and node.output_ops.keys()|length > 1 %}
-  {% for out_k in node.output_ops.keys() -%}
-  {% if out_k != node.output_ops.keys()|list|first %}
-  TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension }}>::tensor_info_t<std::size_t> {{ node.name + '_' + out_k }}_shape = {
-    {% for len in node.shape -%}
-    {{- len -}},
-    {%- endfor %}
-  };
-  TensorView<{{ node.dtype.cpptype() }}, MemoryLayout::{{ node.dimension }}>
-    {{ node.name + '_' + out_k }}({{ node.name + '_' + out_k }}_raw, {{ node.name + '_' + out_k }}_shape);
-  {% endif %}
-  {%- endfor %}
-  {% endif %}
   {%- endfor %}
   {{ '\n' -}}
 
   {%- for node in graph.non_variables %}
+  {% if node.view.params() -%}
+  {{ node.view.params() }}
+  {% endif -%}
+  {% endfor %}
+  {{ '\n' -}}
+
+#if defined RUN_ON_FPGA
+  // convolutions reading the output of the previous one swap the buffers
+  {% for conv in dma_plan.convs if conv.swapped -%}
+  {{ conv.name }}_params.device_input_buf = (QUANTIZED_PACKED*) dma_buffers[{{ conv.input_buffer }}]->buffer();
+  {{ conv.name }}_params.device_output_buf = (BIN_CONV_OUTPUT*) dma_buffers[{{ conv.output_buffer }}]->buffer();
+  {{ conv.name }}_params.device_input_phys_addr = dma_buffers[{{ conv.input_buffer }}]->physical_address();
+  {{ conv.name }}_params.device_output_phys_addr = dma_buffers[{{ conv.output_buffer }}]->physical_address();
+  {{ conv.name }}_params.dma_input_buffer = dma_buffers[{{ conv.input_buffer }}];
+  {{ conv.name }}_params.dma_output_buffer = dma_buffers[{{ conv.output_buffer }}];
+  {% endfor -%}
+#endif
+  {{ '\n' -}}
+
+  for (std::size_t frame = first; frame < n; frame += step) {
+    profiler.begin_frame(first_frame + frame);
+    {% if input_is_looked_up -%}
+    TensorView<{{ graph_input.dtype.cpptype() }}, MemoryLayout::{{ graph_input.dimension }}> {{ graph_input.name }}(network_inputs ? network_inputs + frame * input_elems : nullptr, {{ graph_input.name }}_shape);
+    TensorView<uint8_t, MemoryLayout::{{ graph_input.dimension }}> {{ graph_input.name }}_u8(network_inputs_u8 ? const_cast<uint8_t*>(network_inputs_u8) + frame * input_elems : nullptr, {{ graph_input.name }}_shape);
+    {%- else -%}
+    TensorView<{{ graph_input.dtype.cpptype() }}, MemoryLayout::{{ graph_input.dimension }}> {{ graph_input.name }}(network_inputs + frame * input_elems, {{ graph_input.name }}_shape);
+    {%- endif %}
+  {{ '\n' -}}
+
+  {%- for node in graph.non_variables %}
+  profiler.begin_layer();
+  {% if input_is_looked_up and node.op_type == 'Lookup' -%}
+  if (network_inputs_u8)
+    func_Lookup({{ graph_input.name }}_u8, {{ node.input_ops['lsb'].name }}, {{ node.input_ops['msb'].name }}, {{ node.name }}, thread_pool);
+  else
+    {{ node.view.run() }}
+  {%- else -%}
   {{ node.view.run() }}
+  {%- endif %}
+  profiler.end_layer(layer_info[{{ loop.index0 }}]);
 
   {% if config.debug -%}
     {# Temporary: better access to the quantizer #}
 
     {% if node.dtype.cpptype() in ['int', 'int32_t'] -%}
-      save_int32_data("debug/{{ node.name }}", {{ node.view.shape }}, 0, {{ node.name }}.data(), 3.0 / 2.0 );
+      save_int32_data("debug/{{ node.name }}", {{ node.view.shape }}, frame, {{ node.name }}.data(), 3.0 / 2.0 );
     {% elif node.dtype.cpptype() in ['unsigned', 'uint32_t'] -%}
-      save_uint32_data("debug/{{ node.name }}", {{ node.view.shape }}, 0, {{ node.name }}.data(), 1.0);
+      save_uint32_data("debug/{{ node.name }}", {{ node.view.shape }}, frame, {{ node.name }}.data(), 1.0);
     {% elif node.dtype.cpptype() == 'float' -%}
       {% if node.output_ops.keys()|length > 1 %}
         {% for k in node.output_ops.keys() -%}
@@ -378,14 +617,15 @@ bool Network::run(float *network_input, float *network_output)
           {{ '\n' -}}
         {%- endfor %}
       {% else %}
-        save_float32_data("debug/{{ node.name }}", {{ node.view.shape }}, 0, {{ node.name }}.data(), 1.0);
+        save_float32_data("debug/{{ node.name }}", {{ node.view.shape }}, frame, {{ node.name }}.data(), 1.0);
       {% endif %}
     {% endif %}
   {% endif %}
 
   {% endfor -%}
 
-  std::copy({{ graph_output.name }}.data(), {{ graph_output.name }}.data() + {{ graph_output.view.shape }}, network_output);
+    std::copy({{ graph_output.name }}.data(), {{ graph_output.name }}.data() + output_elems, network_outputs + frame * output_elems);
+  }
 
   return true;
 }
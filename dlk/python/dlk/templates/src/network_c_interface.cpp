@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+
 #include "network.h"
 
 
@@ -32,6 +34,56 @@ extern "C" __attribute__ ((visibility ("default"))) bool network_init(Network *n
   return nn->init();
 }
 
+extern "C" __attribute__ ((visibility ("default"))) void network_set_num_threads(Network *nn, int n)
+{
+  nn->set_num_threads(n);
+}
+
+extern "C" __attribute__ ((visibility ("default"))) void network_set_thread_affinity(Network *nn, const int *cpus, int n)
+{
+  nn->set_thread_affinity(cpus, n);
+}
+
+// parallel_for(pool, begin, end, grain, invoke, ctx) calls invoke(ctx, first, last)
+// on disjoint ranges of at most grain elements covering [begin, end) and
+// returns when all are done. it is called from several threads at once.
+extern "C" __attribute__ ((visibility ("default"))) void network_set_thread_pool(Network *nn,
+    ThreadPool::external_t parallel_for, void *pool, int num_threads)
+{
+  nn->set_thread_pool(parallel_for, pool, num_threads);
+}
+
+extern "C" __attribute__ ((visibility ("default"))) void network_set_weight_path(Network *nn, const char *path)
+{
+  nn->set_weight_path(path != nullptr ? path : "");
+}
+
+extern "C" __attribute__ ((visibility ("default"))) void network_enable_profiling(Network *nn, int capacity)
+{
+  nn->enable_profiling(capacity > 0 ? capacity : 0);
+}
+
+extern "C" __attribute__ ((visibility ("default"))) void network_clear_profile(Network *nn)
+{
+  nn->clear_profile();
+}
+
+// writes the profile (format 0: chrome trace json, 1: csv) to buf as a nul
+// terminated string, truncated to size - 1 characters. returns the length of
+// the whole profile, so a call with size 0 tells the buffer size to use.
+extern "C" __attribute__ ((visibility ("default"))) int network_get_profile(Network *nn, int format, char *buf, int size)
+{
+  if (format != 0 && format != 1)
+    return -1;
+  const auto profile = nn->get_profile(static_cast<dlk::ProfileFormat>(format));
+  if (buf != nullptr && size > 0) {
+    const auto n = std::min(profile.size(), static_cast<std::size_t>(size - 1));
+    std::copy(profile.begin(), profile.begin() + n, buf);
+    buf[n] = '\0';
+  }
+  return static_cast<int>(profile.size());
+}
+
 extern "C" __attribute__ ((visibility ("default"))) int network_get_input_rank(Network *nn)
 {
   return nn->get_input_rank();
@@ -52,7 +104,19 @@ extern "C" __attribute__ ((visibility ("default"))) void network_get_output_shap
   nn->get_output_shape(shape);
 }
 
-extern "C" __attribute__ ((visibility ("default"))) void network_run(Network *nn, float *input, float *output)
+extern "C" __attribute__ ((visibility ("default"))) bool network_run(Network *nn, float *input, float *output)
+{
+  return nn->run(input, output);
+}
+
+extern "C" __attribute__ ((visibility ("default"))) bool network_run_u8(Network *nn, const uint8_t *input, float *output)
+{
+  return nn->run_u8(input, output);
+}
+
+extern "C" __attribute__ ((visibility ("default"))) bool network_run_batch(Network *nn, int n, float *inputs, float *outputs)
 {
-  nn->run(input, output);
+  if (n <= 0)
+    return n == 0;
+  return nn->run_batch(n, inputs, outputs);
 }
@@ -16,16 +16,73 @@ limitations under the License.
 #include "global.h"
 #include "pack_input_to_qwords.h"
 #include "operators.h" // FIXME(nikolay): for convolution_parameters definition, rid of it later
+#include "cpu_features.h"
+#include "kernel_table.h"
+#include "thread_pool.h"
 #include "time_measurement.h"
 #ifdef USE_NEON
 #include <arm_neon.h>
 #endif
-#ifdef USE_AVX
+#ifdef DLK_X86
 #include <x86intrin.h>
 #endif
 
+#ifdef USE_NEON
+void pack_input_2bit_neon(const QUANTIZED_NOT_PACKED *input, std::size_t len,
+  QUANTIZED_PACKED *output) {
+  const uint8_t coeff_ary[16] = {
+    1, 2, 4, 8, 16, 32, 64, 128,
+    1, 2, 4, 8, 16, 32, 64, 128,
+  };
+  const auto coeff = vld1q_u8(coeff_ary);
+  const auto vone = vdupq_n_u8(1);
+  constexpr int b = 32;
+  constexpr int n_bits = 2;
+  const int blocks = len / b;
+  for (int i = 0; i < blocks; ++i) {
+    const auto v0 = vld1q_u8(input + i * b +  0);
+    const auto v1 = vld1q_u8(input + i * b + 16);
+    const auto l0 = vandq_u8(v0, vone);
+    const auto l1 = vandq_u8(v1, vone);
+    const auto m0 = vshrq_n_u8(v0, 1);
+    const auto m1 = vshrq_n_u8(v1, 1);
+    const auto ml0 = vmulq_u8(l0, coeff);
+    const auto ml1 = vmulq_u8(l1, coeff);
+    const auto mm0 = vmulq_u8(m0, coeff);
+    const auto mm1 = vmulq_u8(m1, coeff);
+    const auto al0 = vpadd_u8(vget_low_u8(ml0), vget_high_u8(ml0));
+    const auto al1 = vpadd_u8(vget_low_u8(ml1), vget_high_u8(ml1));
+    const auto am0 = vpadd_u8(vget_low_u8(mm0), vget_high_u8(mm0));
+    const auto am1 = vpadd_u8(vget_low_u8(mm1), vget_high_u8(mm1));
+    const auto bl = vpadd_u8(al0, al1);
+    const auto bm = vpadd_u8(am0, am1);
+    const auto c = vpadd_u8(bl, bm);
+    vst1_u8(reinterpret_cast<uint8_t*>(output + i * n_bits), c);
+  }
+}
+#endif
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+void pack_input_2bit_avx2(const QUANTIZED_NOT_PACKED *input, std::size_t len,
+  QUANTIZED_PACKED *output) {
+  constexpr std::size_t SIMD_WIDTH = 32;
+  const auto blocks = len / SIMD_WIDTH;
+  for (std::size_t i = 0; i < blocks; ++i) {
+    const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i * SIMD_WIDTH));
+    const auto l = _mm256_movemask_epi8(_mm256_slli_epi16(a, 7));
+    const auto m = _mm256_movemask_epi8(_mm256_slli_epi16(a, 6));
+    output[i*2 + 0] = QUANTIZED_PACKED(l);
+    output[i*2 + 1] = QUANTIZED_PACKED(m);
+  }
+}
+
+DLK_TARGET_END
+#endif
+
 int pack_input(QUANTIZED_NOT_PACKED input[], size_t input_height, size_t input_width, size_t input_depth,
-  size_t bits_per_input, QUANTIZED_PACKED output[]) {
+  size_t bits_per_input, QUANTIZED_PACKED output[], ThreadPool& thread_pool) {
 
   Measurement::Start("pack_input");
   const int bits_per_word = sizeof(QUANTIZED_PACKED) * CHAR_BIT;
@@ -35,58 +92,17 @@ int pack_input(QUANTIZED_NOT_PACKED input[], size_t input_height, size_t input_w
   int current_word = 0;
 
   auto len = input_height * input_width * input_depth;
-#ifdef USE_NEON
-  if (input_depth % 32 == 0) {
-    const uint8_t coeff_ary[16] = {
-      1, 2, 4, 8, 16, 32, 64, 128,
-      1, 2, 4, 8, 16, 32, 64, 128,
-    };
-    const auto coeff = vld1q_u8(coeff_ary);
-    const auto vone = vdupq_n_u8(1);
-    constexpr int b = 32;
-    constexpr int n_bits = 2;
-    const auto blocks = len / b;
-#pragma omp parallel for
-    for (int i = 0; i < blocks; ++i) {
-      const auto v0 = vld1q_u8(input + i * b +  0);
-      const auto v1 = vld1q_u8(input + i * b + 16);
-      const auto l0 = vandq_u8(v0, vone);
-      const auto l1 = vandq_u8(v1, vone);
-      const auto m0 = vshrq_n_u8(v0, 1);
-      const auto m1 = vshrq_n_u8(v1, 1);
-      const auto ml0 = vmulq_u8(l0, coeff);
-      const auto ml1 = vmulq_u8(l1, coeff);
-      const auto mm0 = vmulq_u8(m0, coeff);
-      const auto mm1 = vmulq_u8(m1, coeff);
-      const auto al0 = vpadd_u8(vget_low_u8(ml0), vget_high_u8(ml0));
-      const auto al1 = vpadd_u8(vget_low_u8(ml1), vget_high_u8(ml1));
-      const auto am0 = vpadd_u8(vget_low_u8(mm0), vget_high_u8(mm0));
-      const auto am1 = vpadd_u8(vget_low_u8(mm1), vget_high_u8(mm1));
-      const auto bl = vpadd_u8(al0, al1);
-      const auto bm = vpadd_u8(am0, am1);
-      const auto c = vpadd_u8(bl, bm);
-      vst1_u8(reinterpret_cast<uint8_t*>(output + i * n_bits), c);
-    }
-    Measurement::Stop();
-    return 0;
-  }
-#endif
-
-#ifdef USE_AVX
-  constexpr std::size_t SIMD_WIDTH = 32;
-  if ((input_depth % SIMD_WIDTH) == 0) {
-    const auto blocks = len / SIMD_WIDTH;
-    for (int i = 0; i < blocks; ++i) {
-      const auto a = _mm256_loadu_si256(reinterpret_cast<__m256i*>(input + i * SIMD_WIDTH));
-      const auto l = _mm256_movemask_epi8(_mm256_slli_epi16(a, 7));
-      const auto m = _mm256_movemask_epi8(_mm256_slli_epi16(a, 6));
-      output[i*2 + 0] = QUANTIZED_PACKED(l);
-      output[i*2 + 1] = QUANTIZED_PACKED(m);
-    }
+  const auto pack_2bit = dlk::kernels().pack_input_2bit;
+  if (pack_2bit != nullptr && bits_per_input == 2 && input_depth % 32 == 0) {
+    // 32 values make 2 words
+    const std::size_t blocks = len / 32;
+    const std::size_t chunk_size = (blocks + thread_pool.num_threads() - 1) / thread_pool.num_threads();
+    thread_pool.parallel_for(0, blocks, chunk_size, [&](std::size_t first, std::size_t last) {
+      pack_2bit(input + first * 32, (last - first) * 32, output + first * 2);
+    });
     Measurement::Stop();
     return 0;
   }
-#endif
 
   for (int h = 0; h < input_height; ++h)
       for (int w = 0; w < input_width; ++w) {
@@ -129,5 +145,5 @@ void pack_input_to_qwords(
   unsigned im2col_input_elems = p.output_height * p.output_width * kernel_elems;
 
   pack_input(input, bcp.normal_conv_params.input_height, bcp.normal_conv_params.input_width,
-    bcp.normal_conv_params.kernel_depth, bcp.bin_input_bitwidth, output);
+    bcp.normal_conv_params.kernel_depth, bcp.bin_input_bitwidth, output, *p.thread_pool);
 }
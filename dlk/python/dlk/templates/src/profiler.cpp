@@ -0,0 +1,159 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+#include "profiler.h"
+
+namespace dlk {
+
+namespace {
+
+thread_local Profiler *current_profiler = nullptr;
+
+void append_json_string(std::string& out, const char *s) {
+  out += '"';
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\')
+      out += '\\';
+    out += *s;
+  }
+  out += '"';
+}
+
+} // namespace
+
+void Profiler::enable(std::size_t capacity) {
+  std::vector<Event>(capacity).swap(events);
+  head = 0;
+  count = 0;
+  depth = 0;
+}
+
+void Profiler::clear() {
+  head = 0;
+  count = 0;
+}
+
+void Profiler::push(const char *name) {
+  if (depth < max_depth)
+    sections[depth] = Section{name, now()};
+  ++depth;
+}
+
+void Profiler::pop() {
+  if (depth == 0)
+    return;
+  --depth;
+  if (depth < max_depth)
+    record(sections[depth].name, "kernel", 0, 0, sections[depth].start_ns, now(), depth + 1);
+}
+
+void Profiler::record(const char *name, const char *op_type, std::uint64_t flops, std::uint64_t bytes,
+                      std::int64_t start_ns, std::int64_t end_ns, std::uint32_t event_depth) {
+  events[head] = Event{name, op_type, flops, bytes, start_ns, end_ns, frame, event_depth};
+  head = (head + 1) % events.size();
+  if (count < events.size())
+    ++count;
+}
+
+std::string Profiler::export_as(const std::vector<const Profiler*>& profilers, ProfileFormat format) {
+  std::vector<LaneEvent> events;
+  for (std::size_t i = 0; i < profilers.size(); ++i) {
+    if (profilers[i]->count == 0)
+      continue;
+    profilers[i]->for_each([&](const Event& e) { events.push_back(LaneEvent{e, std::uint32_t(i)}); });
+  }
+  // a frame runs on one lane, so this keeps the record order inside frames
+  std::stable_sort(events.begin(), events.end(),
+                   [](const LaneEvent& a, const LaneEvent& b) { return a.event.frame < b.event.frame; });
+
+  switch (format) {
+    case ProfileFormat::ChromeTrace: return chrome_trace(events);
+    case ProfileFormat::Csv: return csv(events);
+  }
+  return std::string();
+}
+
+std::string Profiler::chrome_trace(const std::vector<LaneEvent>& events) {
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  if (events.empty())
+    return out + "]}\n";
+
+  std::int64_t origin = INT64_MAX;
+  for (const auto& le : events)
+    origin = std::min(origin, le.event.start_ns);
+
+  bool first = true;
+  char buf[256];
+  for (const auto& le : events) {
+    const Event& e = le.event;
+    out += first ? "\n" : ",\n";
+    first = false;
+    out += "{\"name\":";
+    append_json_string(out, e.name);
+    out += ",\"cat\":";
+    append_json_string(out, e.op_type);
+    std::snprintf(buf, sizeof(buf),
+        ",\"ph\":\"X\",\"pid\":0,\"tid\":%" PRIu32 ",\"ts\":%.3f,\"dur\":%.3f,"
+        "\"args\":{\"frame\":%" PRIu32 ",\"flops\":%" PRIu64 ",\"bytes\":%" PRIu64 "}}",
+        le.lane, (e.start_ns - origin) / 1000.0, (e.end_ns - e.start_ns) / 1000.0,
+        e.frame, e.flops, e.bytes);
+    out += buf;
+  }
+  return out + "\n]}\n";
+}
+
+std::string Profiler::csv(const std::vector<LaneEvent>& events) {
+  std::string out = "frame,depth,name,op_type,start_us,duration_us,flops,bytes\n";
+  if (events.empty())
+    return out;
+
+  std::int64_t origin = INT64_MAX;
+  for (const auto& le : events)
+    origin = std::min(origin, le.event.start_ns);
+
+  char buf[128];
+  for (const auto& le : events) {
+    const Event& e = le.event;
+    std::snprintf(buf, sizeof(buf), "%" PRIu32 ",%" PRIu32 ",", e.frame, e.depth);
+    out += buf;
+    out += e.name;
+    out += ',';
+    out += e.op_type;
+    std::snprintf(buf, sizeof(buf), ",%.3f,%.3f,%" PRIu64 ",%" PRIu64 "\n",
+        (e.start_ns - origin) / 1000.0, (e.end_ns - e.start_ns) / 1000.0, e.flops, e.bytes);
+    out += buf;
+  }
+  return out;
+}
+
+Profiler *Profiler::current() {
+  return current_profiler;
+}
+
+Profiler::Session::Session(Profiler& profiler)
+    : previous(current_profiler) {
+  if (profiler.enabled())
+    current_profiler = &profiler;
+}
+
+Profiler::Session::~Session() {
+  current_profiler = previous;
+}
+
+} // namespace dlk
@@ -26,15 +26,14 @@ limitations under the License.
 #include <memory>
 
 #include "quantizer.h"
+#include "cpu_features.h"
+#include "kernel_table.h"
 #include "pack_input_to_qwords.h"
 #include "time_measurement.h"
 #ifdef USE_NEON
   #include <arm_neon.h>
 #endif
-#ifdef _OPENMP
-  #include <omp.h>
-#endif
-#ifdef USE_AVX
+#ifdef DLK_X86
   #include <x86intrin.h>
 #endif
 
@@ -68,7 +67,7 @@ void func_QTZ_binary_channel_wise_mean_scaling(
 }
 
 void func_QTZ_linear_mid_tread_half_body(
-  T_FLOAT input[],
+  const T_FLOAT input[],
   T_INT nbit,
   T_FLOAT max_value,
   QUANTIZED_NOT_PACKED output[],
@@ -107,10 +106,36 @@ void func_QTZ_linear_mid_tread_half_body(
     const auto narrow2 = vmovn_u16(vcombine_u16(narrow10, narrow11));
     vst1_u8(output + i, narrow2);
   }
-#elif defined USE_AVX
+#endif
+
+  for (; i < static_cast<int>(end); ++i)
+  {
+    T_FLOAT tmp = std::max(input[i], (T_FLOAT)min_value);
+    tmp = std::min(tmp, max_value);
+    output[i] = (T_INT)roundf(tmp * (max_value_r * n));
+  }
+}
+
+#ifdef DLK_X86
+DLK_TARGET_AVX2_BEGIN
+
+void func_QTZ_linear_mid_tread_half_body_avx2(
+  const T_FLOAT input[],
+  T_INT nbit,
+  T_FLOAT max_value,
+  QUANTIZED_NOT_PACKED output[],
+  T_UINT begin,
+  T_UINT end)
+
+{
+  T_FLOAT max_value_r = 1.0f / max_value;
+
+  T_FLOAT min_value = 0.f;
+  T_FLOAT n = (1 << nbit) - 1.f;
+  int i = begin;
+
   const auto max_value_v = _mm256_set1_ps(max_value);
   const auto min_value_v = _mm256_set1_ps(min_value);
-  const auto round_offset = _mm256_set1_ps(0.5f);
   const auto max_value_rn = _mm256_set1_ps(max_value_r * n);
 
   for (; i <= static_cast<int>(end) - 32; i += 32) {
@@ -141,7 +166,6 @@ void func_QTZ_linear_mid_tread_half_body(
     const auto pack = _mm256_packs_epi16(perm02, perm13);
     _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), pack);
   }
-#endif
 
   for (; i < static_cast<int>(end); ++i)
   {
@@ -151,35 +175,35 @@ void func_QTZ_linear_mid_tread_half_body(
   }
 }
 
-static const auto output_not_packed = std::make_unique<QUANTIZED_NOT_PACKED[]>(MAX_SIZE_INPUTS_PER_LAYER);
+DLK_TARGET_END
+#endif
 
 void func_QTZ_linear_mid_tread_half(
     const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
     const TensorView<T_INT, MemoryLayout::Atom>& nbit,
     const TensorView<T_FLOAT, MemoryLayout::Atom>& max_value,
-    const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& output) {
+    const TensorView<QUANTIZED_PACKED, MemoryLayout::HWChBCl>& output,
+    const Workspace& workspace,
+    ThreadPool& thread_pool) {
   Measurement::Start("QTZ_linear_mid_tread_half");
 
+  QUANTIZED_NOT_PACKED *output_not_packed = workspace.quantizer_buf();
+
   unsigned num_elems = input.size();
 
-#ifdef _OPENMP
-  const unsigned threads = omp_get_max_threads();
-#else
-  const unsigned threads = 1;
-#endif
+  const unsigned threads = thread_pool.num_threads();
   unsigned int chunk_size = (num_elems + threads - 1) / threads;
 
-#pragma omp parallel for
-  for (unsigned int i = 0; i < num_elems; i += chunk_size) {
-    func_QTZ_linear_mid_tread_half_body(input.data(), nbit(), max_value(), output_not_packed.get(), i,
-                                              std::min(i + chunk_size, static_cast<unsigned int>(num_elems)));
-  }
+  const auto quantize = dlk::kernels().quantize_linear;
+  thread_pool.parallel_for(0, num_elems, chunk_size, [&](std::size_t first, std::size_t last) {
+    quantize(input.data(), nbit(), max_value(), output_not_packed, first, last);
+  });
 
   const auto in_shape = input.get_shape();
   const auto in_height = in_shape[1];
   const auto in_width = in_shape[2];
   const auto in_depth = in_shape[3];
-  pack_input(output_not_packed.get(), in_height, in_width, in_depth, nbit(), output.data());
+  pack_input(output_not_packed, in_height, in_width, in_depth, nbit(), output.data(), thread_pool);
 
   Measurement::Stop();
 }
@@ -188,7 +212,9 @@ void func_QTZ_linear_mid_tread_half(
   const TensorView<T_FLOAT, MemoryLayout::NHWC>& input,
   const TensorView<T_INT, MemoryLayout::Atom>& nbit,
   const TensorView<T_FLOAT, MemoryLayout::Atom>& max_value,
-  const TensorView<T_FLOAT, MemoryLayout::NHWC>& output) {
+  const TensorView<T_FLOAT, MemoryLayout::NHWC>& output,
+  const Workspace& workspace,
+  ThreadPool& thread_pool) {
   Measurement::Start("func_QTZ_linear_mid_tread_half");
 
   T_FLOAT min_value = 0.f;
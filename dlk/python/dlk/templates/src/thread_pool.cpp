@@ -0,0 +1,267 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "thread_pool.h"
+
+namespace {
+
+// number of polls of the job counter before a thread goes to sleep.
+// layers follow each other closely, so a short spin avoids most wake ups.
+constexpr int spin_count = 4096;
+
+// set in the workers and in a caller while it takes part in a job, so that a
+// kernel called from inside a parallel_for runs serially instead of deadlocking.
+thread_local bool inside_pool = false;
+
+} // namespace
+
+void ThreadPool::RangesDeleter::operator()(Range *r) const
+{
+  for (std::size_t i = 0; i < count; ++i)
+    r[i].~Range();
+  free(r);
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for (auto& th : workers)
+    th.join();
+}
+
+bool ThreadPool::init(std::size_t num_threads, const std::vector<int>& cpus)
+{
+  if (!workers.empty() || external != nullptr)
+  {
+    std::cout << "Error: thread pool already initialized" << std::endl;
+    return false;
+  }
+
+  if (num_threads == 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  void *mem = nullptr;
+  if (posix_memalign(&mem, alignof(Range), sizeof(Range) * num_threads) != 0)
+  {
+    std::cout << "Error: cannot allocate the thread pool ranges" << std::endl;
+    return false;
+  }
+  Range *r = static_cast<Range*>(mem);
+  for (std::size_t i = 0; i < num_threads; ++i)
+    new (r + i) Range();
+  ranges = std::unique_ptr<Range[], RangesDeleter>(r, RangesDeleter{num_threads});
+
+  for (std::size_t i = 0; i + 1 < num_threads; ++i)
+  {
+    workers.emplace_back(&ThreadPool::worker_main, this, i);
+
+#ifdef __linux__
+    if (!cpus.empty())
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpus[i % cpus.size()], &set);
+      if (pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set) != 0)
+      {
+        std::cout << "Error: cannot pin worker " << i << " to cpu " << cpus[i % cpus.size()] << std::endl;
+        return false;
+      }
+    }
+#endif
+  }
+
+  return true;
+}
+
+bool ThreadPool::init_external(external_t parallel_for, void *pool, std::size_t num_threads)
+{
+  if (!workers.empty() || external != nullptr)
+  {
+    std::cout << "Error: thread pool already initialized" << std::endl;
+    return false;
+  }
+
+  external = parallel_for;
+  external_pool = pool;
+  external_threads = std::max<std::size_t>(num_threads, 1);
+  return true;
+}
+
+void ThreadPool::run(std::size_t begin, std::size_t end, std::size_t grain, invoke_t invoke, void *ctx)
+{
+  if (begin >= end)
+    return;
+
+  grain = std::max<std::size_t>(grain, 1);
+
+  if (external != nullptr)
+  {
+    external(external_pool, begin, end, grain, invoke, ctx);
+    return;
+  }
+
+  if (workers.empty() || inside_pool || end - begin <= grain)
+  {
+    for (std::size_t first = begin; first < end; first += grain)
+      invoke(ctx, first, std::min(first + grain, end));
+    return;
+  }
+
+  const std::size_t n = num_threads();
+  const std::size_t count = end - begin;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    std::lock_guard<std::mutex> lock(ranges[i].mutex);
+    ranges[i].next = begin + count * i / n;
+    ranges[i].end = begin + count * (i + 1) / n;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    job_invoke = invoke;
+    job_ctx = ctx;
+    job_grain = grain;
+    pending.store(workers.size(), std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+  }
+  wake.notify_all();
+
+  // the calling thread takes the last range
+  inside_pool = true;
+  work(n - 1);
+  inside_pool = false;
+
+  for (int i = 0; i < spin_count && pending.load(std::memory_order_acquire) != 0; ++i)
+    std::this_thread::yield();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return pending.load(std::memory_order_acquire) == 0; });
+}
+
+void ThreadPool::work(std::size_t self)
+{
+  Range& own = ranges[self];
+
+  for (;;)
+  {
+    std::size_t first = 0;
+    std::size_t last = 0;
+    {
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (own.next < own.end)
+      {
+        first = own.next;
+        last = std::min(first + job_grain, own.end);
+        own.next = last;
+      }
+    }
+
+    if (first < last)
+      job_invoke(job_ctx, first, last);
+    else if (!steal(self))
+      return;
+  }
+}
+
+bool ThreadPool::steal(std::size_t self)
+{
+  const std::size_t n = num_threads();
+
+  for (;;)
+  {
+    // pick the thread with the most work left
+    std::size_t victim = n;
+    std::size_t most = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      if (i == self)
+        continue;
+      std::lock_guard<std::mutex> lock(ranges[i].mutex);
+      const std::size_t left = ranges[i].end - std::min(ranges[i].next, ranges[i].end);
+      if (left > most)
+      {
+        most = left;
+        victim = i;
+      }
+    }
+
+    if (victim == n)
+      return false;
+
+    std::size_t first;
+    std::size_t last;
+    {
+      std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+      Range& r = ranges[victim];
+      if (r.next >= r.end)
+        continue; // the victim finished in the meantime, look again
+
+      const std::size_t left = r.end - r.next;
+      first = left <= job_grain ? r.next : r.end - left / 2;
+      last = r.end;
+      r.end = first;
+    }
+
+    std::lock_guard<std::mutex> lock(ranges[self].mutex);
+    ranges[self].next = first;
+    ranges[self].end = last;
+    return true;
+  }
+}
+
+void ThreadPool::worker_main(std::size_t self)
+{
+  inside_pool = true;
+  uint64_t seen = 0;
+
+  for (;;)
+  {
+    for (int i = 0; i < spin_count && generation.load(std::memory_order_acquire) == seen; ++i)
+      std::this_thread::yield();
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this, seen] {
+        return stopping || generation.load(std::memory_order_acquire) != seen;
+      });
+      if (stopping)
+        return;
+      seen = generation.load(std::memory_order_acquire);
+    }
+
+    work(self);
+
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done.notify_one();
+    }
+  }
+}
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include <algorithm>
 
+#include "profiler.h"
 #include "time_measurement.h"
 
 std::map<std::string, std::vector<Measurement::measure> > Measurement::times;
@@ -23,17 +24,29 @@ std::vector<Measurement::Node*> Measurement::stack;
 std::vector<std::unique_ptr<Measurement::Node>> Measurement::roots;
 
 #ifndef FUNC_TIME_MEASUREMENT
-/* NOP */
-void Measurement::Start(const std::string &measure_name){}
-void Measurement::Stop(){}
+void Measurement::Start(const char *measure_name)
+{
+  if (auto* profiler = dlk::Profiler::current())
+    profiler->push(measure_name);
+}
+
+void Measurement::Stop()
+{
+  if (auto* profiler = dlk::Profiler::current())
+    profiler->pop();
+}
+
 void Measurement::Report(){}
 void Measurement::DumpTimeTree(const Node& node, int level){}
 #else
-void Measurement::Start(const std::string &measure_name)
+void Measurement::Start(const char *measure_name)
 {
+  if (auto* profiler = dlk::Profiler::current())
+    profiler->push(measure_name);
+
   measure m;
-  m.start = std::chrono::system_clock::now();
-  m.end = std::chrono::system_clock::time_point();
+  m.start = std::chrono::steady_clock::now();
+  m.end = std::chrono::steady_clock::time_point();
 
   if (stack.empty()) {
       roots.emplace_back(std::make_unique<Node>(measure_name, 0));
@@ -60,6 +73,9 @@ void Measurement::Start(const std::string &measure_name)
 
 void Measurement::Stop()
 {
+  if (auto* profiler = dlk::Profiler::current())
+    profiler->pop();
+
   if(current_context.size() == 0 || times[current_context.back()].size() == 0) {
     std::cout << "ERROR: wrong Start/Stop pairs" << std::endl;
     return;
@@ -70,10 +86,10 @@ void Measurement::Stop()
     return;
   }
 
-  stack.back()->measurements.back().end = std::chrono::system_clock::now();
+  stack.back()->measurements.back().end = std::chrono::steady_clock::now();
   stack.pop_back();
 
-  times[current_context.back()].back().end = std::chrono::system_clock::now();
+  times[current_context.back()].back().end = std::chrono::steady_clock::now();
   current_context.pop_back();
 }
 
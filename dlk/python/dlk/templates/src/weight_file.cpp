@@ -0,0 +1,147 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "weight_file.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dlk {
+
+constexpr char WeightFile::magic[8];
+constexpr std::uint32_t WeightFile::version;
+
+bool WeightFile::open(const std::string& file_path)
+{
+  close();
+
+  const int fd = ::open(file_path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    std::cout << "Error: cannot open " << file_path << ": " << std::strerror(errno) << std::endl;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+    std::cout << "Error: " << file_path << " is not a weight file" << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  // private so that a kernel writing to its constants, which the arrays
+  // compiled into the library allowed, gets its own copy of the page
+  void *mapped = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    std::cout << "Error: cannot map " << file_path << ": " << std::strerror(errno) << std::endl;
+    return false;
+  }
+  base = static_cast<std::uint8_t*>(mapped);
+  size = st.st_size;
+  path = file_path;
+
+  const auto *header = reinterpret_cast<const Header*>(base);
+  const char *error = nullptr;
+  if (std::memcmp(header->magic, magic, sizeof(magic)) != 0)
+    error = "is not a weight file";
+  else if (header->version != version)
+    error = "has an unsupported version";
+  else if (header->file_size != size)
+    error = "is truncated";
+  else if (header->num_entries > (size - sizeof(Header)) / sizeof(Entry))
+    error = "has a broken entry table";
+
+  if (error == nullptr) {
+    entries = reinterpret_cast<const Entry*>(base + sizeof(Header));
+    num_entries = header->num_entries;
+    for (std::uint32_t i = 0; i < num_entries && error == nullptr; ++i) {
+      const Entry& e = entries[i];
+      // data aligned for any element type, the generator aligns it to 64 bytes
+      if (e.offset > size || e.size > size - e.offset || e.offset % alignof(std::max_align_t) != 0 ||
+          e.name_offset > size || e.name_size >= size - e.name_offset ||
+          base[e.name_offset + e.name_size] != '\0')
+        error = "has a broken entry table";
+    }
+  }
+
+  if (error != nullptr) {
+    std::cout << "Error: " << file_path << " " << error << std::endl;
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void WeightFile::close()
+{
+  if (base != nullptr)
+    munmap(base, size);
+  base = nullptr;
+  size = 0;
+  entries = nullptr;
+  num_entries = 0;
+  path.clear();
+}
+
+void *WeightFile::find(const char *name, std::size_t bytes) const
+{
+  for (std::uint32_t i = 0; i < num_entries; ++i) {
+    const Entry& e = entries[i];
+    if (std::strcmp(reinterpret_cast<const char*>(base + e.name_offset), name) != 0)
+      continue;
+    if (e.size < bytes) {
+      std::cout << "Error: " << name << " in " << path << " holds " << e.size
+                << " bytes instead of " << bytes << std::endl;
+      return nullptr;
+    }
+    return base + e.offset;
+  }
+
+  std::cout << "Error: " << name << " is missing from " << path << std::endl;
+  return nullptr;
+}
+
+std::string default_weight_path()
+{
+  const char *env = std::getenv("DLK_WEIGHTS");
+  if (env != nullptr && env[0] != '\0')
+    return env;
+
+  // next to the shared library, or the executable this file is linked into
+  Dl_info info;
+  if (dladdr(reinterpret_cast<void*>(&default_weight_path), &info) != 0 && info.dli_fname != nullptr) {
+    const std::string object = info.dli_fname;
+    const auto slash = object.rfind('/');
+    if (slash != std::string::npos) {
+      const std::string path = object.substr(0, slash + 1) + "weights.bin";
+      if (access(path.c_str(), R_OK) == 0)
+        return path;
+    }
+  }
+
+  return "weights.bin";
+}
+
+} // namespace dlk
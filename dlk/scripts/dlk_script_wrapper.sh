@@ -224,6 +224,7 @@ then
 	make_each_target ar_arm libdlk_arm.a ${OUTPUT_DATA_DIR}
 	make_each_target ar_aarch64 libdlk_aarch64.a ${OUTPUT_DATA_DIR}
 	make_each_target ar_fpga libdlk_fpga.a ${OUTPUT_DATA_DIR}
+	cp weights.bin ${OUTPUT_DATA_DIR}
 fi
 
 
@@ -0,0 +1,82 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Test file for ActivationArena."""
+import unittest
+from core.activation_arena import ActivationArena
+from core.data_types import Float32
+from core.graph import Graph
+from core.operators import Add, Conv, Input, MaxPool, Output, Constant, Relu
+import numpy as np
+
+
+class TestActivationArena(unittest.TestCase):
+    """Test class for ActivationArena."""
+
+    @staticmethod
+    def create_sample_graph() -> Graph:
+        """Make conv -> relu -> conv -> relu -> add(relu1, relu2) -> maxpool.
+
+        test_layer_cost.py shares this graph.
+        """
+        graph = Graph()
+        x = Input('input', [1, 8, 8, 3], Float32())
+        w1 = Constant('w1', Float32(), np.zeros([4, 3, 3, 3]))
+        conv1 = Conv('conv1', [1, 8, 8, 4], Float32(), {'X': x, 'W': w1}, kernel_shape=[3, 3], pads=[1, 1, 1, 1])
+        relu1 = Relu('relu1', [1, 8, 8, 4], Float32(), {'X': conv1})
+        w2 = Constant('w2', Float32(), np.zeros([4, 1, 1, 4]))
+        conv2 = Conv('conv2', [1, 8, 8, 4], Float32(), {'X': relu1, 'W': w2}, kernel_shape=[1, 1])
+        relu2 = Relu('relu2', [1, 8, 8, 4], Float32(), {'X': conv2})
+        add = Add('add', [1, 8, 8, 4], Float32(), {'A': relu2, 'B': relu1})
+        pool = MaxPool('pool', [1, 4, 4, 4], Float32(), {'X': add}, kernel_shape=[2, 2], strides=[2, 2])
+        y = Output('output', [1, 4, 4, 4], Float32(), {'input': pool})
+
+        for op in [x, w1, conv1, relu1, w2, conv2, relu2, add, pool, y]:
+            graph.add_op(op)
+
+        return graph
+
+    def test_liveness(self) -> None:
+        """Each buffer is alive from its producer to its last consumer."""
+        arena = ActivationArena(self.create_sample_graph())
+        lifetimes = {b.name: (b.first, b.last) for b in arena.buffers}
+
+        self.assertEqual(lifetimes['conv1'], (0, 1))
+        self.assertEqual(lifetimes['relu1'], (1, 4))
+        self.assertEqual(lifetimes['conv2'], (2, 3))
+        self.assertEqual(lifetimes['relu2'], (3, 4))
+        self.assertEqual(lifetimes['add'], (4, 5))
+        # the graph output outlives the last operator
+        self.assertEqual(lifetimes['pool'], (5, 6))
+
+    def test_offsets(self) -> None:
+        """Buffers alive at the same time never overlap, others are reused."""
+        arena = ActivationArena(self.create_sample_graph(), alignment=64)
+
+        for a in arena.buffers:
+            self.assertEqual(a.offset % 64, 0)
+            self.assertLessEqual(a.offset + a.nbytes, arena.size)
+            for b in arena.buffers:
+                if a is b or not a.overlaps(b):
+                    continue
+                disjoint = a.offset + a.nbytes <= b.offset or b.offset + b.nbytes <= a.offset
+                self.assertTrue(disjoint, f'{a.name} and {b.name} overlap in the arena')
+
+        self.assertEqual(arena.size, 3 * 8 * 8 * 4 * 4)
+        self.assertLess(arena.size, arena.naive_size)
+
+
+if __name__ == '__main__':
+    unittest.main()
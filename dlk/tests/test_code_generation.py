@@ -287,6 +287,21 @@ def get_configurations():
                       'use_avx': True,
                       'threshold_skipping': True}),
 
+        # Classification / aarch64 NEON, run under qemu-aarch64
+        updated_dict(dict_codegen_classification_x86(),
+                     {'cpu_name': 'aarch64', 'hard_quantize': True}),
+        updated_dict(dict_codegen_classification_cpu_hq_ts(), {'cpu_name': 'aarch64'}),
+
+        # Classification resnet / aarch64 NEON
+        updated_dict(dict_codegen_resnet_classification_x86(),
+                     {'cpu_name': 'aarch64', 'hard_quantize': True}),
+        updated_dict(dict_codegen_resnet_classification_x86(),
+                     {'cpu_name': 'aarch64', 'hard_quantize': True, 'threshold_skipping': True}),
+
+        # Detection / aarch64 NEON
+        updated_dict(dict_codegen_object_detection_x86(),
+                     {'cpu_name': 'aarch64', 'hard_quantize': True, 'threshold_skipping': True}),
+
         # Classification FPGA
         dict_codegen_classification_fpga(),
         updated_dict(dict_codegen_classification_fpga(),
@@ -422,6 +437,42 @@ class TestCodeGeneration(TestCaseDLKBase):
         percent_failed = inference.main_test(image, library, expected_output_npy, from_npy=from_npy)
         return percent_failed
 
+    def run_binary_on_qemu(self, project_dir: str, output_path: str,
+                           input_npy: str, expected_output_npy: str) -> float:
+        """Cross built debug binary run by qemu-aarch64, returns the percentage of wrong output values."""
+
+        run_and_check(['make', 'VERBOSE=1', 'lm', '-j8'],
+                      project_dir,
+                      join(output_path, "make_lm.out"),
+                      join(output_path, "make_lm.err"),
+                      self,
+                      check_stdout_include=['Building'],
+                      check_stderr_block=['error: ']
+                      )
+
+        sysroot = os.environ.get('QEMU_LD_PREFIX', '/usr/aarch64-linux-gnu')
+        run_and_check(['qemu-aarch64', '-L', sysroot, './lm_aarch64', input_npy, expected_output_npy],
+                      project_dir,
+                      join(output_path, "qemu.out"),
+                      join(output_path, "qemu.err"),
+                      self,
+                      check_stdout_include=['Comparison: Default network test']
+                      )
+
+        # the binary lists the values off by more than its own tolerance, they
+        # are judged again with the one of run_library
+        diff_file = join(project_dir, 'Default network test .diff')
+        n_failed = 0
+        if os.path.exists(diff_file):
+            with open(diff_file, "r") as diffs:
+                for line in diffs:
+                    fields = dict(field.split(': ') for field in line.strip().split(', '))
+                    rtol = atol = 0.0001
+                    if not np.isclose(float(fields['in']), float(fields['ex']), rtol=rtol, atol=atol):
+                        n_failed += 1
+
+        return (n_failed / np.load(expected_output_npy).size) * 100.0
+
     def run_library_on_remote(self,
                               host: str,
                               output_path: str,
@@ -515,6 +566,9 @@ class TestCodeGeneration(TestCaseDLKBase):
         if need_arm_compiler:
             if shutil.which('arm-linux-gnueabihf-g++') is None:
                 raise unittest.SkipTest('No arm compiler.')
+        if cpu_name == 'aarch64':
+            if shutil.which('aarch64-linux-gnu-g++') is None or shutil.which('qemu-aarch64') is None:
+                raise unittest.SkipTest('No aarch64 compiler or qemu-aarch64.')
 
         dir_tags = [str(test_id), prefix, basename(model_path), cpu_name]
         dir_tags = dir_tags + ['hq'] if hard_quantize else dir_tags
@@ -558,6 +612,7 @@ class TestCodeGeneration(TestCaseDLKBase):
         self.assertTrue(os.path.exists(project_dir))
 
         cmake_use_arm =  '-DTOOLCHAIN_NAME=linux_arm'
+        cmake_use_aarch64 = '-DTOOLCHAIN_NAME=linux_aarch64'
         cmake_use_neon = '-DUSE_NEON=1'
         cmake_use_fpga = '-DRUN_ON_FPGA=1'
         cmake_use_avx =  '-DUSE_AVX=1'
@@ -567,6 +622,8 @@ class TestCodeGeneration(TestCaseDLKBase):
             cmake_defs += [cmake_use_arm, cmake_use_neon]
         if cpu_name == 'arm_fpga':
             cmake_defs += [cmake_use_arm, cmake_use_neon, cmake_use_fpga]
+        if cpu_name == 'aarch64':
+            cmake_defs += [cmake_use_aarch64, cmake_use_neon]
         if use_avx == True:
             cmake_defs += [cmake_use_avx]
 
@@ -592,6 +649,8 @@ class TestCodeGeneration(TestCaseDLKBase):
         if not use_run_test_script:
             if cpu_name == 'x86_64':
                 percent_failed = self.run_library(generated_lib, input_path, expected_output_path)
+            elif cpu_name == 'aarch64':
+                percent_failed = self.run_binary_on_qemu(project_dir, output_path, input_path, expected_output_path)
             else:
                 percent_failed = \
                     self.run_library_on_remote(FPGA_HOST, output_path, generated_lib, input_path, expected_output_path)
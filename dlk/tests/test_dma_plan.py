@@ -0,0 +1,83 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Test file for DmaPlan."""
+import unittest
+from core.data_types import Float32, QUANTIZED_PACKED
+from core.dma_plan import DmaPlan
+from core.graph import Graph
+from core.operators import Conv, Input, Output, Constant, Relu
+import numpy as np
+
+
+class TestDmaPlan(unittest.TestCase):
+    """Test class for DmaPlan."""
+
+    @staticmethod
+    def qconv(name: str, x, graph: Graph) -> Conv:
+        w = Constant(name + '_w', Float32(), np.zeros([32, 3, 3, 32]))
+        conv = Conv(name, [1, 8, 8, 32], QUANTIZED_PACKED(), {'X': x, 'W': w},
+                    kernel_shape=[3, 3], pads=[1, 1, 1, 1], quantized=True)
+        graph.add_op(w)
+        graph.add_op(conv)
+        return conv
+
+    def make_chain(self, branch: bool) -> Graph:
+        """Make relu -> conv1 -> conv2 -> conv3 -> relu, optionally with conv1 also feeding conv3."""
+        graph = Graph()
+        x = Input('input', [1, 8, 8, 32], Float32())
+        graph.add_op(x)
+        pre = Relu('pre', [1, 8, 8, 32], QUANTIZED_PACKED(), {'X': x})
+        graph.add_op(pre)
+
+        conv1 = self.qconv('conv1', pre, graph)
+        conv2 = self.qconv('conv2', conv1, graph)
+        conv3 = self.qconv('conv3', conv2, graph)
+        if branch:
+            conv1.add_output('Y', conv3)
+
+        post = Relu('post', [1, 8, 8, 32], Float32(), {'X': conv3})
+        y = Output('output', [1, 8, 8, 32], Float32(), {'input': post})
+        graph.add_op(post)
+        graph.add_op(y)
+
+        # packed the way the optimizer packs thresholded convolutions
+        for op in [pre, conv1, conv2, conv3]:
+            op.update_shape([1, 8, 8, 2, 32], 'ChHWBCl')
+
+        return graph
+
+    def test_chain_ping_pongs(self) -> None:
+        """Activations read only by the next convolution stay in the DMA buffers, which swap roles."""
+        plan = DmaPlan(self.make_chain(branch=False))
+
+        self.assertEqual([(t.name, t.buffer) for t in plan.tensors],
+                         [('pre', 0), ('conv1', 1), ('conv2', 0)])
+        self.assertEqual([(c.name, c.input_buffer, c.output_buffer) for c in plan.convs],
+                         [('conv1', 0, 1), ('conv2', 1, 0), ('conv3', 0, 1)])
+        self.assertTrue(plan.swaps_buffers)
+
+    def test_shared_activation_stays_in_arena(self) -> None:
+        """An activation with a second consumer is copied, and the chain restarts from the defaults."""
+        plan = DmaPlan(self.make_chain(branch=True))
+
+        self.assertEqual([(t.name, t.buffer) for t in plan.tensors],
+                         [('pre', 0), ('conv2', 1)])
+        self.assertEqual([(c.name, c.input_buffer, c.output_buffer) for c in plan.convs],
+                         [('conv1', 0, 1), ('conv2', 0, 1), ('conv3', 1, 0)])
+
+
+if __name__ == '__main__':
+    unittest.main()
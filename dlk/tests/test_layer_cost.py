@@ -0,0 +1,45 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Test file for layer_costs."""
+import unittest
+from core.layer_cost import layer_costs
+import test_activation_arena
+
+
+class TestLayerCost(unittest.TestCase):
+    """Test class for layer_costs."""
+
+    def test_costs(self) -> None:
+        """Every operator gets its flops and the bytes of its inputs and output, in run order."""
+        graph = test_activation_arena.TestActivationArena.create_sample_graph()
+        costs = layer_costs(graph)
+
+        self.assertEqual([c.name for c in costs], ['conv1', 'relu1', 'conv2', 'relu2', 'add', 'pool'])
+        self.assertEqual([c.op_type for c in costs], ['Conv', 'Relu', 'Conv', 'Relu', 'Add', 'MaxPool'])
+
+        conv1, relu1, conv2, relu2, add, pool = costs
+        self.assertEqual(conv1.flops, 2 * 8 * 8 * 4 * 3 * 3 * 3)
+        self.assertEqual(conv1.nbytes, 4 * (8 * 8 * 4 + 8 * 8 * 3 + 4 * 3 * 3 * 3))
+        self.assertEqual(relu1.flops, 8 * 8 * 4)
+        self.assertEqual(relu1.nbytes, 4 * 2 * 8 * 8 * 4)
+        self.assertEqual(conv2.flops, 2 * 8 * 8 * 4 * 4)
+        self.assertEqual(add.flops, 8 * 8 * 4)
+        self.assertEqual(add.nbytes, 4 * 3 * 8 * 8 * 4)
+        self.assertEqual(pool.flops, 4 * 4 * 4 * 2 * 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
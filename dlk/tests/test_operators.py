@@ -82,6 +82,35 @@ class TestOperators(unittest.TestCase):
 
         print("Conv test passed!")
 
+    def test_conv_dilation(self) -> None:
+        """Test code for the output shape of a dilated Conv."""
+        x = Input(
+            'input',
+            [1, 9, 9, 3],
+            Float32(),
+        )
+        w = Constant(
+            'weight',
+            Float32(),
+            np.zeros([4, 5, 5, 3])
+        )
+        # a 5x5 kernel with dilation 2 spans 9 pixels
+        c = Conv(
+            "conv1",
+            [1, 3, 3, 4],
+            Float32(),
+            {'X': x, 'W': w},
+            kernel_shape=[5, 5],
+            dilations=[2, 2],
+            pads=[1, 1, 1, 1]
+        )
+
+        self.assertEqual(c.height, 3)
+        self.assertEqual(c.width, 3)
+        self.assertEqual(c.dilations, [2, 2])
+
+        print("Conv dilation test passed!")
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -18,11 +18,12 @@ import unittest
 from core.data_types import Float32, PackedUint32, Int32, QUANTIZED_PACKED
 from core.optimizer import pass_remove_identities, pass_transpose, pass_constant_folding, \
     pass_propagate_quantization_details_into_conv, pass_compute_thresholds, pass_pack_weights, \
-    pass_quantize_convolutions, pass_propagate_datatypes, pass_propagate_output_type_backward
+    pass_quantize_convolutions, pass_propagate_datatypes, pass_propagate_output_type_backward, \
+    pass_fuse_conv_epilogue
 from core.graph import Graph
 from core.operators import Add, AveragePool, BatchNormalization, Constant, Conv, Identity, Input, \
-    MaxPool, Operator, Output, Transpose, QTZ_binary_mean_scaling, QTZ_linear_mid_tread_half, Reshape, Softmax, \
-    SpaceToDepth
+    LeakyRelu, MaxPool, Operator, Output, Transpose, QTZ_binary_mean_scaling, QTZ_linear_mid_tread_half, Reshape, \
+    Softmax, SpaceToDepth
 
 import numpy as np
 
@@ -514,6 +515,75 @@ class TestPassComputeThresholds(unittest.TestCase):
         return graph
 
 
+class TestPassFuseConvEpilogue(unittest.TestCase):
+    """Test class for fusing batch normalization and activation into quantized convolution."""
+    def test_pass_fuse_conv_epilogue(self) -> None:
+        """Test pass."""
+        data = np.float32(np.random.rand(3, 2, 2, 3))
+        gamma = np.float32(np.random.rand(3) + 0.5)
+        beta = np.float32(np.random.rand(3))
+        mean = np.float32(np.random.rand(3))
+        var = np.float32(np.random.rand(3) + 0.5)
+        graph1 = self.create_sample_graph(data, gamma, beta, mean, var)
+
+        pass_fuse_conv_epilogue(graph1)
+
+        conv = graph1.get_op('conv')
+        self.assertIsNone(graph1.get_op('bn'), '[Failed] Found batch normalization not removed')
+        self.assertIsNone(graph1.get_op('act'), '[Failed] Found activation not removed')
+        self.assertIsNone(graph1.get_op('gamma'), '[Failed] Found batch normalization parameter not removed')
+        self.assertEqual(graph1.get_op('output').input_ops['input'], conv,
+                         '[Failed] Found output not connected to conv')
+
+        factor = gamma / np.sqrt(var + 1e-3)
+        self.assertTrue(conv.has_epilogue, '[Failed] Found conv without epilogue')
+        np.testing.assert_allclose(conv.epilogue_scale, 0.5 * 2.0 / 3.0 * factor, rtol=1e-5)
+        np.testing.assert_allclose(conv.epilogue_shift, beta - mean * factor, rtol=1e-5, atol=1e-6)
+        self.assertEqual(conv.epilogue_activation, 'LeakyRelu', '[Failed] Found activation not proper')
+        self.assertAlmostEqual(conv.epilogue_alpha, 0.1)
+
+        print("Test pass #10 fuse_conv_epilogue passed!")
+
+    @staticmethod
+    def create_sample_graph(data: np.ndarray, gamma: np.ndarray, beta: np.ndarray,
+                            mean: np.ndarray, var: np.ndarray) -> Graph:
+        graph = Graph()
+
+        # input
+        x = Input('placeholder', [1, 5, 5, 3], Float32())
+
+        # activation quantizer
+        s1 = Constant('aq_const1', Float32(), np.array(1))
+        s2 = Constant('aq_const2', Float32(), np.array(2))
+        aq = QTZ_linear_mid_tread_half('aqtz', [1, 5, 5, 3], Float32(), {'X': x, 'Y': s1, 'Z': s2})
+
+        # quantized conv
+        w = Constant('weight', Float32(), data)
+        kq = QTZ_binary_mean_scaling('kqtz', [3, 2, 2, 3], Float32(), {'input': w})
+        kq.scaling_factor = np.float32(0.5)
+        conv = Conv('conv', [1, 4, 4, 3], Float32(), {'X': aq, 'W': kq}, kernel_shape=[2, 2])
+        conv.a_quantizer = [aq]
+        conv.quantizer = kq
+        conv.is_quantized = True
+
+        # batch normalization and activation
+        bn = BatchNormalization('bn', [1, 4, 4, 3], Float32(), {
+            'X': conv,
+            'scale': Constant('gamma', Float32(), gamma, dimension_format='C'),
+            'B': Constant('beta', Float32(), beta, dimension_format='C'),
+            'mean': Constant('mean', Float32(), mean, dimension_format='C'),
+            'var': Constant('var', Float32(), var, dimension_format='C')}, epsilon=1e-3)
+        act = LeakyRelu('act', [1, 4, 4, 3], Float32(), {'X': bn}, alpha=0.1)
+
+        # One output
+        y = Output('output', [1, 4, 4, 3], Float32(), {'input': act})
+
+        # add ops to the graph
+        graph.add_op_and_inputs(y)
+
+        return graph
+
+
 class TestPassConstantFolding(unittest.TestCase):
     """Test class for packing weight."""
     def test_pass_constant_folding(self) -> None:
@@ -0,0 +1,65 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Test file for View."""
+import unittest
+from core.data_types import Float32
+from core.operators import Conv, Input, Constant
+import numpy as np
+
+
+class TestView(unittest.TestCase):
+    """Test class for View."""
+
+    @staticmethod
+    def same_conv(kh: int, kw: int, sh: int = 1, sw: int = 1) -> Conv:
+        """Make a convolution of a 9x11 input with "same" padding, the extra row or column at the end."""
+        h, w = 9, 11
+        oh, ow = (h + sh - 1) // sh, (w + sw - 1) // sw
+        pad_h = max((oh - 1) * sh + kh - h, 0)
+        pad_w = max((ow - 1) * sw + kw - w, 0)
+        x = Input('input', [1, h, w, 32], Float32())
+        weight = Constant('weight', Float32(), np.zeros([16, kh, kw, 32]))
+        return Conv('conv', [1, oh, ow, 16], Float32(), {'X': x, 'W': weight},
+                    kernel_shape=[kh, kw], pads=[pad_h // 2, pad_w // 2, pad_h - pad_h // 2, pad_w - pad_w // 2],
+                    strides=[sh, sw])
+
+    def assert_conv_params(self, conv: Conv, pad_top: int, pad_left: int, stride_h: int, stride_w: int) -> None:
+        params = conv.view.params()
+        self.assertIn(f'conv_conv_params.padding_top = {pad_top};', params)
+        self.assertIn(f'conv_conv_params.padding_left = {pad_left};', params)
+        self.assertIn(f'conv_conv_params.stride_along_height = {stride_h};', params)
+        self.assertIn(f'conv_conv_params.stride_along_width = {stride_w};', params)
+
+    def test_non_square_kernel_padding(self) -> None:
+        """1xN and Nx1 kernels are padded in one direction only."""
+        self.assert_conv_params(self.same_conv(1, 3), 0, 1, 1, 1)
+        self.assert_conv_params(self.same_conv(3, 1), 1, 0, 1, 1)
+        self.assert_conv_params(self.same_conv(1, 7), 0, 3, 1, 1)
+        self.assert_conv_params(self.same_conv(7, 1), 3, 0, 1, 1)
+
+    def test_square_kernel_padding(self) -> None:
+        """Square kernels keep their padding in both directions."""
+        self.assert_conv_params(self.same_conv(3, 3), 1, 1, 1, 1)
+        self.assert_conv_params(self.same_conv(1, 1), 0, 0, 1, 1)
+
+    def test_non_square_stride(self) -> None:
+        """The strides along the height and the width are passed on separately."""
+        self.assert_conv_params(self.same_conv(3, 3, 2, 1), 1, 1, 2, 1)
+        self.assert_conv_params(self.same_conv(3, 3, 1, 2), 1, 1, 1, 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,69 @@
+# -*- coding: utf-8 -*-
+# Copyright 2019 The Blueoil Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Test file for WeightFile."""
+import unittest
+from typing import Dict
+
+from core.data_types import Float32, QUANTIZED_PACKED_KERNEL
+from core.graph import Graph
+from core.operators import Conv, Input, Output, Constant
+from core.weight_file import WeightFile, MAGIC, VERSION, ALIGNMENT, HEADER, ENTRY
+import numpy as np
+
+
+class TestWeightFile(unittest.TestCase):
+    """Test class for WeightFile."""
+
+    @staticmethod
+    def read(blob: bytes) -> Dict[str, bytes]:
+        magic, version, num_entries, alignment, _, size = HEADER.unpack_from(blob, 0)
+        assert magic == MAGIC and version == VERSION and alignment == ALIGNMENT and size == len(blob)
+
+        entries = {}
+        for i in range(num_entries):
+            offset, nbytes, name_offset, name_size, _ = ENTRY.unpack_from(blob, HEADER.size + ENTRY.size * i)
+            assert offset % ALIGNMENT == 0
+            assert blob[name_offset + name_size] == 0
+            name = blob[name_offset:name_offset + name_size].decode()
+            entries[name] = blob[offset:offset + nbytes]
+        return entries
+
+    def test_weight_file(self) -> None:
+        """Test that every layout of the constants, and no scalar, ends up in the file."""
+        graph = Graph()
+        x = Input('input', [1, 4, 4, 3], Float32())
+        w = Constant('w', Float32(), np.arange(2 * 3 * 3 * 3, dtype=np.float32).reshape([2, 3, 3, 3]))
+        conv = Conv('conv', [1, 4, 4, 2], Float32(), {'X': x, 'W': w}, kernel_shape=[3, 3], pads=[1, 1, 1, 1])
+        qw = Constant('qw', QUANTIZED_PACKED_KERNEL(), np.arange(3, dtype=np.uint32),
+                      packed=True, actual_shape=[1, 1, 1, 96],
+                      transposed_data=[0xffffffff, 1, 2], transposed_shape=[1, 1, 1, 1, 1, 3],
+                      kn2row_data=[7, 8, 9], kn2row_shape=[1, 1, 1, 3])
+        scalar = Constant('scalar', Float32(), np.array([2.0], dtype=np.float32))
+        y = Output('output', [1, 4, 4, 2], Float32(), {'input': conv})
+        for op in [x, w, conv, qw, scalar, y]:
+            graph.add_op(op)
+
+        entries = self.read(WeightFile(graph).to_bytes())
+
+        self.assertEqual(sorted(entries.keys()), ['qw', 'qw.kn2row', 'qw.transposed', 'w'])
+        np.testing.assert_array_equal(np.frombuffer(entries['w'], '<f4'), w.data.flatten())
+        np.testing.assert_array_equal(np.frombuffer(entries['qw'], '<u4'), [0, 1, 2])
+        np.testing.assert_array_equal(np.frombuffer(entries['qw.transposed'], '<u4'), [0xffffffff, 1, 2])
+        np.testing.assert_array_equal(np.frombuffer(entries['qw.kn2row'], '<u4'), [7, 8, 9])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -17,9 +17,16 @@ limitations under the License.
 #define RUNTIME_INCLUDE_BLUEOIL_HPP_
 
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <functional>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <utility>
 
 
 // TODO(wakisaka): Should use netowrk.h from dlk. But dlk's netwrok.h has so many dependancies.
@@ -28,11 +35,30 @@ extern "C" {
   Network* network_create();
   void network_delete(Network *nn);
   bool network_init(Network *nn);
+  void network_set_num_threads(Network *nn, int n);
+  void network_set_thread_affinity(Network *nn, const int *cpus, int n);
+  // weights.bin written by the code generator. must be called before network_init.
+  void network_set_weight_path(Network *nn, const char *path);
+  void network_enable_profiling(Network *nn, int capacity);
+  void network_clear_profile(Network *nn);
+  // format 0: chrome trace json, 1: csv. returns the length of the profile.
+  int network_get_profile(Network *nn, int format, char *buf, int size);
   int network_get_input_rank(const Network *nn);
   int network_get_output_rank(const Network *nn);
   void network_get_input_shape(const Network *nn, int *shape);
   void network_get_output_shape(const Network *nn, int *shape);
-  void network_run(Network *nn, const float *input, float *output);
+  // the run functions return false if a layer failed.
+  bool network_run(Network *nn, const float *input, float *output);
+  // input: rgb bytes of the image in [0, 255], before DivideBy255.
+  bool network_run_u8(Network *nn, const uint8_t *input, float *output);
+  bool network_run_batch(Network *nn, int n, const float *inputs, float *outputs);
+  // run the kernels on parallel_for(pool, ...) instead of threads of the network.
+  // must be called before network_init.
+  void network_set_thread_pool(Network *nn,
+                               void (*parallel_for)(void *pool, size_t begin, size_t end, size_t grain,
+                                                    void (*invoke)(void *ctx, size_t first, size_t last),
+                                                    void *ctx),
+                               void *pool, int num_threads);
 }
 
 
@@ -45,11 +71,20 @@ class Tensor {
   int offsetVolume(const std::vector<int>& indices) const;
 
  public:
+  // empty tensor without shape, to be resized.
+  Tensor();
   explicit Tensor(std::vector<int> shape);
   Tensor(std::vector<int> shape, std::vector<float> data);
   Tensor(std::vector<int> shape, float *data);
   Tensor(const Tensor &tensor);
-  std::vector<int> shape() const;
+  Tensor(Tensor &&tensor) noexcept;
+  Tensor &operator=(const Tensor &tensor);
+  Tensor &operator=(Tensor &&tensor) noexcept;
+  const std::vector<int> &shape() const;
+  // change the shape, keeping the storage when it is large enough.
+  // the values are left unspecified.
+  void resize(const std::vector<int>& shape);
+  void resize(std::initializer_list<int> shape);
   int size() const;
   std::vector<float> & data();
   const float *dataAsArray() const;
@@ -70,9 +105,122 @@ class Tensor {
 };
 
 
+// Read-only view of a Tensor or of a float array, which neither owns nor
+// copies them. The shape and the data must outlive the view.
+class TensorView {
+ private:
+  const std::vector<int> *shape_;
+  const float *data_;
+  int size_;
+
+ public:
+  TensorView(const Tensor &tensor);  // NOLINT(runtime/explicit)
+  TensorView(const std::vector<int>& shape, const float *data);
+  const std::vector<int> &shape() const;
+  int size() const;
+  const float *dataAsArray() const;
+  const float *begin() const;
+  const float *end() const;
+};
+
+
+// image bytes in HWC order, as they come from the camera.
+class TensorU8 {
+ private:
+  std::vector<int> shape_;
+  std::vector<uint8_t> data_;
+
+ public:
+  explicit TensorU8(std::vector<int> shape);
+  TensorU8(std::vector<int> shape, std::vector<uint8_t> data);
+  TensorU8(std::vector<int> shape, const uint8_t *data);
+  const std::vector<int> &shape() const;
+  int size() const;
+  std::vector<uint8_t> & data();
+  const uint8_t *dataAsArray() const;
+  uint8_t *dataAsArray();
+  // float copy, with the same values
+  Tensor toTensor() const;
+};
+
+
 // typedef Tensor (*TensorFunction)(Tensor&);
 typedef std::function<Tensor(const Tensor& input)> Processor;
 
+// A processing step which writes into a tensor owned by the caller, so that
+// its storage is reused from one frame to the next.
+struct BufferedProcessor {
+  std::function<void(const TensorView& input, Tensor* output)> run;
+  // output may be the tensor viewed by input
+  bool in_place;
+};
+
+// Threads shared by the networks of several predictors, which split their
+// layers over them instead of each starting threads of their own. Jobs of
+// different networks run at the same time; a worker done with its share of
+// one job helps with the next.
+class ThreadPool {
+ public:
+  typedef void (*Invoke)(void *ctx, size_t first, size_t last);
+
+  // num_threads counts the thread calling ParallelFor. 0: one per hardware thread.
+  explicit ThreadPool(int num_threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int num_threads() const;
+
+  // calls invoke(ctx, first, last) on disjoint ranges of at most grain
+  // elements covering [begin, end), on the workers and the calling thread,
+  // and returns when all are done. A call from inside a job runs serially.
+  void ParallelFor(size_t begin, size_t end, size_t grain, Invoke invoke, void *ctx);
+  // the same for network_set_thread_pool, pool being the ThreadPool
+  static void ParallelFor(void *pool, size_t begin, size_t end, size_t grain, Invoke invoke, void *ctx);
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+// Entry points of a dlk network: the one linked into the program, or a
+// lib_x86.so / lib_fpga.so built by the dlk Makefile and loaded at run time.
+// A loaded library has its own network code and constants, so several of
+// them (different models, or versions of one) live side by side. dlopen
+// hands out the already loaded library for a path in use, so each version
+// has to be at a path of its own.
+class NetworkLibrary {
+ public:
+  // the network linked into the program
+  static std::shared_ptr<const NetworkLibrary> Linked();
+  // throws std::runtime_error if the library cannot be loaded
+  static std::shared_ptr<const NetworkLibrary> Open(const std::string& path);
+  ~NetworkLibrary();
+  NetworkLibrary(const NetworkLibrary&) = delete;
+  NetworkLibrary& operator=(const NetworkLibrary&) = delete;
+
+  // empty for the linked network
+  const std::string& path() const { return path_; }
+
+  decltype(&network_create) create = nullptr;
+  decltype(&network_delete) destroy = nullptr;
+  decltype(&network_init) init = nullptr;
+  decltype(&network_get_input_rank) get_input_rank = nullptr;
+  decltype(&network_get_output_rank) get_output_rank = nullptr;
+  decltype(&network_get_input_shape) get_input_shape = nullptr;
+  decltype(&network_get_output_shape) get_output_shape = nullptr;
+  decltype(&network_run) run = nullptr;
+  // null in libraries generated before they were added
+  decltype(&network_run_u8) run_u8 = nullptr;
+  decltype(&network_set_weight_path) set_weight_path = nullptr;
+  decltype(&network_set_thread_pool) set_thread_pool = nullptr;
+
+ private:
+  NetworkLibrary() = default;
+  std::string path_;
+  void *handle_ = nullptr;
+};
+
 class Predictor {
  public:
   std::string task;
@@ -80,26 +228,139 @@ class Predictor {
   std::vector<int> expected_input_shape;
 
   Tensor Run(const Tensor& image);
+  // when the pre-processing only divides by 255 (after a Resize to the
+  // size the image already has), the bytes go to the network without an
+  // intermediate float tensor. otherwise same as Run(image.toTensor()).
+  Tensor Run(const TensorU8& image);
+  // same as above, into *output. Passing the same output on every frame, the
+  // runtime allocates nothing once the first frames have sized its buffers.
+  void Run(const Tensor& image, Tensor* output);
+  void Run(const TensorU8& image, Tensor* output);
 
   // constructor
   explicit Predictor(const std::string& meta_yaml_path);
+  // with the network of library, running its kernels on pool if given.
+  // pool must outlive the predictor. throws std::runtime_error if the
+  // network cannot be initialized.
+  Predictor(const std::string& meta_yaml_path, std::shared_ptr<const NetworkLibrary> library,
+            ThreadPool* pool = nullptr);
 
 
  private:
-  // void SetupNetwork(const std::string dlk_so_lib_path);
-  void SetupNetwork();
+  void SetupNetwork(const std::string& meta_yaml_path, ThreadPool* pool);
   void SetupMeta(const std::string& meta_yaml_path);
-  Tensor RunPreProcess(const Tensor& input);
-  Tensor RunPostProcess(const Tensor& input);
+  void RunPreProcess(const Tensor& input, Tensor* output);
+  void RunPostProcess(const Tensor& input, Tensor* output);
 
-  Network* net_;
-  // NetworkRun network_run;
+  std::shared_ptr<const NetworkLibrary> library_;
+  // deleted with the library it comes from
+  std::shared_ptr<Network> net_;
   std::vector<int> network_input_shape_;
   std::vector<int> network_output_shape_;
   std::vector<int> image_size_;
 
-  std::vector<Processor> pre_process_;
-  std::vector<Processor> post_process_;
+  std::vector<BufferedProcessor> pre_process_;
+  std::vector<BufferedProcessor> post_process_;
+
+  // intermediate tensors of the processors and the network, kept between frames
+  Tensor pre_buffers_[2];
+  Tensor post_buffers_[2];
+  Tensor pre_processed_;
+  Tensor network_output_;
+  Tensor u8_input_;
+
+  // pre-processing is DivideBy255, optionally after a Resize to u8_resize_
+  bool u8_direct_ = false;
+  std::pair<int, int> u8_resize_ = std::make_pair(0, 0);
+
+  friend class StreamingPredictor;
+};
+
+struct StreamingResult {
+  uint64_t frame_id;
+  Tensor output;
+};
+
+typedef std::function<void(uint64_t frame_id, const Tensor& output)> StreamingCallback;
+
+// Runs pre-process, network and post-process of consecutive frames in three
+// threads, so that the throughput is bounded by the slowest stage instead of
+// the sum of all three. Frames are numbered from 0 in the order they are
+// pushed and their results are delivered in the same order.
+class StreamingPredictor {
+ public:
+  // queue_capacity: number of frames waiting in front of each stage.
+  explicit StreamingPredictor(const std::string& meta_yaml_path, int queue_capacity = 2);
+  // finishes the frames already pushed.
+  ~StreamingPredictor();
+
+  const Predictor& predictor() const;
+
+  // Both Push block while the input queue is full. Several threads may push
+  // at the same time; the ids follow the order the frames enter the queue.
+  // The callback runs on the post-process thread. If a stage throws, the
+  // error is printed and the callback is not called for that frame. If the
+  // callback throws, the error is printed and the next frames go on.
+  uint64_t Push(const Tensor& image, StreamingCallback callback);
+  // The future holds the exception if a stage throws.
+  std::future<StreamingResult> Push(const Tensor& image);
+
+  // wait until every frame pushed so far is delivered.
+  void Flush();
+
+ private:
+  struct Pipeline;
+  std::unique_ptr<Pipeline> pipeline_;
+};
+
+// Models served side by side under a name each, e.g. a classifier and a
+// detector on one device, whose networks share one thread pool. A model can
+// be replaced by a new version while requests run on it: they finish on the
+// version they started with, which is unloaded when the last of them returns.
+class ModelRegistry {
+ public:
+  // one version of a model. Its requests run one at a time, those of other
+  // models and versions at the same time.
+  class Model {
+   public:
+    Model(const std::string& meta_yaml_path, std::shared_ptr<const NetworkLibrary> library, ThreadPool* pool);
+
+    const Predictor& predictor() const { return predictor_; }
+
+    Tensor Run(const Tensor& image);
+    void Run(const Tensor& image, Tensor* output);
+    void Run(const TensorU8& image, Tensor* output);
+
+   private:
+    std::mutex mutex_;
+    Predictor predictor_;
+  };
+
+  // num_threads of the shared pool, counting the threads sending requests.
+  // 0: one per hardware thread.
+  explicit ModelRegistry(int num_threads = 0);
+  ~ModelRegistry();
+
+  // loads meta.yaml with the network of library_path (the network linked into
+  // the program if empty) and makes it the version of name that new requests
+  // get. Throws, keeping the previous version, if it cannot be loaded.
+  void Load(const std::string& name, const std::string& meta_yaml_path,
+            const std::string& library_path = "");
+  // returns false if there is no model called name
+  bool Unload(const std::string& name);
+  std::vector<std::string> Names() const;
+
+  // current version of the model, kept loaded while it is held, which
+  // must not be longer than the registry lives. throws std::out_of_range if there is no model called name.
+  std::shared_ptr<Model> Get(const std::string& name) const;
+
+  // Get(name)->Run(image, ...)
+  Tensor Run(const std::string& name, const Tensor& image);
+  void Run(const std::string& name, const Tensor& image, Tensor* output);
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
 };
 
 namespace box_util {
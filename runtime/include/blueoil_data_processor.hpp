@@ -29,10 +29,26 @@ limitations under the License.
 
 namespace blueoil {
 namespace data_processor {
+// Each processor also comes in a version which writes into *output instead
+// of returning a new tensor, so that the caller can keep the storage from one
+// frame to the next. DivideBy255, PerImageStandardization and
+// ExcludeLowScoreBox accept an output holding the input itself.
+
 // pre process.
 Tensor Resize(const Tensor& image, const std::pair<int, int>& size);
+void Resize(const TensorView& image, const std::pair<int, int>& size, Tensor* output);
 
 Tensor DivideBy255(const Tensor& image);
+void DivideBy255(const TensorView& image, Tensor* output);
+
+Tensor PerImageStandardization(const Tensor& image);
+void PerImageStandardization(const TensorView& image, Tensor* output);
+
+// Resize followed by DivideBy255 or PerImageStandardization, without an
+// intermediate image. The division by 255 is folded into the resize weights.
+void ResizeAndDivideBy255(const TensorView& image, const std::pair<int, int>& size, Tensor* output);
+void ResizeAndPerImageStandardization(const TensorView& image, const std::pair<int, int>& size,
+                                      Tensor* output);
 
 // post process.
 
@@ -50,9 +66,14 @@ struct FormatYoloV2Parameters {
   int num_classes;
 };
 Tensor FormatYoloV2(const Tensor& input, const FormatYoloV2Parameters& params);
+void FormatYoloV2(const TensorView& input, const FormatYoloV2Parameters& params, Tensor* output);
+// FormatYoloV2 followed by ExcludeLowScoreBox, without writing the low score boxes.
+void FormatYoloV2AndExcludeLowScoreBox(const TensorView& input, const FormatYoloV2Parameters& params,
+                                       const float& threshold, Tensor* output);
 
 
 Tensor ExcludeLowScoreBox(const Tensor& input, const float& threshold);
+void ExcludeLowScoreBox(const TensorView& input, const float& threshold, Tensor* output);
 
 struct NMSParameters {
   std::vector<std::string> classes;
@@ -67,6 +88,7 @@ Tensor NMS(const Tensor& input,
            const bool& per_class);
 Tensor NMS(const Tensor& input,
            const NMSParameters& params);
+void NMS(const TensorView& input, const NMSParameters& params, Tensor* output);
 
 
 }  // namespace data_processor
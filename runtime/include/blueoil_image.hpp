@@ -16,6 +16,9 @@ limitations under the License.
 #ifndef RUNTIME_INCLUDE_BLUEOIL_IMAGE_HPP_
 #define RUNTIME_INCLUDE_BLUEOIL_IMAGE_HPP_
 
+#include <memory>
+#include <vector>
+
 #include "blueoil.hpp"
 
 namespace blueoil {
@@ -26,8 +29,65 @@ enum ResizeFilter {
                    RESIZE_FILTER_BI_LINEAR = 2,
 };
 
+/*
+ * Separable resize of HWC float images between two fixed sizes.
+ * The source taps and weights of both axes are computed once in the
+ * constructor, so a Resizer is meant to be kept across video frames.
+ * Rows are split over pool, or if it is null over a pool of numThreads
+ * threads (0: one per core) started once in the constructor.
+ * The output values are multiplied by scale, at no extra cost.
+ */
+class Resizer {
+ public:
+  Resizer(const int srcWidth, const int srcHeight, const int channels,
+          const int width, const int height, const enum ResizeFilter filter,
+          const int numThreads = 0, const float scale = 1.0f, ThreadPool *pool = nullptr);
+
+  bool Matches(const int srcWidth, const int srcHeight, const int channels,
+               const int width, const int height, const enum ResizeFilter filter,
+               const float scale = 1.0f) const;
+
+  // dst holds height * width * channels floats, and must not overlap src
+  void Run(const float *src, float *dst);
+  Tensor Run(const Tensor& image);
+
+  // run the portable loops instead of the AVX2 ones, to compare them
+  void DisableSIMD() { simd_ = false; }
+
+ private:
+  void ResizeRows(const float *src, float *dst);
+  void ResizeColumns(const float *src, const int rows, float *dst);
+
+  int srcWidth_;
+  int srcHeight_;
+  int channels_;
+  int width_;
+  int height_;
+  enum ResizeFilter filter_;
+  float scale_;
+  std::unique_ptr<ThreadPool> ownPool_;
+  ThreadPool *pool_;
+  bool simd_ = true;
+
+  // vertical taps, per destination row
+  int rowTaps_ = 0;
+  std::vector<int> rowIndex_;
+  std::vector<float> rowWeight_;
+
+  // horizontal taps, tap-major over the width * channels floats of a row
+  int columnTaps_ = 0;
+  std::vector<int> columnOffset_;
+  std::vector<float> columnWeight_;
+
+  // output of the vertical pass when both axes are resized
+  std::vector<float> rows_;
+};
+
 Tensor Resize(const Tensor& image, const int width, const int height,
               const enum ResizeFilter filter);
+// into *output, which must not hold image, multiplying the values by scale.
+void Resize(const TensorView& image, const int width, const int height,
+            const enum ResizeFilter filter, Tensor *output, const float scale = 1.0f);
 
 }  // namespace image
 }  // namespace blueoil
@@ -24,6 +24,7 @@ namespace blueoil {
 namespace opencv {
 
 Tensor Tensor_fromCVMat(cv::Mat img);
+TensorU8 TensorU8_fromCVMat(cv::Mat img);
 cv::Mat Tensor_toCVMat(const Tensor &tensor);
 
 }  // namespace opencv
@@ -14,16 +14,24 @@ limitations under the License.
 =============================================================================*/
 
 #include <dlfcn.h>
+#include <unistd.h>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <numeric>
 #include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include <utility>
 #include <functional>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <stdexcept>
+#include <mutex>
+#include <thread>
 
 #include "blueoil.hpp"
 #include "blueoil_data_processor.hpp"
@@ -39,6 +47,9 @@ int calcVolume(const std::vector<int>& shape) {
                          1, std::multiplies<int>());
 }
 
+Tensor::Tensor() {
+}
+
 Tensor::Tensor(std::vector<int> shape)
   : shape_(shape),
     data_(std::vector<float>(calcVolume(std::move(shape)), 0)) {
@@ -60,6 +71,24 @@ Tensor::Tensor(const Tensor &tensor)
     data_(tensor.data_) {
 }
 
+Tensor::Tensor(Tensor &&tensor) noexcept
+  : shape_(std::move(tensor.shape_)),
+    data_(std::move(tensor.data_)) {
+}
+
+// the vectors keep their storage when it is large enough
+Tensor &Tensor::operator=(const Tensor &tensor) {
+  shape_ = tensor.shape_;
+  data_ = tensor.data_;
+  return *this;
+}
+
+Tensor &Tensor::operator=(Tensor &&tensor) noexcept {
+  shape_ = std::move(tensor.shape_);
+  data_ = std::move(tensor.data_);
+  return *this;
+}
+
 int Tensor::shapeVolume() {
   return calcVolume(shape_);
 }
@@ -74,10 +103,22 @@ int Tensor::offsetVolume(const std::vector<int>& indices) const {
   return offset;
 }
 
-std::vector<int> Tensor::shape() const {
+const std::vector<int> &Tensor::shape() const {
   return shape_;
 }
 
+void Tensor::resize(const std::vector<int>& shape) {
+  if (&shape != &shape_) {
+    shape_.assign(shape.begin(), shape.end());
+  }
+  data_.resize(calcVolume(shape_));
+}
+
+void Tensor::resize(std::initializer_list<int> shape) {
+  shape_.assign(shape);
+  data_.resize(calcVolume(shape_));
+}
+
 int Tensor::size() const {
   return data_.size();
 }
@@ -243,47 +284,170 @@ bool Tensor::allclose(const Tensor &tensor, float rtol, float atol) const {
 }
 
 
+TensorU8::TensorU8(std::vector<int> shape)
+  : shape_(shape),
+    data_(std::vector<uint8_t>(calcVolume(std::move(shape)), 0)) {
+}
+
+TensorU8::TensorU8(std::vector<int> shape, std::vector<uint8_t> data)
+  : shape_(std::move(shape)),
+    data_(std::move(data)) {
+}
+
+TensorU8::TensorU8(std::vector<int> shape, const uint8_t *arr)
+  : shape_(shape),
+    data_(std::vector<uint8_t>(arr,
+                               arr + calcVolume(std::move(shape)))) {
+}
+
+const std::vector<int> &TensorU8::shape() const {
+  return shape_;
+}
+
+int TensorU8::size() const {
+  return data_.size();
+}
+
+std::vector<uint8_t> &TensorU8::data() {
+  return data_;
+}
+
+const uint8_t *TensorU8::dataAsArray() const {
+  if (shape_.size() == 0) {
+    throw std::invalid_argument("Tensor have no shape");
+  }
+  return data_.data();
+}
+
+uint8_t *TensorU8::dataAsArray() {
+  if (shape_.size() == 0) {
+    throw std::invalid_argument("Tensor have no shape");
+  }
+  return data_.data();
+}
+
+TensorView::TensorView(const Tensor &tensor)
+  : shape_(&tensor.shape()),
+    data_(tensor.shape().empty() ? nullptr : tensor.dataAsArray()),
+    size_(tensor.size()) {
+}
+
+TensorView::TensorView(const std::vector<int>& shape, const float *data)
+  : shape_(&shape),
+    data_(data),
+    size_(calcVolume(shape)) {
+}
+
+const std::vector<int> &TensorView::shape() const {
+  return *shape_;
+}
+
+int TensorView::size() const {
+  return size_;
+}
+
+const float *TensorView::dataAsArray() const {
+  if (shape_->size() == 0) {
+    throw std::invalid_argument("Tensor have no shape");
+  }
+  return data_;
+}
+
+const float *TensorView::begin() const {
+  return data_;
+}
+
+const float *TensorView::end() const {
+  return data_ + size_;
+}
+
+
+Tensor TensorU8::toTensor() const {
+  return Tensor(shape_, std::vector<float>(data_.begin(), data_.end()));
+}
+
+
 // mapping process node to functions vector.
-void MappingProcess(const YAML::Node processors_node, std::vector<Processor>* functions) {
+void MappingProcess(const YAML::Node processors_node, std::vector<BufferedProcessor>* functions) {
   switch (processors_node.Type()) {
     case YAML::NodeType::Null: {
       break;
     }
 
     case YAML::NodeType::Sequence: {
+      // a normalization right after a Resize, or the score threshold right
+      // after FormatYoloV2, replaces it by a fused processor
+      bool after_resize = false;
+      std::pair<int, int> resize_size;
+      bool after_format_yolov2 = false;
+      data_processor::FormatYoloV2Parameters format_yolov2_params;
       for (const YAML::Node& process_node : processors_node) {
         for (const auto& key_val : process_node) {
           const auto& method_name = key_val.first.as<std::string>();
           const auto& method_params = key_val.second;
+          const bool fuse = after_resize;
+          after_resize = false;
+          const bool fuse_yolov2 = after_format_yolov2;
+          after_format_yolov2 = false;
 
           // pre process.
-          if (method_name == "DivideBy255") {
-            Processor tmp = std::move(data_processor::DivideBy255);
-            functions->push_back(std::move(tmp));
+          if (method_name == "DivideBy255" && fuse) {
+            const std::pair<int, int> size = resize_size;
+            functions->back() = {[size](const TensorView& input, Tensor* output) {
+              data_processor::ResizeAndDivideBy255(input, size, output);
+            }, false};
+
+          } else if (method_name == "DivideBy255") {
+            functions->push_back({[](const TensorView& input, Tensor* output) {
+              data_processor::DivideBy255(input, output);
+            }, true});
+
+          } else if (method_name == "PerImageStandardization" && fuse) {
+            const std::pair<int, int> size = resize_size;
+            functions->back() = {[size](const TensorView& input, Tensor* output) {
+              data_processor::ResizeAndPerImageStandardization(input, size, output);
+            }, false};
+
+          } else if (method_name == "PerImageStandardization") {
+            functions->push_back({[](const TensorView& input, Tensor* output) {
+              data_processor::PerImageStandardization(input, output);
+            }, true});
 
           } else if (method_name == "Resize" || method_name == "ResizeWithGtBoxes") {
             std::pair<int, int> size = method_params["size"].as<std::pair<int, int>>();
-            Processor tmp = std::bind(data_processor::Resize, std::placeholders::_1, size);
-            functions->push_back(std::move(tmp));
+            functions->push_back({[size](const TensorView& input, Tensor* output) {
+              data_processor::Resize(input, size, output);
+            }, false});
+            after_resize = true;
+            resize_size = size;
 
           // post process.
           } else if (method_name == "FormatYoloV2") {
             auto params = method_params.as<data_processor::FormatYoloV2Parameters>();
-            Processor tmp = std::bind<Tensor(const Tensor&, const data_processor::FormatYoloV2Parameters&)>
-                            (data_processor::FormatYoloV2, std::placeholders::_1, std::move(params));
-            functions->push_back(std::move(tmp));
+            functions->push_back({[params](const TensorView& input, Tensor* output) {
+              data_processor::FormatYoloV2(input, params, output);
+            }, false});
+            after_format_yolov2 = true;
+            format_yolov2_params = params;
+
+          } else if (method_name == "ExcludeLowScoreBox" && fuse_yolov2) {
+            auto threshold = method_params["threshold"].as<float>();
+            const data_processor::FormatYoloV2Parameters params = format_yolov2_params;
+            functions->back() = {[params, threshold](const TensorView& input, Tensor* output) {
+              data_processor::FormatYoloV2AndExcludeLowScoreBox(input, params, threshold, output);
+            }, false};
 
           } else if (method_name == "ExcludeLowScoreBox") {
             auto threshold = method_params["threshold"].as<float>();
-            Processor tmp = std::bind(data_processor::ExcludeLowScoreBox, std::placeholders::_1,
-                                      threshold);
-            functions->push_back(std::move(tmp));
+            functions->push_back({[threshold](const TensorView& input, Tensor* output) {
+              data_processor::ExcludeLowScoreBox(input, threshold, output);
+            }, true});
 
           } else if (method_name == "NMS") {
             auto params = method_params.as<data_processor::NMSParameters>();
-            Processor tmp = std::bind<Tensor(const Tensor&, const data_processor::NMSParameters&)>
-                            (data_processor::NMS, std::placeholders::_1, std::move(params));
-            functions->push_back(std::move(tmp));
+            functions->push_back({[params](const TensorView& input, Tensor* output) {
+              data_processor::NMS(input, params, output);
+            }, false});
 
           } else {
             // TODO(wakisaka): error handle.
@@ -303,30 +467,59 @@ void MappingProcess(const YAML::Node processors_node, std::vector<Processor>* fu
 }
 
 
-void Predictor::SetupNetwork() {
-  net_ = network_create();
-  bool ret = network_init(net_);
+void Predictor::SetupNetwork(const std::string& meta_yaml_path, ThreadPool* pool) {
+  // the deleter keeps the library, and so the code of the network, loaded
+  std::shared_ptr<const NetworkLibrary> library = library_;
+  net_ = std::shared_ptr<Network>(library->create(), [library](Network* nn) {
+    if (nn != nullptr) library->destroy(nn);
+  });
+  Network* net = net_.get();
+
+  // unless $DLK_WEIGHTS tells otherwise, use the weights of the output
+  // directory meta.yaml belongs to (meta.yaml, lib/weights.bin)
+  if (library->set_weight_path != nullptr && std::getenv("DLK_WEIGHTS") == nullptr) {
+    const auto slash = meta_yaml_path.rfind('/');
+    const std::string dir = slash == std::string::npos ? "" : meta_yaml_path.substr(0, slash + 1);
+    for (const std::string& path : {dir + "weights.bin", dir + "lib/weights.bin"}) {
+      if (access(path.c_str(), R_OK) == 0) {
+        library->set_weight_path(net, path.c_str());
+        break;
+      }
+    }
+  }
+
+  // older libraries keep starting threads of their own
+  if (pool != nullptr && library->set_thread_pool != nullptr) {
+    library->set_thread_pool(net, &ThreadPool::ParallelFor, pool, pool->num_threads());
+  }
+
+  bool ret = library->init(net);
 
   if (ret == false) {
-    std::cout << "network init error" << std::endl;
-    exit(1);
+    throw std::runtime_error("network init error");
   }
 
-  const int input_rank = network_get_input_rank(net_);
-  const int output_rank = network_get_output_rank(net_);
+  const int input_rank = library->get_input_rank(net);
+  const int output_rank = library->get_output_rank(net);
 
   network_input_shape_.resize(input_rank);
   network_output_shape_.resize(output_rank);
 
-  network_get_input_shape(net_, network_input_shape_.data());
-  network_get_output_shape(net_, network_output_shape_.data());
+  library->get_input_shape(net, network_input_shape_.data());
+  library->get_output_shape(net, network_output_shape_.data());
 
   expected_input_shape = network_input_shape_;
 }
 
 
-Predictor::Predictor(const std::string& meta_yaml_path) {
-  SetupNetwork();
+Predictor::Predictor(const std::string& meta_yaml_path)
+  : Predictor(meta_yaml_path, NetworkLibrary::Linked()) {
+}
+
+Predictor::Predictor(const std::string& meta_yaml_path, std::shared_ptr<const NetworkLibrary> library,
+                     ThreadPool* pool)
+  : library_(std::move(library)) {
+  SetupNetwork(meta_yaml_path, pool);
   SetupMeta(meta_yaml_path);
   // TODO(wakisaka): check network input shape is the same as meta's image size.
   // TODO(wakisaka): check network output shape is the same as meta's number of class when type is classsification.
@@ -346,40 +539,317 @@ void Predictor::SetupMeta(const std::string& meta_yaml_path) {
 
   YAML::Node post_processor_node = meta["POST_PROCESSOR"];
   MappingProcess(post_processor_node, &post_process_);
+
+  // Run(TensorU8) skips the float pre-processing for [(Resize,) DivideBy255]
+  std::vector<std::string> names;
+  if (pre_processor_node.IsSequence()) {
+    for (const YAML::Node& process_node : pre_processor_node) {
+      for (const auto& key_val : process_node) {
+        names.push_back(key_val.first.as<std::string>());
+        if (names.back() == "Resize") {
+          u8_resize_ = key_val.second["size"].as<std::pair<int, int>>();
+        }
+      }
+    }
+  }
+  u8_direct_ = (names == std::vector<std::string>{"DivideBy255"}) ||
+               (names == std::vector<std::string>{"Resize", "DivideBy255"});
 }
 
 
-Tensor Predictor::RunPreProcess(const Tensor& input) {
-  Tensor tmp = input;
-  for (Processor process : pre_process_) {
-    tmp = process(tmp);
+// runs processors from input to *output. a step writes over its input when
+// it can, otherwise into the buffer which does not hold its input.
+static void RunProcessors(const std::vector<BufferedProcessor>& processors, const Tensor& input,
+                          Tensor buffers[2], Tensor* output) {
+  if (processors.empty()) {
+    *output = input;
+    return;
   }
 
-  return tmp;
+  Tensor* current = nullptr;
+  for (const BufferedProcessor& process : processors) {
+    Tensor* target = current;
+    if (current == nullptr || !process.in_place) {
+      target = (current == &buffers[0]) ? &buffers[1] : &buffers[0];
+    }
+    process.run(current ? TensorView(*current) : TensorView(input), target);
+    current = target;
+  }
+  // the buffer gets the storage of the previous output
+  std::swap(*output, *current);
 }
 
-Tensor Predictor::RunPostProcess(const Tensor& input) {
-  Tensor tmp = input;
-  for (Processor process : post_process_) {
-    tmp = process(tmp);
-  }
+void Predictor::RunPreProcess(const Tensor& input, Tensor* output) {
+  RunProcessors(pre_process_, input, pre_buffers_, output);
+}
 
-  return tmp;
+void Predictor::RunPostProcess(const Tensor& input, Tensor* output) {
+  RunProcessors(post_process_, input, post_buffers_, output);
 }
 
 Tensor Predictor::Run(const Tensor& image) {
-  Tensor pre_processed = RunPreProcess(image);
+  Tensor post_processed;
+  Run(image, &post_processed);
+  return post_processed;
+}
+
+void Predictor::Run(const Tensor& image, Tensor* output) {
+  RunPreProcess(image, &pre_processed_);
 
   // build network output tensor.
-  Tensor n_output(network_output_shape_);
+  network_output_.resize(network_output_shape_);
 
-  network_run(net_, pre_processed.dataAsArray(), n_output.dataAsArray());
+  if (!library_->run(net_.get(), pre_processed_.dataAsArray(), network_output_.dataAsArray())) {
+    throw std::runtime_error("network run error");
+  }
 
-  Tensor post_processed = RunPostProcess(n_output);
+  RunPostProcess(network_output_, output);
+}
 
+Tensor Predictor::Run(const TensorU8& image) {
+  Tensor post_processed;
+  Run(image, &post_processed);
   return post_processed;
 }
 
+void Predictor::Run(const TensorU8& image, Tensor* output) {
+  const std::vector<int>& shape = image.shape();
+  const size_t rank = std::min<size_t>(3, network_input_shape_.size());
+  const bool network_hwc = shape.size() == rank &&
+                           std::equal(shape.begin(), shape.end(), network_input_shape_.end() - rank);
+  // a Resize to the size of the image does not change it
+  const bool resized = u8_resize_.first != 0 && shape.size() == 3 &&
+                       (u8_resize_.first != shape[1] || u8_resize_.second != shape[0]);
+  if (!u8_direct_ || resized || !network_hwc || library_->run_u8 == nullptr) {
+    u8_input_.resize(shape);
+    std::copy(image.dataAsArray(), image.dataAsArray() + image.size(), u8_input_.begin());
+    Run(u8_input_, output);
+    return;
+  }
+
+  network_output_.resize(network_output_shape_);
+
+  if (!library_->run_u8(net_.get(), image.dataAsArray(), network_output_.dataAsArray())) {
+    throw std::runtime_error("network run error");
+  }
+
+  RunPostProcess(network_output_, output);
+}
+
+
+namespace {
+
+// fixed capacity FIFO between two pipeline stages. after Close(), Push fails
+// and Pop returns the remaining items before failing.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  bool Pop(T* item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return false;
+    }
+    *item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  std::deque<T> items_;
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+}  // namespace
+
+
+struct StreamingPredictor::Pipeline {
+  typedef std::function<void(uint64_t, const Tensor&, std::exception_ptr)> Deliver;
+
+  struct Frame {
+    uint64_t id = 0;
+    Tensor tensor;
+    Deliver deliver;
+    std::exception_ptr error;
+  };
+
+  Pipeline(const std::string& meta_yaml_path, int queue_capacity)
+    : predictor(meta_yaml_path),
+      to_pre(queue_capacity),
+      to_network(queue_capacity),
+      to_post(queue_capacity) {
+    // each stage swaps the frame tensor with its own, so that the storage
+    // circulates between the stages instead of being allocated per frame
+    threads.emplace_back(&Pipeline::Stage, this, &to_pre, &to_network, [this](Frame* frame) {
+      predictor.RunPreProcess(frame->tensor, &pre_processed);
+      std::swap(frame->tensor, pre_processed);
+    });
+    threads.emplace_back(&Pipeline::Stage, this, &to_network, &to_post, [this](Frame* frame) {
+      network_output.resize(predictor.network_output_shape_);
+      if (!predictor.library_->run(predictor.net_.get(), frame->tensor.dataAsArray(),
+                                   network_output.dataAsArray())) {
+        throw std::runtime_error("network run error");
+      }
+      std::swap(frame->tensor, network_output);
+    });
+    threads.emplace_back(&Pipeline::Stage, this, &to_post, nullptr, [this](Frame* frame) {
+      predictor.RunPostProcess(frame->tensor, &post_processed);
+      std::swap(frame->tensor, post_processed);
+    });
+  }
+
+  ~Pipeline() {
+    // each stage closes the next queue once it has drained its own
+    to_pre.Close();
+    for (std::thread& t : threads) {
+      t.join();
+    }
+  }
+
+  uint64_t Push(const Tensor& image, Deliver deliver) {
+    Frame frame;
+    frame.tensor = image;
+    frame.deliver = std::move(deliver);
+    // the id is taken and the frame queued under one lock, so that frames of
+    // concurrent callers enter the pipeline in the order of their ids. it is
+    // not mutex, which the last stage needs to deliver while to_pre is full.
+    std::lock_guard<std::mutex> push_lock(push_mutex);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      frame.id = pushed++;
+    }
+    const uint64_t id = frame.id;
+    to_pre.Push(std::move(frame));
+    return id;
+  }
+
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    all_delivered.wait(lock, [this] { return delivered == pushed; });
+  }
+
+  void Stage(BoundedQueue<Frame>* in, BoundedQueue<Frame>* out, std::function<void(Frame*)> work) {
+    Frame frame;
+    while (in->Pop(&frame)) {
+      if (!frame.error) {
+        try {
+          work(&frame);
+        } catch (...) {
+          frame.error = std::current_exception();
+        }
+      }
+
+      if (out) {
+        out->Push(std::move(frame));
+        continue;
+      }
+
+      // a throwing callback must neither end this thread nor keep Flush
+      // waiting for the frame
+      try {
+        frame.deliver(frame.id, frame.tensor, frame.error);
+      } catch (const std::exception& e) {
+        std::cout << "Error: callback of frame " << frame.id << ": " << e.what() << std::endl;
+      } catch (...) {
+        std::cout << "Error: callback of frame " << frame.id << std::endl;
+      }
+      frame.deliver = nullptr;
+      std::lock_guard<std::mutex> lock(mutex);
+      ++delivered;
+      all_delivered.notify_all();
+    }
+    if (out) {
+      out->Close();
+    }
+  }
+
+  Predictor predictor;
+  // used by the pre-process, network and post-process threads respectively
+  Tensor pre_processed;
+  Tensor network_output;
+  Tensor post_processed;
+  BoundedQueue<Frame> to_pre;
+  BoundedQueue<Frame> to_network;
+  BoundedQueue<Frame> to_post;
+  std::vector<std::thread> threads;
+
+  std::mutex push_mutex;
+  std::mutex mutex;
+  std::condition_variable all_delivered;
+  uint64_t pushed = 0;
+  uint64_t delivered = 0;
+};
+
+
+StreamingPredictor::StreamingPredictor(const std::string& meta_yaml_path, int queue_capacity)
+  : pipeline_(new Pipeline(meta_yaml_path, std::max(queue_capacity, 1))) {
+}
+
+StreamingPredictor::~StreamingPredictor() {
+}
+
+const Predictor& StreamingPredictor::predictor() const {
+  return pipeline_->predictor;
+}
+
+uint64_t StreamingPredictor::Push(const Tensor& image, StreamingCallback callback) {
+  return pipeline_->Push(image, [callback](uint64_t id, const Tensor& output, std::exception_ptr error) {
+    if (!error) {
+      callback(id, output);
+      return;
+    }
+    try {
+      std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+      std::cout << "Error: frame " << id << ": " << e.what() << std::endl;
+    } catch (...) {
+      std::cout << "Error: frame " << id << std::endl;
+    }
+  });
+}
+
+std::future<StreamingResult> StreamingPredictor::Push(const Tensor& image) {
+  auto promise = std::make_shared<std::promise<StreamingResult>>();
+  std::future<StreamingResult> result = promise->get_future();
+  pipeline_->Push(image, [promise](uint64_t id, const Tensor& output, std::exception_ptr error) {
+    if (error) {
+      promise->set_exception(error);
+    } else {
+      promise->set_value(StreamingResult{id, output});
+    }
+  });
+  return result;
+}
+
+void StreamingPredictor::Flush() {
+  pipeline_->Flush();
+}
+
 
 namespace box_util {
 
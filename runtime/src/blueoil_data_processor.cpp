@@ -21,8 +21,17 @@ limitations under the License.
 #include <numeric>
 #include <algorithm>
 #include <cstring>
+#include <limits>
 #include <utility>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLUEOIL_DATA_PROCESSOR_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BLUEOIL_DATA_PROCESSOR_NEON 1
+#endif
+
 #include "blueoil.hpp"
 #include "blueoil_image.hpp"
 #include "blueoil_data_processor.hpp"
@@ -30,103 +39,317 @@ limitations under the License.
 namespace blueoil {
 namespace data_processor {
 
-static std::vector<float> softmax(const float* xs, int num) {
-  std::vector<float> r(num);
-
-  float max_val = 0.0;
-  for (int i = 0; i < num; i++) {
-    max_val = std::max(xs[i], max_val);
-  }
-
-  float exp_sum = 0.0;
-  for (int i = 0; i < num; i++) {
-    float val = exp(xs[i] - max_val);
-    r[i] = val;
-    exp_sum += val;
+namespace {
+
+// x[i] = exp(x[i]), i in [0, n)
+void ExpArray(float* x, const int n);
+
+#if defined(BLUEOIL_DATA_PROCESSOR_X86)
+// Cephes' single precision exp: exp(x) = 2^k * exp(r), |r| <= ln(2) / 2.
+// returns the number of elements done.
+__attribute__((target("avx2,fma")))
+int ExpArrayAVX2(float* x, const int n) {
+  const __m256 hi = _mm256_set1_ps(88.3762626647949f);
+  const __m256 lo = _mm256_set1_ps(-88.3762626647949f);
+  const __m256 log2e = _mm256_set1_ps(1.44269504088896341f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 c1 = _mm256_set1_ps(0.693359375f);
+  const __m256 c2 = _mm256_set1_ps(-2.12194440e-4f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(x + i), lo), hi);
+    const __m256 k = _mm256_floor_ps(_mm256_fmadd_ps(v, log2e, half));
+    v = _mm256_fnmadd_ps(k, c1, v);
+    v = _mm256_fnmadd_ps(k, c2, v);
+    __m256 y = _mm256_set1_ps(1.9875691500E-4f);
+    y = _mm256_fmadd_ps(y, v, _mm256_set1_ps(1.3981999507E-3f));
+    y = _mm256_fmadd_ps(y, v, _mm256_set1_ps(8.3334519073E-3f));
+    y = _mm256_fmadd_ps(y, v, _mm256_set1_ps(4.1665795894E-2f));
+    y = _mm256_fmadd_ps(y, v, _mm256_set1_ps(1.6666665459E-1f));
+    y = _mm256_fmadd_ps(y, v, _mm256_set1_ps(5.0000001201E-1f));
+    y = _mm256_add_ps(_mm256_fmadd_ps(y, _mm256_mul_ps(v, v), v), one);
+    const __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(k), _mm256_set1_epi32(127)), 23);
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(y, _mm256_castsi256_ps(e)));
   }
+  return i;
+}
 
-  for (int i = 0; i < num; i++) {
-    r[i] /= exp_sum;
+bool HasAVX2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return avx2;
+}
+#endif
+
+#if defined(BLUEOIL_DATA_PROCESSOR_NEON)
+// same as ExpArrayAVX2, with ARMv7 NEON
+int ExpArrayNEON(float* x, const int n) {
+  const float32x4_t hi = vdupq_n_f32(88.3762626647949f);
+  const float32x4_t lo = vdupq_n_f32(-88.3762626647949f);
+  const float32x4_t log2e = vdupq_n_f32(1.44269504088896341f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t c1 = vdupq_n_f32(0.693359375f);
+  const float32x4_t c2 = vdupq_n_f32(-2.12194440e-4f);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t v = vminq_f32(vmaxq_f32(vld1q_f32(x + i), lo), hi);
+    const float32x4_t t = vmlaq_f32(half, v, log2e);
+    // floor: truncate, then step down where the truncation went up
+    float32x4_t k = vcvtq_f32_s32(vcvtq_s32_f32(t));
+    const uint32x4_t up = vcgtq_f32(k, t);
+    k = vsubq_f32(k, vreinterpretq_f32_u32(vandq_u32(up, vreinterpretq_u32_f32(one))));
+    v = vmlsq_f32(v, k, c1);
+    v = vmlsq_f32(v, k, c2);
+    float32x4_t y = vdupq_n_f32(1.9875691500E-4f);
+    y = vmlaq_f32(vdupq_n_f32(1.3981999507E-3f), y, v);
+    y = vmlaq_f32(vdupq_n_f32(8.3334519073E-3f), y, v);
+    y = vmlaq_f32(vdupq_n_f32(4.1665795894E-2f), y, v);
+    y = vmlaq_f32(vdupq_n_f32(1.6666665459E-1f), y, v);
+    y = vmlaq_f32(vdupq_n_f32(5.0000001201E-1f), y, v);
+    y = vaddq_f32(vmlaq_f32(v, y, vmulq_f32(v, v)), one);
+    const int32x4_t e = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(k), vdupq_n_s32(127)), 23);
+    vst1q_f32(x + i, vmulq_f32(y, vreinterpretq_f32_s32(e)));
   }
-
-  return r;
+  return i;
 }
+#endif
 
-static float sigmoid(float x) {
-  // The exp function becomes infinite at x around 89(float) or 710(double),
-  // so branch and calculate.
-  if (x > 0) {
-    return 1.0 / (1.0 + exp(-x));
-  } else {
-    auto e = exp(x);
-    return e / (1.0 + e);
+void ExpArray(float* x, const int n) {
+  int i = 0;
+#if defined(BLUEOIL_DATA_PROCESSOR_X86)
+  if (HasAVX2()) {
+    i = ExpArrayAVX2(x, n);
+  }
+#elif defined(BLUEOIL_DATA_PROCESSOR_NEON)
+  i = ExpArrayNEON(x, n);
+#endif
+  for (; i < n; i++) {
+    x[i] = std::exp(x[i]);
   }
 }
 
-static float CalcIoU(const box_util::Box& a, const box_util::Box& b) {
-  float left = std::max(a.x, b.x);
-  float top = std::min(a.y+a.h, b.y + b.h);
+// boxes as corners, one array per coordinate
+struct BoxArrays {
+  std::vector<float> x1, y1, x2, y2, area;
+  std::vector<int> index;
 
-  float right = std::min(a.x + a.w, b.x + b.w);
-  float bottom = std::max(a.y, b.y);
+  void clear() {
+    x1.clear(); y1.clear(); x2.clear(); y2.clear(); area.clear(); index.clear();
+  }
 
-  float inner_area = std::max(right - left, 0.f) * std::max(top - bottom, 0.f);
-  float a_area = a.w * a.h;
-  float b_area = b.w * b.h;
-  float epsilon = 1e-10;
+  void push_back(const float* prediction, const int i) {
+    x1.push_back(prediction[0]);
+    y1.push_back(prediction[1]);
+    x2.push_back(prediction[0] + prediction[2]);
+    y2.push_back(prediction[1] + prediction[3]);
+    area.push_back(prediction[2] * prediction[3]);
+    index.push_back(i);
+  }
 
-  float r = inner_area / (a_area + b_area - inner_area + epsilon);
+  int size() const {
+    return index.size();
+  }
 
-  if (std::isnan(r)) {
-    return 0.0;
+  // true if the IoU of the box with one of [first, size()) reaches threshold
+  bool Overlaps(const float* prediction, const int first, const float threshold) const {
+    const float bx1 = prediction[0];
+    const float by1 = prediction[1];
+    const float bx2 = prediction[0] + prediction[2];
+    const float by2 = prediction[1] + prediction[3];
+    const float b_area = prediction[2] * prediction[3];
+    const float epsilon = 1e-10;
+    int k = first;
+#if defined(BLUEOIL_DATA_PROCESSOR_X86)
+    if (HasAVX2()) {
+      k = OverlapsAVX2(bx1, by1, bx2, by2, b_area, first, threshold);
+      if (k < 0) {
+        return true;
+      }
+    }
+#endif
+    for (; k < size(); k++) {
+      const float w = std::max(std::min(x2[k], bx2) - std::max(x1[k], bx1), 0.f);
+      const float h = std::max(std::min(y2[k], by2) - std::max(y1[k], by1), 0.f);
+      const float inner_area = w * h;
+      const float iou = inner_area / (area[k] + b_area - inner_area + epsilon);
+      // a NaN IoU counts as no overlap
+      if (std::min(iou, 1.0f) >= threshold) {
+        return true;
+      }
+    }
+    return false;
   }
-  if (r > 1.0) {
-    return 1.0;
-  } else if (r < 0.0) {
-    return 0.0;
+
+#if defined(BLUEOIL_DATA_PROCESSOR_X86)
+  // Overlaps over 8 boxes at a time. returns -1 if one overlaps, else the
+  // first box left to check.
+  __attribute__((target("avx2,fma")))
+  int OverlapsAVX2(const float bx1, const float by1, const float bx2, const float by2,
+                   const float b_area, const int first, const float threshold) const {
+    const __m256 vx1 = _mm256_set1_ps(bx1);
+    const __m256 vy1 = _mm256_set1_ps(by1);
+    const __m256 vx2 = _mm256_set1_ps(bx2);
+    const __m256 vy2 = _mm256_set1_ps(by2);
+    const __m256 varea = _mm256_set1_ps(b_area);
+    const __m256 epsilon = _mm256_set1_ps(1e-10f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 vthreshold = _mm256_set1_ps(threshold);
+    int k = first;
+    for (; k + 8 <= size(); k += 8) {
+      const __m256 w = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(_mm256_loadu_ps(&x2[k]), vx2),
+                                                   _mm256_max_ps(_mm256_loadu_ps(&x1[k]), vx1)), zero);
+      const __m256 h = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(_mm256_loadu_ps(&y2[k]), vy2),
+                                                   _mm256_max_ps(_mm256_loadu_ps(&y1[k]), vy1)), zero);
+      const __m256 inner_area = _mm256_mul_ps(w, h);
+      const __m256 iou = _mm256_div_ps(inner_area, _mm256_add_ps(_mm256_sub_ps(
+          _mm256_add_ps(_mm256_loadu_ps(&area[k]), varea), inner_area), epsilon));
+      // min(1, NaN) keeps the NaN, which compares false
+      if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_min_ps(one, iou), vthreshold, _CMP_GE_OQ))) {
+        return -1;
+      }
+    }
+    return k;
   }
-  return r;
-}
+#endif
+};
 
-static box_util::Box ConvertBboxCoordinate(float x, float y, float w, float h, float k,
-                                           const std::pair<float, float>& anchor,
-                                           int nth_y, int nth_x,
-                                           int num_cell_y, int num_cell_x) {
-  box_util::Box r;
-  float anchor_w = anchor.first;
-  float anchor_h = anchor.second;
+// FormatYoloV2, keeping the boxes scoring threshold or more
+void DecodeYoloV2(const TensorView& input, const FormatYoloV2Parameters& params,
+                  const float threshold, Tensor* output) {
+  // input shape must be NHWC, N == 1
+  const auto& anchors = params.anchors;
+  const int num_classes = params.num_classes;
+  const std::pair<int, int>& image_size = params.image_size;
 
-  float cy = (y + static_cast<float>(nth_y)) / num_cell_y;
-  float cx = (x + static_cast<float>(nth_x)) / num_cell_x;
+  auto& shape = input.shape();
+  int num_cell_y = shape[1];
+  int num_cell_x = shape[2];
 
-  r.h = exp(h) * static_cast<float>(anchor_h) / num_cell_y;
-  r.w = exp(w) * static_cast<float>(anchor_w) / num_cell_x;
+  assert(shape[0] == 1);
+  assert(shape.size() == 4);
+  assert(input.size() % (num_cell_y * num_cell_x * anchors.size()) == 0);
+  assert(static_cast<int>(anchors.size()) == params.boxes_per_cell);
+
+  const int num_anchors = anchors.size();
+  const int num_boxes = num_cell_y * num_cell_x * num_anchors;
+  const int stride = num_classes + 5;
+
+  // the arguments of every exponential, in the layout of the predictions:
+  // class logits minus their max (softmax), -conf, -x, -y (sigmoid), w, h
+  thread_local std::vector<float> exps;
+  thread_local std::vector<box_util::Box> boxes;
+  exps.resize(num_boxes * stride);
+  boxes.resize(num_boxes);
+  for (int cell = 0; cell < num_cell_y * num_cell_x; cell++) {
+    const float* predictions = input.dataAsArray() + cell * shape[3];
+    for (int k = 0; k < num_anchors; k++) {
+      float* e = exps.data() + (cell * num_anchors + k) * stride;
+      float max_val = 0.0;
+      for (int c_i = 0; c_i < num_classes; c_i++) {
+        max_val = std::max(predictions[c_i], max_val);
+      }
+      for (int c_i = 0; c_i < num_classes; c_i++) {
+        e[c_i] = predictions[c_i] - max_val;
+      }
+      e[num_classes] = -predictions[num_classes];
+      e[num_classes+1] = -predictions[num_classes+1];
+      e[num_classes+2] = -predictions[num_classes+2];
+      e[num_classes+3] = predictions[num_classes+3];
+      e[num_classes+4] = predictions[num_classes+4];
+      predictions = predictions + stride;
+    }
+  }
+
+  ExpArray(exps.data(), exps.size());
 
-  r.y = cy - (r.h / 2);
-  r.x = cx - (r.w / 2);
+  // the scores replace the exponentials of the classes
+  for (int n = 0; n < num_boxes; n++) {
+    float* e = exps.data() + n * stride;
+    const int i = n / (num_cell_x * num_anchors);
+    const int j = n / num_anchors % num_cell_x;
+    const std::pair<float, float>& anchor = anchors[n % num_anchors];
+
+    float exp_sum = 0.0;
+    for (int c_i = 0; c_i < num_classes; c_i++) {
+      exp_sum += e[c_i];
+    }
+    float conf = 1.0 / (1.0 + e[num_classes]);
+    float x = 1.0 / (1.0 + e[num_classes+1]);
+    float y = 1.0 / (1.0 + e[num_classes+2]);
+
+    box_util::Box& r = boxes[n];
+    float cy = (y + static_cast<float>(i)) / num_cell_y;
+    float cx = (x + static_cast<float>(j)) / num_cell_x;
+    r.h = e[num_classes+4] * anchor.second / num_cell_y;
+    r.w = e[num_classes+3] * anchor.first / num_cell_x;
+    r.y = cy - (r.h / 2);
+    r.x = cx - (r.w / 2);
+
+    for (int c_i = 0; c_i < num_classes; c_i++) {
+      e[c_i] = e[c_i] / exp_sum * conf;
+    }
+  }
 
-  return r;
+  // boxes of class c follow those of class c - 1
+  output->resize({1, num_boxes * num_classes, 6});
+  float* result = output->dataAsArray();
+  int num_predictions = 0;
+  for (int c_i = 0; c_i < num_classes; c_i++) {
+    for (int n = 0; n < num_boxes; n++) {
+      float score = exps[n * stride + c_i];
+      if (score < threshold) {
+        continue;
+      }
+      float* p = result + num_predictions * 6;
+      p[0] = boxes[n].x * image_size.first;
+      p[1] = boxes[n].y * image_size.second;
+      p[2] = boxes[n].w * image_size.first;
+      p[3] = boxes[n].h * image_size.second;
+      p[4] = c_i;
+      p[5] = score;
+      num_predictions++;
+    }
+  }
+  output->resize({1, num_predictions, 6});
 }
 
+}  // namespace
+
 Tensor Resize(const Tensor& image, const std::pair<int, int>& size) {
+  Tensor out;
+  Resize(image, size, &out);
+  return out;
+}
+
+void Resize(const TensorView& image, const std::pair<int, int>& size, Tensor* output) {
   const int width = size.first;
   const int height = size.second;
-  return blueoil::image::Resize(image, width, height,
-                                blueoil::image::RESIZE_FILTER_NEAREST_NEIGHBOR);
+  blueoil::image::Resize(image, width, height,
+                         blueoil::image::RESIZE_FILTER_NEAREST_NEIGHBOR, output);
 }
 
 Tensor DivideBy255(const Tensor& image) {
-  Tensor out(image);
+  Tensor out;
+  DivideBy255(image, &out);
+  return out;
+}
 
-  auto div255 = [](float i) { return i/255; };
-  std::transform(image.begin(), image.end(), out.begin(), div255);
+void DivideBy255(const TensorView& image, Tensor* output) {
+  output->resize(image.shape());
 
-  return out;
+  auto div255 = [](float i) { return i/255; };
+  std::transform(image.begin(), image.end(), output->begin(), div255);
 }
 
 Tensor PerImageStandardization(const Tensor& image) {
-  Tensor out(image);
+  Tensor out;
+  PerImageStandardization(image, &out);
+  return out;
+}
 
+void PerImageStandardization(const TensorView& image, Tensor* output) {
   double sum = 0.0;
   double sum2 = 0.0;
 
@@ -140,8 +363,20 @@ Tensor PerImageStandardization(const Tensor& image) {
   double sd = std::sqrt(var);
   float adjusted_sd = std::max(sd, 1.0 / std::sqrt(image.size()));
   auto standardization = [mean, adjusted_sd](float i) { return (i - mean) / adjusted_sd; };
-  std::transform(image.begin(), image.end(), out.begin(), standardization);
-  return out;
+  output->resize(image.shape());
+  std::transform(image.begin(), image.end(), output->begin(), standardization);
+}
+
+void ResizeAndDivideBy255(const TensorView& image, const std::pair<int, int>& size, Tensor* output) {
+  blueoil::image::Resize(image, size.first, size.second,
+                         blueoil::image::RESIZE_FILTER_NEAREST_NEIGHBOR, output, 1.0f / 255);
+}
+
+void ResizeAndPerImageStandardization(const TensorView& image, const std::pair<int, int>& size,
+                                      Tensor* output) {
+  // the statistics need the whole resized image, which is still in cache
+  Resize(image, size, output);
+  PerImageStandardization(*output, output);
 }
 
 
@@ -154,87 +389,55 @@ Tensor FormatYoloV2(const Tensor& input,
                     const std::string& data_format,
                     const std::pair<int, int>& image_size,
                     const int& num_classes) {
-  // input shape must be NHWC, N == 1
-
-  auto shape = input.shape();
-  int num_cell_y = shape[1];
-  int num_cell_x = shape[2];
+  FormatYoloV2Parameters params;
+  params.anchors = anchors;
+  params.boxes_per_cell = boxes_per_cell;
+  params.data_format = data_format;
+  params.image_size = image_size;
+  params.num_classes = num_classes;
+  return FormatYoloV2(input, params);
+}
 
-  assert(shape[0] == 1);
-  assert(shape.size() == 4);
-  assert(input.size() % (num_cell_y * num_cell_x * anchors.size()) == 0);
-  assert(static_cast<int>(anchors.size()) == boxes_per_cell);
-
-  std::vector<int> output_shape = {1, num_cell_y * num_cell_x * boxes_per_cell * num_classes, 6};
-  Tensor result(output_shape);
-
-  int r_i = 0, r_delta = num_cell_y * num_cell_y * anchors.size();
-  for (int i = 0; i < num_cell_y; i++) {
-    for (int j = 0; j < num_cell_x; j++) {
-      const float* predictions = input.dataAsArray({0, i, j, 0});
-      for (size_t k = 0; k < anchors.size(); k++) {
-        // is it ok to use softmax when num_classes == 1?
-        std::vector<float> probs = softmax(predictions, num_classes);
-        float conf = sigmoid(predictions[num_classes]);
-        float x = sigmoid(predictions[num_classes+1]);
-        float y = sigmoid(predictions[num_classes+2]);
-        float w = predictions[num_classes+3];
-        float h = predictions[num_classes+4];
-
-        box_util::Box bbox_im = ConvertBboxCoordinate(x, y, w, h, k, anchors[k], i, j, num_cell_y, num_cell_x);
-
-        int r_i2 = r_i;
-        for (int c_i = 0; c_i < num_classes; c_i++) {
-          float prob = probs[c_i];
-          float score = prob * conf;
-          auto p = result.dataAsArray({0, r_i2, 0});
-          p[0] = bbox_im.x * image_size.first;
-          p[1] = bbox_im.y * image_size.second;
-          p[2] = bbox_im.w * image_size.first;
-          p[3] = bbox_im.h * image_size.second;
-          p[4] = c_i;
-          p[5] = score;
-          r_i2 += r_delta;
-        }
-        r_i++;
-        predictions = predictions + (num_classes + 5);
-      }
-    }
-  }
+Tensor FormatYoloV2(const Tensor& input, const FormatYoloV2Parameters& params) {
+  Tensor out;
+  FormatYoloV2(input, params, &out);
+  return out;
+}
 
-  return result;
+void FormatYoloV2(const TensorView& input, const FormatYoloV2Parameters& params, Tensor* output) {
+  DecodeYoloV2(input, params, -std::numeric_limits<float>::infinity(), output);
 }
 
-Tensor FormatYoloV2(const Tensor& input, const FormatYoloV2Parameters& params) {
-  return FormatYoloV2(input,
-                      params.anchors,
-                      params.boxes_per_cell,
-                      params.data_format,
-                      params.image_size,
-                      params.num_classes);
+void FormatYoloV2AndExcludeLowScoreBox(const TensorView& input, const FormatYoloV2Parameters& params,
+                                       const float& threshold, Tensor* output) {
+  DecodeYoloV2(input, params, threshold, output);
 }
 
 Tensor ExcludeLowScoreBox(const Tensor& input, const float& threshold) {
-  Tensor result(input);
+  Tensor out;
+  ExcludeLowScoreBox(input, threshold, &out);
+  return out;
+}
 
-  auto shape = input.shape();
-  int num_predictions = shape[1];
+void ExcludeLowScoreBox(const TensorView& input, const float& threshold, Tensor* output) {
+  const int num_predictions = input.shape()[1];
+  const float* predictions = input.dataAsArray();
+  output->resize({1, num_predictions, 6});
+  float* compacted_predictions = output->dataAsArray();
   int compacted_num_predictions = 0;
 
   for (int i = 0; i < num_predictions; i++) {
-    float* predictions = result.dataAsArray({0, i, 0});
-    float score = predictions[5];
+    float score = predictions[i * 6 + 5];
     if (score < threshold) {
       // delete entry
     } else {
-      // remain entry
-      float* compacted_predictions = result.dataAsArray({0, compacted_num_predictions, 0});
-      std::memcpy(compacted_predictions, predictions, 6 * sizeof(float));
+      // remain entry. rows only move up, so output may be the input
+      std::memmove(compacted_predictions + compacted_num_predictions * 6, predictions + i * 6,
+                   6 * sizeof(float));
       compacted_num_predictions++;
     }
   }
-  result.erase({0, compacted_num_predictions, 0}, {1, 0, 0});
-  return result;
+  output->resize({1, compacted_num_predictions, 6});
 }
 
 Tensor NMS(const Tensor& input,
@@ -242,132 +445,91 @@ Tensor NMS(const Tensor& input,
            const float& iou_threshold,
            const int& max_output_size,
            const bool& per_class) {
-  auto shape = input.shape();
-  int num_predictions = shape[1];
-  int num_classes = classes.size();
+  NMSParameters params;
+  params.classes = classes;
+  params.iou_threshold = iou_threshold;
+  params.max_output_size = max_output_size;
+  params.per_class = per_class;
+  return NMS(input, params);
+}
 
-  std::vector<int> ids;
+Tensor NMS(const Tensor& input, const NMSParameters& params) {
+  Tensor out;
+  NMS(input, params, &out);
+  return out;
+}
+
+void NMS(const TensorView& input, const NMSParameters& params, Tensor* output) {
+  const float iou_threshold = params.iou_threshold;
+  const int max_output_size = params.max_output_size;
+  const int num_predictions = input.shape()[1];
+  const int num_classes = params.classes.size();
+  const float* predictions = input.dataAsArray();
+
+  // candidates with a known class and a positive score, grouped by class.
+  // kept between calls, like the output
+  thread_local std::vector<int> class_begin;
+  thread_local std::vector<int> class_end;
+  thread_local std::vector<int> candidates;
+  thread_local BoxArrays kept;
+  auto class_of = [predictions](const int i) { return static_cast<int>(predictions[i * 6 + 4]); };
+  auto is_candidate = [predictions, num_classes](const int i) {
+    const float class_id = predictions[i * 6 + 4];
+    return predictions[i * 6 + 5] > 0.0 && class_id >= 0 && class_id < num_classes;
+  };
+  class_begin.assign(num_classes + 1, 0);
   for (int i = 0; i < num_predictions; i++) {
-    ids.push_back(i);
+    if (is_candidate(i)) {
+      class_begin[class_of(i) + 1]++;
+    }
   }
-
-  // sort index by class_id & score.
-  std::sort(ids.begin(), ids.end(),
-            [input](const int& a, const int& b) -> bool {
-              const float* prediction_a = input.dataAsArray({0, a, 0});
-              float class_id_a = prediction_a[4];
-              float score_a = prediction_a[5];
-              const float* prediction_b = input.dataAsArray({0, b, 0});
-              float class_id_b = prediction_b[4];
-              float score_b = prediction_b[5];
-              if (class_id_a != class_id_b) {
-                return class_id_a < class_id_b;
-              }
-              return score_a > score_b;
-            });
-
-  Tensor result(input.shape());
-
-  // sort vector elements by index
+  std::partial_sum(class_begin.begin(), class_begin.end(), class_begin.begin());
+  class_end.assign(class_begin.begin(), class_begin.end() - 1);
+  candidates.resize(class_begin[num_classes]);
   for (int i = 0; i < num_predictions; i++) {
-    const float* prediction = input.dataAsArray({0, ids[i], 0});
-    float* store_location = result.dataAsArray({0, i, 0});
-    auto class_id = prediction[4];
-    if (class_id < num_classes) {
-      std::memcpy(store_location, prediction, 6*sizeof(float));
-    } else {
-      break;
+    if (is_candidate(i)) {
+      candidates[class_end[class_of(i)]++] = i;
     }
   }
 
-  // IoU overlap boxes marking for deletion
-  if (per_class) {
-    for (int class_id = 0 ; class_id < num_classes ; class_id++) {
-      int num_remain = 1;
-      for (int i = 0; i < num_predictions; i++) {
-        float* prediction_a = result.dataAsArray({0, i, 0});
-        float score = prediction_a[5];
-        if (score < 0.0) {
-          break;
-        } else if (score == 0.0) {
-          continue;
-        } else if (prediction_a[4] != class_id) {
-          continue;
-        }
-        box_util::Box box_a = box_util::Box(prediction_a[0], prediction_a[1], prediction_a[2], prediction_a[3]);
-
-        for (int j = i+1; j < num_predictions; j++) {
-          float* prediction_b = result.dataAsArray({0, j, 0});
-          if (prediction_b[4] != class_id) {
-            continue;
-          }
-          if (max_output_size <= num_remain) {
-            prediction_b[5] = 0.0;  // marked for deletion
-            continue;
-          }
-          box_util::Box box_b = box_util::Box(prediction_b[0], prediction_b[1], prediction_b[2], prediction_b[3]);
-          float iou = CalcIoU(box_a, box_b);
-
-          if (iou < iou_threshold) {
-            num_remain++;
-          } else {
-            prediction_b[5] = 0.0;  // marked for deletion
-          }
-        }
+  // the candidates come out of max-heaps by decreasing score: only the boxes
+  // up to the max_output_size-th kept one are ever ordered
+  auto lower_score = [predictions](const int a, const int b) {
+    return predictions[a * 6 + 5] < predictions[b * 6 + 5];
+  };
+  auto select = [&](std::vector<int>::iterator first, std::vector<int>::iterator last) {
+    const int kept_first = params.per_class ? kept.size() : 0;
+    std::make_heap(first, last, lower_score);
+    while (first != last && kept.size() - kept_first < max_output_size) {
+      std::pop_heap(first, last, lower_score);
+      --last;
+      const float* prediction = predictions + *last * 6;
+      if (!kept.Overlaps(prediction, kept_first, iou_threshold)) {
+        kept.push_back(prediction, *last);
       }
     }
-  } else {
-    int num_remain = 1;
-    for (int i = 0; i < num_predictions; i++) {
-      float* prediction_a = result.dataAsArray({0, i, 0});
-      float score = prediction_a[5];
-      if (score < 0.0) {
-        break;
-      } else if (score == 0.0) {
-        continue;
-      }
-      box_util::Box box_a = box_util::Box(prediction_a[0], prediction_a[1], prediction_a[2], prediction_a[3]);
-
-      for (int j = i+1; j < num_predictions; j++) {
-        float* prediction_b = result.dataAsArray({0, j, 0});
-         if (max_output_size <= num_remain) {
-           prediction_b[5] = 0.0;  // marked for deletion
-           continue;
-         }
-        box_util::Box box_b = box_util::Box(prediction_b[0], prediction_b[1], prediction_b[2], prediction_b[3]);
-        float iou = CalcIoU(box_a, box_b);
-
-        if (iou < iou_threshold) {
-          num_remain++;
-        } else {
-          prediction_b[5] = 0.0;  // marked for deletion
-        }
-      }
+  };
+  kept.clear();
+  if (params.per_class) {
+    for (int class_id = 0; class_id < num_classes; class_id++) {
+      select(candidates.begin() + class_begin[class_id], candidates.begin() + class_begin[class_id + 1]);
     }
+  } else {
+    select(candidates.begin(), candidates.end());
   }
 
-  // packing deletion area
+  // class by class, by decreasing score
+  output->resize({1, kept.size(), 6});
+  float* result = output->dataAsArray();
   int j = 0;
-  for (int i = 0; i < num_predictions; i++) {
-    float* prediction = result.dataAsArray({0, i, 0});
-    float score = prediction[5];
-    if (score > 0.0) {
-      float* store_location = result.dataAsArray({0, j, 0});
-      std::memcpy(store_location, prediction, 6*sizeof(float));
-      j++;
+  for (int class_id = 0; class_id < num_classes; class_id++) {
+    for (int k = 0; k < kept.size(); k++) {
+      if (class_of(kept.index[k]) == class_id) {
+        std::memcpy(result + j * 6, predictions + kept.index[k] * 6, 6 * sizeof(float));
+        j++;
+      }
     }
   }
-  // truncating deletion area
-  result.erase({0, j, 0}, {1, 0, 0});
-  return result;
 }
-
-Tensor NMS(const Tensor& input, const NMSParameters& params){
-  return NMS(input,
-             params.classes,
-             params.iou_threshold,
-             params.max_output_size,
-             params.per_class);
-};
 }  // namespace data_processor
 }  // namespace blueoil
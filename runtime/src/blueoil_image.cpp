@@ -14,8 +14,19 @@ limitations under the License.
 =============================================================================*/
 
 #include <iostream>
+#include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <cstring>
+#include <memory>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BLUEOIL_IMAGE_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BLUEOIL_IMAGE_NEON 1
+#endif
 
 #include "blueoil.hpp"
 #include "blueoil_image.hpp"
@@ -35,155 +46,304 @@ T clamp(const T x, const T lowerLimit, const T upperLimit) {
   return x;
 }
 
+namespace {
+
+// below this many output floats a pass runs on the calling thread
+const int kMinParallelElements = 1 << 16;
+
 /*
- * Resize Image (Nearest Neighbor)
+ * source taps and weights of one axis, for every destination position.
+ * the weights of a position are already divided by their sum.
  */
-Tensor ResizeHorizontal_NearestNeighbor(const Tensor &tensor, const int width) {
-  auto shape = tensor.shape();
-  const int srcHeight = shape[0];
-  const int srcWidth  = shape[1];
-  const int channels  = shape[2];
-  const int height = srcHeight;
-  Tensor dstTensor({height, width, channels});
-  //
-  int srcRGBlinesize = srcWidth * channels;
-  float xScale = static_cast<float>(width) / static_cast<float>(srcWidth);
-  float srcRGBscaled = 1.0f / xScale;
-  const float *srcImageData = tensor.dataAsArray();
-  float *srcRGBline = const_cast<float *>(srcImageData);
-  float *dstRGB = dstTensor.dataAsArray();
-  for (int dstY = 0 ; dstY < height ; dstY++) {
-    float srcRGBindexF = 0.5 / xScale;
-    for (int dstX = 0 ; dstX < width ; dstX++) {
-      float *srcRGB = srcRGBline + (static_cast<int>(srcRGBindexF) * channels);
-      for (int c = 0 ; c < channels ; c++) {
-        *dstRGB++ = *srcRGB++;
-      }
-      srcRGBindexF += srcRGBscaled;
+void ComputeTaps(const int srcSize, const int dstSize, const ResizeFilter filter,
+                 int *numTaps, std::vector<int> *index, std::vector<float> *weight) {
+  const float scale = static_cast<float>(dstSize) / static_cast<float>(srcSize);
+  if (filter == RESIZE_FILTER_NEAREST_NEIGHBOR) {
+    *numTaps = 1;
+    index->resize(dstSize);
+    weight->assign(dstSize, 1.0f);
+    // accumulated like the original per pixel loop, to pick the same pixels
+    const float step = 1.0f / scale;
+    float srcIndexF = 0.5 / scale;
+    for (int dst = 0 ; dst < dstSize ; dst++) {
+      (*index)[dst] = std::min(static_cast<int>(srcIndexF), srcSize - 1);
+      srcIndexF += step;
+    }
+    return;
+  }
+
+  // RESIZE_FILTER_BI_LINEAR: a triangle over [-window, window)
+  int window = std::floor(1 / scale);
+  window = (window < 2) ? 2 : window;
+  *numTaps = 2 * window;
+  index->resize(dstSize * *numTaps);
+  weight->resize(dstSize * *numTaps);
+  for (int dst = 0 ; dst < dstSize ; dst++) {
+    const int src = static_cast<int>(std::floor(dst / scale));
+    float totalW = 0.0;
+    for (int t = 0 ; t < *numTaps ; t++) {
+      const int x = t - window;
+      float d = std::abs(static_cast<float>(x) / static_cast<float>(window));
+      float w = 1.0 - d;
+      (*index)[dst * *numTaps + t] = clamp(src + x, 0, srcSize - 1);
+      (*weight)[dst * *numTaps + t] = w;
+      totalW += w;
+    }
+    for (int t = 0 ; t < *numTaps ; t++) {
+      (*weight)[dst * *numTaps + t] /= totalW;
     }
-    srcRGBline += srcRGBlinesize;
   }
-  return dstTensor;
 }
 
-Tensor ResizeVertical_NearestNeighbor(const Tensor &tensor, const int height) {
-  auto shape = tensor.shape();
-  const int srcHeight = shape[0];
-  const int srcWidth  = shape[1];
-  const int channels  = shape[2];
-  const int width = srcWidth;
-  Tensor dstTensor({height, width, channels});
-  const int srcScanLineSize = width * channels;
-  float yScale = static_cast<float> (height) / static_cast<float>(srcHeight);
-  float srcRGBscaled = 1.0f / yScale;
-  const float *srcImageData = tensor.dataAsArray();
-  float *srcRGBbase = const_cast<float *>(srcImageData);
-  float *dstRGB = dstTensor.dataAsArray();
-  float srcRGBindexF = 0.5 / yScale;
-  for (int dstY = 0 ; dstY < height ; dstY++) {
-    float *srcRGB = srcRGBbase + (static_cast<int>(srcRGBindexF) * srcScanLineSize);
-    for (int i = 0 ; i < srcScanLineSize ; i++) {
-      *dstRGB++ = *srcRGB++;
+/*
+ * out[0, n) (+)= w * in[0, n)
+ */
+void AccumulateRow(const float *in, const float w, const int n, const bool first, float *out) {
+  int i = 0;
+#if defined(BLUEOIL_IMAGE_NEON)
+  const float32x4_t vw = vdupq_n_f32(w);
+  for (; i + 4 <= n ; i += 4) {
+    const float32x4_t v = vmulq_f32(vld1q_f32(in + i), vw);
+    vst1q_f32(out + i, first ? v : vaddq_f32(vld1q_f32(out + i), v));
+  }
+#endif
+  for (; i < n ; i++) {
+    out[i] = first ? w * in[i] : out[i] + w * in[i];
+  }
+}
+
+/*
+ * out[j] = sum over taps t of weight[t][j] * in[offset[t][j]], j in [0, n)
+ */
+void GatherRow(const float *in, const int *offset, const float *weight, const int numTaps,
+               const int n, float *out) {
+  for (int j = 0 ; j < n ; j++) {
+    float v = 0.0;
+    for (int t = 0 ; t < numTaps ; t++) {
+      v += weight[t * n + j] * in[offset[t * n + j]];
     }
-    srcRGBindexF += srcRGBscaled;
+    out[j] = v;
   }
-  return dstTensor;
 }
 
+#if defined(BLUEOIL_IMAGE_X86)
+__attribute__((target("avx2,fma")))
+void AccumulateRowAVX2(const float *in, const float w, const int n, const bool first, float *out) {
+  int i = 0;
+  const __m256 vw = _mm256_set1_ps(w);
+  if (first) {
+    for (; i + 8 <= n ; i += 8) {
+      _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), vw));
+    }
+  } else {
+    for (; i + 8 <= n ; i += 8) {
+      _mm256_storeu_ps(out + i, _mm256_fmadd_ps(_mm256_loadu_ps(in + i), vw, _mm256_loadu_ps(out + i)));
+    }
+  }
+  for (; i < n ; i++) {
+    out[i] = first ? w * in[i] : out[i] + w * in[i];
+  }
+}
+
+__attribute__((target("avx2,fma")))
+void GatherRowAVX2(const float *in, const int *offset, const float *weight, const int numTaps,
+                   const int n, float *out) {
+  int j = 0;
+  for (; j + 8 <= n ; j += 8) {
+    __m256 v = _mm256_setzero_ps();
+    for (int t = 0 ; t < numTaps ; t++) {
+      const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offset + t * n + j));
+      v = _mm256_fmadd_ps(_mm256_loadu_ps(weight + t * n + j), _mm256_i32gather_ps(in, o, 4), v);
+    }
+    _mm256_storeu_ps(out + j, v);
+  }
+  for (; j < n ; j++) {
+    float v = 0.0;
+    for (int t = 0 ; t < numTaps ; t++) {
+      v += weight[t * n + j] * in[offset[t * n + j]];
+    }
+    out[j] = v;
+  }
+}
+
+bool HasAVX2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return avx2;
+}
+#endif
+
 /*
- * Resize Image (Bi-Linear)
+ * f(first, last) over the row range [0, rows), split into contiguous
+ * bands over the threads of pool when there is enough work to wake them
  */
-Tensor ResizeHorizontal_BiLinear(const Tensor &tensor, const int width) {
-  auto shape = tensor.shape();
-  const int srcHeight = shape[0];
-  const int srcWidth  = shape[1];
-  const int channels  = shape[2];
-  const int height = srcHeight;
-  Tensor dstTensor({height, width, channels});
-  float xScale = static_cast<float>(width) / static_cast<float>(srcWidth);
-  int xSrcWindow = std::floor(1/xScale);
-  xSrcWindow = (xSrcWindow < 2)? 2 :xSrcWindow;
-  for (int dstY = 0 ; dstY < height ; dstY++) {
-    for (int dstX = 0 ; dstX < width ; dstX++) {
-      int srcX = static_cast<int>(std::floor(dstX/xScale));
-      int srcY = dstY;
-      for (int c = 0 ; c < channels ; c++) {
-        float v = 0.0;
-        float totalW = 0.0;
-        for (int x = -xSrcWindow ; x < xSrcWindow; x++) {
-          int srcX2 = clamp(srcX + x, 0, srcWidth - 1);
-          const float *srcRGB = tensor.dataAsArray({srcY, srcX2, 0});
-          float d = std::abs(static_cast<float>(x) / static_cast<float> (xSrcWindow));
-          float w = 1.0 - d;  // Bi-Linear
-          v += w * srcRGB[c];
-          totalW += w;
+template <typename F>
+void ParallelRows(ThreadPool *pool, const int rows, const int rowElements, F f) {
+  const int numThreads = std::min(pool->num_threads(), rows);
+  if (numThreads <= 1 || static_cast<int64_t>(rows) * rowElements < kMinParallelElements) {
+    f(0, rows);
+    return;
+  }
+  const int band = (rows + numThreads - 1) / numThreads;
+  pool->ParallelFor(0, rows, band, [](void *ctx, size_t first, size_t last) {
+    (*static_cast<F*>(ctx))(static_cast<int>(first), static_cast<int>(last));
+  }, &f);
+}
+
+}  // namespace
+
+
+Resizer::Resizer(const int srcWidth, const int srcHeight, const int channels,
+                 const int width, const int height, const enum ResizeFilter filter,
+                 const int numThreads, const float scale, ThreadPool *pool)
+  : srcWidth_(srcWidth), srcHeight_(srcHeight), channels_(channels),
+    width_(width), height_(height), filter_(filter), scale_(scale),
+    ownPool_(pool ? nullptr : new ThreadPool(numThreads)),
+    pool_(pool ? pool : ownPool_.get()) {
+  assert((filter == RESIZE_FILTER_NEAREST_NEIGHBOR) || (filter == RESIZE_FILTER_BI_LINEAR));
+
+  if (srcHeight != height) {
+    ComputeTaps(srcHeight, height, filter, &rowTaps_, &rowIndex_, &rowWeight_);
+  }
+
+  if (srcWidth != width) {
+    // flatten the horizontal taps to one source offset per output float, so
+    // that a row is filtered with contiguous loads whatever the channel count
+    int numTaps;
+    std::vector<int> index;
+    std::vector<float> weight;
+    ComputeTaps(srcWidth, width, filter, &numTaps, &index, &weight);
+    const int n = width * channels;
+    columnTaps_ = numTaps;
+    columnOffset_.resize(numTaps * n);
+    columnWeight_.resize(numTaps * n);
+    for (int t = 0 ; t < numTaps ; t++) {
+      for (int x = 0 ; x < width ; x++) {
+        for (int c = 0 ; c < channels ; c++) {
+          columnOffset_[t * n + x * channels + c] = index[x * numTaps + t] * channels + c;
+          columnWeight_[t * n + x * channels + c] = weight[x * numTaps + t];
         }
-        float *dstRGB = dstTensor.dataAsArray({dstY, dstX, 0});
-        dstRGB[c] = v / totalW;
       }
     }
   }
-  return dstTensor;
+
+  // the scale goes into the weights of the last pass
+  if (srcWidth != width) {
+    for (float& w : columnWeight_) {
+      w *= scale;
+    }
+  } else {
+    for (float& w : rowWeight_) {
+      w *= scale;
+    }
+  }
+
+  if (srcHeight != height && srcWidth != width) {
+    rows_.resize(static_cast<size_t>(height) * srcWidth * channels);
+  }
 }
 
-Tensor ResizeVertical_BiLinear(const Tensor &tensor, const int height) {
-  auto shape = tensor.shape();
-  const int srcHeight = shape[0];
-  const int srcWidth  = shape[1];
-  const int channels  = shape[2];
-  const int width = srcWidth;
-  Tensor dstTensor({height, width, channels});
-  float yScale = static_cast<float> (height) / static_cast<float>(srcHeight);
-  int ySrcWindow = std::floor(1/yScale);
-  ySrcWindow = (ySrcWindow < 2)? 2 :ySrcWindow;
-  for (int dstY = 0 ; dstY < height ; dstY++) {
-    for (int dstX = 0 ; dstX < width ; dstX++) {
-      int srcX = dstX;
-      int srcY = static_cast<int>(std::floor(dstY/yScale));
-      for (int c = 0 ; c < channels ; c++) {
-        float v = 0.0;
-        float totalW = 0.0;
-        for (int y = -ySrcWindow ; y < ySrcWindow ; y++) {
-          int srcY2 = clamp(srcY + y, 0, srcHeight - 1);
-          const float *srcRGB = tensor.dataAsArray({srcY2, srcX, 0});
-          float d = std::abs(static_cast<float>(y) / static_cast<float> (ySrcWindow));
-          float w = 1.0 - d;  // Bi-Linear
-          v += w * srcRGB[c];
-          totalW += w;
-        }
-        float *dstRGB = dstTensor.dataAsArray({dstY, dstX, 0});
-        dstRGB[c] = v / totalW;
+bool Resizer::Matches(const int srcWidth, const int srcHeight, const int channels,
+                      const int width, const int height, const enum ResizeFilter filter,
+                      const float scale) const {
+  return srcWidth_ == srcWidth && srcHeight_ == srcHeight && channels_ == channels &&
+         width_ == width && height_ == height && filter_ == filter && scale_ == scale;
+}
+
+void Resizer::ResizeRows(const float *src, float *dst) {
+  const int n = srcWidth_ * channels_;
+  auto accumulate = AccumulateRow;
+#if defined(BLUEOIL_IMAGE_X86)
+  if (simd_ && HasAVX2()) {
+    accumulate = AccumulateRowAVX2;
+  }
+#endif
+  if (srcHeight_ == height_) {
+    // nothing to resize, only the scale to apply
+    ParallelRows(pool_, height_, n, [&](int first, int last) {
+      accumulate(src + static_cast<size_t>(first) * n, scale_, (last - first) * n, true,
+                 dst + static_cast<size_t>(first) * n);
+    });
+    return;
+  }
+  ParallelRows(pool_, height_, n, [&](int first, int last) {
+    for (int y = first ; y < last ; y++) {
+      for (int t = 0 ; t < rowTaps_ ; t++) {
+        const int srcY = rowIndex_[y * rowTaps_ + t];
+        accumulate(src + static_cast<size_t>(srcY) * n, rowWeight_[y * rowTaps_ + t], n, t == 0,
+                   dst + static_cast<size_t>(y) * n);
       }
     }
+  });
+}
+
+void Resizer::ResizeColumns(const float *src, const int rows, float *dst) {
+  const int srcN = srcWidth_ * channels_;
+  const int n = width_ * channels_;
+  auto gather = GatherRow;
+#if defined(BLUEOIL_IMAGE_X86)
+  if (simd_ && HasAVX2()) {
+    gather = GatherRowAVX2;
+  }
+#endif
+  ParallelRows(pool_, rows, n, [&](int first, int last) {
+    for (int y = first ; y < last ; y++) {
+      gather(src + static_cast<size_t>(y) * srcN, columnOffset_.data(), columnWeight_.data(),
+             columnTaps_, n, dst + static_cast<size_t>(y) * n);
+    }
+  });
+}
+
+void Resizer::Run(const float *src, float *dst) {
+  const bool vertical = srcHeight_ != height_;
+  const bool horizontal = srcWidth_ != width_;
+  // the vertical pass goes first: it is a plain weighted sum of rows, and
+  // when shrinking it leaves fewer rows to the gathering horizontal pass
+  if (vertical && horizontal) {
+    ResizeRows(src, rows_.data());
+    ResizeColumns(rows_.data(), height_, dst);
+  } else if (vertical) {
+    ResizeRows(src, dst);
+  } else if (horizontal) {
+    ResizeColumns(src, height_, dst);
+  } else if (scale_ != 1.0f) {
+    ResizeRows(src, dst);
+  } else {
+    std::memcpy(dst, src, sizeof(float) * height_ * width_ * channels_);
   }
-  return dstTensor;
+}
+
+Tensor Resizer::Run(const Tensor& image) {
+  Tensor dstImage({height_, width_, channels_});
+  Run(image.dataAsArray(), dstImage.dataAsArray());
+  return dstImage;
 }
 
 Tensor Resize(const Tensor& image, const int width, const int height,
               const enum ResizeFilter filter) {
-  auto shape = image.shape();
-  int channels = shape[2];
+  Tensor dstImage;
+  Resize(image, width, height, filter, &dstImage);
+  return dstImage;
+}
+
+void Resize(const TensorView& image, const int width, const int height,
+            const enum ResizeFilter filter, Tensor *output, const float scale) {
+  auto& shape = image.shape();
   assert(shape.size() == 3);  // 3D shape: HWC
+  int channels = shape[2];
   assert((channels == 1) || (channels == 3));  // grayscale or RGB
   assert((filter == RESIZE_FILTER_NEAREST_NEIGHBOR) || (filter == RESIZE_FILTER_BI_LINEAR));
   const int srcHeight = shape[0];
   const int srcWidth  = shape[1];
-  Tensor dstImage = image;
-  if  (srcWidth != width) {
-    if (filter == RESIZE_FILTER_NEAREST_NEIGHBOR) {
-      dstImage = ResizeHorizontal_NearestNeighbor(dstImage, width);
-    } else {  // RESIZE_FILTER_BI_LINEAR
-      dstImage = ResizeHorizontal_BiLinear(dstImage, width);
-    }
-  }
-  if  (srcHeight != height) {
-    if (filter == RESIZE_FILTER_NEAREST_NEIGHBOR) {
-      dstImage = ResizeVertical_NearestNeighbor(dstImage, height);
-    } else {  // RESIZE_FILTER_BI_LINEAR
-      dstImage = ResizeVertical_BiLinear(dstImage, height);
-    }
+
+  // video frames keep their size, so the tables of the last call are reused.
+  // the resizers of all the calling threads share one pool.
+  static ThreadPool pool;
+  thread_local std::unique_ptr<Resizer> resizer;
+  if (!resizer || !resizer->Matches(srcWidth, srcHeight, channels, width, height, filter, scale)) {
+    resizer.reset(new Resizer(srcWidth, srcHeight, channels, width, height, filter, 0, scale, &pool));
   }
-  return dstImage;
+  output->resize({height, width, channels});
+  resizer->Run(image.dataAsArray(), output->dataAsArray());
 }
 
 
@@ -0,0 +1,353 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=============================================================================*/
+
+#include <dlfcn.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "blueoil.hpp"
+
+// dlk libraries generated before the uint8 input path do not export it
+extern "C" bool network_run_u8(Network *nn, const uint8_t *input, float *output) __attribute__((weak));
+// nor do those with the constants compiled in
+extern "C" void network_set_weight_path(Network *nn, const char *path) __attribute__((weak));
+// nor those starting threads of their own only
+extern "C" void network_set_thread_pool(Network *nn,
+                                        void (*parallel_for)(void *pool, size_t begin, size_t end, size_t grain,
+                                                             void (*invoke)(void *ctx, size_t first, size_t last),
+                                                             void *ctx),
+                                        void *pool, int num_threads) __attribute__((weak));
+
+
+namespace blueoil {
+
+namespace {
+
+// set while the thread runs a part of a job, so that a ParallelFor called from
+// there does not wait for workers which may all be waiting for it
+thread_local bool inside_job = false;
+
+template <typename F>
+void LoadSymbol(void* handle, const char* name, F* f) {
+  *f = reinterpret_cast<F>(dlsym(handle, name));
+}
+
+}  // namespace
+
+
+struct ThreadPool::Impl {
+  struct Job {
+    Invoke invoke;
+    void* ctx;
+    size_t end;
+    size_t grain;
+    std::atomic<size_t> next;
+    // threads working on the job, the caller included
+    int users;
+  };
+
+  explicit Impl(int num_threads);
+  ~Impl();
+
+  void Loop();
+  void Work(Job* job);
+  void Remove(Job* job);
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::deque<Job*> jobs;
+  bool stopping = false;
+};
+
+ThreadPool::Impl::Impl(int num_threads) {
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // the thread calling ParallelFor works too
+  for (int i = 1; i < num_threads; ++i) {
+    workers.emplace_back(&Impl::Loop, this);
+  }
+}
+
+ThreadPool::Impl::~Impl() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Impl::Loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+    if (stopping) {
+      return;
+    }
+    Job* job = jobs.front();
+    ++job->users;
+    lock.unlock();
+    Work(job);
+    lock.lock();
+    // nothing left to claim, the next job is for whoever comes along
+    Remove(job);
+    if (--job->users == 0) {
+      done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::Impl::Work(Job* job) {
+  const bool was_inside = inside_job;
+  inside_job = true;
+  for (;;) {
+    const size_t first = job->next.fetch_add(job->grain);
+    if (first >= job->end) {
+      break;
+    }
+    job->invoke(job->ctx, first, std::min(first + job->grain, job->end));
+  }
+  inside_job = was_inside;
+}
+
+void ThreadPool::Impl::Remove(Job* job) {
+  auto it = std::find(jobs.begin(), jobs.end(), job);
+  if (it != jobs.end()) {
+    jobs.erase(it);
+  }
+}
+
+
+ThreadPool::ThreadPool(int num_threads)
+  : impl_(new Impl(num_threads)) {
+}
+
+ThreadPool::~ThreadPool() {
+}
+
+int ThreadPool::num_threads() const {
+  return static_cast<int>(impl_->workers.size()) + 1;
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain, Invoke invoke, void *ctx) {
+  if (end <= begin) {
+    return;
+  }
+  grain = std::max<size_t>(grain, 1);
+
+  if (inside_job || impl_->workers.empty() || end - begin <= grain) {
+    for (size_t first = begin; first < end;) {
+      const size_t last = first + std::min(grain, end - first);
+      invoke(ctx, first, last);
+      first = last;
+    }
+    return;
+  }
+
+  Impl::Job job;
+  job.invoke = invoke;
+  job.ctx = ctx;
+  job.end = end;
+  job.grain = grain;
+  job.next = begin;
+  job.users = 1;
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->jobs.push_back(&job);
+  }
+  impl_->wake.notify_all();
+
+  impl_->Work(&job);
+
+  std::unique_lock<std::mutex> lock(impl_->mutex);
+  impl_->Remove(&job);
+  --job.users;
+  // the last ranges may still run on workers
+  impl_->done.wait(lock, [&job] { return job.users == 0; });
+}
+
+void ThreadPool::ParallelFor(void *pool, size_t begin, size_t end, size_t grain, Invoke invoke, void *ctx) {
+  static_cast<ThreadPool*>(pool)->ParallelFor(begin, end, grain, invoke, ctx);
+}
+
+
+std::shared_ptr<const NetworkLibrary> NetworkLibrary::Linked() {
+  static const std::shared_ptr<const NetworkLibrary> linked = [] {
+    std::shared_ptr<NetworkLibrary> library(new NetworkLibrary());
+    library->create = &network_create;
+    library->destroy = &network_delete;
+    library->init = &network_init;
+    library->get_input_rank = &network_get_input_rank;
+    library->get_output_rank = &network_get_output_rank;
+    library->get_input_shape = &network_get_input_shape;
+    library->get_output_shape = &network_get_output_shape;
+    library->run = &network_run;
+    library->run_u8 = network_run_u8;
+    library->set_weight_path = network_set_weight_path;
+    library->set_thread_pool = network_set_thread_pool;
+    return library;
+  }();
+  return linked;
+}
+
+std::shared_ptr<const NetworkLibrary> NetworkLibrary::Open(const std::string& path) {
+  // local, so that the networks of several libraries do not resolve to each other
+  void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr) {
+    throw std::runtime_error("cannot load " + path + ": " + dlerror());
+  }
+
+  std::shared_ptr<NetworkLibrary> library(new NetworkLibrary());
+  library->path_ = path;
+  library->handle_ = handle;
+
+  LoadSymbol(handle, "network_create", &library->create);
+  LoadSymbol(handle, "network_delete", &library->destroy);
+  LoadSymbol(handle, "network_init", &library->init);
+  LoadSymbol(handle, "network_get_input_rank", &library->get_input_rank);
+  LoadSymbol(handle, "network_get_output_rank", &library->get_output_rank);
+  LoadSymbol(handle, "network_get_input_shape", &library->get_input_shape);
+  LoadSymbol(handle, "network_get_output_shape", &library->get_output_shape);
+  LoadSymbol(handle, "network_run", &library->run);
+  LoadSymbol(handle, "network_run_u8", &library->run_u8);
+  LoadSymbol(handle, "network_set_weight_path", &library->set_weight_path);
+  LoadSymbol(handle, "network_set_thread_pool", &library->set_thread_pool);
+
+  if (library->create == nullptr || library->destroy == nullptr || library->init == nullptr ||
+      library->get_input_rank == nullptr || library->get_output_rank == nullptr ||
+      library->get_input_shape == nullptr || library->get_output_shape == nullptr ||
+      library->run == nullptr) {
+    throw std::runtime_error(path + " is not a dlk network library");
+  }
+
+  return library;
+}
+
+NetworkLibrary::~NetworkLibrary() {
+  if (handle_ != nullptr) {
+    dlclose(handle_);
+  }
+}
+
+
+ModelRegistry::Model::Model(const std::string& meta_yaml_path, std::shared_ptr<const NetworkLibrary> library,
+                            ThreadPool* pool)
+  : predictor_(meta_yaml_path, std::move(library), pool) {
+}
+
+Tensor ModelRegistry::Model::Run(const Tensor& image) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return predictor_.Run(image);
+}
+
+void ModelRegistry::Model::Run(const Tensor& image, Tensor* output) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  predictor_.Run(image, output);
+}
+
+void ModelRegistry::Model::Run(const TensorU8& image, Tensor* output) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  predictor_.Run(image, output);
+}
+
+
+struct ModelRegistry::Impl {
+  explicit Impl(int num_threads)
+    : pool(num_threads) {
+  }
+
+  ThreadPool pool;
+  mutable std::mutex mutex;
+  std::map<std::string, std::shared_ptr<Model>> models;
+};
+
+ModelRegistry::ModelRegistry(int num_threads)
+  : impl_(new Impl(num_threads)) {
+}
+
+ModelRegistry::~ModelRegistry() {
+}
+
+void ModelRegistry::Load(const std::string& name, const std::string& meta_yaml_path,
+                         const std::string& library_path) {
+  // loading takes long, requests keep going to the current version meanwhile
+  auto library = library_path.empty() ? NetworkLibrary::Linked() : NetworkLibrary::Open(library_path);
+  auto model = std::make_shared<Model>(meta_yaml_path, std::move(library), &impl_->pool);
+
+  std::shared_ptr<Model> previous;
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    previous = std::move(impl_->models[name]);
+    impl_->models[name] = std::move(model);
+  }
+  // requests holding the previous version unload it when they are done,
+  // otherwise it goes here, outside the lock
+}
+
+bool ModelRegistry::Unload(const std::string& name) {
+  std::shared_ptr<Model> previous;
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    auto it = impl_->models.find(name);
+    if (it == impl_->models.end()) {
+      return false;
+    }
+    previous = std::move(it->second);
+    impl_->models.erase(it);
+  }
+  return true;
+}
+
+std::vector<std::string> ModelRegistry::Names() const {
+  std::lock_guard<std::mutex> lock(impl_->mutex);
+  std::vector<std::string> names;
+  for (const auto& model : impl_->models) {
+    names.push_back(model.first);
+  }
+  return names;
+}
+
+std::shared_ptr<ModelRegistry::Model> ModelRegistry::Get(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(impl_->mutex);
+  auto it = impl_->models.find(name);
+  if (it == impl_->models.end()) {
+    throw std::out_of_range("no model called " + name);
+  }
+  return it->second;
+}
+
+Tensor ModelRegistry::Run(const std::string& name, const Tensor& image) {
+  return Get(name)->Run(image);
+}
+
+void ModelRegistry::Run(const std::string& name, const Tensor& image, Tensor* output) {
+  Get(name)->Run(image, output);
+}
+
+}  // namespace blueoil
@@ -49,6 +49,34 @@ Tensor Tensor_fromCVMat(cv::Mat img) {
   return tensor;
 }
 
+/*
+ * accept BGR OpenCV Mat images (not RGB), keeping the bytes
+ */
+TensorU8 TensorU8_fromCVMat(cv::Mat img) {
+  int width = img.cols;
+  int height = img.rows;
+  int channels = img.elemSize();
+  assert((channels == 1) || (channels == 3));  // grayscale or RGB
+  blueoil::TensorU8 tensor({height, width, channels});
+  uint8_t *tensorPixel = tensor.dataAsArray();
+  for (int y = 0 ; y < height ; y++) {
+    const uchar *imgPixel = &(img.data[y * img.step]);
+    for (int x = 0 ; x < width ; x++) {
+      if (channels == 1) {
+        tensorPixel[0] = imgPixel[0];  // I (grayscale)
+      } else {  // (channels == 3)
+        tensorPixel[0] = imgPixel[2];  // R
+        tensorPixel[1] = imgPixel[1];  // G
+        tensorPixel[2] = imgPixel[0];  // B
+      }
+      tensorPixel += channels;
+      imgPixel += channels;
+    }
+  }
+  //
+  return tensor;
+}
+
 /*
  * generate BGR OpenCV Mat images (not RGB)
  */
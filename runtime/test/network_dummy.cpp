@@ -13,14 +13,39 @@ See the License for the specific language governing permissions and
 limitations under the License.
 =============================================================================*/
 
+#include <algorithm>
+
 #include "blueoil.hpp"
 
+// a 1x2x2x3 input and 1x3 output network whose outputs are all input[0].
+// it fails on a negative input[0].
 extern "C" {  // dummy functions
   Network *network_create() { return NULL; }
+  void network_delete(Network *) { ; }
   bool network_init(Network *) { return true; }
-  int network_get_input_rank(const Network *) { return 0; }
-  int network_get_output_rank(const Network *) { return 0; }
-  void network_get_input_shape(const Network *, int *) { ; }
-  void network_get_output_shape(const Network *, int *) { ; }
-  void network_run(Network *, const float *, float *) { ; }
+  void network_set_num_threads(Network *, int) { ; }
+  void network_set_thread_affinity(Network *, const int *, int) { ; }
+  void network_enable_profiling(Network *, int) { ; }
+  void network_clear_profile(Network *) { ; }
+  int network_get_profile(Network *, int, char *, int) { return 0; }
+  int network_get_input_rank(const Network *) { return 4; }
+  int network_get_output_rank(const Network *) { return 2; }
+  void network_get_input_shape(const Network *, int *shape) {
+    const int input_shape[] = {1, 2, 2, 3};
+    std::copy(input_shape, input_shape + 4, shape);
+  }
+  void network_get_output_shape(const Network *, int *shape) {
+    const int output_shape[] = {1, 3};
+    std::copy(output_shape, output_shape + 2, shape);
+  }
+  bool network_run(Network *, const float *input, float *output) {
+    std::fill(output, output + 3, input[0]);
+    return input[0] >= 0;
+  }
+  bool network_run_u8(Network *, const uint8_t *, float *) { return true; }
+  bool network_run_batch(Network *, int, const float *, float *) { return true; }
+  void network_set_weight_path(Network *, const char *) { ; }
+  void network_set_thread_pool(Network *,
+                               void (*)(void *, size_t, size_t, size_t, void (*)(void *, size_t, size_t), void *),
+                               void *, int) { ; }
 }
@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 =============================================================================*/
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <utility>
@@ -190,6 +192,70 @@ int test_data_processor_formatyolov2() {
   return EXIT_SUCCESS;
 }
 
+int test_data_processor_formatyolov2_non_square() {
+  int width = 96, height = 64;
+  int num_cell_y = 2, num_cell_x = 3;
+
+  blueoil::data_processor::FormatYoloV2Parameters params;
+  params.anchors = {{0.2, 0.3}, {0.7, 0.5}};
+  params.boxes_per_cell = 2;
+  params.data_format = "NHWC";
+  params.image_size = std::make_pair(width, height);
+  params.num_classes = 3;
+
+  const int stride = params.num_classes + 5;
+  blueoil::Tensor input({1, num_cell_y, num_cell_x, stride * params.boxes_per_cell});
+  for (int i = 0 ; i < input.size() ; i++) {
+    input.data()[i] = std::sin(static_cast<float>(i));
+  }
+
+  // the boxes of class c come after the num_cell_y * num_cell_x * boxes_per_cell
+  // boxes of class c - 1, whatever the aspect of the grid
+  const int num_boxes = num_cell_y * num_cell_x * params.boxes_per_cell;
+  blueoil::Tensor expect({1, num_boxes * params.num_classes, 6});
+  for (int i = 0; i < num_cell_y; i++) {
+    for (int j = 0; j < num_cell_x; j++) {
+      for (int k = 0; k < params.boxes_per_cell; k++) {
+        const int n = (i * num_cell_x + j) * params.boxes_per_cell + k;
+        const float* predictions = input.dataAsArray({0, i, j, k * stride});
+        float max_val = 0.0;
+        for (int c_i = 0; c_i < params.num_classes; c_i++) {
+          max_val = std::max(predictions[c_i], max_val);
+        }
+        float exp_sum = 0.0;
+        for (int c_i = 0; c_i < params.num_classes; c_i++) {
+          exp_sum += std::exp(predictions[c_i] - max_val);
+        }
+        const float* p = predictions + params.num_classes;
+        float conf = 1.0 / (1.0 + std::exp(-p[0]));
+        float cx = (1.0 / (1.0 + std::exp(-p[1])) + j) / num_cell_x;
+        float cy = (1.0 / (1.0 + std::exp(-p[2])) + i) / num_cell_y;
+        float w = std::exp(p[3]) * params.anchors[k].first / num_cell_x;
+        float h = std::exp(p[4]) * params.anchors[k].second / num_cell_y;
+        for (int c_i = 0; c_i < params.num_classes; c_i++) {
+          float* e = expect.dataAsArray({0, c_i * num_boxes + n, 0});
+          e[0] = (cx - w / 2) * width;
+          e[1] = (cy - h / 2) * height;
+          e[2] = w * width;
+          e[3] = h * height;
+          e[4] = c_i;
+          e[5] = std::exp(predictions[c_i] - max_val) / exp_sum * conf;
+        }
+      }
+    }
+  }
+
+  blueoil::Tensor output = blueoil::data_processor::FormatYoloV2(input, params);
+  if (!output.allclose(expect, 0, 0.0001)) {
+    std::cerr << "test_data_processor_formatyolov2_non_square: output != expect" << std::endl;
+    output.dump();
+    expect.dump();
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 int test_data_processor_excludelowscorebox() {
   int batch_size = 1;  // support 1 only
   float threshold = 0.5;
@@ -226,6 +292,80 @@ int test_data_processor_nms() {
   return EXIT_SUCCESS;
 }
 
+int test_data_processor_in_place() {
+  // element-wise processors may write over their input
+  float data[] = {0, 51, 255, 102};
+  blueoil::Tensor tensor({1, 2, 2}, data);
+  blueoil::Tensor expect = blueoil::data_processor::DivideBy255(tensor);
+  blueoil::data_processor::DivideBy255(tensor, &tensor);
+  if (!tensor.allclose(expect)) {
+    std::cerr << "test_data_processor_in_place: DivideBy255 in place != expect" << std::endl;
+    tensor.dump();
+    expect.dump();
+    return EXIT_FAILURE;
+  }
+
+  blueoil::Tensor boxes({1, 8, 6}, reinterpret_cast<float *>(excludelowscorebox_input));
+  blueoil::data_processor::ExcludeLowScoreBox(boxes, 0.5, &boxes);
+  blueoil::Tensor boxes_expect({1, 4, 6}, reinterpret_cast<float *>(excludelowscorebox_expect));
+  if (!boxes.allclose(boxes_expect, 0, 0.0001)) {
+    std::cerr << "test_data_processor_in_place: ExcludeLowScoreBox in place != expect" << std::endl;
+    boxes.dump();
+    boxes_expect.dump();
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int test_data_processor_fused() {
+  // fused processors match the chain they replace
+  blueoil::Tensor input({3, 8, 8}, reinterpret_cast<float *>(test_input));
+  input = blueoil::util::Tensor_CHW_to_HWC(input);
+  const std::pair<int, int> size = std::make_pair(4, 4);
+
+  blueoil::Tensor expect = blueoil::data_processor::DivideBy255(
+      blueoil::data_processor::Resize(input, size));
+  blueoil::Tensor output;
+  blueoil::data_processor::ResizeAndDivideBy255(input, size, &output);
+  if (!output.allclose(expect)) {
+    std::cerr << "test_data_processor_fused: ResizeAndDivideBy255 != expect" << std::endl;
+    output.dump();
+    expect.dump();
+    return EXIT_FAILURE;
+  }
+
+  expect = blueoil::data_processor::PerImageStandardization(
+      blueoil::data_processor::Resize(input, size));
+  blueoil::data_processor::ResizeAndPerImageStandardization(input, size, &output);
+  if (!output.allclose(expect)) {
+    std::cerr << "test_data_processor_fused: ResizeAndPerImageStandardization != expect" << std::endl;
+    output.dump();
+    expect.dump();
+    return EXIT_FAILURE;
+  }
+
+  blueoil::data_processor::FormatYoloV2Parameters params;
+  params.anchors = {{0.2, 0.2}, {0.7, 0.7}};
+  params.boxes_per_cell = 2;
+  params.data_format = "NHWC";
+  params.image_size = std::make_pair(64, 64);
+  params.num_classes = 2;
+  blueoil::Tensor yolo_output({1, 2, 2, (params.boxes_per_cell+5) * params.boxes_per_cell});
+  for (int i = 0 ; i < yolo_output.size() ; i++) {
+    yolo_output.data()[i] = static_cast<float>(i) / static_cast<float>(yolo_output.size());
+  }
+  expect = blueoil::data_processor::ExcludeLowScoreBox(
+      blueoil::data_processor::FormatYoloV2(yolo_output, params), 0.3);
+  blueoil::data_processor::FormatYoloV2AndExcludeLowScoreBox(yolo_output, params, 0.3, &output);
+  if (!output.allclose(expect) || output.shape()[1] != 9) {
+    std::cerr << "test_data_processor_fused: FormatYoloV2AndExcludeLowScoreBox != expect" << std::endl;
+    output.dump();
+    expect.dump();
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
 int main(void) {
   int status_code = 0;
   std::cerr << "test_data_processor_resize" << std::endl;
@@ -238,6 +378,11 @@ int main(void) {
   if (status_code != EXIT_SUCCESS) {
     std::exit(status_code);
   }
+  std::cerr << "test_data_processor_formatyolov2_non_square" << std::endl;
+  status_code = test_data_processor_formatyolov2_non_square();
+  if (status_code != EXIT_SUCCESS) {
+    std::exit(status_code);
+  }
   std::cerr << "test_data_processor_excludelowscorebox" << std::endl;
   status_code = test_data_processor_excludelowscorebox();
   if (status_code != EXIT_SUCCESS) {
@@ -248,5 +393,15 @@ int main(void) {
   if (status_code != EXIT_SUCCESS) {
     std::exit(status_code);
   }
+  std::cerr << "test_data_processor_in_place" << std::endl;
+  status_code = test_data_processor_in_place();
+  if (status_code != EXIT_SUCCESS) {
+    std::exit(status_code);
+  }
+  std::cerr << "test_data_processor_fused" << std::endl;
+  status_code = test_data_processor_fused();
+  if (status_code != EXIT_SUCCESS) {
+    std::exit(status_code);
+  }
   std::exit(EXIT_SUCCESS);
 }
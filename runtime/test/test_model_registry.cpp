@@ -0,0 +1,160 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=============================================================================*/
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "blueoil.hpp"
+
+namespace {
+
+struct Counts {
+  std::vector<std::atomic<int>> hits;
+  size_t grain;
+  bool too_large = false;
+  blueoil::ThreadPool* nested = nullptr;
+
+  Counts(size_t size, size_t grain) : hits(size), grain(grain) {
+    for (auto& hit : hits) {
+      hit = 0;
+    }
+  }
+
+  bool AllOnce() const {
+    for (const auto& hit : hits) {
+      if (hit != 1) {
+        return false;
+      }
+    }
+    return !too_large;
+  }
+};
+
+void Count(void* ctx, size_t first, size_t last) {
+  Counts* counts = static_cast<Counts*>(ctx);
+  if (last - first > counts->grain) {
+    counts->too_large = true;
+  }
+  for (size_t i = first; i < last; ++i) {
+    ++counts->hits[i];
+  }
+}
+
+void CountNested(void* ctx, size_t first, size_t last) {
+  Counts* counts = static_cast<Counts*>(ctx);
+  Counts inner(16, 3);
+  counts->nested->ParallelFor(0, inner.hits.size(), inner.grain, &Count, &inner);
+  if (!inner.AllOnce()) {
+    counts->too_large = true;
+  }
+  Count(ctx, first, last);
+}
+
+}  // namespace
+
+int test_thread_pool() {
+  blueoil::ThreadPool pool(4);
+  if (pool.num_threads() != 4) {
+    std::cerr << "test_thread_pool: num_threads " << pool.num_threads() << " != 4" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // every index exactly once, in ranges of at most grain
+  Counts counts(1000, 7);
+  blueoil::ThreadPool::ParallelFor(&pool, 0, counts.hits.size(), counts.grain, &Count, &counts);
+  if (!counts.AllOnce()) {
+    std::cerr << "test_thread_pool: ranges do not cover [0, 1000) once" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // several callers at the same time, as the networks of several models
+  std::vector<Counts> shared;
+  for (int i = 0; i < 6; ++i) {
+    shared.emplace_back(500 + i, 1 + i);
+  }
+  std::vector<std::thread> callers;
+  for (auto& c : shared) {
+    callers.emplace_back([&pool, &c] {
+      for (int repeat = 0; repeat < 20; ++repeat) {
+        for (auto& hit : c.hits) {
+          hit = 0;
+        }
+        pool.ParallelFor(0, c.hits.size(), c.grain, &Count, &c);
+        if (!c.AllOnce()) {
+          return;
+        }
+      }
+    });
+  }
+  for (auto& caller : callers) {
+    caller.join();
+  }
+  for (const auto& c : shared) {
+    if (!c.AllOnce()) {
+      std::cerr << "test_thread_pool: concurrent ranges do not cover once" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // a call from inside a job finishes instead of waiting for busy workers
+  Counts outer(64, 1);
+  outer.nested = &pool;
+  pool.ParallelFor(0, outer.hits.size(), outer.grain, &CountNested, &outer);
+  if (!outer.AllOnce()) {
+    std::cerr << "test_thread_pool: nested ranges do not cover once" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int test_model_registry() {
+  try {
+    blueoil::NetworkLibrary::Open("no_such_dir/lib_x86.so");
+    std::cerr << "test_model_registry: Open of a missing library did not throw" << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::runtime_error&) {
+  }
+
+  blueoil::ModelRegistry registry(2);
+  try {
+    registry.Load("model", "meta.yaml", "no_such_dir/lib_x86.so");
+    std::cerr << "test_model_registry: Load of a missing library did not throw" << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::runtime_error&) {
+  }
+  if (!registry.Names().empty() || registry.Unload("model")) {
+    std::cerr << "test_model_registry: a failed Load left a model" << std::endl;
+    return EXIT_FAILURE;
+  }
+  try {
+    registry.Get("model");
+    std::cerr << "test_model_registry: Get of a missing model did not throw" << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::out_of_range&) {
+  }
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  int status_code = test_thread_pool();
+  if (status_code == EXIT_SUCCESS) {
+    status_code = test_model_registry();
+  }
+  std::exit(status_code);
+}
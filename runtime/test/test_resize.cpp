@@ -13,8 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 =============================================================================*/
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 #include "blueoil.hpp"
 #include "blueoil_image.hpp"
@@ -93,6 +96,187 @@ int test_resize() {
   return EXIT_SUCCESS;
 }
 
+int test_resizer() {
+  // a flat image stays flat, and the caller buffer gets what Resize returns
+  const int srcWidth = 300, srcHeight = 200, width = 640, height = 480;
+  std::vector<float> flat(srcHeight * srcWidth * 3, 100);
+  blueoil::Tensor input({srcHeight, srcWidth, 3}, flat);
+  blueoil::Tensor expect({height, width, 3}, std::vector<float>(height * width * 3, 100));
+  blueoil::image::Resizer resizer(srcWidth, srcHeight, 3, width, height,
+                                  blueoil::image::RESIZE_FILTER_BI_LINEAR, 4);
+  blueoil::Tensor output({height, width, 3});
+  resizer.Run(input.dataAsArray(), output.dataAsArray());
+  if (!output.allclose(expect)) {
+    std::cerr << "test_resizer: output != expect" << std::endl;
+    return EXIT_FAILURE;
+  }
+  blueoil::Tensor resized = blueoil::image::Resize(input, width, height,
+                                                   blueoil::image::RESIZE_FILTER_BI_LINEAR);
+  if (!resized.allclose(output)) {
+    std::cerr << "test_resizer: Resize != Resizer::Run" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // the rows split over a pool of the caller give the same image, frame after frame
+  blueoil::ThreadPool pool(3);
+  blueoil::image::Resizer pooled(srcWidth, srcHeight, 3, width, height,
+                                 blueoil::image::RESIZE_FILTER_BI_LINEAR, 0, 1.0f, &pool);
+  for (int frame = 0; frame < 2; frame++) {
+    blueoil::Tensor pooledOutput({height, width, 3});
+    pooled.Run(input.dataAsArray(), pooledOutput.dataAsArray());
+    if (!pooledOutput.allclose(output)) {
+      std::cerr << "test_resizer: Resizer on a caller pool != Resizer::Run" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+namespace {
+
+// source taps of one axis of the original per pixel resize
+void ReferenceTaps(const int srcSize, const int dstSize, const int dst,
+                   const blueoil::image::ResizeFilter filter,
+                   std::vector<int>* index, std::vector<double>* weight) {
+  // in float, as the source position of a pixel depends on the rounding
+  const float scale = static_cast<float>(dstSize) / static_cast<float>(srcSize);
+  index->clear();
+  weight->clear();
+  if (filter == blueoil::image::RESIZE_FILTER_NEAREST_NEIGHBOR) {
+    // the same float accumulation as the resizer, to pick the same pixels
+    const float step = 1.0f / scale;
+    float srcIndexF = 0.5 / scale;
+    for (int i = 0; i < dst; i++) {
+      srcIndexF += step;
+    }
+    index->push_back(std::min(static_cast<int>(srcIndexF), srcSize - 1));
+    weight->push_back(1.0);
+    return;
+  }
+  const int window = std::max(2, static_cast<int>(std::floor(1 / scale)));
+  const int src = static_cast<int>(std::floor(dst / scale));
+  double total = 0;
+  for (int x = -window; x < window; x++) {
+    const double w = 1.0 - std::abs(static_cast<double>(x) / window);
+    index->push_back(std::min(std::max(src + x, 0), srcSize - 1));
+    weight->push_back(w);
+    total += w;
+  }
+  for (double& w : *weight) {
+    w /= total;
+  }
+}
+
+// the resize computed pixel by pixel with both axes at once
+std::vector<float> ReferenceResize(const std::vector<float>& src, const int srcWidth, const int srcHeight,
+                                   const int channels, const int width, const int height,
+                                   const blueoil::image::ResizeFilter filter, const float scale) {
+  std::vector<float> dst(static_cast<size_t>(height) * width * channels);
+  std::vector<int> rows, columns;
+  std::vector<double> rowWeights, columnWeights;
+  for (int y = 0; y < height; y++) {
+    ReferenceTaps(srcHeight, height, y, filter, &rows, &rowWeights);
+    if (srcHeight == height) {
+      rows.assign(1, y);
+      rowWeights.assign(1, 1.0);
+    }
+    for (int x = 0; x < width; x++) {
+      ReferenceTaps(srcWidth, width, x, filter, &columns, &columnWeights);
+      if (srcWidth == width) {
+        columns.assign(1, x);
+        columnWeights.assign(1, 1.0);
+      }
+      for (int c = 0; c < channels; c++) {
+        double v = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+          for (size_t j = 0; j < columns.size(); j++) {
+            v += rowWeights[i] * columnWeights[j] * src[(rows[i] * srcWidth + columns[j]) * channels + c];
+          }
+        }
+        dst[(y * width + x) * channels + c] = v * scale;
+      }
+    }
+  }
+  return dst;
+}
+
+// largest difference relative to the largest reference value
+double MaxError(const std::vector<float>& a, const std::vector<float>& b) {
+  double error = 0, range = 1e-6;
+  for (size_t i = 0; i < a.size(); i++) {
+    error = std::max(error, static_cast<double>(std::abs(a[i] - b[i])));
+    range = std::max(range, static_cast<double>(std::abs(b[i])));
+  }
+  return error / range;
+}
+
+}  // namespace
+
+int test_resizer_values() {
+  // a gradient 4 pixels wide doubled: the taps of dst x are src x/2 - 2 ..
+  // x/2 + 1 with weights 0, 1/4, 1/2, 1/4
+  std::vector<float> gradient = {0, 1, 2, 3};
+  std::vector<float> doubled(8);
+  blueoil::image::Resizer(4, 1, 1, 8, 1, blueoil::image::RESIZE_FILTER_BI_LINEAR, 1)
+    .Run(gradient.data(), doubled.data());
+  const std::vector<float> expect = {0.25, 0.25, 1, 1, 2, 2, 2.75, 2.75};
+  if (MaxError(doubled, expect) > 1e-6) {
+    std::cerr << "test_resizer_values: doubled gradient is wrong:";
+    for (float v : doubled) {
+      std::cerr << " " << v;
+    }
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  struct Case {
+    int srcWidth, srcHeight, channels, width, height;
+    blueoil::image::ResizeFilter filter;
+    float scale;
+  };
+  const Case cases[] = {
+    {30, 20, 3, 64, 48, blueoil::image::RESIZE_FILTER_BI_LINEAR, 1.0f},
+    {300, 200, 3, 97, 61, blueoil::image::RESIZE_FILTER_BI_LINEAR, 1.0f / 255},
+    {300, 200, 3, 640, 480, blueoil::image::RESIZE_FILTER_BI_LINEAR, 1.0f},
+    {64, 48, 3, 64, 30, blueoil::image::RESIZE_FILTER_BI_LINEAR, 0.5f},
+    {64, 48, 1, 41, 48, blueoil::image::RESIZE_FILTER_BI_LINEAR, 2.0f},
+    {64, 48, 3, 64, 48, blueoil::image::RESIZE_FILTER_BI_LINEAR, 0.25f},
+    {37, 23, 3, 80, 11, blueoil::image::RESIZE_FILTER_NEAREST_NEIGHBOR, 1.0f},
+  };
+  for (const Case& c : cases) {
+    // a checkerboard of 3 pixel squares over a diagonal gradient, different per channel
+    std::vector<float> src(static_cast<size_t>(c.srcHeight) * c.srcWidth * c.channels);
+    for (int y = 0; y < c.srcHeight; y++) {
+      for (int x = 0; x < c.srcWidth; x++) {
+        for (int ch = 0; ch < c.channels; ch++) {
+          const float checker = ((x / 3 + y / 3) % 2) ? 100 : 0;
+          src[(y * c.srcWidth + x) * c.channels + ch] = checker + x + 2 * y + 50 * ch;
+        }
+      }
+    }
+    const std::vector<float> expect = ReferenceResize(src, c.srcWidth, c.srcHeight, c.channels,
+                                                      c.width, c.height, c.filter, c.scale);
+
+    std::vector<float> simd(expect.size()), portable(expect.size());
+    blueoil::image::Resizer resizer(c.srcWidth, c.srcHeight, c.channels, c.width, c.height,
+                                    c.filter, 4, c.scale);
+    resizer.Run(src.data(), simd.data());
+    blueoil::image::Resizer portableResizer(c.srcWidth, c.srcHeight, c.channels, c.width, c.height,
+                                            c.filter, 4, c.scale);
+    portableResizer.DisableSIMD();
+    portableResizer.Run(src.data(), portable.data());
+
+    if (MaxError(portable, expect) > 1e-5 || MaxError(simd, expect) > 1e-5 || MaxError(simd, portable) > 1e-5) {
+      std::cerr << "test_resizer_values: " << c.srcWidth << "x" << c.srcHeight << "x" << c.channels
+                << " -> " << c.width << "x" << c.height << " filter " << c.filter << " scale " << c.scale
+                << ": portable error " << MaxError(portable, expect)
+                << ", simd error " << MaxError(simd, expect)
+                << ", simd vs portable " << MaxError(simd, portable) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
 int command_resize(int argc, char **argv) {
 #ifdef USE_OPENCV
   char *infile = argv[1];
@@ -137,10 +321,13 @@ int main(int argc, char **argv) {
   }
   if (argc == 1) {
     status_code = test_resize();
-    if (status_code != EXIT_FAILURE) {
-      std::exit(status_code);
+    if (status_code == EXIT_SUCCESS) {
+      status_code = test_resizer();
     }
-    std::exit(EXIT_SUCCESS);
+    if (status_code == EXIT_SUCCESS) {
+      status_code = test_resizer_values();
+    }
+    std::exit(status_code);
   }
   std::cerr <<
     "Usage: " << argv[0] << " # unit test. no news is good news" << std::endl <<
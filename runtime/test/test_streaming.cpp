@@ -0,0 +1,175 @@
+/* Copyright 2019 The Blueoil Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+=============================================================================*/
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "blueoil.hpp"
+
+// the network is network_dummy.cpp: every output is input[0], and a negative
+// input[0] makes it fail
+namespace {
+
+const char* meta_yaml = "streaming_meta.yaml";
+
+void WriteMeta() {
+  std::ofstream meta(meta_yaml);
+  meta << "TASK: IMAGE.CLASSIFICATION\n"
+       << "IMAGE_SIZE: [2, 2]\n"
+       << "CLASSES: [a, b, c]\n"
+       << "PRE_PROCESSOR:\n"
+       << "POST_PROCESSOR:\n";
+}
+
+blueoil::Tensor Frame(float value) {
+  return blueoil::Tensor({1, 2, 2, 3}, std::vector<float>(12, value));
+}
+
+}  // namespace
+
+int test_streaming_order() {
+  blueoil::StreamingPredictor predictor(meta_yaml, 2);
+
+  // several pushers at once; the results must come in the order of the ids
+  const int pushers = 4;
+  const int frames_per_pusher = 25;
+  const int frames = pushers * frames_per_pusher;
+  std::vector<float> pushed_values(frames, -1.0f);
+  std::vector<uint64_t> delivered_ids;
+  std::vector<float> delivered_values;
+  std::mutex mutex;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < pushers; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < frames_per_pusher; ++i) {
+        const float value = t * frames_per_pusher + i;
+        const uint64_t id = predictor.Push(Frame(value), [&](uint64_t id, const blueoil::Tensor& output) {
+          // the post-process thread is the only writer
+          delivered_ids.push_back(id);
+          delivered_values.push_back(output.dataAsArray()[0]);
+        });
+        std::lock_guard<std::mutex> lock(mutex);
+        pushed_values[id] = value;
+      }
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  predictor.Flush();
+
+  if (delivered_ids.size() != static_cast<size_t>(frames)) {
+    std::cerr << "test_streaming_order: " << delivered_ids.size() << " of " << frames
+              << " frames delivered after Flush" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < frames; ++i) {
+    if (delivered_ids[i] != static_cast<uint64_t>(i)) {
+      std::cerr << "test_streaming_order: frame " << delivered_ids[i] << " delivered at " << i << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (delivered_values[i] != pushed_values[i]) {
+      std::cerr << "test_streaming_order: frame " << i << " has the output of " << delivered_values[i]
+                << " instead of " << pushed_values[i] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int test_streaming_flush() {
+  blueoil::StreamingPredictor predictor(meta_yaml, 1);
+
+  std::vector<std::future<blueoil::StreamingResult>> results;
+  for (int i = 0; i < 10; ++i) {
+    results.push_back(predictor.Push(Frame(i)));
+  }
+  predictor.Flush();
+
+  for (int i = 0; i < 10; ++i) {
+    if (results[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      std::cerr << "test_streaming_flush: frame " << i << " not ready after Flush" << std::endl;
+      return EXIT_FAILURE;
+    }
+    const blueoil::StreamingResult result = results[i].get();
+    if (result.frame_id != static_cast<uint64_t>(i) || result.output.dataAsArray()[0] != i) {
+      std::cerr << "test_streaming_flush: wrong result for frame " << i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Flush without frames in flight returns at once
+  predictor.Flush();
+  return EXIT_SUCCESS;
+}
+
+int test_streaming_errors() {
+  blueoil::StreamingPredictor predictor(meta_yaml, 2);
+
+  // a throwing callback neither stops the pipeline nor keeps Flush waiting
+  int calls = 0;
+  for (int i = 0; i < 9; ++i) {
+    predictor.Push(Frame(i), [&calls](uint64_t id, const blueoil::Tensor&) {
+      ++calls;
+      if (id % 3 == 0) {
+        throw std::runtime_error("callback error");
+      }
+      if (id == 4) {
+        throw 4;
+      }
+    });
+  }
+  predictor.Flush();
+  if (calls != 9) {
+    std::cerr << "test_streaming_errors: " << calls << " of 9 callbacks called" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // a failed network run ends up in the future of its frame only
+  std::future<blueoil::StreamingResult> failed = predictor.Push(Frame(-1.0f));
+  std::future<blueoil::StreamingResult> next = predictor.Push(Frame(1.0f));
+  predictor.Flush();
+  try {
+    failed.get();
+    std::cerr << "test_streaming_errors: failed network run did not throw" << std::endl;
+    return EXIT_FAILURE;
+  } catch (const std::runtime_error&) {
+  }
+  if (next.get().output.dataAsArray()[0] != 1.0f) {
+    std::cerr << "test_streaming_errors: frame after a failed run is wrong" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  WriteMeta();
+  int status_code = test_streaming_order();
+  if (status_code == EXIT_SUCCESS) {
+    status_code = test_streaming_flush();
+  }
+  if (status_code == EXIT_SUCCESS) {
+    status_code = test_streaming_errors();
+  }
+  std::exit(status_code);
+}
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include <cstdlib>
 #include <iostream>
+#include <utility>
 #include "blueoil.hpp"
 
 int test_tensor() {
@@ -66,9 +67,70 @@ int test_tensor() {
   return EXIT_SUCCESS;
 }
 
+int test_tensor_u8() {
+  uint8_t tensor_data[][3] = {
+                              {1, 2, 3},
+                              {7, 8, 255}
+  };
+  float expected_data[][3] = {
+                              {1, 2, 3},
+                              {7, 8, 255}
+  };
+  blueoil::TensorU8 tensor0({2, 3}, reinterpret_cast<uint8_t*>(tensor_data));
+  blueoil::Tensor expected({2, 3}, reinterpret_cast<float*>(expected_data));
+
+  blueoil::Tensor converted = tensor0.toTensor();
+  if (!converted.allequal(expected)) {
+    std::cerr << "tensor_u8_test: toTensor() != expected" << std::endl;
+    converted.dump();
+    expected.dump();
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int test_tensor_move_and_view() {
+  float tensor_data[][3] = {
+                            {1, 2, 3},
+                            {7, 8, 9}
+  };
+  blueoil::Tensor tensor0({2, 3}, reinterpret_cast<float*>(tensor_data));
+  blueoil::Tensor expected(tensor0);
+
+  // moving hands over the storage
+  const float *data = tensor0.dataAsArray();
+  blueoil::Tensor tensor1(std::move(tensor0));
+  if (tensor1.dataAsArray() != data || !tensor1.allequal(expected)) {
+    std::cerr << "tensor_move_test: moved tensor != tensor0" << std::endl;
+    tensor1.dump();
+    return EXIT_FAILURE;
+  }
+
+  // shrinking keeps the storage
+  tensor1.resize({3});
+  if (tensor1.dataAsArray() != data || tensor1.size() != 3 || tensor1.shape().size() != 1) {
+    std::cerr << "tensor_move_test: resize({3}) reallocated" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  blueoil::TensorView view(expected);
+  if (view.dataAsArray() != expected.dataAsArray() || view.size() != 6 ||
+      view.shape() != expected.shape() || view.end() - view.begin() != 6) {
+    std::cerr << "tensor_move_test: view does not match its tensor" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
 
 int main(void) {
   int status_code = test_tensor();
+  if (status_code == EXIT_SUCCESS) {
+    status_code = test_tensor_u8();
+  }
+  if (status_code == EXIT_SUCCESS) {
+    status_code = test_tensor_move_and_view();
+  }
   std::exit(status_code);
 }
 